@@ -137,6 +137,8 @@ AUTH   *authgss_create		(CLIENT *, gss_name_t, struct rpc_gss_sec *);
 AUTH   *authgss_create_default	(CLIENT *, char *, struct rpc_gss_sec *);
 bool_t authgss_service		(AUTH *auth, int svc);
 bool_t authgss_get_private_data (AUTH *auth, struct authgss_private_data *);
+bool_t authgss_get_seq		(AUTH *auth, uint32_t *seq);
+bool_t authgss_set_seq		(AUTH *auth, uint32_t seq);
 
 #ifdef GSSRPC__IMPL
 void	log_debug		(const char *fmt, ...);
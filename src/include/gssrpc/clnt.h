@@ -277,6 +277,21 @@ extern CLIENT *clnt_create(char *, rpcprog_t, rpcvers_t, char *);
 extern CLIENT *clnttcp_create(struct sockaddr_in *, rpcprog_t, rpcvers_t,
 			      int *, u_int, u_int);
 
+/*
+ * Pipelined calls over a TCP client handle.  After clnttcp_setnonblock(),
+ * clnttcp_send() sends a call without waiting for its reply, and
+ * clnttcp_getreply() decodes the header of the next reply (without
+ * blocking unless asked to) for the caller to match by transaction id and
+ * finish with clnttcp_endreply().
+ */
+struct rpc_msg;
+extern bool_t clnttcp_setnonblock(CLIENT *);
+extern enum clnt_stat clnttcp_send(CLIENT *, rpcproc_t, xdrproc_t, void *,
+				   uint32_t *);
+extern enum clnt_stat clnttcp_getreply(CLIENT *, struct rpc_msg *, bool_t);
+extern enum clnt_stat clnttcp_endreply(CLIENT *, struct rpc_msg *,
+				       xdrproc_t, void *);
+
 /*
  * UDP based rpc.
  * CLIENT *
@@ -94,6 +94,8 @@
 #define authgss_create		gssrpc_authgss_create
 #define authgss_create_default	gssrpc_authgss_create_default
 #define authgss_get_private_data	gssrpc_authgss_get_private_data
+#define authgss_get_seq		gssrpc_authgss_get_seq
+#define authgss_set_seq		gssrpc_authgss_set_seq
 #define authgss_service		gssrpc_authgss_service
 
 #ifdef GSSRPC__IMPL
@@ -143,6 +145,10 @@
 #define clntraw_create		gssrpc_clntraw_create
 #define clnt_create		gssrpc_clnt_create
 #define clnttcp_create		gssrpc_clnttcp_create
+#define clnttcp_setnonblock	gssrpc_clnttcp_setnonblock
+#define clnttcp_send		gssrpc_clnttcp_send
+#define clnttcp_getreply	gssrpc_clnttcp_getreply
+#define clnttcp_endreply	gssrpc_clnttcp_endreply
 #define clntudp_create		gssrpc_clntudp_create
 #define clntudp_bufcreate	gssrpc_clntudp_bufcreate
 #define clnt_pcreateerror	gssrpc_clnt_pcreateerror
@@ -223,6 +229,7 @@
 #define svc_getreq		gssrpc_svc_getreq
 #define svc_getreqset		gssrpc_svc_getreqset
 #define svc_getreqset2		gssrpc_svc_getreqset2
+#define svc_getreq_xprt		gssrpc_svc_getreq_xprt
 #define svc_run			gssrpc_svc_run
 
 #define svcraw_create		gssrpc_svcraw_create
@@ -232,6 +239,9 @@
 #define svcudp_enablecache	gssrpc_svcudp_enablecache
 
 #define svctcp_create		gssrpc_svctcp_create
+#define svctcp_accept		gssrpc_svctcp_accept
+#define svctcp_output_pending	gssrpc_svctcp_output_pending
+#define svctcp_flush		gssrpc_svctcp_flush
 
 #define svcfd_create            gssrpc_svcfd_create
 
@@ -309,5 +319,7 @@
 #define xdrrec_endofrecord	gssrpc_xdrrec_endofrecord
 #define xdrrec_skiprecord	gssrpc_xdrrec_skiprecord
 #define xdrrec_eof		gssrpc_xdrrec_eof
+#define xdrrec_setnonblock	gssrpc_xdrrec_setnonblock
+#define xdrrec_getrec		gssrpc_xdrrec_getrec
 
 #endif /* !defined(GSSRPC_RENAME_H) */
@@ -302,6 +302,7 @@ extern void	svc_getreqset2(fd_set *, int);
 #else
 extern void	svc_getreqset(int *);
 #endif
+extern bool_t	svc_getreq_xprt(SVCXPRT *);
 extern void	svc_run(void); 	 /* never returns */
 
 /*
@@ -330,6 +331,21 @@ extern int svcudp_enablecache(SVCXPRT *, uint32_t);
  */
 extern SVCXPRT *svctcp_create(int, u_int, u_int);
 
+/*
+ * Accept a connection on a tcp rendezvouser, returning a non-blocking
+ * transport to be serviced with svc_getreq_xprt() instead of through
+ * svc_fdset.
+ */
+extern SVCXPRT *svctcp_accept(SVCXPRT *);
+
+/*
+ * For a transport from svctcp_accept(): whether replies are queued waiting
+ * for the socket to become writable, and write as many of them as it will
+ * accept.  svctcp_flush() returns FALSE if the connection has failed.
+ */
+extern bool_t	svctcp_output_pending(SVCXPRT *);
+extern bool_t	svctcp_flush(SVCXPRT *);
+
 /*
  * Like svtcp_create(), except the routine takes any *open* UNIX file
  * descriptor as its first input.
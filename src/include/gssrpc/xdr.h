@@ -331,6 +331,12 @@ extern bool_t	xdrrec_skiprecord (XDR *xdrs);
 /* true if no more input */
 extern bool_t	xdrrec_eof (XDR *xdrs);
 
+/* read records without blocking, up to a maximum record size */
+extern bool_t	xdrrec_setnonblock(XDR *, u_int);
+
+/* true if a whole record has been read from a non-blocking stream */
+extern bool_t	xdrrec_getrec(XDR *, bool_t *);
+
 /* free memory buffers for xdr */
 extern void	xdr_free (xdrproc_t, void *);
 GSSRPC__END_DECLS
@@ -208,6 +208,9 @@ extern  kdb_fullresync_result_t * iprop_full_resync_1_svc(void *, struct svc_req
 #define IPROP_FULL_RESYNC_EXT 3
 extern	kdb_fullresync_result_t * iprop_full_resync_ext_1(uint32_t *, CLIENT *);
 extern	kdb_fullresync_result_t * iprop_full_resync_ext_1_svc(uint32_t *, struct svc_req *);
+#define IPROP_DELTA_RESYNC 4
+extern	kdb_fullresync_result_t * iprop_delta_resync_1(kdb_last_t *, CLIENT *);
+extern	kdb_fullresync_result_t * iprop_delta_resync_1_svc(kdb_last_t *, struct svc_req *);
 extern int krb5_iprop_prog_1_freeresult (SVCXPRT *, xdrproc_t, caddr_t);
 
 #else /* K&R C */
@@ -223,6 +226,9 @@ extern  kdb_fullresync_result_t * iprop_full_resync_1_svc();
 #define IPROP_FULL_RESYNC_EXT 3
 extern  kdb_fullresync_result_t * iprop_full_resync_ext_1(uint32_t *, CLIENT *);
 extern  kdb_fullresync_result_t * iprop_full_resync_ext_1_svc(uint32_t *, struct svc_req *);
+#define IPROP_DELTA_RESYNC 4
+extern  kdb_fullresync_result_t * iprop_delta_resync_1();
+extern  kdb_fullresync_result_t * iprop_delta_resync_1_svc();
 extern int krb5_iprop_prog_1_freeresult ();
 #endif /* K&R C */
 
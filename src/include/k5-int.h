@@ -188,7 +188,9 @@ typedef unsigned char   u_char;
 #define KRB5_CONF_CCACHE_TYPE                  "ccache_type"
 #define KRB5_CONF_CLOCKSKEW                    "clockskew"
 #define KRB5_CONF_DATABASE_NAME                "database_name"
+#define KRB5_CONF_DB_CACHE_SIZE                "db_cache_size"
 #define KRB5_CONF_DB_MODULE_DIR                "db_module_dir"
+#define KRB5_CONF_DB_PAGE_SIZE                 "db_page_size"
 #define KRB5_CONF_DEFAULT                      "default"
 #define KRB5_CONF_DEFAULT_CCACHE_NAME          "default_ccache_name"
 #define KRB5_CONF_DEFAULT_CLIENT_KEYTAB_NAME   "default_client_keytab_name"
@@ -225,6 +227,8 @@ typedef unsigned char   u_char;
 #define KRB5_CONF_K5LOGIN_AUTHORITATIVE        "k5login_authoritative"
 #define KRB5_CONF_K5LOGIN_DIRECTORY            "k5login_directory"
 #define KRB5_CONF_KADMIND_PORT                 "kadmind_port"
+#define KRB5_CONF_KADMIND_SLOW_THRESHOLD       "kadmind_slow_threshold"
+#define KRB5_CONF_KADMIND_STATS_FILE           "kadmind_stats_file"
 #define KRB5_CONF_KCM_MACH_SERVICE             "kcm_mach_service"
 #define KRB5_CONF_KCM_SOCKET                   "kcm_socket"
 #define KRB5_CONF_KDC                          "kdc"
@@ -233,6 +237,8 @@ typedef unsigned char   u_char;
 #define KRB5_CONF_KDC_MAX_DGRAM_REPLY_SIZE     "kdc_max_dgram_reply_size"
 #define KRB5_CONF_KDC_PORTS                    "kdc_ports"
 #define KRB5_CONF_KDC_REQ_CHECKSUM_TYPE        "kdc_req_checksum_type"
+#define KRB5_CONF_KDC_SLOW_THRESHOLD           "kdc_slow_threshold"
+#define KRB5_CONF_KDC_STATS_FILE               "kdc_stats_file"
 #define KRB5_CONF_KDC_TCP_PORTS                "kdc_tcp_ports"
 #define KRB5_CONF_KDC_TIMESYNC                 "kdc_timesync"
 #define KRB5_CONF_KEY_STASH_FILE               "key_stash_file"
@@ -251,8 +257,11 @@ typedef unsigned char   u_char;
 #define KRB5_CONF_LDAP_KDC_SASL_MECH           "ldap_kdc_sasl_mech"
 #define KRB5_CONF_LDAP_KDC_SASL_REALM          "ldap_kdc_sasl_realm"
 #define KRB5_CONF_LDAP_KERBEROS_CONTAINER_DN   "ldap_kerberos_container_dn"
+#define KRB5_CONF_LDAP_MAX_CONNS_PER_SERVER    "ldap_max_conns_per_server"
+#define KRB5_CONF_LDAP_PRINCIPAL_CACHE_SIZE    "ldap_principal_cache_size"
 #define KRB5_CONF_LDAP_SERVERS                 "ldap_servers"
 #define KRB5_CONF_LDAP_SERVICE_PASSWORD_FILE   "ldap_service_password_file"
+#define KRB5_CONF_LDAP_TKT_POLICY_CACHE_TTL    "ldap_ticket_policy_cache_ttl"
 #define KRB5_CONF_LIBDEFAULTS                  "libdefaults"
 #define KRB5_CONF_LOGGING                      "logging"
 #define KRB5_CONF_MASTER_KDC                   "master_kdc"
@@ -275,6 +284,7 @@ typedef unsigned char   u_char;
 #define KRB5_CONF_RENEW_LIFETIME               "renew_lifetime"
 #define KRB5_CONF_RESTRICT_ANONYMOUS_TO_TGT    "restrict_anonymous_to_tgt"
 #define KRB5_CONF_SAFE_CHECKSUM_TYPE           "safe_checksum_type"
+#define KRB5_CONF_SHORT_KEYS                   "short_keys"
 #define KRB5_CONF_SUPPORTED_ENCTYPES           "supported_enctypes"
 #define KRB5_CONF_TICKET_LIFETIME              "ticket_lifetime"
 #define KRB5_CONF_UDP_PREFERENCE_LIMIT         "udp_preference_limit"
@@ -629,6 +639,9 @@ krb5int_arcfour_gsscrypt(const krb5_keyblock *keyblock, krb5_keyusage usage,
 krb5_error_code
 k5_sha256(const krb5_data *in, uint8_t out[K5_SHA256_HASHLEN]);
 
+/* Compute a CRC-32 checksum.  c is in-out to allow chaining; init to 0. */
+void mit_crc32(krb5_pointer in, size_t in_length, unsigned long *c);
+
 /*
  * Attempt to zero memory in a way that compilers won't optimize out.
  *
@@ -691,6 +704,25 @@ zapfreestr(void *str)
     }
 }
 
+/* Return a monotonic timestamp in microseconds, for measuring intervals. */
+static inline uint64_t
+k5_monotonic_usec(void)
+{
+#ifdef CLOCK_MONOTONIC
+    struct timespec ts;
+
+    if (clock_gettime(CLOCK_MONOTONIC, &ts) == 0)
+        return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#endif
+    {
+        struct timeval tv;
+
+        if (gettimeofday(&tv, NULL) != 0)
+            return 0;
+        return (uint64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+    }
+}
+
 /*
  * Combine two keys (normally used by the hardware preauth mechanism)
  */
@@ -150,6 +150,14 @@ void krb5int_trace(krb5_context context, const char *fmt, ...);
     TRACE(c, "ccselect choosing default cache {ccache} for server " \
           "principal {princ}", cache, server)
 
+#define TRACE_DB2_CACHE_STATS(c, name, st)                              \
+    TRACE(c, "DB2 page cache for {str}: {long} hits, {long} misses, "   \
+          "{long} reads, {long} writes, {long} evictions, {long}/{long} " \
+          "pages", name, (long)(st)->cachehit, (long)(st)->cachemiss,   \
+          (long)(st)->pageread, (long)(st)->pagewrite,                  \
+          (long)(st)->pageflush, (long)(st)->curcache,                  \
+          (long)(st)->maxcache)
+
 #define TRACE_FAST_ARMOR_CCACHE(c, ccache_name)         \
     TRACE(c, "FAST armor ccache: {str}", ccache_name)
 #define TRACE_FAST_ARMOR_CCACHE_KEY(c, keyblock)                \
@@ -224,6 +232,15 @@ void krb5int_trace(krb5_context context, const char *fmt, ...);
     TRACE(c, "Retrieving {princ} from {keytab} (vno {int}, enctype {etype}) " \
           "with result: {kerr}", princ, keytab, (int) vno, enctype, err)
 
+#define TRACE_LDAP_SERVER_STATS(c, info)                                \
+    TRACE(c, "LDAP server {str}: {long} requests, {long} failures, "    \
+          "{long}us average, {long}us maximum, {int} connections",      \
+          (info)->server_name, (long)(info)->num_requests,              \
+          (long)(info)->num_failures,                                   \
+          (long)((info)->num_requests ?                                 \
+                 (info)->total_usec / (info)->num_requests : 0),        \
+          (long)(info)->max_usec, (int)(info)->num_conns)
+
 #define TRACE_LOCALAUTH_INIT_CONFLICT(c, type, oldname, newname)        \
     TRACE(c, "Ignoring localauth module {str} because it conflicts "    \
           "with an2ln type {str} from module {str}", newname, type, oldname)
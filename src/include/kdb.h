@@ -370,6 +370,9 @@ krb5_error_code krb5_db_promote ( krb5_context kcontext, char **db_args );
 krb5_error_code krb5_db_get_age ( krb5_context kcontext, char *db_name, time_t *t );
 krb5_error_code krb5_db_lock ( krb5_context kcontext, int lock_mode );
 krb5_error_code krb5_db_unlock ( krb5_context kcontext );
+krb5_error_code krb5_db_begin_txn ( krb5_context kcontext );
+krb5_error_code krb5_db_commit_txn ( krb5_context kcontext );
+krb5_error_code krb5_db_abort_txn ( krb5_context kcontext );
 krb5_error_code krb5_db_get_principal ( krb5_context kcontext,
                                         krb5_const_principal search_for,
                                         unsigned int flags,
@@ -390,6 +393,18 @@ krb5_error_code krb5_db_iterate ( krb5_context kcontext,
                                   int (*func) (krb5_pointer, krb5_db_entry *),
                                   krb5_pointer func_arg, krb5_flags iterflags );
 
+/*
+ * Iterate over principals in the order of their database keys, beginning
+ * after the principal start (or at the beginning if start is NULL), until func
+ * returns nonzero.  Return KRB5_PLUGIN_OP_NOTSUPP if the module cannot iterate
+ * in key order.
+ */
+krb5_error_code krb5_db_iterate_after ( krb5_context kcontext,
+                                        char *match_entry,
+                                        krb5_const_principal start,
+                                        int (*func) (krb5_pointer,
+                                                     krb5_db_entry *),
+                                        krb5_pointer func_arg );
 
 krb5_error_code krb5_db_store_master_key  ( krb5_context kcontext,
                                             char *keyfile,
@@ -834,7 +849,7 @@ krb5_dbe_free_string(krb5_context, char *);
  * This number indicates the date of the last incompatible change to the DAL.
  * The maj_ver field of the module's vtable structure must match this version.
  */
-#define KRB5_KDB_DAL_MAJOR_VERSION 5
+#define KRB5_KDB_DAL_MAJOR_VERSION 6
 
 /*
  * A krb5_context can hold one database object.  Modules should use
@@ -1358,6 +1373,47 @@ typedef struct _kdb_vftabl {
                                                  krb5_const_principal client,
                                                  const krb5_db_entry *server,
                                                  krb5_const_principal proxy);
+
+    /*
+     * Optional: Begin a write transaction.  Until commit_txn or abort_txn is
+     * called, put_principal and delete_principal calls are part of the
+     * transaction, and the module may hold locks and other resources across
+     * them so that a batch of changes does not pay per-call setup costs.
+     * Transactions do not nest.
+     */
+    krb5_error_code (*begin_txn)(krb5_context kcontext);
+
+    /*
+     * Optional: Commit the changes made since begin_txn.  The update log
+     * entries for the transaction are synced only after this method returns
+     * successfully; if it fails, they are discarded by resetting the update
+     * log, so replicas will resynchronize fully.
+     */
+    krb5_error_code (*commit_txn)(krb5_context kcontext);
+
+    /*
+     * Optional: End a transaction begun with begin_txn without committing it.
+     * A module which cannot roll back changes may leave the changes made
+     * since begin_txn in place.  Any update log entries for the transaction
+     * are discarded by resetting the update log.
+     */
+    krb5_error_code (*abort_txn)(krb5_context kcontext);
+
+    /*
+     * Optional: Like iterate, but visit principals in the order of their
+     * database keys, beginning with the first principal after start (or the
+     * first principal if start is NULL), and stop as soon as func returns
+     * nonzero.  Callers use this method to page through a large database
+     * without holding an iteration lock across the whole of it.  A module
+     * which can only iterate in an unstable order may return
+     * KRB5_PLUGIN_OP_NOTSUPP.
+     */
+    krb5_error_code (*iterate_after)(krb5_context kcontext,
+                                     char *match_entry,
+                                     krb5_const_principal start,
+                                     int (*func)(krb5_pointer,
+                                                 krb5_db_entry *),
+                                     krb5_pointer func_arg);
 } kdb_vftabl;
 
 #endif /* !defined(_WIN32) */
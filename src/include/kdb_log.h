@@ -71,12 +71,19 @@ krb5_error_code ulog_conv_2logentry(krb5_context context, krb5_db_entry *entry,
                                     kdb_incr_update_t *update);
 krb5_error_code ulog_conv_2dbentry(krb5_context context, krb5_db_entry **entry,
                                    kdb_incr_update_t *update);
+krb5_error_code ulog_merge_2dbentry(krb5_context context,
+                                    krb5_db_entry **entry,
+                                    kdb_incr_update_t *update);
 void ulog_free_entries(kdb_incr_update_t *updates, int no_of_updates);
 krb5_error_code ulog_set_role(krb5_context ctx, iprop_role role);
 update_status_t ulog_get_sno_status(krb5_context context,
                                     const kdb_last_t *last);
 krb5_error_code ulog_get_last(krb5_context context, kdb_last_t *last_out);
 krb5_error_code ulog_set_last(krb5_context context, const kdb_last_t *last);
+krb5_error_code ulog_find_sno(krb5_context context, kdb_sno_t sno,
+                              kdb_last_t *last_out);
+krb5_boolean ulog_sno_discarded(krb5_context context, const kdb_last_t *last);
+krb5_error_code ulog_lock(krb5_context context, int mode);
 
 typedef struct kdb_hlog {
     uint32_t        kdb_hmagic;     /* Log header magic # */
@@ -104,6 +111,11 @@ typedef struct _kdb_log_context {
     kdb_hlog_t      *ulog;
     uint32_t        ulogentries;
     int             ulogfd;
+    krb5_boolean    grouped;    /* ulog is locked for a group of updates */
+    kdb_sno_t       group_sno;  /* first serial number stored in group */
+    uint32_t        group_count; /* number of entries stored in group */
+    krb5_boolean    held;       /* ulog is locked by ulog_lock() */
+    uint64_t        ulog_usec;  /* cumulative time spent writing updates */
 } kdb_log_context;
 
 #ifdef  __cplusplus
@@ -51,8 +51,23 @@ krb5_error_code loop_setup_network(verto_ctx *ctx, void *handle,
                                    const char *progname);
 krb5_error_code loop_setup_signals(verto_ctx *ctx, void *handle,
                                    void (*reset)());
+void loop_setup_worker(void *handle, u_long only_prog, u_long skip_prog);
 void loop_free(verto_ctx *ctx);
 
+/* exported from opstats.c */
+struct opstats;
+krb5_error_code opstats_create(const char *progname, const char *filename,
+                               int worker, long slow_threshold_ms,
+                               const char *const *op_names,
+                               const char *const *phase_names,
+                               struct opstats **st_out);
+void opstats_record(struct opstats *st, int op, krb5_boolean failed,
+                    uint64_t total_usec, const uint64_t *phase_usec,
+                    const char *detail);
+krb5_error_code opstats_write(struct opstats *st);
+krb5_error_code opstats_setup_timer(verto_ctx *ctx, struct opstats *st);
+void opstats_free(struct opstats *st);
+
 /* to be supplied by the server application */
 
 /*
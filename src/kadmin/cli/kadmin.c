@@ -942,14 +942,17 @@ unlock_princ(kadm5_principal_ent_t princ, long *mask, const char *caller)
 }
 
 /*
- * Parse addprinc or modprinc arguments.  Some output fields may be
- * filled in on error.
+ * Parse the options of an addprinc or modprinc-style command, which precede
+ * the final argument.  Attribute flags are accumulated into *toset and
+ * *toclear as for krb5_flagspec_to_mask(); both may point to
+ * oprinc->attributes.  Some output fields may be filled in on error.
  */
 static int
-kadmin_parse_princ_args(int argc, char *argv[], kadm5_principal_ent_t oprinc,
+kadmin_parse_princ_opts(int argc, char *argv[], kadm5_principal_ent_t oprinc,
                         long *mask, char **pass, krb5_boolean *randkey,
                         krb5_boolean *nokey, krb5_key_salt_tuple **ks_tuple,
-                        int *n_ks_tuple, char *caller)
+                        int *n_ks_tuple, krb5_flags *toset,
+                        krb5_flags *toclear, char *caller)
 {
     int i;
     time_t date;
@@ -1071,8 +1074,7 @@ kadmin_parse_princ_args(int argc, char *argv[], kadm5_principal_ent_t oprinc,
             }
             continue;
         }
-        retval = krb5_flagspec_to_mask(argv[i], &oprinc->attributes,
-                                       &oprinc->attributes);
+        retval = krb5_flagspec_to_mask(argv[i], toset, toclear);
         if (retval)
             return -1;
         else
@@ -1080,7 +1082,27 @@ kadmin_parse_princ_args(int argc, char *argv[], kadm5_principal_ent_t oprinc,
     }
     if (i != argc - 1)
         return -1;
-    retval = kadmin_parse_name(argv[i], &oprinc->principal);
+    return 0;
+}
+
+/*
+ * Parse addprinc or modprinc arguments.  Some output fields may be
+ * filled in on error.
+ */
+static int
+kadmin_parse_princ_args(int argc, char *argv[], kadm5_principal_ent_t oprinc,
+                        long *mask, char **pass, krb5_boolean *randkey,
+                        krb5_boolean *nokey, krb5_key_salt_tuple **ks_tuple,
+                        int *n_ks_tuple, char *caller)
+{
+    krb5_error_code retval;
+
+    if (kadmin_parse_princ_opts(argc, argv, oprinc, mask, pass, randkey,
+                                nokey, ks_tuple, n_ks_tuple,
+                                &oprinc->attributes, &oprinc->attributes,
+                                caller))
+        return -1;
+    retval = kadmin_parse_name(argv[argc - 1], &oprinc->principal);
     if (retval) {
         com_err(caller, retval, _("while parsing principal"));
         return -1;
@@ -1344,6 +1366,430 @@ cleanup:
     free(ks_tuple);
 }
 
+static void
+free_princ_list(krb5_principal *princs, char **names, int count)
+{
+    int i;
+
+    for (i = 0; i < count; i++) {
+        krb5_free_principal(context, princs[i]);
+        free(names[i]);
+    }
+    free(princs);
+    free(names);
+}
+
+/*
+ * Read principal names, one per line, from filename, or from standard input
+ * if filename is "-".  Blank lines and lines beginning with '#' are ignored.
+ * Place the parsed principals and their canonical names in *princs_out and
+ * *names_out.  On failure, display an error and return nonzero.
+ */
+static int
+read_princ_list(const char *filename, char *caller,
+                krb5_principal **princs_out, char ***names_out,
+                int *count_out)
+{
+    FILE *fp;
+    char line[BUFSIZ], *p, *end, **names = NULL, **newnames;
+    krb5_principal *princs = NULL, *newprincs;
+    krb5_error_code retval;
+    int count = 0, alloc = 0, lineno = 0, ret = 1;
+
+    *princs_out = NULL;
+    *names_out = NULL;
+    *count_out = 0;
+
+    if (strcmp(filename, "-") == 0) {
+        fp = stdin;
+    } else {
+        fp = fopen(filename, "r");
+        if (fp == NULL) {
+            com_err(caller, errno, _("while opening %s"), filename);
+            return 1;
+        }
+    }
+
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        lineno++;
+        for (p = line; isspace((unsigned char)*p); p++);
+        end = p + strlen(p);
+        while (end > p && isspace((unsigned char)end[-1]))
+            *--end = '\0';
+        if (*p == '\0' || *p == '#')
+            continue;
+
+        if (count == alloc) {
+            alloc = (alloc == 0) ? 64 : alloc * 2;
+            newprincs = realloc(princs, alloc * sizeof(*princs));
+            if (newprincs == NULL) {
+                error(_("%s: Not enough memory\n"), caller);
+                goto cleanup;
+            }
+            princs = newprincs;
+            newnames = realloc(names, alloc * sizeof(*names));
+            if (newnames == NULL) {
+                error(_("%s: Not enough memory\n"), caller);
+                goto cleanup;
+            }
+            names = newnames;
+        }
+
+        retval = kadmin_parse_name(p, &princs[count]);
+        if (retval) {
+            com_err(caller, retval,
+                    _("while parsing principal on line %d of %s"), lineno,
+                    filename);
+            goto cleanup;
+        }
+        retval = krb5_unparse_name(context, princs[count], &names[count]);
+        if (retval) {
+            krb5_free_principal(context, princs[count]);
+            com_err(caller, retval, _("while canonicalizing principal"));
+            goto cleanup;
+        }
+        count++;
+    }
+    if (ferror(fp)) {
+        com_err(caller, errno, _("while reading %s"), filename);
+        goto cleanup;
+    }
+
+    *princs_out = princs;
+    *names_out = names;
+    *count_out = count;
+    princs = NULL;
+    names = NULL;
+    count = 0;
+    ret = 0;
+
+cleanup:
+    free_princ_list(princs, names, count);
+    if (fp != stdin)
+        fclose(fp);
+    return ret;
+}
+
+static void
+kadmin_addprincs_usage()
+{
+    error(_("usage: add_principals [options] {file|-}\n"));
+    error(_("\toptions are:\n"));
+    error(_("\t\t{-randkey|-nokey|-pw password} [-x db_princ_args]* "
+            "[-expire expdate]\n"
+            "\t\t[-pwexpire pwexpdate] [-maxlife maxtixlife] "
+            "[-kvno kvno]\n"
+            "\t\t[-policy policy] [-clearpolicy] "
+            "[-maxrenewlife maxrenewlife]\n"
+            "\t\t[-e keysaltlist] [{+|-}attribute]\n"));
+}
+
+void
+kadmin_addprincs(int argc, char *argv[])
+{
+    kadm5_principal_ent_rec tmpl, *ents = NULL;
+    krb5_principal *princs = NULL;
+    krb5_boolean randkey = FALSE, nokey = FALSE;
+    krb5_key_salt_tuple *ks_tuple = NULL;
+    kadm5_ret_t *results = NULL;
+    krb5_error_code retval;
+    char *pass, **names = NULL;
+    long mask;
+    int i, n_ks_tuple, count = 0;
+
+    memset(&tmpl, 0, sizeof(tmpl));
+    if (kadmin_parse_princ_opts(argc, argv, &tmpl, &mask, &pass, &randkey,
+                                &nokey, &ks_tuple, &n_ks_tuple,
+                                &tmpl.attributes, &tmpl.attributes,
+                                "add_principals")) {
+        kadmin_addprincs_usage();
+        goto cleanup;
+    }
+    if (!randkey && !nokey && pass == NULL) {
+        error(_("add_principals: one of -randkey, -nokey or -pw is "
+                "required\n"));
+        goto cleanup;
+    }
+
+    if (mask & KADM5_POLICY) {
+        if (!script_mode && !policy_exists(tmpl.policy)) {
+            fprintf(stderr, _("WARNING: policy \"%s\" does not exist\n"),
+                    tmpl.policy);
+        }
+    } else if (!(mask & KADM5_POLICY_CLR)) {
+        if (policy_exists("default")) {
+            if (!script_mode) {
+                fprintf(stderr, _("NOTICE: no policy specified; "
+                                  "assigning \"default\"\n"));
+            }
+            tmpl.policy = "default";
+            mask |= KADM5_POLICY;
+        } else if (!script_mode) {
+            fprintf(stderr, _("WARNING: no policy specified; "
+                              "defaulting to no policy\n"));
+        }
+    }
+    mask &= ~KADM5_POLICY_CLR;
+
+    if (nokey) {
+        pass = NULL;
+        mask |= KADM5_KEY_DATA;
+    } else if (randkey) {
+        pass = NULL;
+    }
+    mask |= KADM5_PRINCIPAL;
+
+    if (read_princ_list(argv[argc - 1], "add_principals", &princs, &names,
+                        &count))
+        goto cleanup;
+    ents = calloc(count + 1, sizeof(*ents));
+    results = calloc(count + 1, sizeof(*results));
+    if (ents == NULL || results == NULL) {
+        error(_("add_principals: Not enough memory\n"));
+        goto cleanup;
+    }
+    for (i = 0; i < count; i++) {
+        ents[i] = tmpl;
+        ents[i].principal = princs[i];
+    }
+
+    retval = kadm5_create_principals(handle, ents, count, mask, n_ks_tuple,
+                                     ks_tuple, pass, results);
+    if (retval) {
+        com_err("add_principals", retval, _("while creating principals"));
+        goto cleanup;
+    }
+    for (i = 0; i < count; i++) {
+        if (results[i] != 0) {
+            com_err("add_principals", results[i],
+                    _("while creating \"%s\"."), names[i]);
+        } else {
+            info(_("Principal \"%s\" created.\n"), names[i]);
+        }
+    }
+
+cleanup:
+    free_princ_list(princs, names, count);
+    free(ents);
+    free(results);
+    free(ks_tuple);
+    kadmin_free_tl_data(&tmpl.n_tl_data, &tmpl.tl_data);
+}
+
+static void
+kadmin_modprincs_usage()
+{
+    error(_("usage: modify_principals [options] {file|-}\n"));
+    error(_("\toptions are:\n"));
+    error(_("\t\t[-x db_princ_args]* [-expire expdate] "
+            "[-pwexpire pwexpdate] [-maxlife maxtixlife]\n"
+            "\t\t[-kvno kvno] [-policy policy] [-clearpolicy]\n"
+            "\t\t[-maxrenewlife maxrenewlife] [-unlock] [{+|-}attribute]\n"));
+}
+
+void
+kadmin_modprincs(int argc, char *argv[])
+{
+    kadm5_principal_ent_rec tmpl, *ents = NULL;
+    krb5_principal *princs = NULL;
+    krb5_boolean randkey = FALSE, nokey = FALSE;
+    krb5_key_salt_tuple *ks_tuple = NULL;
+    krb5_flags toset = 0, toclear = ~0;
+    kadm5_ret_t *results = NULL;
+    krb5_error_code retval;
+    char *pass, **names = NULL;
+    long mask;
+    int i, n_ks_tuple = 0, count = 0;
+
+    memset(&tmpl, 0, sizeof(tmpl));
+    retval = kadmin_parse_princ_opts(argc, argv, &tmpl, &mask, &pass,
+                                     &randkey, &nokey, &ks_tuple, &n_ks_tuple,
+                                     &toset, &toclear, "modify_principals");
+    if (retval || ks_tuple != NULL || randkey || nokey || pass || !mask) {
+        kadmin_modprincs_usage();
+        goto cleanup;
+    }
+    if (mask & KADM5_POLICY) {
+        if (!script_mode && !policy_exists(tmpl.policy)) {
+            fprintf(stderr, _("WARNING: policy \"%s\" does not exist\n"),
+                    tmpl.policy);
+        }
+    }
+
+    if (read_princ_list(argv[argc - 1], "modify_principals", &princs, &names,
+                        &count))
+        goto cleanup;
+    ents = calloc(count + 1, sizeof(*ents));
+    results = calloc(count + 1, sizeof(*results));
+    if (ents == NULL || results == NULL) {
+        error(_("modify_principals: Not enough memory\n"));
+        goto cleanup;
+    }
+    for (i = 0; i < count; i++) {
+        ents[i] = tmpl;
+        ents[i].principal = princs[i];
+    }
+
+    /* The server applies the attribute changes to each principal's current
+     * attributes. */
+    retval = kadm5_modify_principals(handle, ents, count, mask, toset,
+                                     ~toclear, results);
+    if (retval) {
+        com_err("modify_principals", retval,
+                _("while modifying principals"));
+        goto cleanup;
+    }
+    for (i = 0; i < count; i++) {
+        if (results[i] != 0) {
+            com_err("modify_principals", results[i],
+                    _("while modifying \"%s\"."), names[i]);
+        } else {
+            info(_("Principal \"%s\" modified.\n"), names[i]);
+        }
+    }
+
+cleanup:
+    free_princ_list(princs, names, count);
+    free(ents);
+    free(results);
+    free(ks_tuple);
+    kadmin_free_tl_data(&tmpl.n_tl_data, &tmpl.tl_data);
+}
+
+static void
+kadmin_randkeyprincs_usage()
+{
+    error(_("usage: randkey_principals [-keepold] [-e keysaltlist] "
+            "{file|-}\n"));
+}
+
+void
+kadmin_randkeyprincs(int argc, char *argv[])
+{
+    krb5_principal *princs = NULL;
+    krb5_boolean keepold = FALSE;
+    krb5_key_salt_tuple *ks_tuple = NULL;
+    kadm5_ret_t *results = NULL;
+    krb5_error_code retval;
+    char **names = NULL;
+    int i, n_ks_tuple = 0, count = 0;
+
+    for (i = 1; i < argc - 1; i++) {
+        if (!strcmp("-keepold", argv[i])) {
+            keepold = TRUE;
+        } else if (!strcmp("-e", argv[i])) {
+            if (++i >= argc - 1) {
+                kadmin_randkeyprincs_usage();
+                goto cleanup;
+            }
+            free(ks_tuple);
+            ks_tuple = NULL;
+            retval = krb5_string_to_keysalts(argv[i], NULL, NULL, 0,
+                                             &ks_tuple, &n_ks_tuple);
+            if (retval) {
+                com_err("randkey_principals", retval,
+                        _("while parsing keysalts %s"), argv[i]);
+                goto cleanup;
+            }
+        } else {
+            break;
+        }
+    }
+    if (argc < 2 || i != argc - 1) {
+        kadmin_randkeyprincs_usage();
+        goto cleanup;
+    }
+
+    if (read_princ_list(argv[argc - 1], "randkey_principals", &princs,
+                        &names, &count))
+        goto cleanup;
+    results = calloc(count + 1, sizeof(*results));
+    if (results == NULL) {
+        error(_("randkey_principals: Not enough memory\n"));
+        goto cleanup;
+    }
+
+    retval = kadm5_randkey_principals(handle, princs, count, keepold,
+                                      n_ks_tuple, ks_tuple, results);
+    if (retval) {
+        com_err("randkey_principals", retval,
+                _("while randomizing keys"));
+        goto cleanup;
+    }
+    for (i = 0; i < count; i++) {
+        if (results[i] != 0) {
+            com_err("randkey_principals", results[i],
+                    _("while randomizing key for \"%s\"."), names[i]);
+        } else {
+            info(_("Key for \"%s\" randomized.\n"), names[i]);
+        }
+    }
+
+cleanup:
+    free_princ_list(princs, names, count);
+    free(results);
+    free(ks_tuple);
+}
+
+void
+kadmin_delprincs(int argc, char *argv[])
+{
+    krb5_principal *princs = NULL;
+    kadm5_ret_t *results = NULL;
+    krb5_error_code retval;
+    char **names = NULL, reply[5];
+    int i, count = 0;
+
+    if (!(argc == 2 || (argc == 3 && !strcmp("-force", argv[1])))) {
+        error(_("usage: delete_principals [-force] {file|-}\n"));
+        return;
+    }
+    /* The confirmation would be read from the exhausted list. */
+    if (argc == 2 && !script_mode && !strcmp(argv[1], "-")) {
+        error(_("delete_principals: -force is required when reading "
+                "principals from standard input\n"));
+        return;
+    }
+    if (read_princ_list(argv[argc - 1], "delete_principals", &princs, &names,
+                        &count))
+        return;
+    if (argc == 2 && !script_mode) {
+        printf(_("Are you sure you want to delete %d principals? "
+                 "(yes/no): "), count);
+        if (fgets(reply, sizeof(reply), stdin) == NULL ||
+            strcmp("yes\n", reply)) {
+            fprintf(stderr, _("Principals not deleted\n"));
+            goto cleanup;
+        }
+    }
+    results = calloc(count + 1, sizeof(*results));
+    if (results == NULL) {
+        error(_("delete_principals: Not enough memory\n"));
+        goto cleanup;
+    }
+
+    retval = kadm5_delete_principals(handle, princs, count, results);
+    if (retval) {
+        com_err("delete_principals", retval,
+                _("while deleting principals"));
+        goto cleanup;
+    }
+    for (i = 0; i < count; i++) {
+        if (results[i] != 0) {
+            com_err("delete_principals", results[i],
+                    _("while deleting principal \"%s\""), names[i]);
+        } else {
+            info(_("Principal \"%s\" deleted.\n"), names[i]);
+        }
+    }
+    info(_("Make sure that you have removed these principals from all ACLs "
+           "before reusing.\n"));
+
+cleanup:
+    free_princ_list(princs, names, count);
+    free(results);
+}
+
 void
 kadmin_getprinc(int argc, char *argv[])
 {
@@ -1474,11 +1920,14 @@ cleanup:
     free(modprincstr);
 }
 
+/* Number of principal names requested at a time by list_principals. */
+#define LIST_PAGE_SIZE 1000
+
 void
 kadmin_getprincs(int argc, char *argv[])
 {
     krb5_error_code retval;
-    char *expr, **names;
+    char *expr, **names, *cursor, *next;
     int i, count;
 
     expr = NULL;
@@ -1486,14 +1935,25 @@ kadmin_getprincs(int argc, char *argv[])
         error(_("usage: get_principals [expression]\n"));
         return;
     }
-    retval = kadm5_get_principals(handle, expr, &names, &count);
-    if (retval) {
-        com_err("get_principals", retval, _("while retrieving list."));
-        return;
-    }
-    for (i = 0; i < count; i++)
-        printf("%s\n", names[i]);
-    kadm5_free_name_list(handle, names, count);
+
+    /* Print each page of names as it arrives rather than waiting for the
+     * whole list. */
+    cursor = NULL;
+    do {
+        retval = kadm5_get_principals_page(handle, expr, cursor,
+                                           LIST_PAGE_SIZE, &names, &count,
+                                           &next);
+        free(cursor);
+        cursor = next;
+        if (retval) {
+            com_err("get_principals", retval, _("while retrieving list."));
+            return;
+        }
+        for (i = 0; i < count; i++)
+            printf("%s\n", names[i]);
+        fflush(stdout);
+        kadm5_free_name_list(handle, names, count);
+    } while (cursor != NULL);
 }
 
 static int
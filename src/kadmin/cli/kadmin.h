@@ -43,6 +43,10 @@ extern void kadmin_renameprinc(int argc, char *argv[]);
 extern void kadmin_cpw(int argc, char *argv[]);
 extern void kadmin_addprinc(int argc, char *argv[]);
 extern void kadmin_modprinc(int argc, char *argv[]);
+extern void kadmin_addprincs(int argc, char *argv[]);
+extern void kadmin_modprincs(int argc, char *argv[]);
+extern void kadmin_randkeyprincs(int argc, char *argv[]);
+extern void kadmin_delprincs(int argc, char *argv[]);
 extern void kadmin_getprinc(int argc, char *argv[]);
 extern void kadmin_getprincs(int argc, char *argv[]);
 extern void kadmin_addpol(int argc, char *argv[]);
@@ -0,0 +1,200 @@
+/* -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* kadmin/dbutil/compile_dict.c - build compiled password dictionaries */
+/*
+ * Copyright (C) 2016 by the Massachusetts Institute of Technology.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * This file implements the kdb5_util compile_dict command, which converts
+ * text word lists into the compiled dictionary format read by the dict
+ * password quality module.  A compiled dictionary holds a sorted array of
+ * fixed-size word hashes, so kadmind can map it into memory instead of
+ * reading and sorting a word list when it starts.
+ */
+
+#include <k5-int.h>
+#include <kadm5/admin.h>
+#include <kadm5/server_internal.h>
+#include "kdb5_util.h"
+
+struct hashlist {
+    uint64_t *hashes;
+    size_t count;
+    size_t alloc;
+};
+
+static int
+hash_compare(const void *a, const void *b)
+{
+    uint64_t ha = *(const uint64_t *)a, hb = *(const uint64_t *)b;
+
+    return (ha > hb) - (ha < hb);
+}
+
+/* Add the hash of each line of fp to list.  Trailing carriage returns and
+ * empty lines are ignored. */
+static krb5_error_code
+read_words(FILE *fp, struct hashlist *list)
+{
+    krb5_error_code ret;
+    char *line = NULL;
+    size_t linesize = 0, newalloc;
+    ssize_t len;
+    uint64_t *newhashes;
+
+    while ((len = getline(&line, &linesize, fp)) != -1) {
+        if (len > 0 && line[len - 1] == '\n')
+            len--;
+        if (len > 0 && line[len - 1] == '\r')
+            len--;
+        if (len == 0)
+            continue;
+        if (list->count == list->alloc) {
+            newalloc = (list->alloc == 0) ? 1024 : list->alloc * 2;
+            newhashes = realloc(list->hashes, newalloc * sizeof(uint64_t));
+            if (newhashes == NULL) {
+                free(line);
+                return ENOMEM;
+            }
+            list->hashes = newhashes;
+            list->alloc = newalloc;
+        }
+        ret = k5_pwqual_dict_hash(line, len, &list->hashes[list->count]);
+        if (ret) {
+            free(line);
+            return ret;
+        }
+        list->count++;
+    }
+    free(line);
+    return ferror(fp) ? errno : 0;
+}
+
+/* Write the sorted, unique hashes in list to fp in compiled form. */
+static krb5_error_code
+write_dict(FILE *fp, const struct hashlist *list)
+{
+    unsigned char header[PWQUAL_DICT_HEADER_LEN], buf[8];
+    size_t i;
+
+    memset(header, 0, sizeof(header));
+    memcpy(header, PWQUAL_DICT_MAGIC, PWQUAL_DICT_MAGIC_LEN);
+    store_32_be(PWQUAL_DICT_VERSION, header + PWQUAL_DICT_MAGIC_LEN);
+    store_64_be(list->count, header + 16);
+    if (fwrite(header, sizeof(header), 1, fp) != 1)
+        return errno;
+    for (i = 0; i < list->count; i++) {
+        store_64_be(list->hashes[i], buf);
+        if (fwrite(buf, sizeof(buf), 1, fp) != 1)
+            return errno;
+    }
+    return 0;
+}
+
+/*
+ * kdb5_util compile_dict outfile [wordfile ...]
+ *
+ * Read words from each wordfile (or standard input if none are given, or for
+ * a wordfile of "-") and write a compiled dictionary to outfile.  The output
+ * is written to a temporary file and renamed into place, so a kadmind which
+ * has the previous dictionary mapped is not disturbed.
+ */
+void
+compile_dict(int argc, char **argv)
+{
+    krb5_error_code ret;
+    struct hashlist list = { NULL, 0, 0 };
+    const char *outfile, *infile;
+    char *tmpfile = NULL;
+    FILE *fp;
+    size_t i, n;
+    int nfiles;
+
+    if (argc < 2)
+        usage();
+    outfile = argv[1];
+    nfiles = argc - 2;
+
+    for (i = 0; i < (size_t)nfiles || (nfiles == 0 && i == 0); i++) {
+        infile = (nfiles == 0) ? "-" : argv[i + 2];
+        if (strcmp(infile, "-") == 0) {
+            ret = read_words(stdin, &list);
+        } else {
+            fp = fopen(infile, "r");
+            if (fp == NULL) {
+                com_err(progname, errno, _("while opening %s"), infile);
+                goto error;
+            }
+            ret = read_words(fp, &list);
+            fclose(fp);
+        }
+        if (ret) {
+            com_err(progname, ret, _("while reading %s"), infile);
+            goto error;
+        }
+    }
+
+    /* Sort the hashes and remove duplicates. */
+    qsort(list.hashes, list.count, sizeof(uint64_t), hash_compare);
+    for (i = 0, n = 0; i < list.count; i++) {
+        if (n == 0 || list.hashes[i] != list.hashes[n - 1])
+            list.hashes[n++] = list.hashes[i];
+    }
+    list.count = n;
+
+    if (asprintf(&tmpfile, "%s.tmp", outfile) < 0) {
+        tmpfile = NULL;
+        com_err(progname, ENOMEM, _("while writing %s"), outfile);
+        goto error;
+    }
+    fp = fopen(tmpfile, "w");
+    if (fp == NULL) {
+        com_err(progname, errno, _("while creating %s"), tmpfile);
+        goto error;
+    }
+    ret = write_dict(fp, &list);
+    if (fclose(fp) == EOF && !ret)
+        ret = errno;
+    if (!ret && rename(tmpfile, outfile) != 0)
+        ret = errno;
+    if (ret) {
+        com_err(progname, ret, _("while writing %s"), outfile);
+        unlink(tmpfile);
+        goto error;
+    }
+
+    free(tmpfile);
+    free(list.hashes);
+    return;
+
+error:
+    free(tmpfile);
+    free(list.hashes);
+    exit_status++;
+}
@@ -29,6 +29,7 @@
  */
 
 #include <k5-int.h>
+#include <k5-input.h>
 #include <kadm5/admin.h>
 #include <kadm5/server_internal.h>
 #include <kdb.h>
@@ -85,6 +86,9 @@ struct dump_args {
     krb5_boolean verbose;
     krb5_boolean omit_nra;      /* omit non-replicated attributes */
     dump_version *dump;
+    uint32_t nrecords;          /* records written (binary format only) */
+    krb5_error_code policy_err; /* first error writing a policy record */
+    krb5_timestamp since;       /* modification time cutoff for a delta */
 };
 
 /* External data */
@@ -538,6 +542,248 @@ dump_ov_princ(krb5_context context, krb5_db_entry *entry, const char *name,
     return 0;
 }
 
+/*
+ * The binary dump format consists of the header line followed by records of
+ * the form:
+ *
+ *      type (one byte: 'P' principal, 'Y' policy, 'C' checksum, or 'E' end)
+ *      length of payload (four bytes, big-endian)
+ *      payload
+ *
+ * Integers within payloads are big-endian, and counted octet strings are
+ * preceded by their length.  The records are divided into blocks of about
+ * BINARY_BLOCK_SIZE bytes, each followed by a checksum record containing the
+ * CRC-32 of the block's records.  The end record contains the number of
+ * principal and policy records in the dump followed by the CRC-32 of the
+ * final block, so that a truncated or corrupted dump is detected.  No record
+ * payload may exceed BINARY_RECORD_MAX bytes, so that the loader can reject a
+ * damaged length before allocating space for the payload.
+ */
+
+#define BINARY_BLOCK_SIZE (1024 * 1024)
+#define BINARY_RECORD_MAX BINARY_BLOCK_SIZE
+
+/* The checksum state of the binary dump block being written or read. */
+static struct {
+    unsigned long crc;
+    size_t len;
+} binary_block;
+
+static void
+binary_block_add(const void *data, size_t len)
+{
+    mit_crc32((krb5_pointer)data, len, &binary_block.crc);
+    binary_block.len += len;
+}
+
+static void
+binary_block_reset(void)
+{
+    binary_block.crc = 0;
+    binary_block.len = 0;
+}
+
+static void
+put_u16(struct k5buf *buf, unsigned int val)
+{
+    unsigned char *p = k5_buf_get_space(buf, 2);
+
+    if (p != NULL)
+        store_16_be(val, p);
+}
+
+static void
+put_u32(struct k5buf *buf, uint32_t val)
+{
+    unsigned char *p = k5_buf_get_space(buf, 4);
+
+    if (p != NULL)
+        store_32_be(val, p);
+}
+
+/* Add a counted octet string with a 16-bit length.  A longer string puts buf
+ * into an error state rather than being written with a truncated length. */
+static void
+put_data16(struct k5buf *buf, const void *data, unsigned int len)
+{
+    if (len > 0xFFFF) {
+        k5_buf_free(buf);
+        return;
+    }
+    put_u16(buf, len);
+    k5_buf_add_len(buf, data, len);
+}
+
+/* Add a counted octet string with a 32-bit length; a null string is written
+ * as an empty one. */
+static void
+put_str(struct k5buf *buf, const char *str)
+{
+    size_t len = (str == NULL) ? 0 : strlen(str);
+
+    put_u32(buf, len);
+    k5_buf_add_len(buf, str, len);
+}
+
+static void
+put_tl_data(struct k5buf *buf, krb5_tl_data *tl_data, krb5_int16 n_tl_data)
+{
+    krb5_tl_data *tlp;
+
+    put_u16(buf, n_tl_data);
+    for (tlp = tl_data; tlp != NULL; tlp = tlp->tl_data_next) {
+        put_u16(buf, tlp->tl_data_type);
+        put_data16(buf, tlp->tl_data_contents, tlp->tl_data_length);
+    }
+}
+
+/* Write a binary dump record of type type with payload data. */
+static krb5_error_code
+put_binary_record(FILE *fp, char type, const void *data, size_t len)
+{
+    unsigned char hdr[5];
+
+    hdr[0] = type;
+    store_32_be(len, hdr + 1);
+    if (fwrite(hdr, 1, sizeof(hdr), fp) != sizeof(hdr) ||
+        fwrite(data, 1, len, fp) != len)
+        return errno ? errno : EIO;
+    if (type != 'C' && type != 'E') {
+        binary_block_add(hdr, sizeof(hdr));
+        binary_block_add(data, len);
+    }
+    return 0;
+}
+
+/* Write the contents of buf to fp as a binary dump record of type type,
+ * followed by a checksum record if the current block is full. */
+static krb5_error_code
+write_binary_record(FILE *fp, char type, struct k5buf *buf)
+{
+    krb5_error_code ret;
+    unsigned char crc[4];
+
+    if (k5_buf_status(buf) != 0)
+        return ENOMEM;
+    if (buf->len > BINARY_RECORD_MAX)
+        return EINVAL;
+    ret = put_binary_record(fp, type, buf->data, buf->len);
+    if (ret || binary_block.len < BINARY_BLOCK_SIZE)
+        return ret;
+    store_32_be(binary_block.crc, crc);
+    binary_block_reset();
+    return put_binary_record(fp, 'C', crc, sizeof(crc));
+}
+
+/* Output a principal record in binary format. */
+static krb5_error_code
+dump_binary_princ(krb5_context context, krb5_db_entry *entry,
+                  const char *name, FILE *fp, krb5_boolean verbose,
+                  krb5_boolean omit_nra)
+{
+    krb5_error_code ret;
+    krb5_tl_data *tlp;
+    krb5_key_data *kdata;
+    struct k5buf buf;
+    int count, i, j;
+
+    count = 0;
+    for (tlp = entry->tl_data; tlp != NULL; tlp = tlp->tl_data_next)
+        count++;
+    if (count != entry->n_tl_data) {
+        fprintf(stderr, _("%s: tagged data list inconsistency for %s "
+                          "(counted %d, stored %d)\n"), progname, name,
+                count, (int)entry->n_tl_data);
+        return EINVAL;
+    }
+
+    k5_buf_init_dynamic(&buf);
+    put_u16(&buf, entry->len);
+    put_str(&buf, name);
+    put_u32(&buf, entry->attributes);
+    put_u32(&buf, entry->max_life);
+    put_u32(&buf, entry->max_renewable_life);
+    put_u32(&buf, entry->expiration);
+    put_u32(&buf, entry->pw_expiration);
+    put_u32(&buf, omit_nra ? 0 : entry->last_success);
+    put_u32(&buf, omit_nra ? 0 : entry->last_failed);
+    put_u32(&buf, omit_nra ? 0 : entry->fail_auth_count);
+    put_tl_data(&buf, entry->tl_data, entry->n_tl_data);
+    put_u16(&buf, entry->n_key_data);
+    for (i = 0; i < entry->n_key_data; i++) {
+        kdata = &entry->key_data[i];
+        put_u16(&buf, kdata->key_data_ver);
+        put_u16(&buf, kdata->key_data_kvno);
+        for (j = 0; j < kdata->key_data_ver; j++) {
+            put_u16(&buf, kdata->key_data_type[j]);
+            put_data16(&buf, kdata->key_data_contents[j],
+                       kdata->key_data_length[j]);
+        }
+    }
+    put_data16(&buf, entry->e_data, entry->e_length);
+
+    ret = write_binary_record(fp, 'P', &buf);
+    k5_buf_free(&buf);
+    if (ret)
+        return ret;
+
+    if (verbose)
+        fprintf(stderr, "%s\n", name);
+    return 0;
+}
+
+/* Output a policy record in binary format. */
+static void
+dump_binary_policy(void *data, osa_policy_ent_t entry)
+{
+    struct dump_args *arg = data;
+    krb5_error_code ret;
+    struct k5buf buf;
+
+    /* Stop writing after an error; dump_db() reports it. */
+    if (arg->policy_err)
+        return;
+    k5_buf_init_dynamic(&buf);
+    put_str(&buf, entry->name);
+    put_u32(&buf, entry->pw_min_life);
+    put_u32(&buf, entry->pw_max_life);
+    put_u32(&buf, entry->pw_min_length);
+    put_u32(&buf, entry->pw_min_classes);
+    put_u32(&buf, entry->pw_history_num);
+    put_u32(&buf, entry->pw_max_fail);
+    put_u32(&buf, entry->pw_failcnt_interval);
+    put_u32(&buf, entry->pw_lockout_duration);
+    put_u32(&buf, entry->attributes);
+    put_u32(&buf, entry->max_life);
+    put_u32(&buf, entry->max_renewable_life);
+    put_str(&buf, entry->allowed_keysalts);
+    put_tl_data(&buf, entry->tl_data, entry->n_tl_data);
+    ret = write_binary_record(arg->ofile, 'Y', &buf);
+    k5_buf_free(&buf);
+    if (ret)
+        arg->policy_err = ret;
+    else
+        arg->nrecords++;
+}
+
+/* Output the end record of a binary dump. */
+static krb5_error_code
+dump_binary_end(struct dump_args *args)
+{
+    krb5_error_code ret;
+    struct k5buf buf;
+
+    k5_buf_init_dynamic(&buf);
+    put_u32(&buf, args->nrecords);
+    put_u32(&buf, binary_block.crc);
+    ret = (k5_buf_status(&buf) == 0) ?
+        put_binary_record(args->ofile, 'E', buf.data, buf.len) : ENOMEM;
+    k5_buf_free(&buf);
+    if (!ret && fflush(args->ofile) != 0)
+        ret = errno;
+    return ret;
+}
+
 static krb5_error_code
 dump_iterator(void *ptr, krb5_db_entry *entry)
 {
@@ -567,12 +813,144 @@ dump_iterator(void *ptr, krb5_db_entry *entry)
 
     ret = args->dump->dump_princ(args->context, entry, name, args->ofile,
                                  args->verbose, args->omit_nra);
+    if (!ret)
+        args->nrecords++;
 
 cleanup:
     free(name);
     return ret;
 }
 
+static int
+compare_names(const void *a, const void *b)
+{
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+/* Output a binary record of type type containing only a principal name. */
+static krb5_error_code
+dump_binary_name(struct dump_args *args, char type, const char *name)
+{
+    krb5_error_code ret;
+    struct k5buf buf;
+
+    k5_buf_init_dynamic(&buf);
+    put_str(&buf, name);
+    ret = write_binary_record(args->ofile, type, &buf);
+    k5_buf_free(&buf);
+    if (ret)
+        return ret;
+    args->nrecords++;
+    return 0;
+}
+
+/* Output a record noting that the principal name was deleted. */
+static krb5_error_code
+dump_binary_delete(struct dump_args *args, const char *name)
+{
+    krb5_error_code ret;
+
+    ret = dump_binary_name(args, 'D', name);
+    if (!ret && args->verbose)
+        fprintf(stderr, _("%s (deleted)\n"), name);
+    return ret;
+}
+
+/*
+ * Output a principal record for entry if it was modified at or after
+ * args->since (or has no modification time), or else a record with just its
+ * name.  A delta made this way names every principal in the database, so the
+ * loader can delete the ones which no longer exist.
+ */
+static krb5_error_code
+dump_stamped_iterator(void *ptr, krb5_db_entry *entry)
+{
+    krb5_error_code ret;
+    struct dump_args *args = ptr;
+    krb5_timestamp mod_time, pwd_time;
+    krb5_principal mod_princ;
+    char *name;
+
+    if (krb5_dbe_lookup_mod_princ_data(args->context, entry, &mod_time,
+                                       &mod_princ) == 0)
+        krb5_free_principal(args->context, mod_princ);
+    else
+        mod_time = 0;
+    if (krb5_dbe_lookup_last_pwd_change(args->context, entry,
+                                        &pwd_time) == 0 && pwd_time > mod_time)
+        mod_time = pwd_time;
+    if (mod_time == 0 || mod_time >= args->since)
+        return dump_iterator(args, entry);
+
+    ret = krb5_unparse_name(args->context, entry->princ, &name);
+    if (ret) {
+        com_err(progname, ret, _("while unparsing principal name"));
+        return ret;
+    }
+    ret = dump_binary_name(args, 'N', name);
+    free(name);
+    return ret;
+}
+
+/*
+ * Output a principal record for each principal named in updates, or a delete
+ * record if the principal no longer exists.  Each principal is dumped once
+ * with its current contents, no matter how many updates name it.
+ */
+static krb5_error_code
+dump_delta_princs(struct dump_args *args, kdb_incr_update_t *updates,
+                  unsigned int nupdates)
+{
+    krb5_error_code ret = 0;
+    krb5_principal princ = NULL;
+    krb5_db_entry *entry;
+    char **names;
+    unsigned int i, n;
+
+    names = k5calloc(nupdates + 1, sizeof(*names), &ret);
+    if (names == NULL)
+        return ret;
+    for (i = 0; i < nupdates; i++) {
+        names[i] = k5memdup0(updates[i].kdb_princ_name.utf8str_t_val,
+                             updates[i].kdb_princ_name.utf8str_t_len, &ret);
+        if (names[i] == NULL)
+            goto cleanup;
+    }
+    qsort(names, nupdates, sizeof(*names), compare_names);
+
+    for (i = 0; i < nupdates; i = n) {
+        /* Skip over repeated updates to the same principal. */
+        for (n = i + 1; n < nupdates && !strcmp(names[i], names[n]); n++);
+
+        ret = krb5_parse_name(args->context, names[i], &princ);
+        if (ret) {
+            com_err(progname, ret, _("while parsing name %s"), names[i]);
+            goto cleanup;
+        }
+        ret = krb5_db_get_principal(args->context, princ, 0, &entry);
+        if (ret == KRB5_KDB_NOENTRY) {
+            if (args->nnames == 0 || name_matches(names[i], args))
+                ret = dump_binary_delete(args, names[i]);
+        } else if (ret == 0) {
+            ret = dump_iterator(args, entry);
+            krb5_db_free_principal(args->context, entry);
+        } else {
+            com_err(progname, ret, _("while retrieving principal %s"),
+                    names[i]);
+        }
+        krb5_free_principal(args->context, princ);
+        princ = NULL;
+        if (ret)
+            goto cleanup;
+    }
+
+cleanup:
+    for (i = 0; i < nupdates; i++)
+        free(names[i]);
+    free(names);
+    return ret;
+}
+
 static inline void
 load_err(const char *fname, int lineno, const char *msg)
 {
@@ -697,6 +1075,39 @@ process_tl_data(const char *fname, FILE *filep, int lineno,
     return 0;
 }
 
+/* Set the mask bits of dbentry implied by its (non-empty) tl-data list. */
+static void
+set_tl_data_mask(krb5_db_entry *dbentry)
+{
+    krb5_tl_data *tl;
+    XDR xdrs;
+    osa_princ_ent_rec osa_princ_ent;
+
+    for (tl = dbentry->tl_data; tl; tl = tl->tl_data_next) {
+        /* test to set mask fields */
+        if (tl->tl_data_type == KRB5_TL_KADM_DATA) {
+            /*
+             * Assuming aux_attributes will always be
+             * there
+             */
+            dbentry->mask |= KADM5_AUX_ATTRIBUTES;
+
+            /* test for an actual policy reference */
+            memset(&osa_princ_ent, 0, sizeof(osa_princ_ent));
+            xdrmem_create(&xdrs, (char *)tl->tl_data_contents,
+                          tl->tl_data_length, XDR_DECODE);
+            if (xdr_osa_princ_ent_rec(&xdrs, &osa_princ_ent)) {
+                if ((osa_princ_ent.aux_attributes & KADM5_POLICY) &&
+                    osa_princ_ent.policy != NULL)
+                    dbentry->mask |= KADM5_POLICY;
+                kdb_free_entry(NULL, NULL, &osa_princ_ent);
+            }
+            xdr_destroy(&xdrs);
+        }
+    }
+    dbentry->mask |= KADM5_TL_DATA;
+}
+
 /* Read a beta 7 entry and add it to the database.  Return -1 for end of file,
  * 0 for success and 1 for failure. */
 static int
@@ -709,7 +1120,6 @@ process_k5beta7_princ(krb5_context context, const char *fname, FILE *filep,
     unsigned int u1, u2, u3, u4, u5;
     char *name = NULL;
     krb5_key_data *kp = NULL, *kd;
-    krb5_tl_data *tl;
     krb5_error_code ret;
 
     dbentry = krb5_db_alloc(context, NULL, sizeof(*dbentry));
@@ -785,32 +1195,7 @@ process_k5beta7_princ(krb5_context context, const char *fname, FILE *filep,
     if (dbentry->n_tl_data) {
         if (process_tl_data(fname, filep, *linenop, dbentry->tl_data))
             goto fail;
-        for (tl = dbentry->tl_data; tl; tl = tl->tl_data_next) {
-            /* test to set mask fields */
-            if (tl->tl_data_type == KRB5_TL_KADM_DATA) {
-                XDR xdrs;
-                osa_princ_ent_rec osa_princ_ent;
-
-                /*
-                 * Assuming aux_attributes will always be
-                 * there
-                 */
-                dbentry->mask |= KADM5_AUX_ATTRIBUTES;
-
-                /* test for an actual policy reference */
-                memset(&osa_princ_ent, 0, sizeof(osa_princ_ent));
-                xdrmem_create(&xdrs, (char *)tl->tl_data_contents,
-                              tl->tl_data_length, XDR_DECODE);
-                if (xdr_osa_princ_ent_rec(&xdrs, &osa_princ_ent)) {
-                    if ((osa_princ_ent.aux_attributes & KADM5_POLICY) &&
-                        osa_princ_ent.policy != NULL)
-                        dbentry->mask |= KADM5_POLICY;
-                    kdb_free_entry(NULL, NULL, &osa_princ_ent);
-                }
-                xdr_destroy(&xdrs);
-            }
-        }
-        dbentry->mask |= KADM5_TL_DATA;
+        set_tl_data_mask(dbentry);
     }
 
     /* Get the key data. */
@@ -904,133 +1289,742 @@ process_k5beta7_policy(krb5_context context, const char *fname, FILE *filep,
         com_err(progname, ret, _("while creating policy"));
         return 1;
     }
-    if (verbose)
-        fprintf(stderr, _("created policy %s\n"), rec.name);
+    if (verbose)
+        fprintf(stderr, _("created policy %s\n"), rec.name);
+
+    return 0;
+}
+
+static int
+process_r1_8_policy(krb5_context context, const char *fname, FILE *filep,
+                    krb5_boolean verbose, int *linenop)
+{
+    osa_policy_ent_rec rec;
+    char namebuf[1024];
+    unsigned int refcnt;
+    int nread, ret;
+
+    memset(&rec, 0, sizeof(rec));
+
+    (*linenop)++;
+    rec.name = namebuf;
+
+    nread = fscanf(filep, "%1023s\t%u\t%u\t%u\t%u\t%u\t%u\t%u\t%u\t%u",
+                   rec.name, &rec.pw_min_life, &rec.pw_max_life,
+                   &rec.pw_min_length, &rec.pw_min_classes,
+                   &rec.pw_history_num, &refcnt, &rec.pw_max_fail,
+                   &rec.pw_failcnt_interval, &rec.pw_lockout_duration);
+    if (nread == EOF)
+        return -1;
+    if (nread != 10) {
+        fprintf(stderr, _("cannot parse policy (%d read)\n"), nread);
+        return 1;
+    }
+
+    ret = krb5_db_create_policy(context, &rec);
+    if (ret)
+        ret = krb5_db_put_policy(context, &rec);
+    if (ret) {
+        com_err(progname, ret, _("while creating policy"));
+        return 1;
+    }
+    if (verbose)
+        fprintf(stderr, "created policy %s\n", rec.name);
+
+    return 0;
+}
+
+static int
+process_r1_11_policy(krb5_context context, const char *fname, FILE *filep,
+                     krb5_boolean verbose, int *linenop)
+{
+    osa_policy_ent_rec rec;
+    krb5_tl_data *tl, *tl_next;
+    char namebuf[1024];
+    char keysaltbuf[KRB5_KDB_MAX_ALLOWED_KS_LEN + 1];
+    unsigned int refcnt;
+    int nread, c, ret = 0;
+
+    memset(&rec, 0, sizeof(rec));
+
+    (*linenop)++;
+    rec.name = namebuf;
+
+    /*
+     * Due to a historical error, iprop dumps use the same version before and
+     * after the 1.11 policy extensions.  So we need to accept both 1.8-format
+     * and 1.11-format policy entries.  Begin by reading the 1.8 fields.
+     */
+    nread = fscanf(filep, "%1023s\t%u\t%u\t%u\t%u\t%u\t%u\t%u\t%u\t%u",
+                   rec.name, &rec.pw_min_life, &rec.pw_max_life,
+                   &rec.pw_min_length, &rec.pw_min_classes,
+                   &rec.pw_history_num, &refcnt, &rec.pw_max_fail,
+                   &rec.pw_failcnt_interval, &rec.pw_lockout_duration);
+    if (nread == EOF)
+        return -1;
+    if (nread != 10) {
+        fprintf(stderr, _("cannot parse policy (%d read)\n"), nread);
+        return 1;
+    }
+
+    /* The next character should be a newline (1.8) or a tab (1.11). */
+    c = getc(filep);
+    if (c == EOF)
+        return -1;
+    if (c != '\n') {
+        /* Read the additional 1.11-format fields. */
+        rec.allowed_keysalts = keysaltbuf;
+        nread = fscanf(filep, "%u\t%u\t%u\t"
+                       K5CONST_WIDTH_SCANF_STR(KRB5_KDB_MAX_ALLOWED_KS_LEN)
+                       "\t%hd", &rec.attributes, &rec.max_life,
+                       &rec.max_renewable_life, rec.allowed_keysalts,
+                       &rec.n_tl_data);
+        if (nread == EOF)
+            return -1;
+        if (nread != 5) {
+            fprintf(stderr, _("cannot parse policy (%d read)\n"), nread);
+            return 1;
+        }
+
+        if (rec.allowed_keysalts && !strcmp(rec.allowed_keysalts, "-"))
+            rec.allowed_keysalts = NULL;
+
+        /* Get TL data */
+        ret = alloc_tl_data(rec.n_tl_data, &rec.tl_data);
+        if (ret)
+            goto cleanup;
+
+        ret = process_tl_data(fname, filep, *linenop, rec.tl_data);
+        if (ret)
+            goto cleanup;
+    }
+
+    ret = krb5_db_create_policy(context, &rec);
+    if (ret)
+        ret = krb5_db_put_policy(context, &rec);
+    if (ret) {
+        com_err(progname, ret, _("while creating policy"));
+        goto cleanup;
+    }
+    if (verbose)
+        fprintf(stderr, "created policy %s\n", rec.name);
+
+cleanup:
+    for (tl = rec.tl_data; tl; tl = tl_next) {
+        tl_next = tl->tl_data_next;
+        free(tl->tl_data_contents);
+        free(tl);
+    }
+    return ret ? 1 : 0;
+}
+
+/* Read a counted octet string with a 16-bit length from in into *out, or set
+ * *out to NULL if the length is zero. */
+static void
+get_data16(struct k5input *in, unsigned int *len_out, unsigned char **out)
+{
+    unsigned int len = k5_input_get_uint16_be(in);
+    const unsigned char *p = k5_input_get_bytes(in, len);
+
+    *len_out = 0;
+    *out = NULL;
+    if (p == NULL || len == 0)
+        return;
+    *out = k5memdup(p, len, &in->status);
+    if (*out != NULL)
+        *len_out = len;
+}
+
+/* Read a counted string with a 32-bit length from in into a newly allocated
+ * C string, or set *out to NULL if the length is zero. */
+static void
+get_str(struct k5input *in, char **out)
+{
+    size_t len = k5_input_get_uint32_be(in);
+    const unsigned char *p = k5_input_get_bytes(in, len);
+
+    *out = NULL;
+    if (p == NULL || len == 0)
+        return;
+    if (memchr(p, '\0', len) != NULL) {
+        k5_input_set_status(in, EINVAL);
+        return;
+    }
+    *out = k5memdup0(p, len, &in->status);
+}
+
+/* Read a tl-data list from in into *tl_out and *n_out. */
+static void
+get_tl_data(struct k5input *in, krb5_tl_data **tl_out, krb5_int16 *n_out)
+{
+    krb5_tl_data **tlp = tl_out;
+    unsigned int n, len, i;
+
+    n = k5_input_get_uint16_be(in);
+    for (i = 0; i < n && !in->status; i++) {
+        *tlp = k5alloc(sizeof(**tlp), &in->status);
+        if (*tlp == NULL)
+            return;
+        (*tlp)->tl_data_type = k5_input_get_uint16_be(in);
+        get_data16(in, &len, &(*tlp)->tl_data_contents);
+        (*tlp)->tl_data_length = len;
+        tlp = &(*tlp)->tl_data_next;
+        (*n_out)++;
+    }
+}
+
+/*
+ * Decode a binary principal payload and add it to the database.  If merge_nra
+ * is true and the principal already exists, keep its non-replicated
+ * attributes.  Return 0 on success and 1 on failure.
+ */
+static int
+load_binary_princ(krb5_context context, const char *fname, int recno,
+                  struct k5input *in, krb5_boolean verbose,
+                  krb5_boolean merge_nra)
+{
+    krb5_error_code ret;
+    krb5_db_entry *dbentry, *cur;
+    krb5_key_data *kd;
+    char *name = NULL;
+    unsigned int len;
+    int retval = 1, i, j;
+
+    dbentry = krb5_db_alloc(context, NULL, sizeof(*dbentry));
+    if (dbentry == NULL)
+        return 1;
+    memset(dbentry, 0, sizeof(*dbentry));
+
+    dbentry->len = k5_input_get_uint16_be(in);
+    get_str(in, &name);
+    dbentry->attributes = k5_input_get_uint32_be(in);
+    dbentry->max_life = k5_input_get_uint32_be(in);
+    dbentry->max_renewable_life = k5_input_get_uint32_be(in);
+    dbentry->expiration = k5_input_get_uint32_be(in);
+    dbentry->pw_expiration = k5_input_get_uint32_be(in);
+    dbentry->last_success = k5_input_get_uint32_be(in);
+    dbentry->last_failed = k5_input_get_uint32_be(in);
+    dbentry->fail_auth_count = k5_input_get_uint32_be(in);
+    get_tl_data(in, &dbentry->tl_data, &dbentry->n_tl_data);
+
+    len = k5_input_get_uint16_be(in);
+    if (len > 0 && !in->status) {
+        dbentry->key_data = k5calloc(len, sizeof(*dbentry->key_data),
+                                     &in->status);
+        if (dbentry->key_data != NULL)
+            dbentry->n_key_data = len;
+    }
+    for (i = 0; i < dbentry->n_key_data && !in->status; i++) {
+        kd = &dbentry->key_data[i];
+        kd->key_data_ver = k5_input_get_uint16_be(in);
+        kd->key_data_kvno = k5_input_get_uint16_be(in);
+        if (kd->key_data_ver < 1 ||
+            kd->key_data_ver > KRB5_KDB_V1_KEY_DATA_ARRAY) {
+            k5_input_set_status(in, EINVAL);
+            break;
+        }
+        for (j = 0; j < kd->key_data_ver; j++) {
+            kd->key_data_type[j] = k5_input_get_uint16_be(in);
+            get_data16(in, &len, &kd->key_data_contents[j]);
+            kd->key_data_length[j] = len;
+        }
+    }
+    get_data16(in, &len, &dbentry->e_data);
+    dbentry->e_length = len;
+
+    if (in->status || name == NULL || in->len != 0) {
+        load_err(fname, recno, _("cannot parse principal record"));
+        goto cleanup;
+    }
+
+    ret = krb5_parse_name(context, name, &dbentry->princ);
+    if (ret) {
+        com_err(progname, ret, _("while parsing name %s"), name);
+        goto cleanup;
+    }
+
+    dbentry->mask = KADM5_LOAD | KADM5_PRINCIPAL | KADM5_ATTRIBUTES |
+        KADM5_MAX_LIFE | KADM5_MAX_RLIFE |
+        KADM5_PRINC_EXPIRE_TIME | KADM5_LAST_SUCCESS |
+        KADM5_LAST_FAILED | KADM5_FAIL_AUTH_COUNT;
+    if (dbentry->n_tl_data)
+        set_tl_data_mask(dbentry);
+    if (dbentry->n_key_data)
+        dbentry->mask |= KADM5_KEY_DATA;
+
+    if (merge_nra &&
+        krb5_db_get_principal(context, dbentry->princ, 0, &cur) == 0) {
+        dbentry->last_success = cur->last_success;
+        dbentry->last_failed = cur->last_failed;
+        dbentry->fail_auth_count = cur->fail_auth_count;
+        krb5_db_free_principal(context, cur);
+    }
+
+    ret = krb5_db_put_principal(context, dbentry);
+    if (ret) {
+        com_err(progname, ret, _("while storing %s"), name);
+        goto cleanup;
+    }
+
+    if (verbose)
+        fprintf(stderr, "%s\n", name);
+    retval = 0;
+
+cleanup:
+    free(name);
+    krb5_db_free_principal(context, dbentry);
+    return retval;
+}
+
+/* Return true if the database has a policy with the same name and contents as
+ * rec. */
+static krb5_boolean
+policy_unchanged(krb5_context context, osa_policy_ent_t rec)
+{
+    osa_policy_ent_t cur;
+    krb5_tl_data *t1, *t2;
+    krb5_boolean same;
+
+    if (krb5_db_get_policy(context, rec->name, &cur) != 0)
+        return FALSE;
+    same = cur->pw_min_life == rec->pw_min_life &&
+        cur->pw_max_life == rec->pw_max_life &&
+        cur->pw_min_length == rec->pw_min_length &&
+        cur->pw_min_classes == rec->pw_min_classes &&
+        cur->pw_history_num == rec->pw_history_num &&
+        cur->pw_max_fail == rec->pw_max_fail &&
+        cur->pw_failcnt_interval == rec->pw_failcnt_interval &&
+        cur->pw_lockout_duration == rec->pw_lockout_duration &&
+        cur->attributes == rec->attributes &&
+        cur->max_life == rec->max_life &&
+        cur->max_renewable_life == rec->max_renewable_life &&
+        (cur->allowed_keysalts == NULL) == (rec->allowed_keysalts == NULL) &&
+        (cur->allowed_keysalts == NULL ||
+         strcmp(cur->allowed_keysalts, rec->allowed_keysalts) == 0);
+    t1 = cur->tl_data;
+    t2 = rec->tl_data;
+    for (; same && t1 != NULL && t2 != NULL; t1 = t1->tl_data_next) {
+        same = t1->tl_data_type == t2->tl_data_type &&
+            t1->tl_data_length == t2->tl_data_length &&
+            memcmp(t1->tl_data_contents, t2->tl_data_contents,
+                   t1->tl_data_length) == 0;
+        t2 = t2->tl_data_next;
+    }
+    same = same && t1 == NULL && t2 == NULL;
+    krb5_db_free_policy(context, cur);
+    return same;
+}
+
+/* Decode a binary policy payload and add it to the database.  For a delta,
+ * leave an identical existing policy alone, since any policy change
+ * reinitializes the update log.  Return 0 on success and 1 on failure. */
+static int
+load_binary_policy(krb5_context context, const char *fname, int recno,
+                   struct k5input *in, krb5_boolean verbose,
+                   krb5_boolean delta)
+{
+    osa_policy_ent_rec rec;
+    krb5_tl_data *tl, *tl_next;
+    krb5_error_code ret;
+
+    memset(&rec, 0, sizeof(rec));
+    get_str(in, &rec.name);
+    rec.pw_min_life = k5_input_get_uint32_be(in);
+    rec.pw_max_life = k5_input_get_uint32_be(in);
+    rec.pw_min_length = k5_input_get_uint32_be(in);
+    rec.pw_min_classes = k5_input_get_uint32_be(in);
+    rec.pw_history_num = k5_input_get_uint32_be(in);
+    rec.pw_max_fail = k5_input_get_uint32_be(in);
+    rec.pw_failcnt_interval = k5_input_get_uint32_be(in);
+    rec.pw_lockout_duration = k5_input_get_uint32_be(in);
+    rec.attributes = k5_input_get_uint32_be(in);
+    rec.max_life = k5_input_get_uint32_be(in);
+    rec.max_renewable_life = k5_input_get_uint32_be(in);
+    get_str(in, &rec.allowed_keysalts);
+    get_tl_data(in, &rec.tl_data, &rec.n_tl_data);
+
+    if (in->status || rec.name == NULL || in->len != 0) {
+        load_err(fname, recno, _("cannot parse policy record"));
+        ret = EINVAL;
+        goto cleanup;
+    }
+
+    if (delta && policy_unchanged(context, &rec)) {
+        ret = 0;
+        goto cleanup;
+    }
+    ret = krb5_db_create_policy(context, &rec);
+    if (ret)
+        ret = krb5_db_put_policy(context, &rec);
+    if (ret) {
+        com_err(progname, ret, _("while creating policy"));
+        goto cleanup;
+    }
+    if (verbose)
+        fprintf(stderr, "created policy %s\n", rec.name);
+
+cleanup:
+    free(rec.name);
+    free(rec.allowed_keysalts);
+    for (tl = rec.tl_data; tl; tl = tl_next) {
+        tl_next = tl->tl_data_next;
+        free(tl->tl_data_contents);
+        free(tl);
+    }
+    return ret ? 1 : 0;
+}
+
+/* Decode a binary delete payload and remove the named principal from the
+ * database if it exists.  Return 0 on success and 1 on failure. */
+static int
+load_binary_delete(krb5_context context, const char *fname, int recno,
+                   struct k5input *in, krb5_boolean verbose)
+{
+    krb5_error_code ret;
+    krb5_principal princ = NULL;
+    char *name = NULL;
+
+    get_str(in, &name);
+    if (in->status || name == NULL || in->len != 0) {
+        load_err(fname, recno, _("cannot parse delete record"));
+        free(name);
+        return 1;
+    }
+
+    ret = krb5_parse_name(context, name, &princ);
+    if (ret) {
+        com_err(progname, ret, _("while parsing name %s"), name);
+        goto cleanup;
+    }
+    ret = krb5_db_delete_principal(context, princ);
+    if (ret == KRB5_KDB_NOENTRY)
+        ret = 0;
+    if (ret) {
+        com_err(progname, ret, _("while deleting %s"), name);
+        goto cleanup;
+    }
+    if (verbose)
+        fprintf(stderr, _("%s (deleted)\n"), name);
+
+cleanup:
+    krb5_free_principal(context, princ);
+    free(name);
+    return ret ? 1 : 0;
+}
+
+/* A list of principal or policy names, sorted before it is searched. */
+struct name_list {
+    char **names;
+    size_t count;
+    size_t space;
+};
+
+/* Add a copy of name to list.  Return 0 on success, 1 on failure. */
+static int
+name_list_add(struct name_list *list, const char *name)
+{
+    char **newptr;
+    size_t newspace;
+
+    if (list->count == list->space) {
+        newspace = (list->space == 0) ? 64 : list->space * 2;
+        newptr = realloc(list->names, newspace * sizeof(*list->names));
+        if (newptr == NULL)
+            return 1;
+        list->names = newptr;
+        list->space = newspace;
+    }
+    list->names[list->count] = strdup(name);
+    if (list->names[list->count] == NULL)
+        return 1;
+    list->count++;
+    return 0;
+}
+
+static krb5_boolean
+name_list_contains(struct name_list *list, const char *name)
+{
+    return list->count > 0 &&
+        bsearch(&name, list->names, list->count, sizeof(*list->names),
+                compare_names) != NULL;
+}
+
+static void
+name_list_free(struct name_list *list)
+{
+    size_t i;
+
+    for (i = 0; i < list->count; i++)
+        free(list->names[i]);
+    free(list->names);
+    memset(list, 0, sizeof(*list));
+}
+
+/*
+ * The policies named in the delta dump being loaded, and its principals if the
+ * delta is complete (names every principal of the source database).  Once its
+ * records are loaded, policies it does not name are deleted, and so are
+ * principals if it is complete.  delta_complete is set from the dump header.
+ */
+static struct name_list delta_princs, delta_policies;
+static krb5_boolean delta_complete;
+
+/* Record the name read from a copy of in, which must begin with a string
+ * (after skip bytes), in list.  Return 0 on success and 1 on failure. */
+static int
+record_delta_name(const char *fname, int recno, struct k5input in,
+                  size_t skip, struct name_list *list)
+{
+    char *name;
+    int retval;
+
+    (void)k5_input_get_bytes(&in, skip);
+    get_str(&in, &name);
+    if (in.status || name == NULL) {
+        load_err(fname, recno, _("cannot parse record name"));
+        free(name);
+        return 1;
+    }
+    retval = name_list_add(list, name);
+    free(name);
+    return retval;
+}
+
+struct absent_args {
+    krb5_context context;
+    struct name_list *present;
+    struct name_list absent;
+    krb5_error_code ret;
+};
+
+static void
+find_absent_policy(void *ptr, osa_policy_ent_t entry)
+{
+    struct absent_args *args = ptr;
+
+    if (!args->ret && !name_list_contains(args->present, entry->name) &&
+        name_list_add(&args->absent, entry->name))
+        args->ret = ENOMEM;
+}
+
+static krb5_error_code
+find_absent_princ(void *ptr, krb5_db_entry *entry)
+{
+    struct absent_args *args = ptr;
+    krb5_error_code ret;
+    char *name;
+
+    ret = krb5_unparse_name(args->context, entry->princ, &name);
+    if (ret)
+        return ret;
+    if (!name_list_contains(args->present, name) &&
+        name_list_add(&args->absent, name))
+        ret = ENOMEM;
+    free(name);
+    return ret;
+}
+
+/* Delete the policies, and for a complete delta the principals, which the
+ * delta dump just loaded does not name.  Return 0 on success and 1 on
+ * failure. */
+static int
+finish_delta(krb5_context context, krb5_boolean verbose)
+{
+    krb5_error_code ret;
+    krb5_principal princ;
+    struct absent_args args;
+    size_t i;
+
+    memset(&args, 0, sizeof(args));
+    args.context = context;
+
+    if (delta_complete) {
+        qsort(delta_princs.names, delta_princs.count, sizeof(char *),
+              compare_names);
+        args.present = &delta_princs;
+        ret = krb5_db_iterate(context, NULL, find_absent_princ, &args, 0);
+        if (ret) {
+            com_err(progname, ret, _("while finding deleted principals"));
+            goto cleanup;
+        }
+        for (i = 0; i < args.absent.count; i++) {
+            ret = krb5_parse_name(context, args.absent.names[i], &princ);
+            if (ret) {
+                com_err(progname, ret, _("while parsing name %s"),
+                        args.absent.names[i]);
+                goto cleanup;
+            }
+            ret = krb5_db_delete_principal(context, princ);
+            krb5_free_principal(context, princ);
+            if (ret && ret != KRB5_KDB_NOENTRY) {
+                com_err(progname, ret, _("while deleting %s"),
+                        args.absent.names[i]);
+                goto cleanup;
+            }
+            if (verbose)
+                fprintf(stderr, _("%s (deleted)\n"), args.absent.names[i]);
+        }
+        name_list_free(&args.absent);
+    }
+
+    qsort(delta_policies.names, delta_policies.count, sizeof(char *),
+          compare_names);
+    args.present = &delta_policies;
+    ret = krb5_db_iter_policy(context, "*", find_absent_policy, &args);
+    if (!ret)
+        ret = args.ret;
+    if (ret) {
+        com_err(progname, ret, _("while finding deleted policies"));
+        goto cleanup;
+    }
+    for (i = 0; i < args.absent.count; i++) {
+        ret = krb5_db_delete_policy(context, args.absent.names[i]);
+        if (ret && ret != KRB5_KDB_NOENTRY) {
+            com_err(progname, ret, _("while deleting policy %s"),
+                    args.absent.names[i]);
+            goto cleanup;
+        }
+        if (verbose)
+            fprintf(stderr, _("policy %s (deleted)\n"), args.absent.names[i]);
+    }
+    ret = 0;
 
-    return 0;
+cleanup:
+    name_list_free(&args.absent);
+    name_list_free(&delta_princs);
+    name_list_free(&delta_policies);
+    return ret ? 1 : 0;
 }
 
+/* The number of principal, policy, delete and name records loaded so far from
+ * a binary dump. */
+static uint32_t binary_nloaded;
+
+/* Check a checksum from a 'C' or 'E' record against the block just read. */
 static int
-process_r1_8_policy(krb5_context context, const char *fname, FILE *filep,
-                    krb5_boolean verbose, int *linenop)
+check_binary_block(const char *fname, int recno, struct k5input *in)
 {
-    osa_policy_ent_rec rec;
-    char namebuf[1024];
-    unsigned int refcnt;
-    int nread, ret;
-
-    memset(&rec, 0, sizeof(rec));
-
-    (*linenop)++;
-    rec.name = namebuf;
-
-    nread = fscanf(filep, "%1023s\t%u\t%u\t%u\t%u\t%u\t%u\t%u\t%u\t%u",
-                   rec.name, &rec.pw_min_life, &rec.pw_max_life,
-                   &rec.pw_min_length, &rec.pw_min_classes,
-                   &rec.pw_history_num, &refcnt, &rec.pw_max_fail,
-                   &rec.pw_failcnt_interval, &rec.pw_lockout_duration);
-    if (nread == EOF)
-        return -1;
-    if (nread != 10) {
-        fprintf(stderr, _("cannot parse policy (%d read)\n"), nread);
-        return 1;
-    }
-
-    ret = krb5_db_create_policy(context, &rec);
-    if (ret)
-        ret = krb5_db_put_policy(context, &rec);
-    if (ret) {
-        com_err(progname, ret, _("while creating policy"));
+    if (k5_input_get_uint32_be(in) != (uint32_t)binary_block.crc ||
+        in->status) {
+        load_err(fname, recno, _("checksum mismatch"));
         return 1;
     }
-    if (verbose)
-        fprintf(stderr, "created policy %s\n", rec.name);
-
+    binary_block_reset();
     return 0;
 }
 
+/* Read a binary dump record and process it.  Delete and name records are only
+ * allowed in a delta dump.  *linenop counts records rather than lines.  Return
+ * -1 at the end record, 0 for success and 1 for failure. */
 static int
-process_r1_11_policy(krb5_context context, const char *fname, FILE *filep,
-                     krb5_boolean verbose, int *linenop)
+read_binary_record(krb5_context context, const char *fname, FILE *filep,
+                   krb5_boolean verbose, int *linenop, krb5_boolean delta)
 {
-    osa_policy_ent_rec rec;
-    krb5_tl_data *tl, *tl_next;
-    char namebuf[1024];
-    char keysaltbuf[KRB5_KDB_MAX_ALLOWED_KS_LEN + 1];
-    unsigned int refcnt;
-    int nread, c, ret = 0;
+    unsigned char hdr[5], *payload = NULL;
+    struct k5input in;
+    uint32_t len;
+    int retval = 1;
 
-    memset(&rec, 0, sizeof(rec));
+    /* Reset the load state at the first record. */
+    if (*linenop == 1) {
+        binary_block_reset();
+        binary_nloaded = 0;
+        name_list_free(&delta_princs);
+        name_list_free(&delta_policies);
+    }
 
+    if (fread(hdr, 1, sizeof(hdr), filep) != sizeof(hdr)) {
+        load_err(fname, *linenop, _("dump file is missing its end record"));
+        return 1;
+    }
     (*linenop)++;
-    rec.name = namebuf;
-
-    /*
-     * Due to a historical error, iprop dumps use the same version before and
-     * after the 1.11 policy extensions.  So we need to accept both 1.8-format
-     * and 1.11-format policy entries.  Begin by reading the 1.8 fields.
-     */
-    nread = fscanf(filep, "%1023s\t%u\t%u\t%u\t%u\t%u\t%u\t%u\t%u\t%u",
-                   rec.name, &rec.pw_min_life, &rec.pw_max_life,
-                   &rec.pw_min_length, &rec.pw_min_classes,
-                   &rec.pw_history_num, &refcnt, &rec.pw_max_fail,
-                   &rec.pw_failcnt_interval, &rec.pw_lockout_duration);
-    if (nread == EOF)
-        return -1;
-    if (nread != 10) {
-        fprintf(stderr, _("cannot parse policy (%d read)\n"), nread);
+    len = load_32_be(hdr + 1);
+    if (len > BINARY_RECORD_MAX) {
+        load_err(fname, *linenop, _("record is too long"));
         return 1;
     }
-
-    /* The next character should be a newline (1.8) or a tab (1.11). */
-    c = getc(filep);
-    if (c == EOF)
-        return -1;
-    if (c != '\n') {
-        /* Read the additional 1.11-format fields. */
-        rec.allowed_keysalts = keysaltbuf;
-        nread = fscanf(filep, "%u\t%u\t%u\t"
-                       K5CONST_WIDTH_SCANF_STR(KRB5_KDB_MAX_ALLOWED_KS_LEN)
-                       "\t%hd", &rec.attributes, &rec.max_life,
-                       &rec.max_renewable_life, rec.allowed_keysalts,
-                       &rec.n_tl_data);
-        if (nread == EOF)
-            return -1;
-        if (nread != 5) {
-            fprintf(stderr, _("cannot parse policy (%d read)\n"), nread);
+    if (len > 0) {
+        payload = malloc(len);
+        if (payload == NULL)
             return 1;
-        }
-
-        if (rec.allowed_keysalts && !strcmp(rec.allowed_keysalts, "-"))
-            rec.allowed_keysalts = NULL;
-
-        /* Get TL data */
-        ret = alloc_tl_data(rec.n_tl_data, &rec.tl_data);
-        if (ret)
-            goto cleanup;
-
-        ret = process_tl_data(fname, filep, *linenop, rec.tl_data);
-        if (ret)
+        if (fread(payload, 1, len, filep) != len) {
+            load_err(fname, *linenop, _("cannot read record"));
             goto cleanup;
+        }
+    }
+    k5_input_init(&in, payload, len);
+    if (hdr[0] != 'C' && hdr[0] != 'E') {
+        binary_block_add(hdr, sizeof(hdr));
+        binary_block_add(payload, len);
+        binary_nloaded++;
     }
 
-    ret = krb5_db_create_policy(context, &rec);
-    if (ret)
-        ret = krb5_db_put_policy(context, &rec);
-    if (ret) {
-        com_err(progname, ret, _("while creating policy"));
-        goto cleanup;
+    switch (hdr[0]) {
+    case 'P':
+        /* The name follows the 16-bit entry length. */
+        if (delta && delta_complete &&
+            record_delta_name(fname, *linenop, in, 2, &delta_princs))
+            break;
+        retval = load_binary_princ(context, fname, *linenop, &in, verbose,
+                                   delta);
+        break;
+    case 'D':
+        if (!delta) {
+            load_err(fname, *linenop, _("unknown record type"));
+            break;
+        }
+        retval = load_binary_delete(context, fname, *linenop, &in, verbose);
+        break;
+    case 'N':
+        if (!delta || !delta_complete) {
+            load_err(fname, *linenop, _("unknown record type"));
+            break;
+        }
+        retval = record_delta_name(fname, *linenop, in, 0, &delta_princs);
+        break;
+    case 'Y':
+        if (delta &&
+            record_delta_name(fname, *linenop, in, 0, &delta_policies))
+            break;
+        retval = load_binary_policy(context, fname, *linenop, &in, verbose,
+                                    delta);
+        break;
+    case 'C':
+        retval = check_binary_block(fname, *linenop, &in);
+        break;
+    case 'E':
+        if (k5_input_get_uint32_be(&in) != binary_nloaded || in.status) {
+            load_err(fname, *linenop, _("record count mismatch"));
+            break;
+        }
+        if (check_binary_block(fname, *linenop, &in) != 0)
+            break;
+        if (delta && finish_delta(context, verbose))
+            break;
+        retval = -1;
+        break;
+    default:
+        load_err(fname, *linenop, _("unknown record type"));
+        break;
     }
-    if (verbose)
-        fprintf(stderr, "created policy %s\n", rec.name);
 
 cleanup:
-    for (tl = rec.tl_data; tl; tl = tl_next) {
-        tl_next = tl->tl_data_next;
-        free(tl->tl_data_contents);
-        free(tl);
-    }
-    return ret ? 1 : 0;
+    free(payload);
+    return retval;
+}
+
+static int
+process_binary_record(krb5_context context, const char *fname, FILE *filep,
+                      krb5_boolean verbose, int *linenop)
+{
+    return read_binary_record(context, fname, filep, verbose, linenop, FALSE);
+}
+
+static int
+process_delta_record(krb5_context context, const char *fname, FILE *filep,
+                     krb5_boolean verbose, int *linenop)
+{
+    return read_binary_record(context, fname, filep, verbose, linenop, TRUE);
 }
 
 /* Read a record which is tagged with "princ" or "policy", calling princfn
@@ -1162,6 +2156,45 @@ dump_version ipropx_1_version = {
     process_r1_11_record,
 };
 
+dump_version binary_version = {
+    "Kerberos version 5 binary",
+    "kdb5_util load_dump binary version 1\n",
+    0,
+    0,
+    0,
+    dump_binary_princ,
+    dump_binary_policy,
+    process_binary_record,
+};
+
+/* A binary dump for iprop full resyncs, with the update log serial number and
+ * timestamp appended to the header. */
+dump_version binary_iprop_version = {
+    "Kerberos version 5 binary iprop",
+    "kdb5_util load_dump binary iprop version 1",
+    0,
+    1,
+    0,
+    dump_binary_princ,
+    dump_binary_policy,
+    process_binary_record,
+};
+
+/* A delta dump holds only the principals changed after a given serial number,
+ * with the serial numbers and timestamps it starts from and brings the
+ * database up to appended to the header.  If the header ends with the word
+ * "complete", the delta also names every unchanged principal. */
+dump_version delta_version = {
+    "Kerberos version 5 binary delta",
+    "kdb5_util load_dump binary delta version 1",
+    1,
+    0,
+    0,
+    dump_binary_princ,
+    dump_binary_policy,
+    process_delta_record,
+};
+
 /* Read the dump header.  Return 1 on success, 0 if the file is not a
  * recognized iprop dump format. */
 static int
@@ -1171,6 +2204,14 @@ parse_iprop_header(char *buf, dump_version **dv, kdb_last_t *last)
     int nread;
     uint32_t u[4];
     uint32_t *up = &u[0];
+    size_t hlen = strlen(binary_iprop_version.header);
+
+    if (strncmp(buf, binary_iprop_version.header, hlen) == 0) {
+        if (sscanf(buf + hlen, "%u %u %u", &u[0], &u[1], &u[2]) != 3)
+            return 0;
+        *dv = &binary_iprop_version;
+        goto done;
+    }
 
     nread = sscanf(buf, "%127s %u %u %u %u", head, &u[0], &u[1], &u[2], &u[3]);
     if (nread < 1)
@@ -1198,12 +2239,61 @@ parse_iprop_header(char *buf, dump_version **dv, kdb_last_t *last)
         return 0;
     }
 
+done:
     last->last_sno = *up++;
     last->last_time.seconds = *up++;
     last->last_time.useconds = *up++;
     return 1;
 }
 
+/* Read the starting and ending serial numbers and timestamps from a delta
+ * dump header, and whether the delta is complete.  Return 1 on success, 0 if
+ * the header is malformed. */
+static int
+parse_delta_header(char *buf, kdb_last_t *from, kdb_last_t *to,
+                   krb5_boolean *complete)
+{
+    uint32_t u[6];
+    int nread, len = 0;
+    char *rest;
+
+    nread = sscanf(buf + strlen(delta_version.header), "%u %u %u %u %u %u%n",
+                   &u[0], &u[1], &u[2], &u[3], &u[4], &u[5], &len);
+    rest = buf + strlen(delta_version.header) + len;
+    *complete = (strcmp(rest, " complete\n") == 0);
+    if (nread != 6 || (!*complete && strcmp(rest, "\n") != 0)) {
+        fprintf(stderr, _("%s: Invalid delta dump header\n"), progname);
+        return 0;
+    }
+    from->last_sno = u[0];
+    from->last_time.seconds = u[1];
+    from->last_time.useconds = u[2];
+    to->last_sno = u[3];
+    to->last_time.seconds = u[4];
+    to->last_time.useconds = u[5];
+    return 1;
+}
+
+/* Parse a timestamp of the form seconds.useconds into *out.  Return 1 on
+ * success, 0 if str is malformed. */
+static int
+parse_since_time(const char *str, kdbe_time_t *out)
+{
+    unsigned long sec, usec;
+    char *endp;
+
+    sec = strtoul(str, &endp, 10);
+    if (endp == str || *endp != '.')
+        return 0;
+    str = endp + 1;
+    usec = strtoul(str, &endp, 10);
+    if (endp == str || *endp != '\0' || sec > UINT32_MAX || usec >= 1000000)
+        return 0;
+    out->seconds = sec;
+    out->useconds = usec;
+    return 1;
+}
+
 /* Return true if the serial number and timestamp in an existing dump file is
  * in the ulog. */
 static krb5_boolean
@@ -1232,8 +2322,9 @@ current_dump_sno_in_ulog(krb5_context context, const char *ifile)
 
 /*
  * usage is:
- *      dump_db [-b7] [-ov] [-r13] [-r18] [-verbose] [-mkey_convert]
- *              [-new_mkey_file mkey_file] [-rev] [-recurse]
+ *      dump_db [-b7] [-ov] [-r13] [-r18] [-binary]
+ *              [-since sno [-since_time seconds.useconds]] [-verbose]
+ *              [-mkey_convert] [-new_mkey_file mkey_file] [-rev] [-recurse]
  *              [filename [principals...]]
  */
 void
@@ -1249,8 +2340,14 @@ dump_db(int argc, char **argv)
     kdb_log_context *log_ctx;
     unsigned int ipropx_version = IPROPX_VERSION_0;
     krb5_kvno kt_kvno;
-    krb5_boolean conditional = FALSE;
-    kdb_last_t last;
+    krb5_boolean conditional = FALSE, binary = FALSE, stamped = FALSE;
+    krb5_boolean have_since_time = FALSE, db_locked = FALSE;
+    krb5_boolean ulog_locked = FALSE;
+    kdb_last_t last, since;
+    kdbe_time_t since_time;
+    kdb_incr_result_t ures;
+    unsigned long since_sno = 0;
+    char *endp;
     krb5_flags iterflags = 0;
 
     /* Parse the arguments. */
@@ -1259,6 +2356,7 @@ dump_db(int argc, char **argv)
     args.omit_nra = FALSE;
     mkey_convert = FALSE;
     log_ctx = util_context->kdblog_context;
+    memset(&ures, 0, sizeof(ures));
 
     /*
      * Parse the qualifiers.
@@ -1272,6 +2370,25 @@ dump_db(int argc, char **argv)
             dump = &r1_3_version;
         } else if (!strcmp(argv[aindex], "-r18")) {
             dump = &r1_8_version;
+        } else if (!strcmp(argv[aindex], "-binary")) {
+            dump = &binary_version;
+            binary = TRUE;
+        } else if (!strcmp(argv[aindex], "-since") && aindex + 1 < argc) {
+            if (log_ctx && log_ctx->iproprole) {
+                since_sno = strtoul(argv[++aindex], &endp, 10);
+                if (*argv[aindex] == '\0' || *endp != '\0')
+                    usage();
+                dump = &delta_version;
+                args.omit_nra = TRUE;
+            } else {
+                fprintf(stderr, _("Iprop not enabled\n"));
+                goto error;
+            }
+        } else if (!strcmp(argv[aindex], "-since_time") &&
+                   aindex + 1 < argc) {
+            if (!parse_since_time(argv[++aindex], &since_time))
+                usage();
+            have_since_time = TRUE;
         } else if (!strncmp(argv[aindex], "-i", 2)) {
             if (log_ctx && log_ctx->iproprole) {
                 /* ipropx_version is the maximum version acceptable. */
@@ -1309,6 +2426,13 @@ dump_db(int argc, char **argv)
         }
     }
 
+    /* -binary with -i selects the binary format with an iprop header. */
+    if (binary && dump_sno)
+        dump = &binary_iprop_version;
+
+    if (have_since_time && dump != &delta_version)
+        usage();
+
     args.names = NULL;
     args.nnames = 0;
     if (aindex < argc) {
@@ -1412,9 +2536,76 @@ dump_db(int argc, char **argv)
         f = stdout;
     }
 
+    /*
+     * For a delta dump, find the principals changed since the given serial
+     * number.  Hold the database and ulog locks until every record is
+     * written, so that the records reflect exactly the updates up to the
+     * serial number in the header.
+     */
+    if (dump == &delta_version) {
+        ret = krb5_db_lock(util_context, KRB5_DB_LOCKMODE_SHARED);
+        if (ret == 0) {
+            db_locked = TRUE;
+        } else if (ret != KRB5_PLUGIN_OP_NOTSUPP) {
+            com_err(progname, ret, _("while locking database"));
+            goto error;
+        }
+        ret = ulog_lock(util_context, KRB5_LOCKMODE_SHARED);
+        if (ret) {
+            com_err(progname, ret, _("while locking update log"));
+            goto error;
+        }
+        ulog_locked = TRUE;
+
+        ret = ulog_find_sno(util_context, since_sno, &since);
+        if (!ret && have_since_time &&
+            (since.last_time.seconds != since_time.seconds ||
+             since.last_time.useconds != since_time.useconds)) {
+            fprintf(stderr, _("%s: serial number %lu has a different "
+                              "timestamp in the update log\n"), progname,
+                    since_sno);
+            goto error;
+        }
+        if (!ret) {
+            ret = ulog_get_entries(util_context, &since, &ures);
+            if (!ret && ures.ret == UPDATE_NIL) {
+                last = since;
+            } else if (!ret && ures.ret == UPDATE_OK) {
+                last = ures.lastentry;
+            } else if (!ret) {
+                ret = KRB5_LOG_ERROR;
+            }
+        } else if (have_since_time) {
+            /* If the serial number has been overwritten in the ulog, fall
+             * back to the principals' modification times. */
+            since.last_sno = since_sno;
+            since.last_time = since_time;
+            if (ulog_sno_discarded(util_context, &since)) {
+                stamped = TRUE;
+                args.since = since_time.seconds;
+                ret = ulog_get_last(util_context, &last);
+            }
+        }
+        if (ret) {
+            com_err(progname, ret,
+                    _("while finding updates since serial number %lu"),
+                    since_sno);
+            goto error;
+        }
+        if (stamped && args.nnames > 0) {
+            fprintf(stderr, _("%s: principal names cannot be given when "
+                              "serial number %lu is no longer in the update "
+                              "log\n"), progname, since_sno);
+            goto error;
+        }
+    }
+
     args.ofile = f;
     args.context = util_context;
     args.dump = dump;
+    args.nrecords = 0;
+    args.policy_err = 0;
+    binary_block_reset();
     fprintf(args.ofile, "%s", dump->header);
 
     if (dump_sno) {
@@ -1423,17 +2614,35 @@ dump_db(int argc, char **argv)
             com_err(progname, ret, _("while reading update log header"));
             goto error;
         }
-        if (ipropx_version)
+        if (ipropx_version && dump != &binary_iprop_version)
             fprintf(f, " %u", IPROPX_VERSION);
         fprintf(f, " %u", last.last_sno);
         fprintf(f, " %u", last.last_time.seconds);
         fprintf(f, " %u", last.last_time.useconds);
     }
 
+    if (dump == &delta_version) {
+        fprintf(f, " %u %u %u", since.last_sno, since.last_time.seconds,
+                since.last_time.useconds);
+        fprintf(f, " %u %u %u", last.last_sno, last.last_time.seconds,
+                last.last_time.useconds);
+        if (stamped)
+            fprintf(f, " complete");
+    }
+
     if (dump->header[strlen(dump->header)-1] != '\n')
         fputc('\n', args.ofile);
 
-    ret = krb5_db_iterate(util_context, NULL, dump_iterator, &args, iterflags);
+    if (stamped) {
+        ret = krb5_db_iterate(util_context, NULL, dump_stamped_iterator, &args,
+                              iterflags);
+    } else if (dump == &delta_version) {
+        ret = dump_delta_princs(&args, ures.updates.kdb_ulog_t_val,
+                                ures.updates.kdb_ulog_t_len);
+    } else {
+        ret = krb5_db_iterate(util_context, NULL, dump_iterator, &args,
+                              iterflags);
+    }
     if (ret) {
         com_err(progname, ret, _("performing %s dump"), dump->name);
         goto error;
@@ -1441,47 +2650,105 @@ dump_db(int argc, char **argv)
 
     if (dump->dump_policy != NULL) {
         ret = krb5_db_iter_policy(util_context, "*", dump->dump_policy, &args);
+        if (!ret)
+            ret = args.policy_err;
+        if (ret) {
+            com_err(progname, ret, _("performing %s dump"), dump->name);
+            goto error;
+        }
+    }
+
+    if (dump->dump_princ == dump_binary_princ) {
+        ret = dump_binary_end(&args);
         if (ret) {
             com_err(progname, ret, _("performing %s dump"), dump->name);
             goto error;
         }
     }
 
+    if (ulog_locked)
+        (void)ulog_lock(util_context, KRB5_LOCKMODE_UNLOCK);
+    if (db_locked)
+        (void)krb5_db_unlock(util_context);
+
     if (f != stdout) {
         fclose(f);
         finish_ofile(ofile, &tmpofile);
         update_ok_file(util_context, ok_fd);
     }
+    ulog_free_entries(ures.updates.kdb_ulog_t_val,
+                      ures.updates.kdb_ulog_t_len);
     return;
 
 error:
+    if (ulog_locked)
+        (void)ulog_lock(util_context, KRB5_LOCKMODE_UNLOCK);
+    if (db_locked)
+        (void)krb5_db_unlock(util_context);
     if (tmpofile != NULL)
         unlink(tmpofile);
     free(tmpofile);
+    ulog_free_entries(ures.updates.kdb_ulog_t_val,
+                      ures.updates.kdb_ulog_t_len);
     exit_status++;
 }
 
-/* Restore the database from any version dump file. */
+/*
+ * Restore the database from any version dump file.  The records are put within
+ * a single DB transaction, so the module keeps the database open and locked
+ * across the whole load, and any update log entries are written as one group.
+ */
 static int
 restore_dump(krb5_context context, char *dumpfile, FILE *f,
              krb5_boolean verbose, dump_version *dump)
 {
+    krb5_error_code ret;
     int err = 0;
     int lineno = 1;
 
+    ret = krb5_db_begin_txn(context);
+    if (ret) {
+        com_err(progname, ret, _("while beginning database transaction"));
+        return 1;
+    }
+
     /* Process the records. */
     while (!(err = dump->load_record(context, dumpfile, f, verbose, &lineno)));
     if (err != -1) {
         fprintf(stderr, _("%s: error processing line %d of %s\n"), progname,
                 lineno, dumpfile);
+        (void)krb5_db_abort_txn(context);
         return err;
     }
+
+    ret = krb5_db_commit_txn(context);
+    if (ret) {
+        com_err(progname, ret, _("while committing database transaction"));
+        return 1;
+    }
     return 0;
 }
 
 /*
- * Usage: load_db [-ov] [-b7] [-r13] [-verbose] [-update] [-hash]
- *                filename
+ * Wait for the process writing the dump to a pipe to confirm that it sent the
+ * whole dump, by writing a 'C' byte to fd.  Return true if it did; the writer
+ * exiting for any reason before then closes fd without confirming.
+ */
+static krb5_boolean
+read_commit(int fd)
+{
+    char c;
+    ssize_t n;
+
+    do {
+        n = read(fd, &c, 1);
+    } while (n < 0 && errno == EINTR);
+    return n == 1 && c == 'C';
+}
+
+/*
+ * Usage: load_db [-ov] [-b7] [-r13] [-binary] [-verbose] [-update] [-hash]
+ *                [-commit_fd fd] filename
  */
 void
 load_db(int argc, char **argv)
@@ -1492,14 +2759,17 @@ load_db(int argc, char **argv)
     dump_version *load = NULL;
     int aindex;
     kdb_log_context *log_ctx;
-    kdb_last_t last;
+    kdb_last_t last, delta_from, cur;
     krb5_boolean db_locked = FALSE, temp_db_created = FALSE;
     krb5_boolean verbose = FALSE, update = FALSE, iprop_load = FALSE;
+    int commit_fd = -1;
+    char *endp;
 
     /* Parse the arguments. */
     dbname = global_params.dbname;
     exit_status = 0;
     log_ctx = util_context->kdblog_context;
+    memset(&delta_from, 0, sizeof(delta_from));
 
     for (aindex = 1; aindex < argc; aindex++) {
         if (!strcmp(argv[aindex], "-b7")){
@@ -1510,6 +2780,8 @@ load_db(int argc, char **argv)
             load = &r1_3_version;
         } else if (!strcmp(argv[aindex], "-r18")){
             load = &r1_8_version;
+        } else if (!strcmp(argv[aindex], "-binary")) {
+            load = &binary_version;
         } else if (!strcmp(argv[aindex], "-i")) {
             if (log_ctx && log_ctx->iproprole) {
                 load = &iprop_version;
@@ -1522,6 +2794,11 @@ load_db(int argc, char **argv)
             verbose = TRUE;
         } else if (!strcmp(argv[aindex], "-update")){
             update = TRUE;
+        } else if (!strcmp(argv[aindex], "-commit_fd") && aindex + 1 < argc) {
+            /* Used by kpropd when it feeds the dump through a pipe. */
+            commit_fd = strtol(argv[++aindex], &endp, 10);
+            if (*argv[aindex] == '\0' || *endp != '\0' || commit_fd < 0)
+                usage();
         } else if (!strcmp(argv[aindex], "-hash")) {
             if (!add_db_arg("hash=true")) {
                 com_err(progname, ENOMEM, _("while parsing options"));
@@ -1534,6 +2811,8 @@ load_db(int argc, char **argv)
     if (argc - aindex != 1)
         usage();
     dumpfile = argv[aindex];
+    if (strcmp(dumpfile, "-") == 0)
+        dumpfile = NULL;
 
     /* Open the dumpfile. */
     if (dumpfile != NULL) {
@@ -1553,7 +2832,19 @@ load_db(int argc, char **argv)
                 dumpfile);
         goto error;
     }
-    if (load) {
+    if ((load == NULL || iprop_load) &&
+        strncmp(buf, delta_version.header,
+                strlen(delta_version.header)) == 0) {
+        /* A delta dump is always applied to the existing database. */
+        load = &delta_version;
+        update = TRUE;
+        if (!parse_delta_header(buf, &delta_from, &last, &delta_complete))
+            goto error;
+    } else if (iprop_load &&
+               strncmp(buf, binary_iprop_version.header,
+                       strlen(binary_iprop_version.header)) == 0) {
+        load = &binary_iprop_version;
+    } else if (load) {
         /* Only check what we know; some headers only contain a prefix.
          * NB: this should work for ipropx even though load is iprop */
         if (strncmp(buf, load->header, strlen(load->header)) != 0) {
@@ -1570,6 +2861,8 @@ load_db(int argc, char **argv)
             load = &r1_8_version;
         } else if (strcmp(buf, r1_11_version.header) == 0) {
             load = &r1_11_version;
+        } else if (strcmp(buf, binary_version.header) == 0) {
+            load = &binary_version;
         } else if (strncmp(buf, ov_version.header,
                            strlen(ov_version.header)) == 0) {
             load = &ov_version;
@@ -1593,6 +2886,33 @@ load_db(int argc, char **argv)
         goto error;
     }
 
+    /*
+     * When kpropd loads a delta with -i, the delta brings the replica's
+     * database from the serial number it starts from to the one it ends at,
+     * so it can only be applied at the starting serial number.  Check this
+     * before locking the database, since a failed update leaves it locked.
+     * Without -i (e.g. on a master), the delta's changes are logged like any
+     * other updates.
+     */
+    if (load == &delta_version && iprop_load) {
+        ret = ulog_get_last(util_context, &cur);
+        if (ret) {
+            com_err(progname, ret, _("while reading update log header"));
+            goto error;
+        }
+        if (cur.last_sno != delta_from.last_sno ||
+            cur.last_time.seconds != delta_from.last_time.seconds ||
+            cur.last_time.useconds != delta_from.last_time.useconds) {
+            fprintf(stderr, _("%s: delta dump starts at serial number %u, "
+                              "but the database is at serial number %u\n"),
+                    progname, delta_from.last_sno, cur.last_sno);
+            goto error;
+        }
+        /* Don't log the delta's changes; the ulog header is set to the end
+         * of the delta after loading it. */
+        log_ctx->iproprole = IPROP_SLAVE;
+    }
+
     /* If we are not in update mode, we create an alternate database and then
      * promote it to be the live db. */
     if (!update) {
@@ -1649,11 +2969,27 @@ load_db(int argc, char **argv)
         goto error;
     }
 
+    /* Don't make the loaded data live unless the writer confirms that the dump
+     * is complete; end of input alone could be a truncated transfer. */
+    if (commit_fd >= 0 && !read_commit(commit_fd)) {
+        fprintf(stderr, _("%s: load of %s was not confirmed by the sender\n"),
+                progname, dumpfile);
+        goto error;
+    }
+
     if (db_locked && (ret = krb5_db_unlock(util_context))) {
         com_err(progname, ret, _("while unlocking database"));
         goto error;
     }
 
+    if (load == &delta_version && iprop_load) {
+        ret = ulog_set_last(util_context, &last);
+        if (ret) {
+            com_err(progname, ret, _("while writing update log header"));
+            goto error;
+        }
+    }
+
     if (!update) {
         /* Initialize the ulog header before promoting so we can't leave behind
          * the pre-load ulog state if we are killed just after promoting. */
@@ -1025,12 +1025,26 @@ kdb5_update_princ_encryption(int argc, char *argv[])
 
     if (!data.dry_run) {
         /* Grab a write lock so we don't have to upgrade to a write lock and
-         * reopen the DB while iterating. */
+         * reopen the DB while iterating, and batch the updates in one
+         * transaction. */
         iterflags = KRB5_DB_ITER_WRITE;
+        retval = krb5_db_begin_txn(util_context);
+        if (retval) {
+            com_err(progname, retval,
+                    _("while starting database transaction"));
+            exit_status++;
+            goto cleanup;
+        }
     }
 
     retval = krb5_db_iterate(util_context, name_pattern,
                              update_princ_encryption_1, &data, iterflags);
+    if (!data.dry_run) {
+        if (retval == 0 && exit_status == 0)
+            retval = krb5_db_commit_txn(util_context);
+        else
+            (void)krb5_db_abort_txn(util_context);
+    }
     /* If exit_status is set, then update_princ_encryption_1 already
        printed a message.  */
     if (retval != 0 && exit_status == 0) {
@@ -84,11 +84,12 @@ void usage()
               "\tcreate  [-s]\n"
               "\tdestroy [-f]\n"
               "\tstash   [-f keyfile]\n"
-              "\tdump    [-old|-ov|-b6|-b7|-r13|-r18] [-verbose]\n"
-              "\t        [-mkey_convert] [-new_mkey_file mkey_file]\n"
+              "\tdump    [-old|-ov|-b6|-b7|-r13|-r18|-binary]\n"
+              "\t        [-since sno [-since_time sec.usec]]\n"
+              "\t        [-verbose] [-mkey_convert] [-new_mkey_file mkey_file]\n"
               "\t        [-rev] [-recurse] [filename [princs...]]\n"
-              "\tload    [-old|-ov|-b6|-b7|-r13|-r18] [-verbose] [-update] "
-              "filename\n"
+              "\tload    [-old|-ov|-b6|-b7|-r13|-r18|-binary] [-verbose] "
+              "[-update] filename\n"
               "\tark     [-e etype_list] principal\n"
               "\tadd_mkey [-e etype] [-s]\n"
               "\tuse_mkey kvno [time]\n"
@@ -98,6 +99,7 @@ void usage()
             _("\tupdate_princ_encryption [-f] [-n] [-v] [princ-pattern]\n"
               "\tpurge_mkeys [-f] [-n] [-v]\n"
               "\ttabdump [-H] [-c] [-e] [-n] [-o outfile] dumptype\n"
+              "\tcompile_dict outfile [wordfile ...]\n"
               "\nwhere,\n\t[-x db_args]* - any number of database specific "
               "arguments.\n"
               "\t\t\tLook at each database documentation for supported "
@@ -138,6 +140,7 @@ struct _cmd_table {
     {"update_princ_encryption", kdb5_update_princ_encryption, 1},
     {"purge_mkeys", kdb5_purge_mkeys, 1},
     {"tabdump", tabdump, 1},
+    {"compile_dict", compile_dict, 0},
     {NULL, NULL, 0},
 };
 
@@ -84,6 +84,7 @@ extern void kdb5_use_mkey (int argc, char **argv);
 extern void kdb5_list_mkeys (int argc, char **argv);
 extern void kdb5_update_princ_encryption (int argc, char **argv);
 extern void tabdump (int argc, char **argv);
+extern void compile_dict (int argc, char **argv);
 
 extern krb5_error_code master_key_convert(krb5_context context,
                                           krb5_db_entry *db_entry);
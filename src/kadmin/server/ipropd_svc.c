@@ -9,7 +9,9 @@
 
 #include "k5-platform.h"
 #include <signal.h>
+#include <ctype.h>
 #include <sys/types.h>
+#include <sys/wait.h>
 #include <sys/resource.h> /* rlimit */
 #include <syslog.h>
 
@@ -243,19 +245,83 @@ getclhoststr(const char *clprinc, char *cl, size_t len)
     return (cl);
 }
 
+/*
+ * The client host name becomes part of a file name and an argument to kprop,
+ * so allow only host name characters, and no leading '-' or '.'.
+ */
+static int
+valid_clhost(const char *host)
+{
+    const char *p;
+
+    if (*host == '\0' || *host == '-' || *host == '.')
+	return 0;
+    for (p = host; *p != '\0'; p++) {
+	if (!isalnum((unsigned char)*p) && *p != '-' && *p != '.')
+	    return 0;
+    }
+    return 1;
+}
+
+/* Remove a slave's delta dump, along with the files kdb5_util and kprop
+ * create beside it. */
+static void
+remove_delta(const char *delta_file, const char *clhost)
+{
+    char *name;
+
+    (void) unlink(delta_file);
+    if (asprintf(&name, "%s.dump_ok", delta_file) >= 0) {
+	(void) unlink(name);
+	free(name);
+    }
+    if (asprintf(&name, "%s.%s.last_prop", delta_file, clhost) >= 0) {
+	(void) unlink(name);
+	free(name);
+    }
+}
+
+/* Run the program at path with argv and wait for it.  Return its exit status,
+ * or -1 if it could not be run or did not exit normally. */
+static int
+run_program(const char *path, char *const argv[])
+{
+    pid_t pid;
+    int status;
+
+    pid = fork();
+    if (pid == -1)
+	return -1;
+    if (pid == 0) {
+	execv(path, argv);
+	_exit(1);
+    }
+    while (waitpid(pid, &status, 0) == -1) {
+	if (errno != EINTR)
+	    return -1;
+    }
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+/*
+ * Dump the database and send it to the slave with kprop.  If since is not
+ * NULL, send a delta dump of the changes since that serial number and
+ * timestamp, which the ulog no longer holds; otherwise send a full dump.
+ */
 static kdb_fullresync_result_t *
-ipropx_resync(uint32_t vers, struct svc_req *rqstp)
+ipropx_resync(uint32_t vers, const kdb_last_t *since, struct svc_req *rqstp)
 {
     static kdb_fullresync_result_t ret;
-    char *ubuf = 0;
+    char *delta_file = NULL, *file = dump_file;
     char clhost[NI_MAXHOST] = {0};
-    int pret, fret;
-    FILE *p;
+    char snostr[16], timestr[32], versstr[16];
+    char *dump_argv[8], *kprop_argv[7];
+    int pret, fret, i;
     kadm5_server_handle_t handle = global_server_handle;
     OM_uint32 min_stat;
     gss_name_t name = NULL;
     char *client_name = NULL, *service_name = NULL;
-    char *whoami = "iprop_full_resync_1";
+    char *whoami = since ? "iprop_delta_resync_1" : "iprop_full_resync_1";
 
     /*
      * vers contains the highest version number the client is
@@ -320,29 +386,81 @@ ipropx_resync(uint32_t vers, struct svc_req *rqstp)
 			 whoami);
 	goto out;
     }
-
-    /*
-     * Note the -i; modified version of kdb5_util dump format
-     * to include sno (serial number). This argument is now
-     * versioned (-i0 for legacy dump format, -i1 for ipropx
-     * version 1 format, etc).
-     *
-     * The -c option ("conditional") causes the dump to dump only if no
-     * dump already exists or that dump is not in ipropx format, or the
-     * sno and timestamp in the header of that dump are outside the
-     * ulog.  This allows us to share a single global dump with all
-     * slaves, since it's OK to share an older dump, as long as its sno
-     * and timestamp are in the ulog (then the slaves can get the
-     * subsequent updates very iprop).
-     */
-    if (asprintf(&ubuf, "%s dump -i%d -c %s",
-		 kdb5_util, vers, dump_file) < 0) {
+    if (!valid_clhost(clhost)) {
 	krb5_klog_syslog(LOG_ERR,
-			 _("%s: cannot construct kdb5 util dump string too long; out of memory"),
-			 whoami);
+			 _("%s: invalid client host name in %s"),
+			 whoami, client_name);
 	goto out;
     }
 
+    if (since != NULL) {
+	/*
+	 * A delta can only be made from the principals' modification
+	 * times if the slave's serial number was once in our ulog and
+	 * has since been overwritten; otherwise (say our ulog was
+	 * reinitialized), the slave must do a full resync.
+	 */
+	if (!ulog_sno_discarded(handle->context, since)) {
+	    ret.ret = UPDATE_FULL_RESYNC_NEEDED;
+	    goto out;
+	}
+
+	/* Each slave gets its own delta, in a file named after it. */
+	if (asprintf(&delta_file, "%s.delta.%s", dump_file, clhost) < 0) {
+	    krb5_klog_syslog(LOG_ERR, _("%s: out of memory"), whoami);
+	    goto out;
+	}
+	file = delta_file;
+	(void) snprintf(snostr, sizeof(snostr), "%u", since->last_sno);
+	(void) snprintf(timestr, sizeof(timestr), "%u.%u",
+			since->last_time.seconds,
+			since->last_time.useconds);
+	i = 0;
+	dump_argv[i++] = "kdb5_util";
+	dump_argv[i++] = "dump";
+	dump_argv[i++] = "-since";
+	dump_argv[i++] = snostr;
+	dump_argv[i++] = "-since_time";
+	dump_argv[i++] = timestr;
+	dump_argv[i++] = file;
+	dump_argv[i] = NULL;
+    } else {
+	/*
+	 * Note the -i; modified version of kdb5_util dump format
+	 * to include sno (serial number). This argument is now
+	 * versioned (-i0 for legacy dump format, -i1 for ipropx
+	 * version 1 format, etc).
+	 *
+	 * The -c option ("conditional") causes the dump to dump only if
+	 * no dump already exists or that dump is not in ipropx format,
+	 * or the sno and timestamp in the header of that dump are
+	 * outside the ulog.  This allows us to share a single global
+	 * dump with all slaves, since it's OK to share an older dump, as
+	 * long as its sno and timestamp are in the ulog (then the slaves
+	 * can get the subsequent updates very iprop).
+	 */
+	(void) snprintf(versstr, sizeof(versstr), "-i%d", (int)vers);
+	i = 0;
+	dump_argv[i++] = "kdb5_util";
+	dump_argv[i++] = "dump";
+	dump_argv[i++] = versstr;
+	dump_argv[i++] = "-c";
+	dump_argv[i++] = file;
+	dump_argv[i] = NULL;
+    }
+
+    i = 0;
+    kprop_argv[i++] = "kprop";
+    kprop_argv[i++] = "-f";
+    kprop_argv[i++] = file;
+    /* XXX Yuck!  */
+    if (getenv("KPROP_PORT")) {
+	kprop_argv[i++] = "-P";
+	kprop_argv[i++] = getenv("KPROP_PORT");
+    }
+    kprop_argv[i++] = clhost;
+    kprop_argv[i] = NULL;
+
     /*
      * Fork to dump the db and xfer it to the slave.
      * (the fork allows parent to return quickly and the child
@@ -364,41 +482,34 @@ ipropx_resync(uint32_t vers, struct svc_req *rqstp)
 	goto out;
 
     case 0: /* child */
-	DPRINT("%s: run `%s' ...\n", whoami, ubuf);
+	DPRINT("%s: run `%s dump ... %s' ...\n", whoami, kdb5_util, file);
 	(void) signal(SIGCHLD, SIG_DFL);
 	/* run kdb5_util(1M) dump for IProp */
-	p = popen(ubuf, "w");
-	if (p == NULL) {
-	    krb5_klog_syslog(LOG_ERR,
-			     _("%s: popen failed: %s"),
-			     whoami, error_message(errno));
-	    _exit(1);
-	}
-	pret = pclose(p);
-	DPRINT("%s: pclose=%d\n", whoami, pret);
+	pret = run_program(kdb5_util, dump_argv);
+	DPRINT("%s: kdb5_util dump=%d\n", whoami, pret);
 	if (pret != 0) {
-	    /* XXX popen/pclose may not set errno
-	       properly, and the error could be from the
-	       subprocess anyways.  */
-	    if (nofork) {
-		perror(whoami);
-	    }
 	    krb5_klog_syslog(LOG_ERR,
-			     _("%s: pclose(popen) failed: %s"),
-			     whoami,
-			     error_message(errno));
+			     _("%s: %s dump failed"),
+			     whoami, kdb5_util);
+	    if (delta_file != NULL)
+		remove_delta(delta_file, clhost);
 	    _exit(1);
 	}
 
 	DPRINT("%s: exec `kprop -f %s %s' ...\n",
-		whoami, dump_file, clhost);
-	/* XXX Yuck!  */
-	if (getenv("KPROP_PORT")) {
-	    pret = execl(kprop, "kprop", "-f", dump_file, "-P",
-			 getenv("KPROP_PORT"), clhost, NULL);
-	} else {
-	    pret = execl(kprop, "kprop", "-f", dump_file, clhost, NULL);
+		whoami, file, clhost);
+	if (delta_file != NULL) {
+	    /* The delta holds key data and is made for this slave alone, so
+	     * remove it once kprop is done with it. */
+	    pret = run_program(kprop, kprop_argv);
+	    remove_delta(delta_file, clhost);
+	    if (pret != 0) {
+		krb5_klog_syslog(LOG_ERR, _("%s: %s failed"), whoami, kprop);
+		_exit(1);
+	    }
+	    _exit(0);
 	}
+	pret = execv(kprop, kprop_argv);
 	perror(whoami);
 	krb5_klog_syslog(LOG_ERR,
 			 _("%s: exec failed: %s"),
@@ -432,20 +543,26 @@ out:
     free(service_name);
     if (name)
 	gss_release_name(&min_stat, &name);
-    free(ubuf);
+    free(delta_file);
     return (&ret);
 }
 
 kdb_fullresync_result_t *
 iprop_full_resync_1_svc(/* LINTED */ void *argp, struct svc_req *rqstp)
 {
-    return ipropx_resync(IPROPX_VERSION_0, rqstp);
+    return ipropx_resync(IPROPX_VERSION_0, NULL, rqstp);
 }
 
 kdb_fullresync_result_t *
 iprop_full_resync_ext_1_svc(uint32_t *argp, struct svc_req *rqstp)
 {
-    return ipropx_resync(*argp, rqstp);
+    return ipropx_resync(*argp, NULL, rqstp);
+}
+
+kdb_fullresync_result_t *
+iprop_delta_resync_1_svc(kdb_last_t *argp, struct svc_req *rqstp)
+{
+    return ipropx_resync(IPROPX_VERSION_1, argp, rqstp);
 }
 
 static int
@@ -527,6 +644,8 @@ krb5_iprop_prog_1(struct svc_req *rqstp,
 {
     union {
 	kdb_last_t iprop_get_updates_1_arg;
+	uint32_t iprop_full_resync_ext_1_arg;
+	kdb_last_t iprop_delta_resync_1_arg;
     } argument;
     char *result;
     bool_t (*_xdr_argument)(), (*_xdr_result)();
@@ -566,6 +685,12 @@ krb5_iprop_prog_1(struct svc_req *rqstp,
 	local = (char *(*)()) iprop_full_resync_ext_1_svc;
 	break;
 
+    case IPROP_DELTA_RESYNC:
+	_xdr_argument = xdr_kdb_last_t;
+	_xdr_result = xdr_kdb_fullresync_result_t;
+	local = (char *(*)()) iprop_delta_resync_1_svc;
+	break;
+
     default:
 	krb5_klog_syslog(LOG_ERR,
 			 _("RPC unknown request: %d (%s)"),
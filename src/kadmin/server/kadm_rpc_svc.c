@@ -60,6 +60,12 @@ void kadm_1(rqstp, transp)
 	  setkey3_arg setkey_principal3_2_arg;
 	  setkey4_arg setkey_principal4_2_arg;
 	  getpkeys_arg get_principal_keys_2_arg;
+	  cprincs_arg create_principals_2_arg;
+	  mprincs_arg modify_principals_2_arg;
+	  chrands_arg chrand_principals_2_arg;
+	  setkeys_arg setkey_principals_2_arg;
+	  dprincs_arg delete_principals_2_arg;
+	  gprincs_page_arg get_princs_page_2_arg;
      } argument;
      union {
 	  generic_ret gen_ret;
@@ -72,10 +78,13 @@ void kadm_1(rqstp, transp)
 	  chrand_ret chrand_principal3_2_ret;
 	  gstrings_ret get_string_2_ret;
 	  getpkeys_ret get_principal_keys_ret;
+	  batch_ret batch_2_ret;
+	  gprincs_page_ret get_princs_page_2_ret;
      } result;
      bool_t retval;
      bool_t (*xdr_argument)(), (*xdr_result)();
      bool_t (*local)();
+     struct stats_mark mark;
 
      if (rqstp->rq_cred.oa_flavor != AUTH_GSSAPI &&
 	 !check_rpcsec_auth(rqstp)) {
@@ -248,12 +257,49 @@ void kadm_1(rqstp, transp)
 	  local = (bool_t (*)()) get_principal_keys_2_svc;
 	  break;
 
+     case CREATE_PRINCIPALS:
+	  xdr_argument = xdr_cprincs_arg;
+	  xdr_result = xdr_batch_ret;
+	  local = (bool_t (*)()) create_principals_2_svc;
+	  break;
+
+     case MODIFY_PRINCIPALS:
+	  xdr_argument = xdr_mprincs_arg;
+	  xdr_result = xdr_batch_ret;
+	  local = (bool_t (*)()) modify_principals_2_svc;
+	  break;
+
+     case CHRAND_PRINCIPALS:
+	  xdr_argument = xdr_chrands_arg;
+	  xdr_result = xdr_batch_ret;
+	  local = (bool_t (*)()) chrand_principals_2_svc;
+	  break;
+
+     case SETKEY_PRINCIPALS:
+	  xdr_argument = xdr_setkeys_arg;
+	  xdr_result = xdr_batch_ret;
+	  local = (bool_t (*)()) setkey_principals_2_svc;
+	  break;
+
+     case DELETE_PRINCIPALS:
+	  xdr_argument = xdr_dprincs_arg;
+	  xdr_result = xdr_batch_ret;
+	  local = (bool_t (*)()) delete_principals_2_svc;
+	  break;
+
+     case GET_PRINCS_PAGE:
+	  xdr_argument = xdr_gprincs_page_arg;
+	  xdr_result = xdr_gprincs_page_ret;
+	  local = (bool_t (*)()) get_princs_page_2_svc;
+	  break;
+
      default:
 	  krb5_klog_syslog(LOG_ERR, "Invalid KADM5 procedure number: %s, %d",
 			   client_addr(rqstp->rq_xprt), rqstp->rq_proc);
 	  svcerr_noproc(transp);
 	  return;
      }
+     stats_begin(&mark);
      memset(&argument, 0, sizeof(argument));
      if (!svc_getargs(transp, xdr_argument, &argument)) {
 	  svcerr_decode(transp);
@@ -266,6 +312,10 @@ void kadm_1(rqstp, transp)
 		 "continuing.");
 	  svcerr_systemerr(transp);
      }
+     /* Every result type begins with the API version and the error code. */
+     stats_end(&mark, rqstp->rq_proc,
+	       !retval || ((generic_ret *)&result)->code != 0,
+	       client_addr(transp));
      if (!svc_freeargs(transp, xdr_argument, &argument)) {
 	  krb5_klog_syslog(LOG_ERR, "WARNING! Unable to free arguments, "
 		 "continuing.");
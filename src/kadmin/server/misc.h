@@ -58,6 +58,21 @@ const char *client_addr(SVCXPRT *xprt);
 /* network.c */
 #include "net-server.h"
 
+/* stats.c */
+#define STATS_OP_KPASSWD 33     /* follows the kadm5 RPC procedure numbers */
+#define STATS_NPHASES 5
+
+struct stats_mark {
+    uint64_t start;
+    uint64_t phases[STATS_NPHASES];
+};
+
+krb5_error_code stats_init(verto_ctx *ctx, int worker);
+void stats_fini(void);
+void stats_begin(struct stats_mark *mark);
+void stats_end(const struct stats_mark *mark, int op, krb5_boolean failed,
+               const char *detail);
+
 
 void
 krb5_iprop_prog_1(struct svc_req *rqstp, SVCXPRT *transp);
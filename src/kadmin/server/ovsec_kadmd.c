@@ -42,6 +42,7 @@
 #endif
 #include <sys/time.h>
 #include <sys/socket.h>
+#include <sys/wait.h>
 #include <unistd.h>
 #include <netinet/in.h>
 #include <netdb.h>
@@ -75,6 +76,10 @@ char *dump_file = KPROP_DEFAULT_FILE;
 
 static krb5_context context;
 static char *progname;
+static int workers = 0;
+static int worker_index = -1;   /* index of this worker process, if any */
+static volatile int signal_received = 0;
+static volatile int sighup_received = 0;
 
 #ifdef USE_PASSWORD_SERVER
 void kadm5_set_use_password_server(void);
@@ -86,7 +91,8 @@ usage()
     fprintf(stderr, _("Usage: kadmind [-x db_args]* [-r realm] [-m] [-nofork] "
                       "[-port port-number]\n"
                       "\t\t[-proponly] [-p path-to-kdb5_util] [-F dump-file]\n"
-                      "\t\t[-K path-to-kprop] [-P pid_file]\n"
+                      "\t\t[-K path-to-kprop] [-P pid_file] "
+                      "[-w numworkers]\n"
                       "\nwhere,\n\t[-x db_args]* - any number of database "
                       "specific arguments.\n"
                       "\t\t\tLook at each database documentation for "
@@ -134,8 +140,27 @@ write_pid_file(const char *pid_file)
     return st1 ? st1 : st2;
 }
 
+/* Reload the ACL file (and with it, clear the ACL lookup cache) on SIGHUP.
+ * If the new file cannot be loaded, keep the current ACL. */
+static void
+reload_acl(void *handle)
+{
+    kadm5_server_handle_t h = handle;
+
+    if (kadm5int_acl_reload(h->context)) {
+        krb5_klog_syslog(LOG_INFO, _("reloaded ACL file %s"),
+                         h->params.acl_file);
+    } else {
+        krb5_klog_syslog(LOG_ERR, _("failed to reload ACL file %s; keeping "
+                                    "the current ACL"), h->params.acl_file);
+    }
+}
+
 /* Set up the main loop.  If proponly is set, don't set up ports for kpasswd or
- * kadmin.  May set *ctx_out even on error. */
+ * kadmin.  If we will use worker processes, leave signal handling to the
+ * workers and don't listen for routing socket messages, since the workers
+ * won't be able to re-open the listener sockets.  May set *ctx_out even on
+ * error. */
 static krb5_error_code
 setup_loop(int proponly, verto_ctx **ctx_out)
 {
@@ -146,9 +171,11 @@ setup_loop(int proponly, verto_ctx **ctx_out)
     *ctx_out = ctx = loop_init(VERTO_EV_TYPE_SIGNAL);
     if (ctx == NULL)
         return ENOMEM;
-    ret = loop_setup_signals(ctx, global_server_handle, NULL);
-    if (ret)
-        return ret;
+    if (workers == 0) {
+        ret = loop_setup_signals(ctx, global_server_handle, reload_acl);
+        if (ret)
+            return ret;
+    }
     if (!proponly) {
         ret = loop_add_udp_port(handle->params.kpasswd_port);
         if (ret)
@@ -169,10 +196,215 @@ setup_loop(int proponly, verto_ctx **ctx_out)
             return ret;
     }
 #endif
-    ret = loop_setup_routing_socket(ctx, global_server_handle, progname);
+    if (workers == 0) {
+        ret = loop_setup_routing_socket(ctx, global_server_handle, progname);
+        if (ret)
+            return ret;
+    }
+    return loop_setup_network(ctx, global_server_handle, progname);
+}
+
+static krb5_sigtype
+on_monitor_signal(int signo)
+{
+    signal_received = signo;
+
+#ifdef POSIX_SIGTYPE
+    return;
+#else
+    return(0);
+#endif
+}
+
+static krb5_sigtype
+on_monitor_sighup(int signo)
+{
+    sighup_received = 1;
+
+#ifdef POSIX_SIGTYPE
+    return;
+#else
+    return(0);
+#endif
+}
+
+/*
+ * Kill the worker subprocesses given by pids[0..bound-1], skipping any which
+ * are set to -1, and wait for them to exit (so that we know the ports are no
+ * longer in use).
+ */
+static void
+terminate_workers(pid_t *pids, int bound)
+{
+    int i, status, num_active = 0;
+    pid_t pid;
+
+    for (i = 0; i < bound; i++) {
+        if (pids[i] == -1)
+            continue;
+        kill(pids[i], SIGTERM);
+        num_active++;
+    }
+
+    while (num_active > 0) {
+        pid = wait(&status);
+        if (pid >= 0)
+            num_active--;
+    }
+}
+
+/*
+ * Create num admin worker processes, plus a process dedicated to iprop
+ * requests if separate_iprop is set, and return successfully in each child
+ * with *iprop_worker_out indicating which kind of worker it is.  Each worker
+ * accepts connections on the listener sockets it inherits, so requests from
+ * different clients are processed concurrently; database writes are
+ * serialized by the KDB and update log locks.  The parent process acts as a
+ * supervisor and only returns from this function in error cases.
+ */
+static krb5_error_code
+create_workers(verto_ctx *ctx, int num, int separate_iprop,
+               int *iprop_worker_out)
+{
+    krb5_error_code ret;
+    int i, total, status;
+    pid_t pid, *pids;
+#ifdef POSIX_SIGNALS
+    struct sigaction s_action;
+#endif /* POSIX_SIGNALS */
+
+    *iprop_worker_out = 0;
+
+    /* Set up signal handlers which will forward to the children.  The
+     * children install their own handlers once they are initialized. */
+#ifdef POSIX_SIGNALS
+    (void)sigemptyset(&s_action.sa_mask);
+    s_action.sa_flags = 0;
+    s_action.sa_handler = on_monitor_signal;
+    (void)sigaction(SIGINT, &s_action, NULL);
+    (void)sigaction(SIGTERM, &s_action, NULL);
+    (void)sigaction(SIGQUIT, &s_action, NULL);
+    s_action.sa_handler = on_monitor_sighup;
+    (void)sigaction(SIGHUP, &s_action, NULL);
+#else  /* POSIX_SIGNALS */
+    signal(SIGINT, on_monitor_signal);
+    signal(SIGTERM, on_monitor_signal);
+    signal(SIGQUIT, on_monitor_signal);
+    signal(SIGHUP, on_monitor_sighup);
+#endif /* POSIX_SIGNALS */
+
+    total = separate_iprop ? num + 1 : num;
+    krb5_klog_syslog(LOG_INFO, _("creating %d worker processes"), total);
+    pids = calloc(total, sizeof(pid_t));
+    if (pids == NULL)
+        return ENOMEM;
+    for (i = 0; i < total; i++) {
+        pid = fork();
+        if (pid == 0) {
+            free(pids);
+            if (!verto_reinitialize(ctx)) {
+                krb5_klog_syslog(LOG_ERR,
+                                 _("Unable to reinitialize main loop"));
+                return ENOMEM;
+            }
+            /* The last process created serves iprop requests. */
+            *iprop_worker_out = (separate_iprop && i == num);
+            worker_index = i;
+            return 0;
+        }
+        if (pid == -1) {
+            ret = errno;
+            terminate_workers(pids, i);
+            free(pids);
+            return ret;
+        }
+        pids[i] = pid;
+    }
+
+    /* We're going to use our own main loop here. */
+    loop_free(ctx);
+
+    /* Supervise the worker processes. */
+    while (!signal_received) {
+        pid = wait(&status);
+        if (pid >= 0) {
+            krb5_klog_syslog(LOG_ERR, _("worker %ld exited with status %d"),
+                             (long)pid, status);
+            for (i = 0; i < total; i++) {
+                if (pids[i] == pid)
+                    pids[i] = -1;
+            }
+
+            /* When one worker process exits, terminate them all, so that
+             * crashes behave similarly with or without worker processes. */
+            break;
+        }
+
+        /* Propagate HUP signal to worker processes if we received one. */
+        if (sighup_received) {
+            sighup_received = 0;
+            for (i = 0; i < total; i++) {
+                if (pids[i] != -1)
+                    kill(pids[i], SIGHUP);
+            }
+        }
+    }
+    if (signal_received) {
+        krb5_klog_syslog(LOG_INFO, _("signal %d received in supervisor"),
+                         signal_received);
+    }
+
+    terminate_workers(pids, total);
+    free(pids);
+    exit(0);
+}
+
+/*
+ * Fork the worker processes and prepare to run as one of them; the parent
+ * process only returns from this function in error cases.  Each worker
+ * re-creates the server handle so that it does not share database
+ * connections or file offsets with the other workers, and closes the
+ * listeners it should not serve.
+ */
+static krb5_error_code
+setup_worker(verto_ctx *ctx, kadm5_config_params *params, char **db_args,
+             int separate_iprop)
+{
+    krb5_error_code ret;
+    int iprop_worker;
+    u_long only_prog = 0, skip_prog = 0;
+
+    kadm5_destroy(global_server_handle);
+    global_server_handle = NULL;
+
+    ret = create_workers(ctx, workers, separate_iprop, &iprop_worker);
     if (ret)
         return ret;
-    return loop_setup_network(ctx, global_server_handle, progname);
+
+    /* We get here only in a worker process. */
+    ret = kadm5_init(context, "kadmind", NULL, NULL, params,
+                     KADM5_STRUCT_VERSION, KADM5_API_VERSION_4, db_args,
+                     &global_server_handle);
+    if (ret)
+        return ret;
+
+#ifndef DISABLE_IPROP
+    if (iprop_worker)
+        only_prog = KRB5_IPROP_PROG;
+    else if (separate_iprop)
+        skip_prog = KRB5_IPROP_PROG;
+#endif
+    loop_setup_worker(global_server_handle, only_prog, skip_prog);
+
+    ret = loop_setup_signals(ctx, global_server_handle, reload_acl);
+    if (ret)
+        return ret;
+
+    /* Avoid a race with a signal received before our handlers were set. */
+    if (signal_received)
+        exit(0);
+
+    return 0;
 }
 
 /* Point GSSAPI at the KDB keytab so we don't need an actual file keytab. */
@@ -234,7 +466,15 @@ log_badverf(gss_name_t client_name, gss_name_t server_name,
         {21, "SETKEY_PRINCIPAL3"},
         {22, "PURGEKEYS"},
         {23, "GET_STRINGS"},
-        {24, "SET_STRING"}
+        {24, "SET_STRING"},
+        {25, "SETKEY_PRINCIPAL4"},
+        {26, "EXTRACT_KEYS"},
+        {27, "CREATE_PRINCIPALS"},
+        {28, "MODIFY_PRINCIPALS"},
+        {29, "CHRAND_PRINCIPALS"},
+        {30, "SETKEY_PRINCIPALS"},
+        {31, "DELETE_PRINCIPALS"},
+        {32, "GET_PRINCS_PAGE"}
     };
     OM_uint32 minor;
     gss_buffer_desc client, server;
@@ -353,6 +593,7 @@ main(int argc, char *argv[])
     const char *pid_file = NULL;
     char **db_args = NULL, **tmpargs;
     int ret, i, db_args_size = 0, strong_random = 1, proponly = 0;
+    int separate_iprop = 0;
 
     setlocale(LC_ALL, "");
     setvbuf(stderr, NULL, _IONBF, 0);
@@ -431,6 +672,13 @@ main(int argc, char *argv[])
             if (!argc)
                 usage();
             kprop = *argv;
+        } else if (strcmp(*argv, "-w") == 0) {
+            argc--, argv++;
+            if (!argc)
+                usage();
+            workers = atoi(*argv);
+            if (workers <= 0)
+                usage();
         } else {
             break;
         }
@@ -449,6 +697,11 @@ main(int argc, char *argv[])
 
     krb5_klog_init(context, "admin_server", progname, 1);
 
+    /* Worker processes cannot prompt for the master key. */
+    if (workers > 0 && params.mkey_from_kbd)
+        fail_to_start(0, _("Cannot read the master key from the keyboard "
+                           "with worker processes"));
+
     ret = kadm5_init(context, "kadmind", NULL, NULL, &params,
                      KADM5_STRUCT_VERSION, KADM5_API_VERSION_4, db_args,
                      &global_server_handle);
@@ -527,6 +780,22 @@ main(int argc, char *argv[])
         }
     }
 
+    if (workers > 0) {
+#ifndef DISABLE_IPROP
+        /* Give iprop its own process so that replicas don't wait behind
+         * administrative requests.  With -proponly, all workers serve
+         * iprop. */
+        separate_iprop = params.iprop_enabled && !proponly;
+#endif
+        ret = setup_worker(vctx, &params, db_args, separate_iprop);
+        if (ret)
+            fail_to_start(ret, _("creating worker processes"));
+    }
+
+    ret = stats_init(vctx, worker_index);
+    if (ret)
+        fail_to_start(ret, _("initializing statistics"));
+
     krb5_klog_syslog(LOG_INFO, _("starting"));
     if (nofork)
         fprintf(stderr, _("%s: starting...\n"), progname);
@@ -535,6 +804,7 @@ main(int argc, char *argv[])
     krb5_klog_syslog(LOG_INFO, _("finished, exiting"));
 
     /* Clean up memory, etc */
+    stats_fini();
     svcauth_gssapi_unset_names();
     kadm5_destroy(global_server_handle);
     loop_free(vctx);
@@ -43,7 +43,9 @@ process_chpw_request(krb5_context context, void *server_handle, char *realm,
     socklen_t salen;
     char addrbuf[100];
     krb5_address *addr = remote_faddr->address;
+    struct stats_mark mark;
 
+    stats_begin(&mark);
     *rep = empty_data();
 
     if (req->length < 4) {
@@ -421,6 +423,8 @@ chpwfail:
     memcpy(ptr, cipher.data, cipher.length);
 
 bailout:
+    stats_end(&mark, STATS_OP_KPASSWD,
+              ret != 0 || numresult != KRB5_KPASSWD_SUCCESS, clientstr);
     krb5_auth_con_free(context, auth_context);
     krb5_free_principal(context, changepw);
     krb5_free_ticket(context, ticket);
@@ -130,15 +130,22 @@ static kadm5_ret_t new_server_handle(krb5_ui_4 api_version,
 /*
  * Function: free_server_handle
  *
- * Purpose: Free handle memory allocated by new_server_handle
+ * Purpose: Free handle memory allocated by new_server_handle, folding its
+ * phase timings into the global handle
  *
  * Arguments:
  *      handle          (input/output) The handle to free
  */
 static void free_server_handle(kadm5_server_handle_t handle)
 {
+    kadm5_server_handle_t global = global_server_handle;
+
     if (!handle)
         return;
+    /* The copy's phase counters began with the global values; carry them
+     * back so that kadmind sees the time spent by this request. */
+    memcpy(global->phase_usec, handle->phase_usec,
+           sizeof(global->phase_usec));
     krb5_free_principal(handle->context, handle->current_caller);
     free(handle);
 }
@@ -770,6 +777,59 @@ exit_func:
     return TRUE;
 }
 
+/* Largest page of names returned by get_princs_page_2_svc, keeping the reply
+ * well under the RPC record size limit. */
+#define MAX_PAGE_NAMES 4096
+
+bool_t
+get_princs_page_2_svc(gprincs_page_arg *arg, gprincs_page_ret *ret,
+                      struct svc_req *rqstp)
+{
+    char                            *prime_arg = NULL;
+    gss_buffer_desc                 client_name = GSS_C_EMPTY_BUFFER;
+    gss_buffer_desc                 service_name = GSS_C_EMPTY_BUFFER;
+    kadm5_server_handle_t           handle;
+    const char                      *errmsg = NULL;
+    int                             max;
+
+    ret->code = stub_setup(arg->api_version, rqstp, NULL, &handle,
+                           &ret->api_version, &client_name, &service_name,
+                           NULL);
+    if (ret->code)
+        goto exit_func;
+
+    prime_arg = arg->exp;
+    if (prime_arg == NULL)
+        prime_arg = "*";
+
+    if (CHANGEPW_SERVICE(rqstp) || !kadm5int_acl_check(handle->context,
+                                                       rqst2name(rqstp),
+                                                       ACL_LIST,
+                                                       NULL,
+                                                       NULL)) {
+        ret->code = KADM5_AUTH_LIST;
+        log_unauth("kadm5_get_principals_page", prime_arg,
+                   &client_name, &service_name, rqstp);
+    } else {
+        max = (arg->max > MAX_PAGE_NAMES) ? MAX_PAGE_NAMES : arg->max;
+        ret->code = kadm5_get_principals_page(handle, arg->exp, arg->cursor,
+                                              max, &ret->princs, &ret->count,
+                                              &ret->cursor);
+        if (ret->code != 0)
+            errmsg = krb5_get_error_message(handle->context, ret->code);
+
+        log_done("kadm5_get_principals_page", prime_arg, errmsg,
+                 &client_name, &service_name, rqstp);
+
+        if (errmsg != NULL)
+            krb5_free_error_message(handle->context, errmsg);
+    }
+
+exit_func:
+    stub_cleanup(handle, NULL, &client_name, &service_name);
+    return TRUE;
+}
+
 bool_t
 chpass_principal_2_svc(chpass_arg *arg, generic_ret *ret,
                        struct svc_req *rqstp)
@@ -1705,3 +1765,385 @@ exit_func:
     stub_cleanup(handle, prime_arg, &client_name, &service_name);
     return TRUE;
 }
+
+/*
+ * Allocate the per-principal result codes of a batch reply for n principals
+ * and begin a database transaction for the batch.
+ */
+static kadm5_ret_t
+batch_setup(kadm5_server_handle_t handle, int n, batch_ret *ret)
+{
+    kadm5_ret_t code;
+
+    if (n < 0)
+        return EINVAL;
+    ret->codes = calloc(n > 0 ? n : 1, sizeof(*ret->codes));
+    if (ret->codes == NULL)
+        return ENOMEM;
+    ret->n_codes = n;
+
+    code = krb5_db_begin_txn(handle->context);
+    if (code) {
+        free(ret->codes);
+        ret->codes = NULL;
+        ret->n_codes = 0;
+    }
+    return code;
+}
+
+/* Commit the transaction for a batch, setting the overall result code. */
+static void
+batch_finish(kadm5_server_handle_t handle, batch_ret *ret)
+{
+    ret->code = krb5_db_commit_txn(handle->context);
+    if (ret->code) {
+        free(ret->codes);
+        ret->codes = NULL;
+        ret->n_codes = 0;
+    }
+}
+
+/* Log the result of one element of a batch request. */
+static void
+log_batch_done(kadm5_server_handle_t handle, char *op, char *target,
+               kadm5_ret_t code, gss_buffer_t client, gss_buffer_t server,
+               struct svc_req *rqstp)
+{
+    const char *errmsg = NULL;
+
+    if (code != 0)
+        errmsg = krb5_get_error_message(handle->context, code);
+    log_done(op, target, errmsg, client, server, rqstp);
+    if (errmsg != NULL)
+        krb5_free_error_message(handle->context, errmsg);
+}
+
+bool_t
+create_principals_2_svc(cprincs_arg *arg, batch_ret *ret,
+                        struct svc_req *rqstp)
+{
+    char                        *prime_arg;
+    gss_buffer_desc             client_name = GSS_C_EMPTY_BUFFER;
+    gss_buffer_desc             service_name = GSS_C_EMPTY_BUFFER;
+    kadm5_server_handle_t       handle;
+    kadm5_principal_ent_t       rec;
+    restriction_t               *rp;
+    long                        mask;
+    int                         i;
+
+    ret->code = stub_setup(arg->api_version, rqstp, NULL, &handle,
+                           &ret->api_version, &client_name, &service_name,
+                           NULL);
+    if (ret->code)
+        goto exit_func;
+
+    ret->code = batch_setup(handle, arg->n_recs, ret);
+    if (ret->code)
+        goto exit_func;
+
+    for (i = 0; i < arg->n_recs; i++) {
+        rec = &arg->recs[i];
+        mask = arg->mask;
+        prime_arg = NULL;
+        if (rec->principal == NULL ||
+            krb5_unparse_name(handle->context, rec->principal, &prime_arg)) {
+            ret->codes[i] = KADM5_BAD_PRINCIPAL;
+            continue;
+        }
+
+        if (CHANGEPW_SERVICE(rqstp)
+            || !kadm5int_acl_check(handle->context, rqst2name(rqstp), ACL_ADD,
+                                   rec->principal, &rp)
+            || kadm5int_acl_impose_restrictions(handle->context, rec, &mask,
+                                                rp)) {
+            ret->codes[i] = KADM5_AUTH_ADD;
+            log_unauth("kadm5_create_principal", prime_arg,
+                       &client_name, &service_name, rqstp);
+        } else {
+            ret->codes[i] = kadm5_create_principal_3(handle, rec, mask,
+                                                     arg->n_ks_tuple,
+                                                     arg->ks_tuple,
+                                                     arg->passwd);
+            log_batch_done(handle, "kadm5_create_principal", prime_arg,
+                           ret->codes[i], &client_name, &service_name, rqstp);
+        }
+        free(prime_arg);
+    }
+
+    batch_finish(handle, ret);
+
+exit_func:
+    stub_cleanup(handle, NULL, &client_name, &service_name);
+    return TRUE;
+}
+
+bool_t
+modify_principals_2_svc(mprincs_arg *arg, batch_ret *ret,
+                        struct svc_req *rqstp)
+{
+    char                        *prime_arg;
+    gss_buffer_desc             client_name = GSS_C_EMPTY_BUFFER;
+    gss_buffer_desc             service_name = GSS_C_EMPTY_BUFFER;
+    kadm5_server_handle_t       handle;
+    kadm5_principal_ent_t       rec;
+    kadm5_principal_ent_rec     old;
+    restriction_t               *rp;
+    kadm5_ret_t                 code;
+    long                        mask;
+    int                         i;
+
+    ret->code = stub_setup(arg->api_version, rqstp, NULL, &handle,
+                           &ret->api_version, &client_name, &service_name,
+                           NULL);
+    if (ret->code)
+        goto exit_func;
+
+    ret->code = batch_setup(handle, arg->n_recs, ret);
+    if (ret->code)
+        goto exit_func;
+
+    for (i = 0; i < arg->n_recs; i++) {
+        rec = &arg->recs[i];
+        mask = arg->mask;
+        prime_arg = NULL;
+        if (rec->principal == NULL ||
+            krb5_unparse_name(handle->context, rec->principal, &prime_arg)) {
+            ret->codes[i] = KADM5_BAD_PRINCIPAL;
+            continue;
+        }
+
+        code = KADM5_OK;
+        if (CHANGEPW_SERVICE(rqstp)
+            || !kadm5int_acl_check(handle->context, rqst2name(rqstp),
+                                   ACL_MODIFY, rec->principal, &rp)) {
+            code = KADM5_AUTH_MODIFY;
+        } else if (mask & KADM5_ATTRIBUTES) {
+            /* Apply the attribute changes to the current attributes. */
+            code = kadm5_get_principal(handle, rec->principal, &old,
+                                       KADM5_ATTRIBUTES);
+            if (code == KADM5_OK) {
+                rec->attributes = (old.attributes | arg->set_attrs) &
+                    ~arg->clear_attrs;
+                kadm5_free_principal_ent(handle, &old);
+            }
+        }
+        if (code == KADM5_OK &&
+            kadm5int_acl_impose_restrictions(handle->context, rec, &mask,
+                                             rp)) {
+            code = KADM5_AUTH_MODIFY;
+        }
+        if (code == KADM5_OK && (mask & KADM5_ATTRIBUTES) &&
+            !(rec->attributes & KRB5_KDB_LOCKDOWN_KEYS)) {
+            code = check_lockdown_keys(handle, rec->principal);
+            if (code == KADM5_PROTECT_KEYS)
+                code = KADM5_AUTH_MODIFY;
+        }
+
+        if (code == KADM5_AUTH_MODIFY) {
+            log_unauth("kadm5_modify_principal", prime_arg,
+                       &client_name, &service_name, rqstp);
+        } else {
+            if (code == KADM5_OK)
+                code = kadm5_modify_principal(handle, rec, mask);
+            log_batch_done(handle, "kadm5_modify_principal", prime_arg, code,
+                           &client_name, &service_name, rqstp);
+        }
+        ret->codes[i] = code;
+        free(prime_arg);
+    }
+
+    batch_finish(handle, ret);
+
+exit_func:
+    stub_cleanup(handle, NULL, &client_name, &service_name);
+    return TRUE;
+}
+
+bool_t
+chrand_principals_2_svc(chrands_arg *arg, batch_ret *ret,
+                        struct svc_req *rqstp)
+{
+    char                        *prime_arg;
+    gss_buffer_desc             client_name = GSS_C_EMPTY_BUFFER;
+    gss_buffer_desc             service_name = GSS_C_EMPTY_BUFFER;
+    kadm5_server_handle_t       handle;
+    krb5_principal              princ;
+    int                         i;
+
+    ret->code = stub_setup(arg->api_version, rqstp, NULL, &handle,
+                           &ret->api_version, &client_name, &service_name,
+                           NULL);
+    if (ret->code)
+        goto exit_func;
+
+    ret->code = batch_setup(handle, arg->n_princs, ret);
+    if (ret->code)
+        goto exit_func;
+
+    /* Keys are not returned, so lockdown_keys principals need no special
+     * treatment here. */
+    for (i = 0; i < arg->n_princs; i++) {
+        princ = arg->princs[i];
+        prime_arg = NULL;
+        if (princ == NULL ||
+            krb5_unparse_name(handle->context, princ, &prime_arg)) {
+            ret->codes[i] = KADM5_BAD_PRINCIPAL;
+            continue;
+        }
+
+        if (cmp_gss_krb5_name(handle, rqst2name(rqstp), princ)) {
+            ret->codes[i] = randkey_principal_wrapper_3(handle, princ,
+                                                        arg->keepold,
+                                                        arg->n_ks_tuple,
+                                                        arg->ks_tuple, NULL,
+                                                        NULL);
+        } else if (!(CHANGEPW_SERVICE(rqstp)) &&
+                   kadm5int_acl_check(handle->context, rqst2name(rqstp),
+                                      ACL_CHANGEPW, princ, NULL)) {
+            ret->codes[i] = kadm5_randkey_principal_3(handle, princ,
+                                                      arg->keepold,
+                                                      arg->n_ks_tuple,
+                                                      arg->ks_tuple, NULL,
+                                                      NULL);
+        } else {
+            ret->codes[i] = KADM5_AUTH_CHANGEPW;
+            log_unauth("kadm5_randkey_principal", prime_arg,
+                       &client_name, &service_name, rqstp);
+        }
+
+        if (ret->codes[i] != KADM5_AUTH_CHANGEPW) {
+            log_batch_done(handle, "kadm5_randkey_principal", prime_arg,
+                           ret->codes[i], &client_name, &service_name, rqstp);
+        }
+        free(prime_arg);
+    }
+
+    batch_finish(handle, ret);
+
+exit_func:
+    stub_cleanup(handle, NULL, &client_name, &service_name);
+    return TRUE;
+}
+
+bool_t
+setkey_principals_2_svc(setkeys_arg *arg, batch_ret *ret,
+                        struct svc_req *rqstp)
+{
+    char                        *prime_arg;
+    gss_buffer_desc             client_name = GSS_C_EMPTY_BUFFER;
+    gss_buffer_desc             service_name = GSS_C_EMPTY_BUFFER;
+    kadm5_server_handle_t       handle;
+    setkeys_ent                 *ent;
+    kadm5_ret_t                 code;
+    int                         i;
+
+    ret->code = stub_setup(arg->api_version, rqstp, NULL, &handle,
+                           &ret->api_version, &client_name, &service_name,
+                           NULL);
+    if (ret->code)
+        goto exit_func;
+
+    ret->code = batch_setup(handle, arg->n_ents, ret);
+    if (ret->code)
+        goto exit_func;
+
+    for (i = 0; i < arg->n_ents; i++) {
+        ent = &arg->ents[i];
+        prime_arg = NULL;
+        if (ent->princ == NULL ||
+            krb5_unparse_name(handle->context, ent->princ, &prime_arg)) {
+            ret->codes[i] = KADM5_BAD_PRINCIPAL;
+            continue;
+        }
+
+        code = check_lockdown_keys(handle, ent->princ);
+        if (code == KADM5_PROTECT_KEYS) {
+            code = KADM5_AUTH_SETKEY;
+        } else if (code == KADM5_OK &&
+                   (CHANGEPW_SERVICE(rqstp) ||
+                    !kadm5int_acl_check(handle->context, rqst2name(rqstp),
+                                        ACL_SETKEY, ent->princ, NULL))) {
+            code = KADM5_AUTH_SETKEY;
+        } else if (code == KADM5_OK) {
+            code = kadm5_setkey_principal_4(handle, ent->princ, arg->keepold,
+                                            ent->key_data, ent->n_key_data);
+        }
+
+        if (code == KADM5_AUTH_SETKEY) {
+            log_unauth("kadm5_setkey_principal", prime_arg,
+                       &client_name, &service_name, rqstp);
+        } else {
+            log_batch_done(handle, "kadm5_setkey_principal", prime_arg, code,
+                           &client_name, &service_name, rqstp);
+        }
+        ret->codes[i] = code;
+        free(prime_arg);
+    }
+
+    batch_finish(handle, ret);
+
+exit_func:
+    stub_cleanup(handle, NULL, &client_name, &service_name);
+    return TRUE;
+}
+
+bool_t
+delete_principals_2_svc(dprincs_arg *arg, batch_ret *ret,
+                        struct svc_req *rqstp)
+{
+    char                        *prime_arg;
+    gss_buffer_desc             client_name = GSS_C_EMPTY_BUFFER;
+    gss_buffer_desc             service_name = GSS_C_EMPTY_BUFFER;
+    kadm5_server_handle_t       handle;
+    krb5_principal              princ;
+    kadm5_ret_t                 code;
+    int                         i;
+
+    ret->code = stub_setup(arg->api_version, rqstp, NULL, &handle,
+                           &ret->api_version, &client_name, &service_name,
+                           NULL);
+    if (ret->code)
+        goto exit_func;
+
+    ret->code = batch_setup(handle, arg->n_princs, ret);
+    if (ret->code)
+        goto exit_func;
+
+    for (i = 0; i < arg->n_princs; i++) {
+        princ = arg->princs[i];
+        prime_arg = NULL;
+        if (princ == NULL ||
+            krb5_unparse_name(handle->context, princ, &prime_arg)) {
+            ret->codes[i] = KADM5_BAD_PRINCIPAL;
+            continue;
+        }
+
+        if (CHANGEPW_SERVICE(rqstp)
+            || !kadm5int_acl_check(handle->context, rqst2name(rqstp),
+                                   ACL_DELETE, princ, NULL)) {
+            code = KADM5_AUTH_DELETE;
+        } else {
+            code = check_lockdown_keys(handle, princ);
+            if (code == KADM5_PROTECT_KEYS)
+                code = KADM5_AUTH_DELETE;
+        }
+
+        if (code == KADM5_AUTH_DELETE) {
+            log_unauth("kadm5_delete_principal", prime_arg,
+                       &client_name, &service_name, rqstp);
+        } else {
+            if (code == KADM5_OK)
+                code = kadm5_delete_principal(handle, princ);
+            log_batch_done(handle, "kadm5_delete_principal", prime_arg, code,
+                           &client_name, &service_name, rqstp);
+        }
+        ret->codes[i] = code;
+        free(prime_arg);
+    }
+
+    batch_finish(handle, ret);
+
+exit_func:
+    stub_cleanup(handle, NULL, &client_name, &service_name);
+    return TRUE;
+}
@@ -0,0 +1,177 @@
+/* -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* kadmin/server/stats.c - kadmind operation statistics */
+/*
+ * Copyright (C) 2016 by the Massachusetts Institute of Technology.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * kadmind records the elapsed time of each kadm5 RPC and kpasswd request,
+ * divided into time spent checking ACLs, in password quality modules, in
+ * kadm5_hook modules, in the KDB and writing the update log.  The phase times
+ * are taken from cumulative counters kept by libkadm5srv and libkdb5, so the
+ * KDB figure excludes the update log time nested within it.
+ */
+
+#include <k5-int.h>
+#include <kadm5/admin.h>
+#include <kadm5/server_acl.h>
+#include <adm_proto.h>
+#include <syslog.h>
+#include <kdb_log.h>
+#include "kadm5/server_internal.h"
+#include "misc.h"
+
+extern void *global_server_handle;
+
+/* Operation names, indexed by kadm5 RPC procedure number, followed by
+ * kpasswd. */
+static const char *const op_names[] = {
+    "null", "create_principal", "delete_principal", "modify_principal",
+    "rename_principal", "get_principal", "chpass_principal",
+    "chrand_principal", "create_policy", "delete_policy", "modify_policy",
+    "get_policy", "get_privs", "init", "get_princs", "get_pols",
+    "setkey_principal", "setv4key_principal", "create_principal3",
+    "chpass_principal3", "chrand_principal3", "setkey_principal3",
+    "purgekeys", "get_strings", "set_string", "setkey_principal4",
+    "extract_keys", "create_principals", "modify_principals",
+    "chrand_principals", "setkey_principals", "delete_principals",
+    "get_princs_page", "kpasswd", NULL
+};
+
+/* Phase indices; misc.h defines STATS_NPHASES to match. */
+enum { PHASE_ACL, PHASE_PWQUAL, PHASE_HOOK, PHASE_KDB, PHASE_ULOG };
+
+static const char *const phase_names[] = {
+    "acl", "pwqual", "hook", "kdb", "ulog", NULL
+};
+
+static struct opstats *stats;
+
+/* Read the cumulative phase counters into phases. */
+static void
+get_phases(uint64_t *phases)
+{
+    kadm5_server_handle_t handle = global_server_handle;
+    kdb_log_context *log_ctx = handle->context->kdblog_context;
+
+    phases[PHASE_ACL] = kadm5int_acl_usec();
+    phases[PHASE_PWQUAL] = handle->phase_usec[KADM5_PHASE_PWQUAL];
+    phases[PHASE_HOOK] = handle->phase_usec[KADM5_PHASE_HOOK];
+    phases[PHASE_KDB] = handle->phase_usec[KADM5_PHASE_KDB];
+    phases[PHASE_ULOG] = (log_ctx != NULL) ? log_ctx->ulog_usec : 0;
+}
+
+/*
+ * If a statistics file is configured for the realm, begin recording
+ * statistics, writing them periodically while ctx runs.  worker is the index
+ * of this worker process, or -1 if there are no worker processes.
+ */
+krb5_error_code
+stats_init(verto_ctx *ctx, int worker)
+{
+    kadm5_server_handle_t handle = global_server_handle;
+    krb5_error_code ret;
+    krb5_pointer aprof;
+    const char *hierarchy[4];
+    char *filename = NULL;
+    krb5_int32 threshold = 0;
+
+    assert(sizeof(op_names) / sizeof(*op_names) == STATS_OP_KPASSWD + 2);
+    assert(sizeof(phase_names) / sizeof(*phase_names) == STATS_NPHASES + 1);
+    ret = krb5_aprof_init(DEFAULT_KDC_PROFILE, KDC_PROFILE_ENV, &aprof);
+    if (ret)
+        return ret;
+    hierarchy[0] = KRB5_CONF_REALMS;
+    hierarchy[1] = handle->params.realm;
+    hierarchy[2] = KRB5_CONF_KADMIND_STATS_FILE;
+    hierarchy[3] = NULL;
+    if (krb5_aprof_get_string(aprof, hierarchy, TRUE, &filename))
+        filename = NULL;
+    hierarchy[2] = KRB5_CONF_KADMIND_SLOW_THRESHOLD;
+    if (krb5_aprof_get_int32(aprof, hierarchy, TRUE, &threshold))
+        threshold = 0;
+    krb5_aprof_finish(aprof);
+    if (filename == NULL)
+        return 0;
+
+    ret = opstats_create("kadmind", filename, worker, threshold, op_names,
+                         phase_names, &stats);
+    free(filename);
+    if (ret)
+        return ret;
+    return opstats_setup_timer(ctx, stats);
+}
+
+/* Write out and release the statistics, if they are being recorded. */
+void
+stats_fini(void)
+{
+    krb5_error_code ret;
+
+    if (stats == NULL)
+        return;
+    ret = opstats_write(stats);
+    if (ret) {
+        krb5_klog_syslog(LOG_ERR, _("%s while writing statistics"),
+                         error_message(ret));
+    }
+    opstats_free(stats);
+    stats = NULL;
+}
+
+/* Note the start of an operation. */
+void
+stats_begin(struct stats_mark *mark)
+{
+    if (stats == NULL)
+        return;
+    mark->start = k5_monotonic_usec();
+    get_phases(mark->phases);
+}
+
+/* Record an operation begun with stats_begin().  detail, if not NULL,
+ * identifies the client in the slow-operation log. */
+void
+stats_end(const struct stats_mark *mark, int op, krb5_boolean failed,
+          const char *detail)
+{
+    uint64_t end, phases[STATS_NPHASES];
+    int i;
+
+    if (stats == NULL)
+        return;
+    end = k5_monotonic_usec();
+    get_phases(phases);
+    for (i = 0; i < STATS_NPHASES; i++)
+        phases[i] -= mark->phases[i];
+    /* Update log writes happen within KDB calls. */
+    phases[PHASE_KDB] -= (phases[PHASE_ULOG] < phases[PHASE_KDB]) ?
+        phases[PHASE_ULOG] : phases[PHASE_KDB];
+    opstats_record(stats, op, failed, end - mark->start, phases, detail);
+}
@@ -35,6 +35,11 @@
 
 static krb5_int32 last_usec = 0, last_os_random = 0;
 
+/* Request types for which statistics are kept. */
+enum { OP_AS_REQ, OP_TGS_REQ, OP_OTHER };
+static const char *const op_names[] = { "as_req", "tgs_req", "other", NULL };
+static struct opstats *stats;
+
 static krb5_error_code make_too_big_error(kdc_realm_t *kdc_active_realm,
                                           krb5_data **out);
 
@@ -45,6 +50,9 @@ struct dispatch_state {
     int is_tcp;
     kdc_realm_t *active_realm;
     krb5_context kdc_err_context;
+    int op;
+    uint64_t start;
+    char addrbuf[46];
 };
 
 static void
@@ -54,6 +62,7 @@ finish_dispatch(struct dispatch_state *state, krb5_error_code code,
     loop_respond_fn oldrespond = state->respond;
     void *oldarg = state->arg;
     kdc_realm_t *kdc_active_realm = state->active_realm;
+    krb5_boolean failed;
 
     if (state->is_tcp == 0 && response &&
         response->length > (unsigned int)max_dgram_reply_size) {
@@ -66,6 +75,14 @@ finish_dispatch(struct dispatch_state *state, krb5_error_code code,
                              error_message(code));
     }
 
+    if (stats != NULL) {
+        failed = (code != 0 || response == NULL ||
+                  krb5_is_krb_error(response));
+        opstats_record(stats, state->op, failed,
+                       k5_monotonic_usec() - state->start, NULL,
+                       state->addrbuf);
+    }
+
     free(state);
     (*oldrespond)(oldarg, code, response);
 }
@@ -140,6 +157,20 @@ dispatch(void *cb, struct sockaddr *local_saddr,
     state->request = pkt;
     state->is_tcp = is_tcp;
     state->kdc_err_context = kdc_err_context;
+    if (stats != NULL) {
+        state->start = k5_monotonic_usec();
+        if (krb5_is_tgs_req(pkt))
+            state->op = OP_TGS_REQ;
+        else if (krb5_is_as_req(pkt))
+            state->op = OP_AS_REQ;
+        else
+            state->op = OP_OTHER;
+        if (inet_ntop(ADDRTYPE2FAMILY(from->address->addrtype),
+                      from->address->contents, state->addrbuf,
+                      sizeof(state->addrbuf)) == NULL)
+            strlcpy(state->addrbuf, "[unknown address type]",
+                    sizeof(state->addrbuf));
+    }
 
     /* decode incoming packet, and dispatch */
 
@@ -201,6 +232,43 @@ dispatch(void *cb, struct sockaddr *local_saddr,
     finish_dispatch_cache(state, retval, response);
 }
 
+/*
+ * If filename is not NULL, begin recording request statistics, writing them
+ * to filename (suffixed with the worker index if it is not negative)
+ * periodically while ctx runs.
+ */
+krb5_error_code
+dispatch_stats_init(verto_ctx *ctx, const char *filename, int worker,
+                    long slow_threshold_ms)
+{
+    krb5_error_code ret;
+
+    if (filename == NULL)
+        return 0;
+    ret = opstats_create("krb5kdc", filename, worker, slow_threshold_ms,
+                         op_names, NULL, &stats);
+    if (ret)
+        return ret;
+    return opstats_setup_timer(ctx, stats);
+}
+
+/* Write out and release the request statistics, if they are being kept. */
+void
+dispatch_stats_fini(void)
+{
+    krb5_error_code ret;
+
+    if (stats == NULL)
+        return;
+    ret = opstats_write(stats);
+    if (ret) {
+        krb5_klog_syslog(LOG_ERR, _("%s while writing statistics"),
+                         error_message(ret));
+    }
+    opstats_free(stats);
+    stats = NULL;
+}
+
 static krb5_error_code
 make_too_big_error(kdc_realm_t *kdc_active_realm, krb5_data **out)
 {
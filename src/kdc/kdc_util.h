@@ -163,6 +163,13 @@ dispatch (void *,
           loop_respond_fn,
           void *);
 
+krb5_error_code
+dispatch_stats_init(verto_ctx *ctx, const char *filename, int worker,
+                    long slow_threshold_ms);
+
+void
+dispatch_stats_fini(void);
+
 void
 kdc_err(krb5_context call_context, errcode_t code, const char *fmt, ...)
 #if !defined(__cplusplus) && (__GNUC__ > 2)
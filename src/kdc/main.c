@@ -59,6 +59,9 @@ static void finish_realms (void);
 
 static int nofork = 0;
 static int workers = 0;
+static int worker_index = -1;   /* index of this worker process, if any */
+static char *stats_file = NULL;
+static krb5_int32 slow_threshold = 0;
 static int time_offset = 0;
 static const char *pid_file = NULL;
 static int rkey_init_done = 0;
@@ -525,6 +528,7 @@ create_workers(verto_ctx *ctx, int num)
                 exit(0);
 
             /* Return control to main() in the new worker process. */
+            worker_index = i;
             return 0;
         }
         if (pid == -1) {
@@ -645,6 +649,13 @@ initialize_realms(krb5_context kcontext, int argc, char **argv)
         hierarchy[1] = KRB5_CONF_HOST_BASED_SERVICES;
         if (krb5_aprof_get_string_all(aprof, hierarchy, &hostbased))
             hostbased = 0;
+        free(stats_file);
+        hierarchy[1] = KRB5_CONF_KDC_STATS_FILE;
+        if (krb5_aprof_get_string(aprof, hierarchy, TRUE, &stats_file))
+            stats_file = NULL;
+        hierarchy[1] = KRB5_CONF_KDC_SLOW_THRESHOLD;
+        if (krb5_aprof_get_int32(aprof, hierarchy, TRUE, &slow_threshold))
+            slow_threshold = 0;
     }
 
     if (default_udp_ports == 0) {
@@ -1056,12 +1067,21 @@ int main(int argc, char **argv)
         finish_realms();
         return 1;
     }
+    retval = dispatch_stats_init(ctx, stats_file, worker_index,
+                                 slow_threshold);
+    if (retval) {
+        kdc_err(kcontext, retval, _("while initializing statistics"));
+        finish_realms();
+        return 1;
+    }
+
     krb5_klog_syslog(LOG_INFO, _("commencing operation"));
     if (nofork)
         fprintf(stderr, _("%s: starting...\n"), kdc_progname);
     kau_kdc_start(kcontext, TRUE);
 
     verto_run(ctx);
+    dispatch_stats_fini();
     loop_free(ctx);
     kau_kdc_stop(kcontext, TRUE);
     krb5_klog_syslog(LOG_INFO, _("shutting down"));
@@ -1075,6 +1095,7 @@ int main(int argc, char **argv)
 #ifndef NOCACHE
     kdc_free_lookaside(kcontext);
 #endif
+    free(stats_file);
     krb5_free_context(kcontext);
     return errout;
 }
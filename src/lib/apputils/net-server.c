@@ -43,9 +43,7 @@
 #include <sys/sockio.h>
 #endif
 #include <sys/time.h>
-#if HAVE_SYS_SELECT_H
-#include <sys/select.h>
-#endif
+#include <sys/resource.h>
 #include <arpa/inet.h>
 
 #ifndef ARPHRD_ETHER /* OpenBSD breaks on multiple inclusions */
@@ -65,8 +63,16 @@
 /* XXX */
 #define KDC5_NONET                               (-1779992062L)
 
-static int tcp_or_rpc_data_counter;
-static int max_tcp_or_rpc_data_connections = 45;
+static int tcp_data_counter;
+static int max_tcp_data_connections = 45;
+
+/* RPC connections are long-lived (kadmin clients, iprop replicas), so their
+ * limit is raised to fit the descriptor limit in loop_setup_network(). */
+static int rpc_data_counter;
+static int max_rpc_data_connections = 45;
+
+/* Descriptors to leave for purposes other than RPC connections. */
+#define RESERVED_FDS 64
 
 static int
 ipv6_enabled()
@@ -158,7 +164,7 @@ struct connection {
 
     /* RPC-specific fields */
     SVCXPRT *transp;
-    int rpc_force_close;
+    u_long prognum;
 };
 
 #define SET(TYPE) struct { TYPE *data; size_t n, max; }
@@ -356,7 +362,7 @@ free_connection(struct connection *conn)
         krb5_free_data(get_context(conn->handle), conn->response);
     if (conn->buffer)
         free(conn->buffer);
-    if (conn->type == CONN_RPC_LISTENER && conn->transp != NULL)
+    if (conn->transp != NULL)
         svc_destroy(conn->transp);
     free(conn);
 }
@@ -379,7 +385,6 @@ static void
 free_socket(verto_ctx *ctx, verto_ev *ev)
 {
     struct connection *conn = NULL;
-    fd_set fds;
     int fd;
 
     remove_event_from_set(ev);
@@ -387,29 +392,21 @@ free_socket(verto_ctx *ctx, verto_ev *ev)
     fd = verto_get_fd(ev);
     conn = verto_get_private(ev);
 
-    /* Close the file descriptor. */
+    /* Close the file descriptor, unless it belongs to an RPC transport.  The
+     * transport closes it when destroyed, which happens below or (for an RPC
+     * connection with no transport) has already happened. */
     krb5_klog_syslog(LOG_INFO, _("closing down fd %d"), fd);
-    if (fd >= 0 && (!conn || conn->type != CONN_RPC || conn->rpc_force_close))
+    if (fd >= 0 && (!conn || (conn->type != CONN_RPC && conn->transp == NULL)))
         close(fd);
 
     /* Free the connection struct. */
     if (conn) {
         switch (conn->type) {
         case CONN_RPC:
-            if (conn->rpc_force_close) {
-                FD_ZERO(&fds);
-                FD_SET(fd, &fds);
-                svc_getreqset(&fds);
-                if (FD_ISSET(fd, &svc_fdset)) {
-                    krb5_klog_syslog(LOG_ERR,
-                                     _("descriptor %d closed but still "
-                                       "in svc_fdset"),
-                                     fd);
-                }
-            }
-            /* Fall through. */
+            rpc_data_counter--;
+            break;
         case CONN_TCP:
-            tcp_or_rpc_data_counter--;
+            tcp_data_counter--;
             break;
         default:
             break;
@@ -450,14 +447,6 @@ add_fd(struct socksetup *data, int sock, enum conn_type conntype,
 {
     struct connection *newconn;
 
-#ifndef _WIN32
-    if (sock >= FD_SETSIZE) {
-        data->retval = EMFILE;  /* XXX */
-        com_err(data->prog, 0,
-                _("file descriptor number %d too high"), sock);
-        return 0;
-    }
-#endif
     newconn = malloc(sizeof(*newconn));
     if (newconn == NULL) {
         data->retval = ENOMEM;
@@ -580,6 +569,7 @@ add_rpc_listener_fd(struct socksetup *data, struct rpc_svc_data *svc, int sock)
         return NULL;
 
     conn = verto_get_private(ev);
+    conn->prognum = svc->prognum;
     conn->transp = svctcp_create(sock, 0, 0);
     if (conn->transp == NULL) {
         krb5_klog_syslog(LOG_ERR,
@@ -746,6 +736,9 @@ setup_rpc_listener_ports(struct socksetup *data)
         s4 = create_server_socket(data, (struct sockaddr *)&sin4, SOCK_STREAM);
         if (s4 < 0)
             return -1;
+        /* Several worker processes may wait on the listener, so don't let
+         * accept() block if another worker takes the connection. */
+        setnbio(s4);
 
         if (add_rpc_listener_fd(data, &svc, s4) == NULL)
             close(s4);
@@ -759,6 +752,7 @@ setup_rpc_listener_ports(struct socksetup *data)
                                       SOCK_STREAM);
             if (s6 < 0)
                 return -1;
+            setnbio(s6);
 
             if (add_rpc_listener_fd(data, &svc, s6) == NULL)
                 close(s6);
@@ -997,6 +991,25 @@ loop_setup_routing_socket(verto_ctx *ctx, void *handle, const char *progname)
     return 0;
 }
 
+/*
+ * Allow as many RPC connections as the descriptor limit has room for, so
+ * that we shed old connections before accept() starts failing.
+ */
+static void
+set_max_rpc_connections()
+{
+    struct rlimit rl;
+    rlim_t avail, reserved;
+
+    if (getrlimit(RLIMIT_NOFILE, &rl) != 0)
+        return;
+    avail = (rl.rlim_cur == RLIM_INFINITY || rl.rlim_cur > INT_MAX) ?
+        INT_MAX : rl.rlim_cur;
+    reserved = events.n + max_tcp_data_connections + RESERVED_FDS;
+    if (avail > reserved + max_rpc_data_connections)
+        max_rpc_data_connections = avail - reserved;
+}
+
 krb5_error_code
 loop_setup_network(verto_ctx *ctx, void *handle, const char *prog)
 {
@@ -1030,6 +1043,7 @@ loop_setup_network(verto_ctx *ctx, void *handle, const char *prog)
     }
     setup_tcp_listener_ports(&setup_data);
     setup_rpc_listener_ports(&setup_data);
+    set_max_rpc_connections();
     krb5_klog_syslog (LOG_INFO, _("set up %d sockets"), (int) events.n);
     if (events.n == 0) {
         com_err(prog, 0, _("no sockets set up?"));
@@ -1214,12 +1228,13 @@ process_packet(verto_ctx *ctx, verto_ev *ev)
              &state->request, 0, ctx, process_packet_response, state);
 }
 
-static int
-kill_lru_tcp_or_rpc_connection(void *handle, verto_ev *newev)
+/* Drop the oldest connection of type conntype other than newev. */
+static void
+kill_lru_connection(enum conn_type conntype, verto_ev *newev)
 {
-    struct connection *c = NULL, *oldest_c = NULL;
+    struct connection *c, *oldest_c = NULL;
     verto_ev *ev, *oldest_ev = NULL;
-    int i, fd = -1;
+    int i;
 
     krb5_klog_syslog(LOG_INFO, _("too many connections"));
 
@@ -1228,15 +1243,8 @@ kill_lru_tcp_or_rpc_connection(void *handle, verto_ev *newev)
             continue;
 
         c = verto_get_private(ev);
-        if (!c)
-            continue;
-        if (c->type != CONN_TCP && c->type != CONN_RPC)
+        if (!c || c->type != conntype)
             continue;
-#if 0
-        krb5_klog_syslog(LOG_INFO, "fd %d started at %ld",
-                         verto_get_fd(oldest_ev),
-                         c->start_time);
-#endif
         if (oldest_c == NULL
             || oldest_c->start_time > c->start_time) {
             oldest_ev = ev;
@@ -1245,13 +1253,10 @@ kill_lru_tcp_or_rpc_connection(void *handle, verto_ev *newev)
     }
     if (oldest_c != NULL) {
         krb5_klog_syslog(LOG_INFO, _("dropping %s fd %d from %s"),
-                         c->type == CONN_RPC ? "rpc" : "tcp",
+                         oldest_c->type == CONN_RPC ? "rpc" : "tcp",
                          verto_get_fd(oldest_ev), oldest_c->addrbuf);
-        if (oldest_c->type == CONN_RPC)
-            oldest_c->rpc_force_close = 1;
         verto_del(oldest_ev);
     }
-    return fd;
 }
 
 static void
@@ -1317,8 +1322,8 @@ accept_tcp_connection(verto_ctx *ctx, verto_ev *ev)
     newconn->buffer = malloc(newconn->bufsiz);
     newconn->start_time = time(0);
 
-    if (++tcp_or_rpc_data_counter > max_tcp_or_rpc_data_connections)
-        kill_lru_tcp_or_rpc_connection(conn->handle, newev);
+    if (++tcp_data_counter > max_tcp_data_connections)
+        kill_lru_connection(CONN_TCP, newev);
 
     if (newconn->buffer == 0) {
         com_err(conn->prog, errno,
@@ -1370,7 +1375,7 @@ process_tcp_response(void *arg, krb5_error_code code, krb5_data *response)
     }
 
 kill_tcp_connection:
-    tcp_or_rpc_data_counter--;
+    tcp_data_counter--;
     free_connection(state->conn);
     close(state->sock);
     free(state);
@@ -1532,6 +1537,32 @@ process_tcp_connection_write(verto_ctx *ctx, verto_ev *ev)
     verto_del(ev);
 }
 
+/*
+ * Adjust the listeners inherited by a forked worker process.  Point them at
+ * handle (which may have been re-created in the worker), then close the
+ * listeners the worker should not serve: if only_prog is nonzero, close all
+ * listeners except the RPC listeners for only_prog; if skip_prog is nonzero,
+ * close the RPC listeners for skip_prog.
+ */
+void
+loop_setup_worker(void *handle, u_long only_prog, u_long skip_prog)
+{
+    struct connection *conn;
+    verto_ev *ev;
+    int i, is_rpc_listener;
+
+    FOREACH_ELT(events, i, ev) {
+        conn = verto_get_private(ev);
+        conn->handle = handle;
+        is_rpc_listener = (conn->type == CONN_RPC_LISTENER);
+        if ((only_prog != 0 &&
+             (!is_rpc_listener || conn->prognum != only_prog)) ||
+            (skip_prog != 0 && is_rpc_listener &&
+             conn->prognum == skip_prog))
+            verto_del(ev);
+    }
+}
+
 void
 loop_free(verto_ctx *ctx)
 {
@@ -1542,27 +1573,18 @@ loop_free(verto_ctx *ctx)
     FREE_SET_DATA(rpc_svc_data);
 }
 
-static int
-have_event_for_fd(int fd)
-{
-    verto_ev *ev;
-    int i;
-
-    FOREACH_ELT(events, i, ev) {
-        if (verto_get_fd(ev) == fd)
-            return 1;
-    }
-
-    return 0;
-}
-
 static void
 accept_rpc_connection(verto_ctx *ctx, verto_ev *ev)
 {
     struct socksetup sockdata;
-    struct connection *conn;
-    fd_set fds;
-    register int s;
+    struct connection *conn, *newconn;
+    struct sockaddr_storage addr_s;
+    struct sockaddr *addr = (struct sockaddr *)&addr_s;
+    socklen_t addrlen = sizeof(addr_s);
+    SVCXPRT *newtransp;
+    char tmpbuf[10];
+    verto_ev *newev;
+    int s;
 
     conn = verto_get_private(ev);
 
@@ -1571,80 +1593,88 @@ accept_rpc_connection(verto_ctx *ctx, verto_ev *ev)
     sockdata.prog = conn->prog;
     sockdata.retval = 0;
 
-    /* Service the woken RPC listener descriptor. */
-    FD_ZERO(&fds);
-    FD_SET(verto_get_fd(ev), &fds);
-    svc_getreqset(&fds);
-
-    /* Scan svc_fdset for any new connections. */
-    for (s = 0; s < FD_SETSIZE; s++) {
-        struct sockaddr_storage addr_s;
-        struct sockaddr *addr = (struct sockaddr *) &addr_s;
-        socklen_t addrlen = sizeof(addr_s);
-        struct connection *newconn;
-        char tmpbuf[10];
-        verto_ev *newev;
-
-        /* If we already have this fd, continue. */
-        if (!FD_ISSET(s, &svc_fdset) || have_event_for_fd(s))
-            continue;
-
-        newev = add_rpc_data_fd(&sockdata, s);
-        if (newev == NULL)
-            continue;
-        newconn = verto_get_private(newev);
+    /* Accept the connection as a non-blocking transport which we will drive
+     * from the event loop. */
+    newtransp = svctcp_accept(conn->transp);
+    if (newtransp == NULL)
+        return;
+    s = newtransp->xp_sock;
 
-        set_cloexec_fd(s);
-#if 0
-        setnbio(s), setnolinger(s), setkeepalive(s);
-#endif
+    newev = add_rpc_data_fd(&sockdata, s);
+    if (newev == NULL) {
+        svc_destroy(newtransp);
+        return;
+    }
+    newconn = verto_get_private(newev);
+    newconn->transp = newtransp;
 
-        if (getpeername(s, addr, &addrlen) ||
-            getnameinfo(addr, addrlen,
-                        newconn->addrbuf,
-                        sizeof(newconn->addrbuf),
-                        tmpbuf, sizeof(tmpbuf),
-                        NI_NUMERICHOST | NI_NUMERICSERV)) {
-            strlcpy(newconn->addrbuf, "???",
-                    sizeof(newconn->addrbuf));
-        } else {
-            char *p, *end;
-            p = newconn->addrbuf;
-            end = p + sizeof(newconn->addrbuf);
-            p += strlen(p);
-            if ((size_t)(end - p) > 2 + strlen(tmpbuf)) {
-                *p++ = '.';
-                strlcpy(p, tmpbuf, end - p);
-            }
+    if (getpeername(s, addr, &addrlen) ||
+        getnameinfo(addr, addrlen,
+                    newconn->addrbuf,
+                    sizeof(newconn->addrbuf),
+                    tmpbuf, sizeof(tmpbuf),
+                    NI_NUMERICHOST | NI_NUMERICSERV)) {
+        strlcpy(newconn->addrbuf, "???",
+                sizeof(newconn->addrbuf));
+    } else {
+        char *p, *end;
+        p = newconn->addrbuf;
+        end = p + sizeof(newconn->addrbuf);
+        p += strlen(p);
+        if ((size_t)(end - p) > 2 + strlen(tmpbuf)) {
+            *p++ = '.';
+            strlcpy(p, tmpbuf, end - p);
         }
+    }
 #if 0
-        krb5_klog_syslog(LOG_INFO, _("accepted RPC connection on socket %d "
-                                     "from %s"), s, newconn->addrbuf);
+    krb5_klog_syslog(LOG_INFO, _("accepted RPC connection on socket %d "
+                                 "from %s"), s, newconn->addrbuf);
 #endif
 
-        newconn->addr_s = addr_s;
-        newconn->addrlen = addrlen;
-        newconn->start_time = time(0);
+    newconn->addr_s = addr_s;
+    newconn->addrlen = addrlen;
+    newconn->start_time = time(0);
 
-        if (++tcp_or_rpc_data_counter > max_tcp_or_rpc_data_connections)
-            kill_lru_tcp_or_rpc_connection(newconn->handle, newev);
+    if (++rpc_data_counter > max_rpc_data_connections)
+        kill_lru_connection(CONN_RPC, newev);
 
-        newconn->faddr.address = &newconn->kaddr;
-        init_addr(&newconn->faddr, ss2sa(&newconn->addr_s));
-    }
+    newconn->faddr.address = &newconn->kaddr;
+    init_addr(&newconn->faddr, ss2sa(&newconn->addr_s));
 }
 
 static void
 process_rpc_connection(verto_ctx *ctx, verto_ev *ev)
 {
-    fd_set fds;
-
-    FD_ZERO(&fds);
-    FD_SET(verto_get_fd(ev), &fds);
-    svc_getreqset(&fds);
+    struct connection *conn = verto_get_private(ev);
+    verto_ev_flag flags, newflags;
+
+    /* While replies are queued we wait for the socket to become writable,
+     * and read no more requests.  Once the queue drains, handle any requests
+     * which arrived in the meantime. */
+    flags = verto_get_flags(ev);
+    if (flags & VERTO_EV_FLAG_IO_WRITE) {
+        if (!svctcp_flush(conn->transp)) {
+            verto_del(ev);
+            return;
+        }
+    }
+    if (!svctcp_output_pending(conn->transp)) {
+        /* If the transport died, it has been destroyed along with its
+         * socket. */
+        if (!svc_getreq_xprt(conn->transp)) {
+            conn->transp = NULL;
+            verto_del(ev);
+            return;
+        }
+    }
 
-    if (!FD_ISSET(verto_get_fd(ev), &svc_fdset))
-        verto_del(ev);
+    newflags = flags & ~(VERTO_EV_FLAG_IO_READ | VERTO_EV_FLAG_IO_WRITE);
+    if (svctcp_output_pending(conn->transp))
+        newflags |= VERTO_EV_FLAG_IO_WRITE;
+    else
+        newflags |= VERTO_EV_FLAG_IO_READ;
+    if (newflags != flags)
+        verto_set_flags(ev, newflags);
 }
 
 #endif /* INET */
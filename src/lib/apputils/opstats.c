@@ -0,0 +1,319 @@
+/* -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* lib/apputils/opstats.c - Per-operation latency statistics for servers */
+/*
+ * Copyright (C) 2016 by the Massachusetts Institute of Technology.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Servers record the elapsed time of each operation they perform, optionally
+ * broken down into named phases, and the accumulated counters and latency
+ * histograms are periodically written to a text file.  The file has a comment
+ * header followed by one line per operation performed so far:
+ *
+ *   <op> count=<n> errors=<n> sum_us=<n> max_us=<n> hist=<n>,<n>,...
+ *
+ * and one line per phase of that operation:
+ *
+ *   <op>.<phase> sum_us=<n> max_us=<n> hist=<n>,<n>,...
+ *
+ * Histogram bucket i counts the operations which took less than 2^(i+1)
+ * microseconds (and at least 2^i, for i > 0); the last bucket is unbounded.
+ * Operations taking longer than the slow threshold are also logged.
+ */
+
+#include "k5-int.h"
+#include "adm_proto.h"
+#include "net-server.h"
+#include <syslog.h>
+
+/* Number of histogram buckets; the last one counts everything over about two
+ * minutes. */
+#define NBUCKETS 28
+
+/* How often to write the statistics file, in milliseconds. */
+#define WRITE_INTERVAL 10000
+
+struct timing {
+    uint64_t sum;
+    uint64_t max;
+    uint64_t hist[NBUCKETS];
+};
+
+struct opcounters {
+    uint64_t count;
+    uint64_t errors;
+    struct timing total;
+    struct timing *phases;
+};
+
+struct opstats {
+    char *progname;
+    char *filename;
+    uint64_t slow_usec;
+    const char *const *op_names;
+    const char *const *phase_names;
+    size_t nops;
+    size_t nphases;
+    struct opcounters *ops;
+    krb5_boolean dirty;
+};
+
+static size_t
+count_names(const char *const *names)
+{
+    size_t n = 0;
+
+    while (names != NULL && names[n] != NULL)
+        n++;
+    return n;
+}
+
+static void
+add_timing(struct timing *t, uint64_t usec)
+{
+    int b = 0;
+
+    t->sum += usec;
+    if (usec > t->max)
+        t->max = usec;
+    while (usec > 1 && b < NBUCKETS - 1) {
+        usec >>= 1;
+        b++;
+    }
+    t->hist[b]++;
+}
+
+static void
+write_timing(FILE *fp, const struct timing *t)
+{
+    int b;
+
+    fprintf(fp, " sum_us=%llu max_us=%llu hist=", (unsigned long long)t->sum,
+            (unsigned long long)t->max);
+    for (b = 0; b < NBUCKETS; b++) {
+        fprintf(fp, "%s%llu", (b > 0) ? "," : "",
+                (unsigned long long)t->hist[b]);
+    }
+    fputc('\n', fp);
+}
+
+/*
+ * Create a statistics object for operations named by the null-terminated list
+ * op_names, each of which may be divided into the phases named by
+ * phase_names (which may be NULL).  The name lists must remain valid for the
+ * lifetime of the object.  Statistics are written to filename, with a suffix
+ * of ".<worker>" if worker is not negative.  If slow_threshold_ms is
+ * positive, operations taking at least that many milliseconds are logged.
+ */
+krb5_error_code
+opstats_create(const char *progname, const char *filename, int worker,
+               long slow_threshold_ms, const char *const *op_names,
+               const char *const *phase_names, struct opstats **st_out)
+{
+    struct opstats *st;
+    size_t i;
+    int ret;
+
+    *st_out = NULL;
+    st = calloc(1, sizeof(*st));
+    if (st == NULL)
+        return ENOMEM;
+    st->op_names = op_names;
+    st->phase_names = phase_names;
+    st->nops = count_names(op_names);
+    st->nphases = count_names(phase_names);
+    st->slow_usec = (slow_threshold_ms > 0) ?
+        (uint64_t)slow_threshold_ms * 1000 : 0;
+    st->progname = strdup(progname);
+    if (worker >= 0)
+        ret = asprintf(&st->filename, "%s.%d", filename, worker);
+    else
+        ret = asprintf(&st->filename, "%s", filename);
+    if (ret < 0)
+        st->filename = NULL;
+    st->ops = calloc(st->nops, sizeof(*st->ops));
+    if (st->progname == NULL || st->filename == NULL || st->ops == NULL)
+        goto oom;
+    for (i = 0; i < st->nops && st->nphases > 0; i++) {
+        st->ops[i].phases = calloc(st->nphases, sizeof(struct timing));
+        if (st->ops[i].phases == NULL)
+            goto oom;
+    }
+    *st_out = st;
+    return 0;
+
+oom:
+    opstats_free(st);
+    return ENOMEM;
+}
+
+void
+opstats_free(struct opstats *st)
+{
+    size_t i;
+
+    if (st == NULL)
+        return;
+    for (i = 0; st->ops != NULL && i < st->nops; i++)
+        free(st->ops[i].phases);
+    free(st->ops);
+    free(st->filename);
+    free(st->progname);
+    free(st);
+}
+
+/*
+ * Record an operation of index op taking total_usec microseconds.  If the
+ * object has phases, phase_usec contains the time spent in each.  detail, if
+ * not NULL, identifies the request in the slow-operation log.
+ */
+void
+opstats_record(struct opstats *st, int op, krb5_boolean failed,
+               uint64_t total_usec, const uint64_t *phase_usec,
+               const char *detail)
+{
+    struct opcounters *c;
+    struct k5buf buf;
+    size_t i;
+
+    if (st == NULL || op < 0 || (size_t)op >= st->nops)
+        return;
+    c = &st->ops[op];
+    c->count++;
+    if (failed)
+        c->errors++;
+    add_timing(&c->total, total_usec);
+    for (i = 0; i < st->nphases; i++)
+        add_timing(&c->phases[i], phase_usec[i]);
+    st->dirty = TRUE;
+
+    if (st->slow_usec == 0 || total_usec < st->slow_usec)
+        return;
+    k5_buf_init_dynamic(&buf);
+    k5_buf_add_fmt(&buf, "slow operation %s%s%s: %llu us", st->op_names[op],
+                   (detail != NULL) ? " from " : "",
+                   (detail != NULL) ? detail : "",
+                   (unsigned long long)total_usec);
+    for (i = 0; i < st->nphases; i++) {
+        k5_buf_add_fmt(&buf, "%s %s %llu us", (i == 0) ? ";" : ",",
+                       st->phase_names[i], (unsigned long long)phase_usec[i]);
+    }
+    if (k5_buf_status(&buf) == 0)
+        krb5_klog_syslog(LOG_WARNING, "%s", (char *)buf.data);
+    k5_buf_free(&buf);
+}
+
+/* Write the accumulated statistics, replacing the file atomically. */
+krb5_error_code
+opstats_write(struct opstats *st)
+{
+    struct opcounters *c;
+    char *tmpname;
+    FILE *fp;
+    size_t i, j;
+    int b;
+    krb5_error_code ret;
+
+    if (st == NULL)
+        return 0;
+    if (asprintf(&tmpname, "%s.tmp", st->filename) < 0)
+        return ENOMEM;
+    fp = fopen(tmpname, "w");
+    if (fp == NULL) {
+        ret = errno;
+        goto cleanup;
+    }
+
+    fprintf(fp, "# %s operation statistics, pid %ld, written at %ld\n",
+            st->progname, (long)getpid(), (long)time(NULL));
+    fprintf(fp, "# hist bucket upper bounds in us:");
+    for (b = 0; b < NBUCKETS - 1; b++)
+        fprintf(fp, " %lu", 2UL << b);
+    fprintf(fp, " inf\n");
+    for (i = 0; i < st->nops; i++) {
+        c = &st->ops[i];
+        if (c->count == 0)
+            continue;
+        fprintf(fp, "%s count=%llu errors=%llu", st->op_names[i],
+                (unsigned long long)c->count, (unsigned long long)c->errors);
+        write_timing(fp, &c->total);
+        for (j = 0; j < st->nphases; j++) {
+            fprintf(fp, "%s.%s", st->op_names[i], st->phase_names[j]);
+            write_timing(fp, &c->phases[j]);
+        }
+    }
+
+    if (ferror(fp)) {
+        ret = EIO;
+        (void)fclose(fp);
+        (void)unlink(tmpname);
+        goto cleanup;
+    }
+    if (fclose(fp) != 0 || rename(tmpname, st->filename) != 0) {
+        ret = errno;
+        (void)unlink(tmpname);
+        goto cleanup;
+    }
+    st->dirty = FALSE;
+    ret = 0;
+
+cleanup:
+    free(tmpname);
+    return ret;
+}
+
+static void
+write_timer(verto_ctx *ctx, verto_ev *ev)
+{
+    struct opstats *st = verto_get_private(ev);
+    krb5_error_code ret;
+
+    if (!st->dirty)
+        return;
+    ret = opstats_write(st);
+    if (ret) {
+        krb5_klog_syslog(LOG_ERR, _("%s while writing statistics to %s"),
+                         error_message(ret), st->filename);
+    }
+}
+
+/* Arrange for the statistics file to be written periodically while ctx runs,
+ * if any operations have been recorded since it was last written. */
+krb5_error_code
+opstats_setup_timer(verto_ctx *ctx, struct opstats *st)
+{
+    verto_ev *ev;
+
+    ev = verto_add_timeout(ctx, VERTO_EV_FLAG_PERSIST, write_timer,
+                           WRITE_INTERVAL);
+    if (ev == NULL)
+        return ENOMEM;
+    verto_set_private(ev, st, NULL);
+    return 0;
+}
@@ -24,242 +24,146 @@
  * or implied warranty.
  */
 
-#include <ctype.h>
 #include "crypto_int.h"
+#include "sha1/shs.h"
 
 /*
- * RFC 2898 specifies PBKDF2 in terms of an underlying pseudo-random
- * function with two arguments (password and salt||blockindex).  Right
- * now we only use PBKDF2 with the hmac-sha1 PRF, also specified in
- * RFC 2898, which invokes HMAC with the password as the key and the
- * second argument as the text.  (HMAC accepts any key size up to the
- * block size; the password is pre-hashed with unkeyed SHA1 if it is
- * longer than the block size.)
- *
- * For efficiency, it is better to generate the key from the password
- * once at the beginning, so we specify prf_fn in terms of a
- * krb5_key first argument.  That might not be convenient for a PRF
- * which uses the password in some other way, so this might need to be
- * adjusted in the future.
+ * PBKDF2 with HMAC-SHA-1, as described in RFC 2898.  HMAC computes two SHA-1
+ * compression operations per call over the padded key, which is the same for
+ * every call in a derivation, so we absorb the inner and outer pads once and
+ * copy the resulting hash states for each iteration.  This halves the number
+ * of compression operations.  The output blocks of a derivation are
+ * independent of each other, so they are computed together in a single pass
+ * over the iteration count.
  */
 
-typedef krb5_error_code (*prf_fn)(krb5_key pass, krb5_data *salt,
-                                  krb5_data *out);
-
-/* Not exported, for now.  */
-static krb5_error_code
-krb5int_pbkdf2 (prf_fn prf, size_t hlen, krb5_key pass,
-                const krb5_data *salt, unsigned long count,
-                const krb5_data *output);
-
-static int debug_hmac = 0;
-
-static void printd (const char *descr, krb5_data *d) {
-    unsigned int i, j;
-    const int r = 16;
-
-    printf("%s:", descr);
+/* The number of output blocks computed together in one pass. */
+#define PBKDF2_LANES 4
 
-    for (i = 0; i < d->length; i += r) {
-        printf("\n  %04x: ", i);
-        for (j = i; j < i + r && j < d->length; j++)
-            printf(" %02x", 0xff & d->data[j]);
-        for (; j < i + r; j++)
-            printf("   ");
-        printf("   ");
-        for (j = i; j < i + r && j < d->length; j++) {
-            int c = 0xff & d->data[j];
-            printf("%c", isprint(c) ? c : '.');
-        }
-    }
-    printf("\n");
-}
+/* SHA-1 states after absorbing the inner and outer padded HMAC keys. */
+struct hmac_sha1_state {
+    SHS_INFO inner;
+    SHS_INFO outer;
+};
 
-static krb5_error_code
-F(char *output, char *u_tmp1, char *u_tmp2, prf_fn prf, size_t hlen,
-  krb5_key pass, const krb5_data *salt, unsigned long count, int i)
+static void
+sha1_output(SHS_INFO *ctx, unsigned char *out)
 {
-    unsigned char ibytes[4];
-    size_t tlen;
-    unsigned int j, k;
-    krb5_data sdata;
-    krb5_data out;
-    krb5_error_code err;
-
-#if 0
-    printf("F(i=%d, count=%lu, pass=%d:%s)\n", i, count,
-           pass->length, pass->data);
-#endif
-
-    /* Compute U_1.  */
-    store_32_be(i, ibytes);
+    int i;
 
-    tlen = salt->length;
-    memcpy(u_tmp2, salt->data, tlen);
-    memcpy(u_tmp2 + tlen, ibytes, 4);
-    tlen += 4;
-    sdata.data = u_tmp2;
-    sdata.length = tlen;
-
-#if 0
-    printd("initial salt", &sdata);
-#endif
-
-    out.data = u_tmp1;
-    out.length = hlen;
-
-#if 0
-    printf("F: computing hmac #1 (U_1) with %s\n", pdata.contents);
-#endif
-    err = (*prf)(pass, &sdata, &out);
-    if (err)
-        return err;
-#if 0
-    printd("F: prf return value", &out);
-#endif
-    memcpy(output, u_tmp1, hlen);
-
-    /* Compute U_2, .. U_c.  */
-    sdata.length = hlen;
-    for (j = 2; j <= count; j++) {
-#if 0
-        printf("F: computing hmac #%d (U_%d)\n", j, j);
-#endif
-        memcpy(u_tmp2, u_tmp1, hlen);
-        err = (*prf)(pass, &sdata, &out);
-        if (err)
-            return err;
-#if 0
-        printd("F: prf return value", &out);
-#endif
-        /* And xor them together.  */
-        for (k = 0; k < hlen; k++)
-            output[k] ^= u_tmp1[k];
-#if 0
-        printf("F: xor result:\n");
-        for (k = 0; k < hlen; k++)
-            printf(" %02x", 0xff & output[k]);
-        printf("\n");
-#endif
-    }
-    return 0;
+    shsFinal(ctx);
+    for (i = 0; i < 5; i++)
+        store_32_be(ctx->digest[i], out + i * 4);
 }
 
-static krb5_error_code
-krb5int_pbkdf2 (prf_fn prf, size_t hlen, krb5_key pass,
-                const krb5_data *salt, unsigned long count,
-                const krb5_data *output)
+static void
+hmac_sha1_init(struct hmac_sha1_state *st, const krb5_data *pass)
 {
-    int l, i;
-    char *utmp1, *utmp2;
-    char utmp3[20];             /* XXX length shouldn't be hardcoded! */
-
-    if (output->length == 0 || hlen == 0)
-        abort();
-    /* Step 1 & 2.  */
-    if (output->length / hlen > 0xffffffff)
-        abort();
-    /* Step 2.  */
-    l = (output->length + hlen - 1) / hlen;
-
-    utmp1 = /*output + dklen; */ malloc(hlen);
-    if (utmp1 == NULL)
-        return ENOMEM;
-    utmp2 = /*utmp1 + hlen; */ malloc(salt->length + 4 + hlen);
-    if (utmp2 == NULL) {
-        free(utmp1);
-        return ENOMEM;
+    SHS_INFO ctx;
+    unsigned char keyhash[SHS_DIGESTSIZE], pad[SHS_DATASIZE];
+    const unsigned char *key = (unsigned char *)pass->data;
+    unsigned int i, keylen = pass->length;
+
+    /* Keys longer than the block size are replaced by their hash. */
+    if (keylen > SHS_DATASIZE) {
+        shsInit(&ctx);
+        shsUpdate(&ctx, key, keylen);
+        sha1_output(&ctx, keyhash);
+        key = keyhash;
+        keylen = SHS_DIGESTSIZE;
     }
 
-    /* Step 3.  */
-    for (i = 1; i <= l; i++) {
-#if 0
-        int j;
-#endif
-        krb5_error_code err;
-        char *out;
-
-        if (i == l)
-            out = utmp3;
-        else
-            out = output->data + (i-1) * hlen;
-        err = F(out, utmp1, utmp2, prf, hlen, pass, salt, count, i);
-        if (err) {
-            free(utmp1);
-            free(utmp2);
-            return err;
-        }
-        if (i == l)
-            memcpy(output->data + (i-1) * hlen, utmp3,
-                   output->length - (i-1) * hlen);
-
-#if 0
-        printf("after F(%d), @%p:\n", i, output->data);
-        for (j = (i-1) * hlen; j < i * hlen; j++)
-            printf(" %02x", 0xff & output->data[j]);
-        printf ("\n");
-#endif
-    }
-    free(utmp1);
-    free(utmp2);
-    return 0;
+    memset(pad, 0x36, sizeof(pad));
+    for (i = 0; i < keylen; i++)
+        pad[i] ^= key[i];
+    shsInit(&st->inner);
+    shsUpdate(&st->inner, pad, sizeof(pad));
+
+    memset(pad, 0x5c, sizeof(pad));
+    for (i = 0; i < keylen; i++)
+        pad[i] ^= key[i];
+    shsInit(&st->outer);
+    shsUpdate(&st->outer, pad, sizeof(pad));
+
+    zap(&ctx, sizeof(ctx));
+    zap(keyhash, sizeof(keyhash));
+    zap(pad, sizeof(pad));
 }
 
-/*
- * Implements the hmac-sha1 PRF.  pass has been pre-hashed (if
- * necessary) and converted to a key already; salt has had the block
- * index appended to the original salt.
- */
-static krb5_error_code
-hmac_sha1(krb5_key pass, krb5_data *salt, krb5_data *out)
+/* Compute HMAC-SHA-1 of in using the key state st, placing the result in
+ * out.  in and out may overlap. */
+static void
+hmac_sha1(const struct hmac_sha1_state *st, const unsigned char *in,
+          unsigned int len, unsigned char *out)
 {
-    const struct krb5_hash_provider *h = &krb5int_hash_sha1;
-    krb5_error_code err;
-    krb5_crypto_iov iov;
-
-    if (debug_hmac)
-        printd(" hmac input", salt);
-    iov.flags = KRB5_CRYPTO_TYPE_DATA;
-    iov.data = *salt;
-    err = krb5int_hmac(h, pass, &iov, 1, out);
-    if (err == 0 && debug_hmac)
-        printd(" hmac output", out);
-    return err;
+    SHS_INFO ctx;
+
+    ctx = st->inner;
+    shsUpdate(&ctx, in, len);
+    sha1_output(&ctx, out);
+    ctx = st->outer;
+    shsUpdate(&ctx, out, SHS_DIGESTSIZE);
+    sha1_output(&ctx, out);
+    zap(&ctx, sizeof(ctx));
 }
 
 krb5_error_code
 krb5int_pbkdf2_hmac_sha1(const krb5_data *out, unsigned long count,
                          const krb5_data *pass, const krb5_data *salt)
 {
-    const struct krb5_hash_provider *h = &krb5int_hash_sha1;
-    krb5_keyblock keyblock;
-    krb5_key key;
-    char tmp[40];
-    krb5_data d;
-    krb5_crypto_iov iov;
-    krb5_error_code err;
+    struct hmac_sha1_state st;
+    unsigned char u[PBKDF2_LANES][SHS_DIGESTSIZE];
+    unsigned char t[PBKDF2_LANES][SHS_DIGESTSIZE];
+    unsigned char *sbuf;
+    unsigned long j;
+    unsigned int nblocks, first, lanes, lane, k, len;
+
+    if (out->length == 0 || count == 0)
+        return KRB5_CRYPTO_INTERNAL;
+    nblocks = (out->length + SHS_DIGESTSIZE - 1) / SHS_DIGESTSIZE;
+
+    /* Allocate space for salt || INT(i). */
+    sbuf = malloc(salt->length + 4);
+    if (sbuf == NULL)
+        return ENOMEM;
+    if (salt->length > 0)
+        memcpy(sbuf, salt->data, salt->length);
 
-    assert(h->hashsize <= sizeof(tmp));
-    if (pass->length > h->blocksize) {
-        d = make_data(tmp, h->hashsize);
-        iov.flags = KRB5_CRYPTO_TYPE_DATA;
-        iov.data = *pass;
-        err = h->hash(&iov, 1, &d);
-        if (err)
-            return err;
-        keyblock.length = d.length;
-        keyblock.contents = (krb5_octet *) d.data;
-    } else {
-        keyblock.length = pass->length;
-        keyblock.contents = (krb5_octet *) pass->data;
-    }
-    keyblock.enctype = ENCTYPE_NULL;
+    hmac_sha1_init(&st, pass);
+
+    for (first = 0; first < nblocks; first += lanes) {
+        lanes = nblocks - first;
+        if (lanes > PBKDF2_LANES)
+            lanes = PBKDF2_LANES;
 
-    err = krb5_k_create_key(NULL, &keyblock, &key);
-    if (err)
-        return err;
+        /* U_1 = PRF(P, S || INT(i)) */
+        for (lane = 0; lane < lanes; lane++) {
+            store_32_be(first + lane + 1, sbuf + salt->length);
+            hmac_sha1(&st, sbuf, salt->length + 4, u[lane]);
+            memcpy(t[lane], u[lane], SHS_DIGESTSIZE);
+        }
+
+        /* U_j = PRF(P, U_{j-1}); T_i = U_1 ^ U_2 ^ ... ^ U_c */
+        for (j = 2; j <= count; j++) {
+            for (lane = 0; lane < lanes; lane++) {
+                hmac_sha1(&st, u[lane], SHS_DIGESTSIZE, u[lane]);
+                for (k = 0; k < SHS_DIGESTSIZE; k++)
+                    t[lane][k] ^= u[lane][k];
+            }
+        }
 
-    err = krb5int_pbkdf2(hmac_sha1, 20, key, salt, count, out);
-    krb5_k_free_key(NULL, key);
-    return err;
+        for (lane = 0; lane < lanes; lane++) {
+            k = (first + lane) * SHS_DIGESTSIZE;
+            len = out->length - k;
+            if (len > SHS_DIGESTSIZE)
+                len = SHS_DIGESTSIZE;
+            memcpy(out->data + k, t[lane], len);
+        }
+    }
+
+    zap(&st, sizeof(st));
+    zap(u, sizeof(u));
+    zap(t, sizeof(t));
+    free(sbuf);
+    return 0;
 }
@@ -351,9 +351,7 @@ krb5_error_code krb5int_cmac_checksum(const struct krb5_enc_provider *enc,
                                       size_t num_data,
                                       krb5_data *output);
 
-/* Compute a CRC-32 checksum.  c is in-out to allow chaining; init to 0. */
 #define CRC32_CKSUM_LENGTH 4
-void mit_crc32(krb5_pointer in, size_t in_length, unsigned long *c);
 
 /* Translate an RFC 3961 key usage to a Microsoft RC4 usage. */
 krb5_keyusage krb5int_arcfour_translate_usage(krb5_keyusage usage);
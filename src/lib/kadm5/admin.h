@@ -456,6 +456,19 @@ kadm5_ret_t    kadm5_get_policies(void *server_handle,
                                   char *exp, char ***pols,
                                   int *count);
 
+/*
+ * Get up to max principal names matching exp, continuing after the page which
+ * returned cursor (or from the beginning if cursor is NULL).  Set *cursor_out
+ * to a continuation cursor for the next page, or to NULL if there are no more
+ * matching principals.  The list is freed with kadm5_free_name_list() and the
+ * cursor with free().  A page may hold fewer than max names even when more
+ * follow.
+ */
+kadm5_ret_t    kadm5_get_principals_page(void *server_handle, char *exp,
+                                         char *cursor, int max,
+                                         char ***princs, int *count,
+                                         char **cursor_out);
+
 kadm5_ret_t    kadm5_free_key_data(void *server_handle,
                                    krb5_int16 *n_key_data,
                                    krb5_key_data *key_data);
@@ -494,6 +507,114 @@ kadm5_ret_t    kadm5_free_strings(void *server_handle,
 kadm5_ret_t    kadm5_free_kadm5_key_data(krb5_context context, int n_key_data,
                                          kadm5_key_data *key_data);
 
+/*
+ * Batch operations.  Each applies the corresponding single-principal
+ * operation to every element of a vector, placing each element's result code
+ * in the corresponding element of results.  The return value is nonzero only
+ * if the batch as a whole could not be processed, in which case the contents
+ * of results are unspecified.  The server performs a batch in a single
+ * database transaction if the database module supports transactions.
+ */
+kadm5_ret_t    kadm5_create_principals(void *server_handle,
+                                       kadm5_principal_ent_t ents,
+                                       int n_ents, long mask,
+                                       int n_ks_tuple,
+                                       krb5_key_salt_tuple *ks_tuple,
+                                       char *pass, kadm5_ret_t *results);
+
+/*
+ * For kadm5_modify_principals(), the attributes field of ents is ignored.  If
+ * mask includes KADM5_ATTRIBUTES, the bits in set_attrs are set and the bits
+ * in clear_attrs are cleared in each principal's current attributes.
+ */
+kadm5_ret_t    kadm5_modify_principals(void *server_handle,
+                                       kadm5_principal_ent_t ents,
+                                       int n_ents, long mask,
+                                       krb5_flags set_attrs,
+                                       krb5_flags clear_attrs,
+                                       kadm5_ret_t *results);
+
+kadm5_ret_t    kadm5_randkey_principals(void *server_handle,
+                                        krb5_principal *princs, int n_princs,
+                                        krb5_boolean keepold,
+                                        int n_ks_tuple,
+                                        krb5_key_salt_tuple *ks_tuple,
+                                        kadm5_ret_t *results);
+
+kadm5_ret_t    kadm5_setkey_principals(void *server_handle,
+                                       krb5_principal *princs, int n_princs,
+                                       krb5_boolean keepold,
+                                       kadm5_key_data **key_data,
+                                       int *n_key_data,
+                                       kadm5_ret_t *results);
+
+kadm5_ret_t    kadm5_delete_principals(void *server_handle,
+                                       krb5_principal *princs, int n_princs,
+                                       kadm5_ret_t *results);
+
+/*
+ * Asynchronous principal operations (client library only).  Each function
+ * sends its request without waiting for the reply, so that many requests can
+ * be outstanding on one handle, and returns nonzero only if the request could
+ * not be sent.  The arguments need not remain valid after it returns.  When
+ * the reply arrives, cb is called with data and the result code of the
+ * operation; for kadm5_get_principal_async(), ent points to the principal
+ * entry on success, which is valid only until the callback returns.
+ *
+ * Replies are read by kadm5_process_async(), which completes every request
+ * whose reply has arrived without blocking and sets *pending_out (if not
+ * NULL) to the number still outstanding, and by kadm5_flush_async(), which
+ * waits for all of them.  kadm5_async_fd() returns a descriptor which becomes
+ * readable when kadm5_process_async() has work to do.  Synchronous calls on
+ * the handle, including kadm5_destroy(), complete outstanding requests first.
+ * A callback may make further calls on the handle, but must not destroy it.
+ *
+ * Requests are pipelined only over RPCSEC_GSS; with the older AUTH_GSSAPI
+ * flavor, each request is made synchronously and its callback is called
+ * before the function returns.
+ */
+typedef void (*kadm5_async_callback)(void *data, kadm5_ret_t code,
+                                     kadm5_principal_ent_t ent);
+
+kadm5_ret_t    kadm5_create_principal_async(void *server_handle,
+                                            kadm5_principal_ent_t ent,
+                                            long mask, int n_ks_tuple,
+                                            krb5_key_salt_tuple *ks_tuple,
+                                            char *pass,
+                                            kadm5_async_callback cb,
+                                            void *data);
+
+kadm5_ret_t    kadm5_modify_principal_async(void *server_handle,
+                                            kadm5_principal_ent_t ent,
+                                            long mask,
+                                            kadm5_async_callback cb,
+                                            void *data);
+
+kadm5_ret_t    kadm5_delete_principal_async(void *server_handle,
+                                            krb5_principal principal,
+                                            kadm5_async_callback cb,
+                                            void *data);
+
+kadm5_ret_t    kadm5_chpass_principal_async(void *server_handle,
+                                            krb5_principal principal,
+                                            krb5_boolean keepold,
+                                            int n_ks_tuple,
+                                            krb5_key_salt_tuple *ks_tuple,
+                                            char *pass,
+                                            kadm5_async_callback cb,
+                                            void *data);
+
+kadm5_ret_t    kadm5_get_principal_async(void *server_handle,
+                                         krb5_principal principal, long mask,
+                                         kadm5_async_callback cb,
+                                         void *data);
+
+kadm5_ret_t    kadm5_async_fd(void *server_handle, int *fd_out);
+
+kadm5_ret_t    kadm5_process_async(void *server_handle, int *pending_out);
+
+kadm5_ret_t    kadm5_flush_async(void *server_handle);
+
 KADM5INT_END_DECLS
 
 #endif /* __KADM5_ADMIN_H__ */
@@ -48,6 +48,8 @@ bool_t	    xdr_gprinc_arg(XDR *xdrs, gprinc_arg *objp);
 bool_t      xdr_gprinc_ret(XDR *xdrs, gprinc_ret *objp);
 bool_t	    xdr_gprincs_arg(XDR *xdrs, gprincs_arg *objp);
 bool_t      xdr_gprincs_ret(XDR *xdrs, gprincs_ret *objp);
+bool_t	    xdr_gprincs_page_arg(XDR *xdrs, gprincs_page_arg *objp);
+bool_t	    xdr_gprincs_page_ret(XDR *xdrs, gprincs_page_ret *objp);
 bool_t	    xdr_cpol_arg(XDR *xdrs, cpol_arg *objp);
 bool_t	    xdr_dpol_arg(XDR *xdrs, dpol_arg *objp);
 bool_t	    xdr_mpol_arg(XDR *xdrs, mpol_arg *objp);
@@ -72,3 +74,9 @@ bool_t      xdr_osa_pw_hist_ent(XDR *xdrs, osa_pw_hist_ent *objp);
 bool_t      xdr_kadm5_key_data(XDR *xdrs, kadm5_key_data *objp);
 bool_t      xdr_getpkeys_arg(XDR *xdrs, getpkeys_arg *objp);
 bool_t      xdr_getpkeys_ret(XDR *xdrs, getpkeys_ret *objp);
+bool_t      xdr_cprincs_arg(XDR *xdrs, cprincs_arg *objp);
+bool_t      xdr_mprincs_arg(XDR *xdrs, mprincs_arg *objp);
+bool_t      xdr_chrands_arg(XDR *xdrs, chrands_arg *objp);
+bool_t      xdr_setkeys_arg(XDR *xdrs, setkeys_arg *objp);
+bool_t      xdr_dprincs_arg(XDR *xdrs, dprincs_arg *objp);
+bool_t      xdr_batch_ret(XDR *xdrs, batch_ret *objp);
@@ -0,0 +1,445 @@
+/* -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* lib/kadm5/clnt/client_async.c - asynchronous kadm5 client calls */
+/*
+ * Copyright (C) 2016 by the Massachusetts Institute of Technology.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * This file implements the asynchronous principal operations.  Each call is
+ * sent as soon as it is made, without waiting for the replies to earlier
+ * calls, and the replies are matched to their calls by transaction id as they
+ * are read.  Completions are reported through a callback, from
+ * kadm5_process_async() when the handle's socket is readable, or from
+ * kadm5_flush_async().
+ *
+ * RPCSEC_GSS verifies and unwraps each reply using the sequence number of
+ * its call, which the auth handle keeps as the number of the last call sent.
+ * We record the sequence number of each outstanding call and install it while
+ * its reply is processed.  The older AUTH_GSSAPI flavor cannot do this, so
+ * over an AUTH_GSSAPI connection each call is made synchronously and its
+ * callback invoked before the submitting function returns.
+ */
+
+#include <gssrpc/rpc.h>
+#include <gssrpc/auth_gss.h>
+#include <kadm5/admin.h>
+#include <kadm5/kadm_rpc.h>
+#include <string.h>
+#include <errno.h>
+#include "client_internal.h"
+
+/* Limit the calls in flight, so that neither side blocks writing to a peer
+ * which is itself blocked writing. */
+#define MAX_OUTSTANDING 64
+
+static struct timeval TIMEOUT = { 25, 0 };
+
+struct async_req {
+    struct async_req *next;
+    uint32_t xid;
+    uint32_t seq;
+    krb5_boolean get;           /* reply is a gprinc_ret */
+    kadm5_async_callback cb;
+    void *data;
+};
+
+struct kadm5_async_state {
+    struct async_req *head;
+    struct async_req *tail;
+    int count;
+    krb5_boolean checked;       /* has pipelined been determined? */
+    krb5_boolean pipelined;
+};
+
+kadm5_ret_t
+kadm5int_async_init(kadm5_server_handle_t handle)
+{
+    handle->async = calloc(1, sizeof(*handle->async));
+    if (handle->async == NULL)
+        return ENOMEM;
+    handle->lhandle->async = handle->async;
+    return 0;
+}
+
+void
+kadm5int_async_free(kadm5_server_handle_t handle)
+{
+    free(handle->async);
+    handle->async = NULL;
+}
+
+/* Remove and return the outstanding call with the given xid, if any. */
+static struct async_req *
+take_req(struct kadm5_async_state *state, uint32_t xid)
+{
+    struct async_req **rp, *req, *prev = NULL;
+
+    for (rp = &state->head; *rp != NULL; prev = *rp, rp = &(*rp)->next) {
+        req = *rp;
+        if (req->xid != xid)
+            continue;
+        *rp = req->next;
+        if (state->tail == req)
+            state->tail = prev;
+        state->count--;
+        return req;
+    }
+    return NULL;
+}
+
+/* Invoke the callback for a call with the decoded result in res. */
+static void
+complete(kadm5_async_callback cb, void *data, krb5_boolean get,
+         enum clnt_stat st, void *res)
+{
+    generic_ret *gr = res;
+    gprinc_ret *pr = res;
+
+    if (st != RPC_SUCCESS)
+        cb(data, KADM5_RPC_ERROR, NULL);
+    else if (get)
+        cb(data, pr->code, (pr->code == 0) ? &pr->rec : NULL);
+    else
+        cb(data, gr->code, NULL);
+    if (get)
+        xdr_free((xdrproc_t)xdr_gprinc_ret, (char *)pr);
+}
+
+/* Report a transport failure to every outstanding call. */
+static void
+fail_all(struct kadm5_async_state *state)
+{
+    struct async_req *req;
+
+    while ((req = state->head) != NULL) {
+        state->head = req->next;
+        if (state->head == NULL)
+            state->tail = NULL;
+        state->count--;
+        req->cb(req->data, KADM5_RPC_ERROR, NULL);
+        free(req);
+    }
+}
+
+/*
+ * Read and complete replies until no more have arrived (if wait is false),
+ * or until no more than target calls remain outstanding (if wait is true).
+ */
+static kadm5_ret_t
+process_replies(kadm5_server_handle_t handle, krb5_boolean wait, int target)
+{
+    struct kadm5_async_state *state = handle->async;
+    CLIENT *clnt = handle->clnt;
+    struct async_req *req;
+    struct rpc_msg msg;
+    enum clnt_stat st;
+    generic_ret gr;
+    gprinc_ret pr;
+    uint32_t last_seq;
+
+    while (state->count > target) {
+        st = clnttcp_getreply(clnt, &msg, wait);
+        if (st == RPC_TIMEDOUT && !wait)
+            return 0;
+        if (st != RPC_SUCCESS) {
+            fail_all(state);
+            return KADM5_RPC_ERROR;
+        }
+        req = take_req(state, msg.rm_xid);
+        if (req == NULL) {
+            (void)clnttcp_endreply(clnt, &msg, NULL, NULL);
+            continue;
+        }
+
+        /* Verify and unwrap the reply under the sequence number of its call,
+         * then restore the number of the last call sent. */
+        memset(&gr, 0, sizeof(gr));
+        memset(&pr, 0, sizeof(pr));
+        (void)authgss_get_seq(clnt->cl_auth, &last_seq);
+        (void)authgss_set_seq(clnt->cl_auth, req->seq);
+        if (req->get) {
+            st = clnttcp_endreply(clnt, &msg, (xdrproc_t)xdr_gprinc_ret,
+                                  &pr);
+        } else {
+            st = clnttcp_endreply(clnt, &msg, (xdrproc_t)xdr_generic_ret,
+                                  &gr);
+        }
+        (void)authgss_set_seq(clnt->cl_auth, last_seq);
+
+        /* The call is off the list, so the callback may make more calls. */
+        complete(req->cb, req->data, req->get, st,
+                 req->get ? (void *)&pr : (void *)&gr);
+        free(req);
+    }
+    return 0;
+}
+
+/* Send a call, or make it synchronously if the connection cannot pipeline
+ * calls. */
+static kadm5_ret_t
+start_call(kadm5_server_handle_t handle, rpcproc_t proc, xdrproc_t xdr_args,
+           void *args, krb5_boolean get, kadm5_async_callback cb, void *data)
+{
+    struct kadm5_async_state *state = handle->async;
+    CLIENT *clnt = handle->clnt;
+    struct async_req *req;
+    enum clnt_stat st;
+    generic_ret gr;
+    gprinc_ret pr;
+    uint32_t seq;
+    kadm5_ret_t ret;
+
+    if (cb == NULL)
+        return EINVAL;
+
+    if (!state->checked) {
+        state->pipelined = authgss_get_seq(clnt->cl_auth, &seq) &&
+            clnttcp_setnonblock(clnt);
+        state->checked = TRUE;
+    }
+
+    if (!state->pipelined) {
+        memset(&gr, 0, sizeof(gr));
+        memset(&pr, 0, sizeof(pr));
+        if (get) {
+            st = clnt_call(clnt, proc, xdr_args, args,
+                           (xdrproc_t)xdr_gprinc_ret, (caddr_t)&pr, TIMEOUT);
+        } else {
+            st = clnt_call(clnt, proc, xdr_args, args,
+                           (xdrproc_t)xdr_generic_ret, (caddr_t)&gr, TIMEOUT);
+        }
+        complete(cb, data, get, st, get ? (void *)&pr : (void *)&gr);
+        return 0;
+    }
+
+    /* Complete whatever has already arrived, then make room if needed. */
+    ret = process_replies(handle, FALSE, 0);
+    if (ret)
+        return ret;
+    ret = process_replies(handle, TRUE, MAX_OUTSTANDING - 1);
+    if (ret)
+        return ret;
+
+    req = calloc(1, sizeof(*req));
+    if (req == NULL)
+        return ENOMEM;
+    if (clnttcp_send(clnt, proc, xdr_args, args, &req->xid) != RPC_SUCCESS) {
+        free(req);
+        return KADM5_RPC_ERROR;
+    }
+    (void)authgss_get_seq(clnt->cl_auth, &req->seq);
+    req->get = get;
+    req->cb = cb;
+    req->data = data;
+    if (state->tail != NULL)
+        state->tail->next = req;
+    else
+        state->head = req;
+    state->tail = req;
+    state->count++;
+    return 0;
+}
+
+void
+kadm5int_drain_async(kadm5_server_handle_t handle)
+{
+    if (handle->async != NULL && handle->async->count > 0)
+        (void)process_replies(handle, TRUE, 0);
+}
+
+/* Clear fields of rec which are not selected by mask, as the synchronous
+ * create and modify functions do. */
+static void
+mask_rec(kadm5_principal_ent_t rec, long mask)
+{
+    rec->mod_name = NULL;
+    if (!(mask & KADM5_POLICY))
+        rec->policy = NULL;
+    if (!(mask & KADM5_KEY_DATA)) {
+        rec->n_key_data = 0;
+        rec->key_data = NULL;
+    }
+    if (!(mask & KADM5_TL_DATA)) {
+        rec->n_tl_data = 0;
+        rec->tl_data = NULL;
+    }
+}
+
+kadm5_ret_t
+kadm5_create_principal_async(void *server_handle,
+                             kadm5_principal_ent_t princ, long mask,
+                             int n_ks_tuple, krb5_key_salt_tuple *ks_tuple,
+                             char *pw, kadm5_async_callback cb, void *data)
+{
+    kadm5_server_handle_t handle = server_handle;
+    cprinc_arg arg;
+    cprinc3_arg arg3;
+
+    ASYNC_CHECK_HANDLE(server_handle);
+
+    if (princ == NULL)
+        return EINVAL;
+
+    if (n_ks_tuple == 0) {
+        memset(&arg, 0, sizeof(arg));
+        arg.api_version = handle->api_version;
+        arg.rec = *princ;
+        arg.mask = mask;
+        arg.passwd = pw;
+        mask_rec(&arg.rec, mask);
+        return start_call(handle, CREATE_PRINCIPAL,
+                          (xdrproc_t)xdr_cprinc_arg, &arg, FALSE, cb, data);
+    }
+
+    memset(&arg3, 0, sizeof(arg3));
+    arg3.api_version = handle->api_version;
+    arg3.rec = *princ;
+    arg3.mask = mask;
+    arg3.n_ks_tuple = n_ks_tuple;
+    arg3.ks_tuple = ks_tuple;
+    arg3.passwd = pw;
+    mask_rec(&arg3.rec, mask);
+    return start_call(handle, CREATE_PRINCIPAL3, (xdrproc_t)xdr_cprinc3_arg,
+                      &arg3, FALSE, cb, data);
+}
+
+kadm5_ret_t
+kadm5_modify_principal_async(void *server_handle,
+                             kadm5_principal_ent_t princ, long mask,
+                             kadm5_async_callback cb, void *data)
+{
+    kadm5_server_handle_t handle = server_handle;
+    mprinc_arg arg;
+
+    ASYNC_CHECK_HANDLE(server_handle);
+
+    if (princ == NULL)
+        return EINVAL;
+    memset(&arg, 0, sizeof(arg));
+    arg.api_version = handle->api_version;
+    arg.rec = *princ;
+    arg.mask = mask;
+    mask_rec(&arg.rec, mask);
+    return start_call(handle, MODIFY_PRINCIPAL, (xdrproc_t)xdr_mprinc_arg,
+                      &arg, FALSE, cb, data);
+}
+
+kadm5_ret_t
+kadm5_delete_principal_async(void *server_handle, krb5_principal principal,
+                             kadm5_async_callback cb, void *data)
+{
+    kadm5_server_handle_t handle = server_handle;
+    dprinc_arg arg;
+
+    ASYNC_CHECK_HANDLE(server_handle);
+
+    if (principal == NULL)
+        return EINVAL;
+    arg.api_version = handle->api_version;
+    arg.princ = principal;
+    return start_call(handle, DELETE_PRINCIPAL, (xdrproc_t)xdr_dprinc_arg,
+                      &arg, FALSE, cb, data);
+}
+
+kadm5_ret_t
+kadm5_chpass_principal_async(void *server_handle, krb5_principal principal,
+                             krb5_boolean keepold, int n_ks_tuple,
+                             krb5_key_salt_tuple *ks_tuple, char *pw,
+                             kadm5_async_callback cb, void *data)
+{
+    kadm5_server_handle_t handle = server_handle;
+    chpass3_arg arg;
+
+    ASYNC_CHECK_HANDLE(server_handle);
+
+    if (principal == NULL)
+        return EINVAL;
+    arg.api_version = handle->api_version;
+    arg.princ = principal;
+    arg.keepold = keepold;
+    arg.n_ks_tuple = n_ks_tuple;
+    arg.ks_tuple = ks_tuple;
+    arg.pass = pw;
+    return start_call(handle, CHPASS_PRINCIPAL3, (xdrproc_t)xdr_chpass3_arg,
+                      &arg, FALSE, cb, data);
+}
+
+kadm5_ret_t
+kadm5_get_principal_async(void *server_handle, krb5_principal principal,
+                          long mask, kadm5_async_callback cb, void *data)
+{
+    kadm5_server_handle_t handle = server_handle;
+    gprinc_arg arg;
+
+    ASYNC_CHECK_HANDLE(server_handle);
+
+    if (principal == NULL)
+        return EINVAL;
+    arg.api_version = handle->api_version;
+    arg.princ = principal;
+    arg.mask = mask;
+    return start_call(handle, GET_PRINCIPAL, (xdrproc_t)xdr_gprinc_arg,
+                      &arg, TRUE, cb, data);
+}
+
+kadm5_ret_t
+kadm5_async_fd(void *server_handle, int *fd_out)
+{
+    kadm5_server_handle_t handle = server_handle;
+
+    ASYNC_CHECK_HANDLE(server_handle);
+
+    *fd_out = handle->client_socket;
+    return 0;
+}
+
+kadm5_ret_t
+kadm5_process_async(void *server_handle, int *pending_out)
+{
+    kadm5_server_handle_t handle = server_handle;
+    kadm5_ret_t ret = 0;
+
+    ASYNC_CHECK_HANDLE(server_handle);
+
+    if (handle->async->count > 0)
+        ret = process_replies(handle, FALSE, 0);
+    if (pending_out != NULL)
+        *pending_out = handle->async->count;
+    return ret;
+}
+
+kadm5_ret_t
+kadm5_flush_async(void *server_handle)
+{
+    kadm5_server_handle_t handle = server_handle;
+
+    ASYNC_CHECK_HANDLE(server_handle);
+
+    return process_replies(handle, TRUE, 0);
+}
@@ -5,6 +5,6 @@
 
 int _kadm5_check_handle(void *handle)
 {
-    CHECK_HANDLE(handle);
+    ASYNC_CHECK_HANDLE(handle);
     return 0;
 }
@@ -272,6 +272,10 @@ init_any(krb5_context context, char *client_name, enum init_type init_type,
     handle->lhandle->clnt = handle->clnt;
     handle->lhandle->client_socket = fd;
 
+    code = kadm5int_async_init(handle);
+    if (code)
+        goto error;
+
     /* now that handle->clnt is set, we can check the handle */
     if ((code = _kadm5_check_handle((void *) handle)))
         goto error;
@@ -351,6 +355,7 @@ error:
         clnt_destroy(handle->clnt);
     if (fd != -1)
         close(fd);
+    kadm5int_async_free(handle);
 
     kadm5_free_config_params(handle->context, &handle->params);
 
@@ -761,6 +766,7 @@ kadm5_destroy(void *server_handle)
         close(handle->client_socket);
     if (handle->lhandle)
         free (handle->lhandle);
+    kadm5int_async_free(handle);
 
     kadm5_free_config_params(handle->context, &handle->params);
 
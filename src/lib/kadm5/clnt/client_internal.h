@@ -65,6 +65,8 @@
 
 #include "admin_internal.h"
 
+struct kadm5_async_state;
+
 typedef struct _kadm5_server_handle_t {
     krb5_ui_4       magic_number;
     krb5_ui_4       struct_version;
@@ -77,6 +79,7 @@ typedef struct _kadm5_server_handle_t {
     gss_cred_id_t   cred;
     kadm5_config_params params;
     struct _kadm5_server_handle_t *lhandle;
+    struct kadm5_async_state *async;
 } kadm5_server_handle_rec, *kadm5_server_handle_t;
 
 #define CLIENT_CHECK_HANDLE(handle)             \
@@ -92,9 +95,22 @@ typedef struct _kadm5_server_handle_t {
             return KADM5_BAD_SERVER_HANDLE;     \
     }
 
-#define CHECK_HANDLE(handle)                                    \
+/*
+ * Synchronous calls share the connection with asynchronous ones, so
+ * CHECK_HANDLE completes any outstanding asynchronous calls first.
+ * ASYNC_CHECK_HANDLE only checks the handle.
+ */
+#define ASYNC_CHECK_HANDLE(handle)                              \
     GENERIC_CHECK_HANDLE(handle, KADM5_OLD_LIB_API_VERSION,     \
                          KADM5_NEW_LIB_API_VERSION)             \
     CLIENT_CHECK_HANDLE(handle)
 
+#define CHECK_HANDLE(handle)                                    \
+    ASYNC_CHECK_HANDLE(handle)                                  \
+    kadm5int_drain_async((kadm5_server_handle_t)handle);
+
+kadm5_ret_t kadm5int_async_init(kadm5_server_handle_t handle);
+void kadm5int_async_free(kadm5_server_handle_t handle);
+void kadm5int_drain_async(kadm5_server_handle_t handle);
+
 #endif /* __KADM5_CLIENT_INTERNAL_H__ */
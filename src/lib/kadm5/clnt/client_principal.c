@@ -206,6 +206,44 @@ kadm5_get_principals(void *server_handle,
     return r.code;
 }
 
+kadm5_ret_t
+kadm5_get_principals_page(void *server_handle, char *exp, char *cursor,
+                          int max, char ***princs, int *count,
+                          char **cursor_out)
+{
+    gprincs_page_arg arg;
+    gprincs_page_ret r;
+    enum clnt_stat st;
+    kadm5_server_handle_t handle = server_handle;
+
+    CHECK_HANDLE(server_handle);
+
+    if (princs == NULL || count == NULL || cursor_out == NULL || max <= 0)
+        return EINVAL;
+    *princs = NULL;
+    *count = 0;
+    *cursor_out = NULL;
+    arg.api_version = handle->api_version;
+    arg.exp = exp;
+    arg.cursor = cursor;
+    arg.max = max;
+    memset(&r, 0, sizeof(r));
+    st = get_princs_page_2(&arg, &r, handle->clnt);
+    if (st == RPC_PROCUNAVAIL && cursor == NULL) {
+        /* Older servers can only return all of the names at once. */
+        return kadm5_get_principals(handle, exp, princs, count);
+    } else if (st != RPC_SUCCESS) {
+        return KADM5_RPC_ERROR;
+    }
+    if (r.code == 0) {
+        *princs = r.princs;
+        *count = r.count;
+        *cursor_out = r.cursor;
+    }
+
+    return r.code;
+}
+
 kadm5_ret_t
 kadm5_rename_principal(void *server_handle,
                        krb5_principal source, krb5_principal dest)
@@ -548,3 +586,313 @@ kadm5_get_principal_keys(void *server_handle, krb5_principal princ,
     }
     return r.code;
 }
+
+/*
+ * Batch requests are sent in chunks of at most BATCH_MAX principals, to stay
+ * well within the server's limit on the size of an RPC record.  If the server
+ * does not implement a batch procedure, the batch functions fall back to one
+ * request per principal.
+ */
+#define BATCH_MAX 256
+
+/* Copy ent into *rec, omitting the fields not selected by mask. */
+static void
+batch_rec(kadm5_principal_ent_t ent, long mask, kadm5_principal_ent_t rec)
+{
+    memcpy(rec, ent, sizeof(*rec));
+    rec->mod_name = NULL;
+    if (!(mask & KADM5_POLICY))
+        rec->policy = NULL;
+    if (!(mask & KADM5_KEY_DATA)) {
+        rec->n_key_data = 0;
+        rec->key_data = NULL;
+    }
+    if (!(mask & KADM5_TL_DATA)) {
+        rec->n_tl_data = 0;
+        rec->tl_data = NULL;
+    }
+}
+
+/* Copy the per-principal codes of a batch reply for n principals into
+ * results, and free the reply. */
+static kadm5_ret_t
+batch_results(batch_ret *r, int n, kadm5_ret_t *results)
+{
+    kadm5_ret_t ret = r->code;
+
+    if (ret == KADM5_OK && r->n_codes != n)
+        ret = KADM5_RPC_ERROR;
+    if (ret == KADM5_OK)
+        memcpy(results, r->codes, n * sizeof(*results));
+    xdr_free((xdrproc_t)xdr_batch_ret, r);
+    return ret;
+}
+
+kadm5_ret_t
+kadm5_create_principals(void *server_handle, kadm5_principal_ent_t ents,
+                        int n_ents, long mask, int n_ks_tuple,
+                        krb5_key_salt_tuple *ks_tuple, char *pass,
+                        kadm5_ret_t *results)
+{
+    cprincs_arg         arg;
+    batch_ret           r;
+    kadm5_principal_ent_rec *recs;
+    kadm5_server_handle_t handle = server_handle;
+    enum clnt_stat      st;
+    kadm5_ret_t         ret = 0;
+    int                 i, j, n;
+
+    CHECK_HANDLE(server_handle);
+
+    if (n_ents < 0 || (n_ents > 0 && (ents == NULL || results == NULL)))
+        return EINVAL;
+    if (n_ents == 0)
+        return 0;
+    recs = calloc((n_ents < BATCH_MAX) ? n_ents : BATCH_MAX, sizeof(*recs));
+    if (recs == NULL)
+        return ENOMEM;
+
+    for (i = 0; i < n_ents && ret == 0; i += n) {
+        n = (n_ents - i < BATCH_MAX) ? n_ents - i : BATCH_MAX;
+        for (j = 0; j < n; j++)
+            batch_rec(&ents[i + j], mask, &recs[j]);
+
+        memset(&arg, 0, sizeof(arg));
+        arg.api_version = handle->api_version;
+        arg.recs = recs;
+        arg.n_recs = n;
+        arg.mask = mask;
+        arg.n_ks_tuple = n_ks_tuple;
+        arg.ks_tuple = ks_tuple;
+        arg.passwd = pass;
+        memset(&r, 0, sizeof(r));
+        st = create_principals_2(&arg, &r, handle->clnt);
+        if (st == RPC_PROCUNAVAIL) {
+            for (j = 0; j < n; j++) {
+                results[i + j] = kadm5_create_principal_3(handle, &ents[i + j],
+                                                          mask, n_ks_tuple,
+                                                          ks_tuple, pass);
+            }
+        } else if (st != RPC_SUCCESS) {
+            ret = KADM5_RPC_ERROR;
+        } else {
+            ret = batch_results(&r, n, results + i);
+        }
+    }
+    free(recs);
+    return ret;
+}
+
+/* Modify one principal for kadm5_modify_principals(), for servers which do
+ * not support the batch operation. */
+static kadm5_ret_t
+modify_one(void *server_handle, kadm5_principal_ent_t ent, long mask,
+           krb5_flags set_attrs, krb5_flags clear_attrs)
+{
+    kadm5_principal_ent_rec rec, old;
+    kadm5_ret_t ret;
+
+    rec = *ent;
+    if (mask & KADM5_ATTRIBUTES) {
+        ret = kadm5_get_principal(server_handle, ent->principal, &old,
+                                  KADM5_ATTRIBUTES);
+        if (ret)
+            return ret;
+        rec.attributes = (old.attributes | set_attrs) & ~clear_attrs;
+        kadm5_free_principal_ent(server_handle, &old);
+    }
+    return kadm5_modify_principal(server_handle, &rec, mask);
+}
+
+kadm5_ret_t
+kadm5_modify_principals(void *server_handle, kadm5_principal_ent_t ents,
+                        int n_ents, long mask, krb5_flags set_attrs,
+                        krb5_flags clear_attrs, kadm5_ret_t *results)
+{
+    mprincs_arg         arg;
+    batch_ret           r;
+    kadm5_principal_ent_rec *recs;
+    kadm5_server_handle_t handle = server_handle;
+    enum clnt_stat      st;
+    kadm5_ret_t         ret = 0;
+    int                 i, j, n;
+
+    CHECK_HANDLE(server_handle);
+
+    if (n_ents < 0 || (n_ents > 0 && (ents == NULL || results == NULL)))
+        return EINVAL;
+    if (n_ents == 0)
+        return 0;
+    recs = calloc((n_ents < BATCH_MAX) ? n_ents : BATCH_MAX, sizeof(*recs));
+    if (recs == NULL)
+        return ENOMEM;
+
+    for (i = 0; i < n_ents && ret == 0; i += n) {
+        n = (n_ents - i < BATCH_MAX) ? n_ents - i : BATCH_MAX;
+        for (j = 0; j < n; j++)
+            batch_rec(&ents[i + j], mask, &recs[j]);
+
+        memset(&arg, 0, sizeof(arg));
+        arg.api_version = handle->api_version;
+        arg.recs = recs;
+        arg.n_recs = n;
+        arg.mask = mask;
+        arg.set_attrs = set_attrs;
+        arg.clear_attrs = clear_attrs;
+        memset(&r, 0, sizeof(r));
+        st = modify_principals_2(&arg, &r, handle->clnt);
+        if (st == RPC_PROCUNAVAIL) {
+            for (j = 0; j < n; j++) {
+                results[i + j] = modify_one(handle, &ents[i + j], mask,
+                                            set_attrs, clear_attrs);
+            }
+        } else if (st != RPC_SUCCESS) {
+            ret = KADM5_RPC_ERROR;
+        } else {
+            ret = batch_results(&r, n, results + i);
+        }
+    }
+    free(recs);
+    return ret;
+}
+
+kadm5_ret_t
+kadm5_randkey_principals(void *server_handle, krb5_principal *princs,
+                         int n_princs, krb5_boolean keepold, int n_ks_tuple,
+                         krb5_key_salt_tuple *ks_tuple, kadm5_ret_t *results)
+{
+    chrands_arg         arg;
+    batch_ret           r;
+    kadm5_server_handle_t handle = server_handle;
+    enum clnt_stat      st;
+    kadm5_ret_t         ret = 0;
+    int                 i, j, n;
+
+    CHECK_HANDLE(server_handle);
+
+    if (n_princs < 0 || (n_princs > 0 && (princs == NULL || results == NULL)))
+        return EINVAL;
+
+    for (i = 0; i < n_princs && ret == 0; i += n) {
+        n = (n_princs - i < BATCH_MAX) ? n_princs - i : BATCH_MAX;
+
+        arg.api_version = handle->api_version;
+        arg.princs = princs + i;
+        arg.n_princs = n;
+        arg.keepold = keepold;
+        arg.n_ks_tuple = n_ks_tuple;
+        arg.ks_tuple = ks_tuple;
+        memset(&r, 0, sizeof(r));
+        st = chrand_principals_2(&arg, &r, handle->clnt);
+        if (st == RPC_PROCUNAVAIL) {
+            for (j = 0; j < n; j++) {
+                results[i + j] = kadm5_randkey_principal_3(handle,
+                                                           princs[i + j],
+                                                           keepold,
+                                                           n_ks_tuple,
+                                                           ks_tuple, NULL,
+                                                           NULL);
+            }
+        } else if (st != RPC_SUCCESS) {
+            ret = KADM5_RPC_ERROR;
+        } else {
+            ret = batch_results(&r, n, results + i);
+        }
+    }
+    return ret;
+}
+
+kadm5_ret_t
+kadm5_setkey_principals(void *server_handle, krb5_principal *princs,
+                        int n_princs, krb5_boolean keepold,
+                        kadm5_key_data **key_data, int *n_key_data,
+                        kadm5_ret_t *results)
+{
+    setkeys_arg         arg;
+    batch_ret           r;
+    setkeys_ent         *ents;
+    kadm5_server_handle_t handle = server_handle;
+    enum clnt_stat      st;
+    kadm5_ret_t         ret = 0;
+    int                 i, j, n;
+
+    CHECK_HANDLE(server_handle);
+
+    if (n_princs < 0 || (n_princs > 0 &&
+                         (princs == NULL || key_data == NULL ||
+                          n_key_data == NULL || results == NULL)))
+        return EINVAL;
+    if (n_princs == 0)
+        return 0;
+    ents = calloc((n_princs < BATCH_MAX) ? n_princs : BATCH_MAX,
+                  sizeof(*ents));
+    if (ents == NULL)
+        return ENOMEM;
+
+    for (i = 0; i < n_princs && ret == 0; i += n) {
+        n = (n_princs - i < BATCH_MAX) ? n_princs - i : BATCH_MAX;
+        for (j = 0; j < n; j++) {
+            ents[j].princ = princs[i + j];
+            ents[j].key_data = key_data[i + j];
+            ents[j].n_key_data = n_key_data[i + j];
+        }
+
+        arg.api_version = handle->api_version;
+        arg.ents = ents;
+        arg.n_ents = n;
+        arg.keepold = keepold;
+        memset(&r, 0, sizeof(r));
+        st = setkey_principals_2(&arg, &r, handle->clnt);
+        if (st == RPC_PROCUNAVAIL) {
+            for (j = 0; j < n; j++) {
+                results[i + j] = kadm5_setkey_principal_4(handle,
+                                                          princs[i + j],
+                                                          keepold,
+                                                          key_data[i + j],
+                                                          n_key_data[i + j]);
+            }
+        } else if (st != RPC_SUCCESS) {
+            ret = KADM5_RPC_ERROR;
+        } else {
+            ret = batch_results(&r, n, results + i);
+        }
+    }
+    free(ents);
+    return ret;
+}
+
+kadm5_ret_t
+kadm5_delete_principals(void *server_handle, krb5_principal *princs,
+                        int n_princs, kadm5_ret_t *results)
+{
+    dprincs_arg         arg;
+    batch_ret           r;
+    kadm5_server_handle_t handle = server_handle;
+    enum clnt_stat      st;
+    kadm5_ret_t         ret = 0;
+    int                 i, j, n;
+
+    CHECK_HANDLE(server_handle);
+
+    if (n_princs < 0 || (n_princs > 0 && (princs == NULL || results == NULL)))
+        return EINVAL;
+
+    for (i = 0; i < n_princs && ret == 0; i += n) {
+        n = (n_princs - i < BATCH_MAX) ? n_princs - i : BATCH_MAX;
+
+        arg.api_version = handle->api_version;
+        arg.princs = princs + i;
+        arg.n_princs = n;
+        memset(&r, 0, sizeof(r));
+        st = delete_principals_2(&arg, &r, handle->clnt);
+        if (st == RPC_PROCUNAVAIL) {
+            for (j = 0; j < n; j++)
+                results[i + j] = kadm5_delete_principal(handle, princs[i + j]);
+        } else if (st != RPC_SUCCESS) {
+            ret = KADM5_RPC_ERROR;
+        } else {
+            ret = batch_results(&r, n, results + i);
+        }
+    }
+    return ret;
+}
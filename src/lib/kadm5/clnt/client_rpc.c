@@ -219,3 +219,51 @@ get_principal_keys_2(getpkeys_arg *argp, getpkeys_ret *res, CLIENT *clnt)
 			 (xdrproc_t)xdr_getpkeys_arg, (caddr_t)argp,
 			 (xdrproc_t)xdr_getpkeys_ret, (caddr_t)res, TIMEOUT);
 }
+
+enum clnt_stat
+create_principals_2(cprincs_arg *argp, batch_ret *res, CLIENT *clnt)
+{
+	return clnt_call(clnt, CREATE_PRINCIPALS,
+			 (xdrproc_t)xdr_cprincs_arg, (caddr_t)argp,
+			 (xdrproc_t)xdr_batch_ret, (caddr_t)res, TIMEOUT);
+}
+
+enum clnt_stat
+modify_principals_2(mprincs_arg *argp, batch_ret *res, CLIENT *clnt)
+{
+	return clnt_call(clnt, MODIFY_PRINCIPALS,
+			 (xdrproc_t)xdr_mprincs_arg, (caddr_t)argp,
+			 (xdrproc_t)xdr_batch_ret, (caddr_t)res, TIMEOUT);
+}
+
+enum clnt_stat
+chrand_principals_2(chrands_arg *argp, batch_ret *res, CLIENT *clnt)
+{
+	return clnt_call(clnt, CHRAND_PRINCIPALS,
+			 (xdrproc_t)xdr_chrands_arg, (caddr_t)argp,
+			 (xdrproc_t)xdr_batch_ret, (caddr_t)res, TIMEOUT);
+}
+
+enum clnt_stat
+setkey_principals_2(setkeys_arg *argp, batch_ret *res, CLIENT *clnt)
+{
+	return clnt_call(clnt, SETKEY_PRINCIPALS,
+			 (xdrproc_t)xdr_setkeys_arg, (caddr_t)argp,
+			 (xdrproc_t)xdr_batch_ret, (caddr_t)res, TIMEOUT);
+}
+
+enum clnt_stat
+delete_principals_2(dprincs_arg *argp, batch_ret *res, CLIENT *clnt)
+{
+	return clnt_call(clnt, DELETE_PRINCIPALS,
+			 (xdrproc_t)xdr_dprincs_arg, (caddr_t)argp,
+			 (xdrproc_t)xdr_batch_ret, (caddr_t)res, TIMEOUT);
+}
+
+enum clnt_stat
+get_princs_page_2(gprincs_page_arg *argp, gprincs_page_ret *res, CLIENT *clnt)
+{
+	return clnt_call(clnt, GET_PRINCS_PAGE,
+			 (xdrproc_t)xdr_gprincs_page_arg, (caddr_t)argp,
+			 (xdrproc_t)xdr_gprincs_page_ret, (caddr_t)res, TIMEOUT);
+}
@@ -65,6 +65,23 @@ struct gprincs_ret {
 };
 typedef struct gprincs_ret gprincs_ret;
 
+struct gprincs_page_arg {
+	krb5_ui_4 api_version;
+	char *exp;
+	char *cursor;
+	int max;
+};
+typedef struct gprincs_page_arg gprincs_page_arg;
+
+struct gprincs_page_ret {
+	krb5_ui_4 api_version;
+	kadm5_ret_t code;
+	char **princs;
+	int count;
+	char *cursor;
+};
+typedef struct gprincs_page_ret gprincs_page_ret;
+
 struct chpass_arg {
 	krb5_ui_4 api_version;
 	krb5_principal princ;
@@ -253,6 +270,67 @@ struct getpkeys_ret {
 };
 typedef struct getpkeys_ret getpkeys_ret;
 
+struct cprincs_arg {
+	krb5_ui_4 api_version;
+	kadm5_principal_ent_rec *recs;
+	int n_recs;
+	long mask;
+	int n_ks_tuple;
+	krb5_key_salt_tuple *ks_tuple;
+	char *passwd;
+};
+typedef struct cprincs_arg cprincs_arg;
+
+struct mprincs_arg {
+	krb5_ui_4 api_version;
+	kadm5_principal_ent_rec *recs;
+	int n_recs;
+	long mask;
+	krb5_flags set_attrs;
+	krb5_flags clear_attrs;
+};
+typedef struct mprincs_arg mprincs_arg;
+
+struct chrands_arg {
+	krb5_ui_4 api_version;
+	krb5_principal *princs;
+	int n_princs;
+	krb5_boolean keepold;
+	int n_ks_tuple;
+	krb5_key_salt_tuple *ks_tuple;
+};
+typedef struct chrands_arg chrands_arg;
+
+struct setkeys_ent {
+	krb5_principal princ;
+	kadm5_key_data *key_data;
+	int n_key_data;
+};
+typedef struct setkeys_ent setkeys_ent;
+
+struct setkeys_arg {
+	krb5_ui_4 api_version;
+	setkeys_ent *ents;
+	int n_ents;
+	krb5_boolean keepold;
+};
+typedef struct setkeys_arg setkeys_arg;
+
+struct dprincs_arg {
+	krb5_ui_4 api_version;
+	krb5_principal *princs;
+	int n_princs;
+};
+typedef struct dprincs_arg dprincs_arg;
+
+struct batch_ret {
+	krb5_ui_4 api_version;
+	kadm5_ret_t code;
+	kadm5_ret_t *codes;
+	int n_codes;
+};
+typedef struct batch_ret batch_ret;
+
 #define KADM 2112
 #define KADMVERS 2
 #define CREATE_PRINCIPAL 1
@@ -369,6 +447,36 @@ extern enum clnt_stat get_principal_keys_2(getpkeys_arg *, getpkeys_ret *,
 					   CLIENT *);
 extern  bool_t get_principal_keys_2_svc(getpkeys_arg *, getpkeys_ret *,
 					struct svc_req *);
+#define CREATE_PRINCIPALS 27
+extern  enum clnt_stat create_principals_2(cprincs_arg *, batch_ret *,
+					   CLIENT *);
+extern  bool_t create_principals_2_svc(cprincs_arg *, batch_ret *,
+				       struct svc_req *);
+#define MODIFY_PRINCIPALS 28
+extern  enum clnt_stat modify_principals_2(mprincs_arg *, batch_ret *,
+					   CLIENT *);
+extern  bool_t modify_principals_2_svc(mprincs_arg *, batch_ret *,
+				       struct svc_req *);
+#define CHRAND_PRINCIPALS 29
+extern  enum clnt_stat chrand_principals_2(chrands_arg *, batch_ret *,
+					   CLIENT *);
+extern  bool_t chrand_principals_2_svc(chrands_arg *, batch_ret *,
+				       struct svc_req *);
+#define SETKEY_PRINCIPALS 30
+extern  enum clnt_stat setkey_principals_2(setkeys_arg *, batch_ret *,
+					   CLIENT *);
+extern  bool_t setkey_principals_2_svc(setkeys_arg *, batch_ret *,
+				       struct svc_req *);
+#define DELETE_PRINCIPALS 31
+extern  enum clnt_stat delete_principals_2(dprincs_arg *, batch_ret *,
+					   CLIENT *);
+extern  bool_t delete_principals_2_svc(dprincs_arg *, batch_ret *,
+				       struct svc_req *);
+#define GET_PRINCS_PAGE 32
+extern  enum clnt_stat get_princs_page_2(gprincs_page_arg *,
+					 gprincs_page_ret *, CLIENT *);
+extern  bool_t get_princs_page_2_svc(gprincs_page_arg *, gprincs_page_ret *,
+				     struct svc_req *);
 
 extern bool_t xdr_cprinc_arg ();
 extern bool_t xdr_cprinc3_arg ();
@@ -378,6 +486,8 @@ extern bool_t xdr_mprinc_arg ();
 extern bool_t xdr_rprinc_arg ();
 extern bool_t xdr_gprincs_arg ();
 extern bool_t xdr_gprincs_ret ();
+extern bool_t xdr_gprincs_page_arg ();
+extern bool_t xdr_gprincs_page_ret ();
 extern bool_t xdr_chpass_arg ();
 extern bool_t xdr_chpass3_arg ();
 extern bool_t xdr_setv4key_arg ();
@@ -414,5 +524,11 @@ extern bool_t xdr_krb5_string_attr ();
 extern bool_t xdr_kadm5_key_data ();
 extern bool_t xdr_getpkeys_arg ();
 extern bool_t xdr_getpkeys_ret ();
+extern bool_t xdr_cprincs_arg ();
+extern bool_t xdr_mprincs_arg ();
+extern bool_t xdr_chrands_arg ();
+extern bool_t xdr_setkeys_arg ();
+extern bool_t xdr_dprincs_arg ();
+extern bool_t xdr_batch_ret ();
 
 #endif /* __KADM_RPC_H__ */
@@ -671,6 +671,46 @@ xdr_gprincs_ret(XDR *xdrs, gprincs_ret *objp)
      return (TRUE);
 }
 
+bool_t
+xdr_gprincs_page_arg(XDR *xdrs, gprincs_page_arg *objp)
+{
+	if (!xdr_ui_4(xdrs, &objp->api_version)) {
+		return (FALSE);
+	}
+	if (!xdr_nullstring(xdrs, &objp->exp)) {
+		return (FALSE);
+	}
+	if (!xdr_nullstring(xdrs, &objp->cursor)) {
+		return (FALSE);
+	}
+	if (!xdr_int(xdrs, &objp->max)) {
+		return (FALSE);
+	}
+	return (TRUE);
+}
+
+bool_t
+xdr_gprincs_page_ret(XDR *xdrs, gprincs_page_ret *objp)
+{
+	if (!xdr_ui_4(xdrs, &objp->api_version)) {
+		return (FALSE);
+	}
+	if (!xdr_kadm5_ret_t(xdrs, &objp->code)) {
+		return (FALSE);
+	}
+	if (objp->code == KADM5_OK) {
+		if (!xdr_array(xdrs, (caddr_t *) &objp->princs,
+			       (unsigned int *) &objp->count, ~0,
+			       sizeof(char *), xdr_nullstring)) {
+			return (FALSE);
+		}
+		if (!xdr_nullstring(xdrs, &objp->cursor)) {
+			return (FALSE);
+		}
+	}
+	return (TRUE);
+}
+
 bool_t
 xdr_chpass_arg(XDR *xdrs, chpass_arg *objp)
 {
@@ -1226,3 +1266,141 @@ xdr_getpkeys_ret(XDR *xdrs, getpkeys_ret *objp)
 	}
 	return TRUE;
 }
+
+bool_t
+xdr_cprincs_arg(XDR *xdrs, cprincs_arg *objp)
+{
+	if (!xdr_ui_4(xdrs, &objp->api_version)) {
+		return FALSE;
+	}
+	if (!xdr_array(xdrs, (caddr_t *) &objp->recs,
+		       (unsigned int *) &objp->n_recs, ~0,
+		       sizeof(kadm5_principal_ent_rec),
+		       xdr_kadm5_principal_ent_rec)) {
+		return FALSE;
+	}
+	if (!xdr_long(xdrs, &objp->mask)) {
+		return FALSE;
+	}
+	if (!xdr_array(xdrs, (caddr_t *) &objp->ks_tuple,
+		       (unsigned int *) &objp->n_ks_tuple, ~0,
+		       sizeof(krb5_key_salt_tuple),
+		       xdr_krb5_key_salt_tuple)) {
+		return FALSE;
+	}
+	if (!xdr_nullstring(xdrs, &objp->passwd)) {
+		return FALSE;
+	}
+	return TRUE;
+}
+
+bool_t
+xdr_mprincs_arg(XDR *xdrs, mprincs_arg *objp)
+{
+	if (!xdr_ui_4(xdrs, &objp->api_version)) {
+		return FALSE;
+	}
+	if (!xdr_array(xdrs, (caddr_t *) &objp->recs,
+		       (unsigned int *) &objp->n_recs, ~0,
+		       sizeof(kadm5_principal_ent_rec),
+		       xdr_kadm5_principal_ent_rec)) {
+		return FALSE;
+	}
+	if (!xdr_long(xdrs, &objp->mask)) {
+		return FALSE;
+	}
+	if (!xdr_krb5_flags(xdrs, &objp->set_attrs)) {
+		return FALSE;
+	}
+	if (!xdr_krb5_flags(xdrs, &objp->clear_attrs)) {
+		return FALSE;
+	}
+	return TRUE;
+}
+
+bool_t
+xdr_chrands_arg(XDR *xdrs, chrands_arg *objp)
+{
+	if (!xdr_ui_4(xdrs, &objp->api_version)) {
+		return FALSE;
+	}
+	if (!xdr_array(xdrs, (caddr_t *) &objp->princs,
+		       (unsigned int *) &objp->n_princs, ~0,
+		       sizeof(krb5_principal), xdr_krb5_principal)) {
+		return FALSE;
+	}
+	if (!xdr_krb5_boolean(xdrs, &objp->keepold)) {
+		return FALSE;
+	}
+	if (!xdr_array(xdrs, (caddr_t *) &objp->ks_tuple,
+		       (unsigned int *) &objp->n_ks_tuple, ~0,
+		       sizeof(krb5_key_salt_tuple),
+		       xdr_krb5_key_salt_tuple)) {
+		return FALSE;
+	}
+	return TRUE;
+}
+
+static bool_t
+xdr_setkeys_ent(XDR *xdrs, setkeys_ent *objp)
+{
+	if (!xdr_krb5_principal(xdrs, &objp->princ)) {
+		return FALSE;
+	}
+	if (!xdr_array(xdrs, (caddr_t *) &objp->key_data,
+		       (unsigned int *) &objp->n_key_data, ~0,
+		       sizeof(kadm5_key_data), xdr_kadm5_key_data)) {
+		return FALSE;
+	}
+	return TRUE;
+}
+
+bool_t
+xdr_setkeys_arg(XDR *xdrs, setkeys_arg *objp)
+{
+	if (!xdr_ui_4(xdrs, &objp->api_version)) {
+		return FALSE;
+	}
+	if (!xdr_array(xdrs, (caddr_t *) &objp->ents,
+		       (unsigned int *) &objp->n_ents, ~0,
+		       sizeof(setkeys_ent), xdr_setkeys_ent)) {
+		return FALSE;
+	}
+	if (!xdr_krb5_boolean(xdrs, &objp->keepold)) {
+		return FALSE;
+	}
+	return TRUE;
+}
+
+bool_t
+xdr_dprincs_arg(XDR *xdrs, dprincs_arg *objp)
+{
+	if (!xdr_ui_4(xdrs, &objp->api_version)) {
+		return FALSE;
+	}
+	if (!xdr_array(xdrs, (caddr_t *) &objp->princs,
+		       (unsigned int *) &objp->n_princs, ~0,
+		       sizeof(krb5_principal), xdr_krb5_principal)) {
+		return FALSE;
+	}
+	return TRUE;
+}
+
+bool_t
+xdr_batch_ret(XDR *xdrs, batch_ret *objp)
+{
+	if (!xdr_ui_4(xdrs, &objp->api_version)) {
+		return FALSE;
+	}
+	if (!xdr_kadm5_ret_t(xdrs, &objp->code)) {
+		return FALSE;
+	}
+	if (objp->code == KADM5_OK) {
+		if (!xdr_array(xdrs, (caddr_t *) &objp->codes,
+			       (unsigned int *) &objp->n_codes, ~0,
+			       sizeof(kadm5_ret_t), xdr_kadm5_ret_t)) {
+			return FALSE;
+		}
+	}
+	return TRUE;
+}
@@ -39,6 +39,18 @@ typedef struct pwqual_handle_st *pwqual_handle;
 
 typedef struct kadm5_hook_handle_st *kadm5_hook_handle;
 
+/*
+ * Phases of a server operation whose elapsed time is accumulated in the
+ * handle, so that kadmind can report where time is spent.  Calls made through
+ * the handle's lhandle are not counted.
+ */
+enum kadm5_phase {
+    KADM5_PHASE_PWQUAL,         /* password quality checks */
+    KADM5_PHASE_HOOK,           /* kadm5_hook module calls */
+    KADM5_PHASE_KDB,            /* KDB reads and writes, including the ulog */
+    KADM5_NUM_PHASES
+};
+
 typedef struct _kadm5_server_handle_t {
     krb5_ui_4       magic_number;
     krb5_ui_4       struct_version;
@@ -50,6 +62,7 @@ typedef struct _kadm5_server_handle_t {
     char **db_args;
     pwqual_handle   *qual_handles;
     kadm5_hook_handle *hook_handles;
+    uint64_t        phase_usec[KADM5_NUM_PHASES];
 } kadm5_server_handle_rec, *kadm5_server_handle_t;
 
 #define OSA_ADB_PRINC_VERSION_1  0x12345C01
@@ -95,6 +108,7 @@ krb5_error_code     kdb_put_entry(kadm5_server_handle_t handle,
                                   krb5_db_entry *kdb, osa_princ_ent_rec *adb);
 krb5_error_code     kdb_delete_entry(kadm5_server_handle_t handle,
                                      krb5_principal name);
+krb5_error_code     kdb_commit_txn(kadm5_server_handle_t handle);
 krb5_error_code     kdb_iter_entry(kadm5_server_handle_t handle,
                                    char *match_entry,
                                    void (*iter_fct)(void *, krb5_principal),
@@ -185,6 +199,25 @@ k5_pwqual_check(krb5_context context, pwqual_handle handle,
                 const char *password, const char *policy_name,
                 krb5_principal princ);
 
+/*
+ * A compiled dictionary file for the dict module begins with a header of
+ * PWQUAL_DICT_HEADER_LEN bytes: the magic string PWQUAL_DICT_MAGIC, a four-byte
+ * big-endian format version, four zero bytes, and an eight-byte big-endian
+ * count of words.  It continues with the k5_pwqual_dict_hash() value of each
+ * word as an eight-byte big-endian number, in ascending order without
+ * duplicates.
+ */
+#define PWQUAL_DICT_MAGIC "KRB5DICT"
+#define PWQUAL_DICT_MAGIC_LEN 8
+#define PWQUAL_DICT_VERSION 1
+#define PWQUAL_DICT_HEADER_LEN 24
+
+/* Set *hash_out to the first eight bytes (as a big-endian number) of the
+ * SHA-256 hash of the len bytes of word, with ASCII letters folded to lower
+ * case. */
+krb5_error_code
+k5_pwqual_dict_hash(const char *word, size_t len, uint64_t *hash_out);
+
 /*** initvt functions for built-in password quality modules ***/
 
 /* The dict module checks passwords against the realm's dictionary. */
@@ -221,10 +254,9 @@ k5_kadm5_hook_load(krb5_context context,
 void
 k5_kadm5_hook_free_handles(krb5_context context, kadm5_hook_handle *handles);
 
-/** Call the chpass entry point on every kadm5_hook in @a handles. */
+/** Call the chpass entry point on every kadm5_hook of @a handle. */
 kadm5_ret_t
-k5_kadm5_hook_chpass (krb5_context context,
-                      kadm5_hook_handle *handles,
+k5_kadm5_hook_chpass (kadm5_server_handle_t handle,
                       int stage, krb5_principal princ,
                       krb5_boolean keepold,
                       int n_ks_tuple,
@@ -233,8 +265,7 @@ k5_kadm5_hook_chpass (krb5_context context,
 
 /** Call the create entry point for kadm5_hook_plugins. */
 kadm5_ret_t
-k5_kadm5_hook_create (krb5_context context,
-                      kadm5_hook_handle *handles,
+k5_kadm5_hook_create (kadm5_server_handle_t handle,
                       int stage,
                       kadm5_principal_ent_t princ, long mask,
                       int n_ks_tuple,
@@ -243,22 +274,19 @@ k5_kadm5_hook_create (krb5_context context,
 
 /** Call modify kadm5_hook entry point. */
 kadm5_ret_t
-k5_kadm5_hook_modify (krb5_context context,
-                      kadm5_hook_handle *handles,
+k5_kadm5_hook_modify (kadm5_server_handle_t handle,
                       int stage,
                       kadm5_principal_ent_t princ, long mask);
 
 /** Call remove kadm5_hook entry point. */
 kadm5_ret_t
-k5_kadm5_hook_remove (krb5_context context,
-                      kadm5_hook_handle *handles,
+k5_kadm5_hook_remove (kadm5_server_handle_t handle,
                       int stage,
                       krb5_principal princ);
 
 /** Call rename kadm5_hook entry point. */
 kadm5_ret_t
-k5_kadm5_hook_rename (krb5_context context,
-                      kadm5_hook_handle *handles,
+k5_kadm5_hook_rename (kadm5_server_handle_t handle,
                       int stage,
                       krb5_principal oprinc, krb5_principal nprinc);
 
@@ -121,65 +121,70 @@ log_failure(krb5_context context,
     krb5_free_error_message(context, e);
 }
 
+/*
+ * Call operation on each hook module of the server handle, accumulating the
+ * elapsed time in the handle's hook phase counter.  A precommit failure stops
+ * the iteration and is returned; postcommit failures are only logged.
+ */
 #define ITERATE(operation, params)                                      \
-    for (; *handles; handles++) {                                       \
-        kadm5_hook_handle h = *handles;                                 \
-        krb5_error_code ret = 0;                                        \
-        if (h->vt.operation) {                                          \
+    krb5_context context = handle->context;                             \
+    kadm5_hook_handle *hp;                                              \
+    uint64_t start = k5_monotonic_usec();                               \
+    krb5_error_code ret = 0;                                            \
+                                                                        \
+    for (hp = handle->hook_handles; *hp != NULL; hp++) {                \
+        kadm5_hook_handle h = *hp;                                      \
+        if (h->vt.operation)                                            \
             ret = h->vt.operation params;                               \
-        }                                                               \
+        if (ret && stage == KADM5_HOOK_STAGE_PRECOMMIT)                 \
+            break;                                                      \
         if (ret) {                                                      \
-            if (stage == KADM5_HOOK_STAGE_PRECOMMIT)                    \
-                return ret;                                             \
-            else                                                        \
-                log_failure(context, h->vt.name, #operation, ret);      \
+            log_failure(context, h->vt.name, #operation, ret);          \
+            ret = 0;                                                    \
         }                                                               \
-    }
+    }                                                                   \
+    handle->phase_usec[KADM5_PHASE_HOOK] += k5_monotonic_usec() - start; \
+    return ret
 
 
 kadm5_ret_t
-k5_kadm5_hook_chpass(krb5_context context, kadm5_hook_handle *handles,
-                     int stage, krb5_principal princ, krb5_boolean keepold,
+k5_kadm5_hook_chpass(kadm5_server_handle_t handle, int stage,
+                     krb5_principal princ, krb5_boolean keepold,
                      int n_ks_tuple, krb5_key_salt_tuple *ks_tuple,
                      const char *newpass)
 {
     ITERATE(chpass, (context, h->data,
                      stage, princ, keepold,
                      n_ks_tuple, ks_tuple, newpass));
-    return 0;
 }
 
 kadm5_ret_t
-k5_kadm5_hook_create(krb5_context context, kadm5_hook_handle *handles,
-                     int stage, kadm5_principal_ent_t princ, long mask,
+k5_kadm5_hook_create(kadm5_server_handle_t handle, int stage,
+                     kadm5_principal_ent_t princ, long mask,
                      int n_ks_tuple, krb5_key_salt_tuple *ks_tuple,
                      const char *newpass)
 {
     ITERATE(create, (context, h->data,
                      stage, princ, mask, n_ks_tuple, ks_tuple, newpass));
-    return 0;
 }
 
 kadm5_ret_t
-k5_kadm5_hook_modify(krb5_context context, kadm5_hook_handle *handles,
-                     int stage, kadm5_principal_ent_t princ, long mask)
+k5_kadm5_hook_modify(kadm5_server_handle_t handle, int stage,
+                     kadm5_principal_ent_t princ, long mask)
 {
     ITERATE(modify, (context, h->data, stage, princ, mask));
-    return 0;
 }
 
 kadm5_ret_t
-k5_kadm5_hook_rename(krb5_context context, kadm5_hook_handle *handles,
-                     int stage, krb5_principal oprinc, krb5_principal nprinc)
+k5_kadm5_hook_rename(kadm5_server_handle_t handle, int stage,
+                     krb5_principal oprinc, krb5_principal nprinc)
 {
     ITERATE(rename, (context, h->data, stage, oprinc, nprinc));
-    return 0;
 }
 
 kadm5_ret_t
-k5_kadm5_hook_remove(krb5_context context, kadm5_hook_handle *handles,
-                     int stage, krb5_principal princ)
+k5_kadm5_hook_remove(kadm5_server_handle_t handle, int stage,
+                     krb5_principal princ)
 {
     ITERATE(remove, (context, h->data, stage, princ));
-    return 0;
 }
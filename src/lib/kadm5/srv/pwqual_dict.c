@@ -29,10 +29,11 @@
 
 /* Password quality module to look up passwords within the realm dictionary. */
 
-#include "k5-platform.h"
+#include "k5-int.h"
 #include <krb5/pwqual_plugin.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <unistd.h>
 #include <kadm5/admin.h>
 #include "adm_proto.h"
@@ -43,6 +44,10 @@ typedef struct dict_moddata_st {
     char **word_list;        /* list of word pointers */
     char *word_block;        /* actual word data */
     unsigned int word_count; /* number of words */
+    void *map;               /* mapping of a compiled dictionary */
+    size_t map_len;          /* length of map */
+    const unsigned char *hashes; /* word hashes within map */
+    uint64_t hash_count;     /* number of word hashes */
 } *dict_moddata;
 
 
@@ -67,6 +72,101 @@ word_compare(const void *s1, const void *s2)
     return (strcasecmp(*(const char **)s1, *(const char **)s2));
 }
 
+/*
+ * Map the compiled dictionary open on fd, of size len, into dict.  The mapping
+ * is shared, so processes using the same dictionary share its pages.
+ */
+static int
+map_dict(dict_moddata dict, int fd, off_t len, const char *dict_file)
+{
+    unsigned char *p;
+    uint64_t count;
+
+    if ((uint64_t)len > SIZE_MAX)
+        return EFBIG;
+    p = mmap(NULL, len, PROT_READ, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED)
+        return errno;
+    count = load_64_be(p + 16);
+    if (load_32_be(p + PWQUAL_DICT_MAGIC_LEN) != PWQUAL_DICT_VERSION ||
+        count > ((uint64_t)len - PWQUAL_DICT_HEADER_LEN) / 8 ||
+        PWQUAL_DICT_HEADER_LEN + count * 8 != (uint64_t)len) {
+        krb5_klog_syslog(LOG_ERR, _("Compiled dictionary file %s is "
+                                    "invalid"), dict_file);
+        munmap(p, len);
+        return KRB5_CONFIG_BADFORMAT;
+    }
+    dict->map = p;
+    dict->map_len = len;
+    dict->hashes = p + PWQUAL_DICT_HEADER_LEN;
+    dict->hash_count = count;
+    return KADM5_OK;
+}
+
+/*
+ * Return true if hash is one of the sorted hashes of a compiled dictionary.
+ * The hashes are uniformly distributed, so interpolation steps find the
+ * position in a few probes; alternating them with bisection steps bounds the
+ * number of probes by twice the binary logarithm of the count.
+ */
+static krb5_boolean
+find_hash(const unsigned char *hashes, uint64_t count, uint64_t hash)
+{
+    uint64_t lo = 0, hi = count, mid, vlo, vhi, v;
+    krb5_boolean interp = TRUE;
+
+    while (lo < hi) {
+        if (interp && hi - lo > 2) {
+            vlo = load_64_be(hashes + lo * 8);
+            vhi = load_64_be(hashes + (hi - 1) * 8);
+            if (hash < vlo || hash > vhi)
+                return FALSE;
+            if (vhi == vlo)
+                return hash == vlo;
+            mid = lo + (uint64_t)((double)(hash - vlo) / (double)(vhi - vlo) *
+                                  (double)(hi - 1 - lo));
+            if (mid >= hi)
+                mid = hi - 1;
+        } else {
+            mid = lo + (hi - lo) / 2;
+        }
+        interp = !interp;
+        v = load_64_be(hashes + mid * 8);
+        if (v == hash)
+            return TRUE;
+        else if (v < hash)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return FALSE;
+}
+
+krb5_error_code
+k5_pwqual_dict_hash(const char *word, size_t len, uint64_t *hash_out)
+{
+    krb5_error_code ret;
+    krb5_data d;
+    uint8_t digest[K5_SHA256_HASHLEN];
+    char *folded;
+    size_t i;
+
+    folded = k5memdup(word, len, &ret);
+    if (folded == NULL && len > 0)
+        return ret;
+    for (i = 0; i < len; i++) {
+        if (folded[i] >= 'A' && folded[i] <= 'Z')
+            folded[i] += 'a' - 'A';
+    }
+    d = make_data(folded, len);
+    ret = k5_sha256(&d, digest);
+    free(folded);
+    if (ret)
+        return ret;
+    *hash_out = load_64_be(digest);
+    return 0;
+}
+
 /*
  * Function: init-dict
  *
@@ -83,8 +183,8 @@ word_compare(const void *s1, const void *s2)
  *
  * Effects:
  *      If WORDFILE exists, it is read into memory sorted for future
- * use.  If it does not exist, it syslogs an error message and returns
- * success.
+ * use, or mapped into memory if it is a compiled dictionary.  If it
+ * does not exist, it syslogs an error message and returns success.
  *
  * Modifies:
  *      word_list to point to a chunck of allocated memory containing
@@ -96,9 +196,9 @@ word_compare(const void *s1, const void *s2)
 static int
 init_dict(dict_moddata dict, const char *dict_file)
 {
-    int fd;
+    int fd, ret;
     size_t len, i;
-    char *p, *t;
+    char *p, *t, magic[PWQUAL_DICT_MAGIC_LEN];
     struct stat sb;
 
     if (dict_file == NULL) {
@@ -121,6 +221,18 @@ init_dict(dict_moddata dict, const char *dict_file)
         close(fd);
         return errno;
     }
+    /* Map a compiled dictionary instead of reading it. */
+    if (sb.st_size >= PWQUAL_DICT_HEADER_LEN &&
+        read(fd, magic, sizeof(magic)) == sizeof(magic) &&
+        memcmp(magic, PWQUAL_DICT_MAGIC, sizeof(magic)) == 0) {
+        ret = map_dict(dict, fd, sb.st_size, dict_file);
+        close(fd);
+        return ret;
+    }
+    if (lseek(fd, 0, SEEK_SET) == -1) {
+        close(fd);
+        return errno;
+    }
     if ((dict->word_block = malloc(sb.st_size + 1)) == NULL)
         return ENOMEM;
     if (read(fd, dict->word_block, sb.st_size) != sb.st_size)
@@ -173,6 +285,8 @@ destroy_dict(dict_moddata dict)
         return;
     free(dict->word_list);
     free(dict->word_block);
+    if (dict->map != NULL)
+        munmap(dict->map, dict->map_len);
     free(dict);
     return;
 }
@@ -194,6 +308,10 @@ dict_open(krb5_context context, const char *dict_file,
     dict->word_list = NULL;
     dict->word_block = NULL;
     dict->word_count = 0;
+    dict->map = NULL;
+    dict->map_len = 0;
+    dict->hashes = NULL;
+    dict->hash_count = 0;
 
     /* Fill in the dictionary structure with data from dict_file. */
     ret = init_dict(dict, dict_file);
@@ -214,11 +332,23 @@ dict_check(krb5_context context, krb5_pwqual_moddata data,
            krb5_principal princ, const char **languages)
 {
     dict_moddata dict = (dict_moddata)data;
+    krb5_error_code ret;
+    uint64_t hash;
 
     /* Don't check the dictionary for principals with no password policy. */
     if (policy_name == NULL)
         return 0;
 
+    /* Check against the word hashes of a compiled dictionary. */
+    if (dict->hashes != NULL) {
+        ret = k5_pwqual_dict_hash(password, strlen(password), &hash);
+        if (ret)
+            return ret;
+        if (find_hash(dict->hashes, dict->hash_count, hash))
+            return KADM5_PASS_Q_DICT;
+        return 0;
+    }
+
     /* Check against words in the dictionary if we successfully loaded one. */
     if (dict->word_list != NULL &&
         bsearch(&password, dict->word_list, dict->word_count, sizeof(char *),
@@ -41,6 +41,8 @@ typedef struct _acl_op_table {
 
 typedef struct _acl_entry {
     struct _acl_entry   *ae_next;
+    struct _acl_entry   *ae_index_next; /* Next in index bucket or wild tier */
+    int                 ae_seq;         /* Position in the ACL file */
     char                *ae_name;
     krb5_boolean        ae_name_bad;
     krb5_principal      ae_principal;
@@ -77,9 +79,36 @@ typedef struct _wildstate {
 static aent_t   *acl_list_head = (aent_t *) NULL;
 static aent_t   *acl_list_tail = (aent_t *) NULL;
 
+/*
+ * Entries are compiled into an index when the ACL file is loaded.  Entries
+ * whose principal names contain no wildcards are placed in a hash table
+ * keyed by those names; the rest are placed in a separate wildcard tier.
+ * Both keep file order, so a lookup considers the caller's bucket and the
+ * wildcard tier in file order and finds the same entry as a scan of the
+ * whole list would.
+ */
+static aent_t   **acl_index = NULL;
+static unsigned int acl_index_mask = 0;
+static aent_t   *acl_wild_head = (aent_t *) NULL;
+
+/*
+ * Recent lookups are remembered in a small direct-mapped cache of the entry
+ * (or lack of one) found for a (caller, target) pair.  The entry found does
+ * not depend on the operation, so one slot answers checks for any operation
+ * mask.  The cache is emptied whenever the ACL entries are freed.
+ */
+#define ACL_CACHE_SIZE 64
+typedef struct _acl_cache_ent {
+    krb5_principal      ac_caller;
+    krb5_principal      ac_target;
+    aent_t              *ac_entry;
+} acl_cache_t;
+static acl_cache_t acl_cache[ACL_CACHE_SIZE];
+
 static const char *acl_acl_file = (char *) NULL;
 static int acl_inited = 0;
 static int acl_debug_level = 0;
+static uint64_t acl_usec = 0;     /* cumulative time in ACL checks */
 /*
  * This is the catchall entry.  If nothing else appropriate is found, or in
  * the case where the ACL file is not present, this entry controls what can
@@ -189,6 +218,8 @@ kadm5int_acl_parse_line(lp)
         acle = (aent_t *) malloc(sizeof(aent_t));
         if (acle) {
             acle->ae_next = (aent_t *) NULL;
+            acle->ae_index_next = (aent_t *) NULL;
+            acle->ae_seq = 0;
             acle->ae_op_allowed = (krb5_int32) 0;
             acle->ae_target =
                 (nmatch >= 3) ? strdup(acle_object) : (char *) NULL;
@@ -436,16 +467,30 @@ kadm5int_acl_impose_restrictions(kcontext, recp, maskp, rp)
 }
 
 /*
- * kadm5int_acl_free_entries() - Free all ACL entries.
+ * kadm5int_acl_clear_cache() - Forget all cached lookup results.
  */
 static void
-kadm5int_acl_free_entries()
+kadm5int_acl_clear_cache()
+{
+    int         i;
+
+    for (i = 0; i < ACL_CACHE_SIZE; i++) {
+        krb5_free_principal((krb5_context) NULL, acl_cache[i].ac_caller);
+        krb5_free_principal((krb5_context) NULL, acl_cache[i].ac_target);
+    }
+    memset(acl_cache, 0, sizeof(acl_cache));
+}
+
+/*
+ * kadm5int_acl_free_list()     - Free a list of ACL entries.
+ */
+static void
+kadm5int_acl_free_list(aent_t *list)
 {
     aent_t      *ap;
     aent_t      *np;
 
-    DPRINT(DEBUG_CALLS, acl_debug_level, ("* kadm5int_acl_free_entries()\n"));
-    for (ap=acl_list_head; ap; ap = np) {
+    for (ap=list; ap; ap = np) {
         if (ap->ae_name)
             free(ap->ae_name);
         if (ap->ae_principal)
@@ -464,16 +509,150 @@ kadm5int_acl_free_entries()
         np = ap->ae_next;
         free(ap);
     }
+}
+
+/*
+ * kadm5int_acl_free_entries() - Free all ACL entries.
+ */
+static void
+kadm5int_acl_free_entries()
+{
+    DPRINT(DEBUG_CALLS, acl_debug_level, ("* kadm5int_acl_free_entries()\n"));
+    kadm5int_acl_clear_cache();
+    free(acl_index);
+    acl_index = NULL;
+    acl_index_mask = 0;
+    acl_wild_head = (aent_t *) NULL;
+    kadm5int_acl_free_list(acl_list_head);
     acl_list_head = acl_list_tail = (aent_t *) NULL;
     acl_inited = 0;
     DPRINT(DEBUG_CALLS, acl_debug_level, ("X kadm5int_acl_free_entries()\n"));
 }
 
+/*
+ * kadm5int_acl_wild_data()     - Does an ACL entry component match anything?
+ *
+ * This must agree with the wildcard test in kadm5int_acl_match_data().
+ */
+static krb5_boolean
+kadm5int_acl_wild_data(const krb5_data *d)
+{
+    return d->length == 0 ||
+        (d->data[0] == '*' && (d->length == 1 || d->data[1] == '\0'));
+}
+
+/*
+ * kadm5int_acl_hash_princ()    - Hash a principal name for the ACL index.
+ *
+ * Components are compared with strncmp() when matching, so only the bytes up
+ * to a component's first null byte are hashed.
+ */
+static unsigned int
+kadm5int_acl_hash_princ(krb5_const_principal princ)
+{
+    unsigned int        h, i, n;
+    const krb5_data     *d;
+
+    h = princ->length;
+    for (n = 0; n <= (unsigned int)princ->length; n++) {
+        d = (n == 0) ? &princ->realm : &princ->data[n - 1];
+        for (i = 0; i < d->length && d->data[i] != '\0'; i++)
+            h = h * 33 + (unsigned char)d->data[i];
+        h = h * 33 + '/';
+    }
+    return h;
+}
+
+/*
+ * kadm5int_acl_compile_entry() - Parse the principals and restrictions of an
+ *                                entry, returning false if any are invalid.
+ */
+static krb5_boolean
+kadm5int_acl_compile_entry(krb5_context kcontext, aent_t *entry)
+{
+    if (strcmp(entry->ae_name, "*") &&
+        krb5_parse_name(kcontext, entry->ae_name, &entry->ae_principal)) {
+        DPRINT(DEBUG_ACL, acl_debug_level,
+               ("Bad ACL entry %s\n", entry->ae_name));
+        return FALSE;
+    }
+    if (entry->ae_target && strcmp(entry->ae_target, "*") &&
+        krb5_parse_name(kcontext, entry->ae_target,
+                        &entry->ae_target_princ)) {
+        DPRINT(DEBUG_ACL, acl_debug_level,
+               ("Bad target in ACL entry for %s\n", entry->ae_name));
+        entry->ae_target_bad = 1;
+        return FALSE;
+    }
+    if (entry->ae_restriction_string &&
+        kadm5int_acl_parse_restrictions(entry->ae_restriction_string,
+                                        &entry->ae_restrictions)) {
+        DPRINT(DEBUG_ACL, acl_debug_level,
+               ("Bad restrictions in ACL entry for %s\n", entry->ae_name));
+        entry->ae_restriction_bad = 1;
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/*
+ * kadm5int_acl_compile()       - Parse each loaded entry and build the index.
+ *                                Entries which fail to parse are marked bad
+ *                                and left out of the index.
+ */
+static int
+kadm5int_acl_compile(krb5_context kcontext)
+{
+    aent_t              *entry, **tails, **wild_tail;
+    unsigned int        size, n, b;
+    krb5_boolean        wild;
+    int                 i;
+
+    n = 0;
+    for (entry = acl_list_head; entry; entry = entry->ae_next)
+        n++;
+    for (size = 16; size < n * 2; size *= 2);
+    acl_index = calloc(size, sizeof(*acl_index));
+    tails = calloc(size, sizeof(*tails));
+    if (acl_index == NULL || tails == NULL) {
+        free(tails);
+        return 0;
+    }
+    acl_index_mask = size - 1;
+    wild_tail = &acl_wild_head;
+
+    n = 0;
+    for (entry = acl_list_head; entry; entry = entry->ae_next) {
+        entry->ae_seq = n++;
+        if (!kadm5int_acl_compile_entry(kcontext, entry)) {
+            entry->ae_name_bad = 1;
+            continue;
+        }
+        wild = (entry->ae_principal == NULL ||
+                kadm5int_acl_wild_data(&entry->ae_principal->realm));
+        for (i = 0; !wild && i < entry->ae_principal->length; i++)
+            wild = kadm5int_acl_wild_data(&entry->ae_principal->data[i]);
+        if (wild) {
+            *wild_tail = entry;
+            wild_tail = &entry->ae_index_next;
+        } else {
+            b = kadm5int_acl_hash_princ(entry->ae_principal) & acl_index_mask;
+            if (tails[b] == NULL)
+                acl_index[b] = entry;
+            else
+                tails[b]->ae_index_next = entry;
+            tails[b] = entry;
+        }
+    }
+    free(tails);
+    return 1;
+}
+
 /*
  * kadm5int_acl_load_acl_file() - Open and parse the ACL file.
  */
 static int
-kadm5int_acl_load_acl_file()
+kadm5int_acl_load_acl_file(krb5_context kcontext)
 {
     FILE        *afp;
     char        *alinep;
@@ -534,6 +713,8 @@ kadm5int_acl_load_acl_file()
         }
     }
 
+    if (retval)
+        retval = kadm5int_acl_compile(kcontext);
     if (!retval) {
         kadm5int_acl_free_entries();
     }
@@ -589,107 +770,132 @@ kadm5int_acl_match_data(const krb5_data *e1, const krb5_data *e2,
 }
 
 /*
- * kadm5int_acl_find_entry()    - Find a matching entry.
+ * kadm5int_acl_match_entry()   - Does entry apply to principal and
+ *                                dest_princ?
  */
-static aent_t *
-kadm5int_acl_find_entry(krb5_context kcontext, krb5_const_principal principal,
-                        krb5_const_principal dest_princ)
+static krb5_boolean
+kadm5int_acl_match_entry(aent_t *entry, krb5_const_principal principal,
+                         krb5_const_principal dest_princ)
 {
-    aent_t              *entry;
-    krb5_error_code     kret;
     int                 i;
     int                 matchgood;
     wildstate_t         state;
 
-    DPRINT(DEBUG_CALLS, acl_debug_level, ("* kadm5int_acl_find_entry()\n"));
-    for (entry=acl_list_head; entry; entry = entry->ae_next) {
-        memset(&state, 0, sizeof(state));
-        if (entry->ae_name_bad)
-            continue;
-        if (!strcmp(entry->ae_name, "*")) {
-            DPRINT(DEBUG_ACL, acl_debug_level, ("A wildcard ACL match\n"));
+    memset(&state, 0, sizeof(state));
+    if (entry->ae_name_bad)
+        return FALSE;
+    if (!strcmp(entry->ae_name, "*")) {
+        DPRINT(DEBUG_ACL, acl_debug_level, ("A wildcard ACL match\n"));
+        matchgood = 1;
+    }
+    else {
+        matchgood = 0;
+        if (kadm5int_acl_match_data(&entry->ae_principal->realm,
+                                    &principal->realm, 0, (wildstate_t *)0) &&
+            (entry->ae_principal->length == principal->length)) {
             matchgood = 1;
-        }
-        else {
-            if (!entry->ae_principal && !entry->ae_name_bad) {
-                kret = krb5_parse_name(kcontext,
-                                       entry->ae_name,
-                                       &entry->ae_principal);
-                if (kret)
-                    entry->ae_name_bad = 1;
-            }
-            if (entry->ae_name_bad) {
-                DPRINT(DEBUG_ACL, acl_debug_level,
-                       ("Bad ACL entry %s\n", entry->ae_name));
-                continue;
-            }
-            matchgood = 0;
-            if (kadm5int_acl_match_data(&entry->ae_principal->realm,
-                                        &principal->realm, 0, (wildstate_t *)0) &&
-                (entry->ae_principal->length == principal->length)) {
-                matchgood = 1;
-                for (i=0; i<principal->length; i++) {
-                    if (!kadm5int_acl_match_data(&entry->ae_principal->data[i],
-                                                 &principal->data[i], 0, &state)) {
-                        matchgood = 0;
-                        break;
-                    }
+            for (i=0; i<principal->length; i++) {
+                if (!kadm5int_acl_match_data(&entry->ae_principal->data[i],
+                                             &principal->data[i], 0, &state)) {
+                    matchgood = 0;
+                    break;
                 }
             }
         }
-        if (!matchgood)
-            continue;
+    }
+    if (!matchgood)
+        return FALSE;
 
-        /* We've matched the principal.  If we have a target, then try it */
-        if (entry->ae_target && strcmp(entry->ae_target, "*")) {
-            if (!entry->ae_target_princ && !entry->ae_target_bad) {
-                kret = krb5_parse_name(kcontext, entry->ae_target,
-                                       &entry->ae_target_princ);
-                if (kret)
-                    entry->ae_target_bad = 1;
-            }
-            if (entry->ae_target_bad) {
-                DPRINT(DEBUG_ACL, acl_debug_level,
-                       ("Bad target in ACL entry for %s\n", entry->ae_name));
-                entry->ae_name_bad = 1;
-                continue;
-            }
-            if (!dest_princ)
-                matchgood = 0;
-            else if (entry->ae_target_princ && dest_princ) {
-                if (kadm5int_acl_match_data(&entry->ae_target_princ->realm,
-                                            &dest_princ->realm, 1, (wildstate_t *)0) &&
-                    (entry->ae_target_princ->length == dest_princ->length)) {
-                    for (i=0; i<dest_princ->length; i++) {
-                        if (!kadm5int_acl_match_data(&entry->ae_target_princ->data[i],
-                                                     &dest_princ->data[i], 1, &state)) {
-                            matchgood = 0;
-                            break;
-                        }
-                    }
-                }
-                else
+    /* We've matched the principal.  If we have a target, then try it */
+    if (entry->ae_target && strcmp(entry->ae_target, "*")) {
+        if (!dest_princ)
+            matchgood = 0;
+        else if (kadm5int_acl_match_data(&entry->ae_target_princ->realm,
+                                         &dest_princ->realm, 1,
+                                         (wildstate_t *)0) &&
+                 (entry->ae_target_princ->length == dest_princ->length)) {
+            for (i=0; i<dest_princ->length; i++) {
+                if (!kadm5int_acl_match_data(&entry->ae_target_princ->data[i],
+                                             &dest_princ->data[i], 1, &state)) {
                     matchgood = 0;
+                    break;
+                }
             }
         }
-        if (!matchgood)
-            continue;
+        else
+            matchgood = 0;
+    }
+    return matchgood;
+}
 
-        if (entry->ae_restriction_string
-            && !entry->ae_restriction_bad
-            && !entry->ae_restrictions
-            && kadm5int_acl_parse_restrictions(entry->ae_restriction_string,
-                                               &entry->ae_restrictions)) {
-            DPRINT(DEBUG_ACL, acl_debug_level,
-                   ("Bad restrictions in ACL entry for %s\n", entry->ae_name));
-            entry->ae_restriction_bad = 1;
-        }
-        if (entry->ae_restriction_bad) {
-            entry->ae_name_bad = 1;
-            continue;
+/*
+ * kadm5int_acl_cache_slot()    - Find the cache slot for a lookup.
+ */
+static acl_cache_t *
+kadm5int_acl_cache_slot(krb5_const_principal principal,
+                        krb5_const_principal dest_princ)
+{
+    unsigned int        h;
+
+    h = kadm5int_acl_hash_princ(principal);
+    if (dest_princ)
+        h = h * 31 + kadm5int_acl_hash_princ(dest_princ);
+    return &acl_cache[h % ACL_CACHE_SIZE];
+}
+
+/*
+ * kadm5int_acl_find_entry()    - Find a matching entry.
+ */
+static aent_t *
+kadm5int_acl_find_entry(krb5_context kcontext, krb5_const_principal principal,
+                        krb5_const_principal dest_princ)
+{
+    aent_t              *entry, *lit, *wild;
+    acl_cache_t         *slot;
+
+    DPRINT(DEBUG_CALLS, acl_debug_level, ("* kadm5int_acl_find_entry()\n"));
+    slot = kadm5int_acl_cache_slot(principal, dest_princ);
+    if (slot->ac_caller &&
+        krb5_principal_compare(kcontext, slot->ac_caller, principal) &&
+        ((!slot->ac_target && !dest_princ) ||
+         (slot->ac_target && dest_princ &&
+          krb5_principal_compare(kcontext, slot->ac_target, dest_princ)))) {
+        DPRINT(DEBUG_CALLS, acl_debug_level,
+               ("X kadm5int_acl_find_entry()=%x (cached)\n", slot->ac_entry));
+        return slot->ac_entry;
+    }
+
+    /* Merge the caller's index bucket with the wildcard tier in file order,
+     * stopping at the first entry which matches. */
+    entry = NULL;
+    lit = (acl_index == NULL) ? NULL :
+        acl_index[kadm5int_acl_hash_princ(principal) & acl_index_mask];
+    wild = acl_wild_head;
+    while (lit || wild) {
+        if (!wild || (lit && lit->ae_seq < wild->ae_seq)) {
+            entry = lit;
+            lit = lit->ae_index_next;
+        } else {
+            entry = wild;
+            wild = wild->ae_index_next;
         }
-        break;
+        if (kadm5int_acl_match_entry(entry, principal, dest_princ))
+            break;
+        entry = NULL;
+    }
+
+    /* Remember the result, unless we cannot copy the names. */
+    krb5_free_principal(kcontext, slot->ac_caller);
+    krb5_free_principal(kcontext, slot->ac_target);
+    slot->ac_caller = slot->ac_target = NULL;
+    if (krb5_copy_principal(kcontext, principal, &slot->ac_caller) == 0 &&
+        dest_princ &&
+        krb5_copy_principal(kcontext, dest_princ, &slot->ac_target) != 0) {
+        krb5_free_principal(kcontext, slot->ac_caller);
+        slot->ac_caller = NULL;
     }
+    slot->ac_entry = entry;
+
     DPRINT(DEBUG_CALLS, acl_debug_level, ("X kadm5int_acl_find_entry()=%x\n",entry));
     return(entry);
 }
@@ -711,12 +917,51 @@ kadm5int_acl_init(kcontext, debug_level, acl_file)
            ("* kadm5int_acl_init(afile=%s)\n",
             ((acl_file) ? acl_file : "(null)")));
     acl_acl_file = (acl_file) ? acl_file : (char *) KRB5_DEFAULT_ADMIN_ACL;
-    acl_inited = kadm5int_acl_load_acl_file();
+    acl_inited = kadm5int_acl_load_acl_file(kcontext);
 
     DPRINT(DEBUG_CALLS, acl_debug_level, ("X kadm5int_acl_init() = %d\n", kret));
     return(kret);
 }
 
+/*
+ * kadm5int_acl_reload() - Re-read the ACL file given to kadm5int_acl_init().
+ *                         If the file cannot be loaded, the current entries
+ *                         remain in effect.  Returns nonzero on success.
+ */
+int
+kadm5int_acl_reload(kcontext)
+    krb5_context        kcontext;
+{
+    aent_t      *old_head = acl_list_head, *old_tail = acl_list_tail;
+    aent_t      **old_index = acl_index, *old_wild = acl_wild_head;
+    unsigned int old_mask = acl_index_mask;
+    int         old_inited = acl_inited;
+    int         retval;
+
+    DPRINT(DEBUG_CALLS, acl_debug_level, ("* kadm5int_acl_reload()\n"));
+    /* Load the file into an empty set of entries. */
+    kadm5int_acl_clear_cache();
+    acl_list_head = acl_list_tail = acl_wild_head = (aent_t *) NULL;
+    acl_index = NULL;
+    acl_index_mask = 0;
+    retval = kadm5int_acl_load_acl_file(kcontext);
+    if (retval) {
+        acl_inited = 1;
+        free(old_index);
+        kadm5int_acl_free_list(old_head);
+    } else {
+        acl_list_head = old_head;
+        acl_list_tail = old_tail;
+        acl_index = old_index;
+        acl_index_mask = old_mask;
+        acl_wild_head = old_wild;
+        acl_inited = old_inited;
+    }
+    DPRINT(DEBUG_CALLS, acl_debug_level,
+           ("X kadm5int_acl_reload() = %d\n", retval));
+    return(retval);
+}
+
 /*
  * kadm5int_acl_finish  - Terminate ACL context.
  */
@@ -730,16 +975,11 @@ kadm5int_acl_finish(kcontext, debug_level)
     DPRINT(DEBUG_CALLS, acl_debug_level, ("X kadm5int_acl_finish()\n"));
 }
 
-/*
- * kadm5int_acl_check_krb()     - Is this operation permitted for this principal?
- */
-krb5_boolean
-kadm5int_acl_check_krb(kcontext, caller_princ, opmask, principal, restrictions)
-    krb5_context         kcontext;
-    krb5_const_principal caller_princ;
-    krb5_int32           opmask;
-    krb5_const_principal principal;
-    restriction_t        **restrictions;
+/* Determine whether caller_princ may perform opmask on principal. */
+static krb5_boolean
+acl_op_permitted(krb5_context kcontext, krb5_const_principal caller_princ,
+                 krb5_int32 opmask, krb5_const_principal principal,
+                 restriction_t **restrictions)
 {
     krb5_boolean        retval;
     aent_t              *aentry;
@@ -766,6 +1006,27 @@ kadm5int_acl_check_krb(kcontext, caller_princ, opmask, principal, restrictions)
     return retval;
 }
 
+/*
+ * kadm5int_acl_check_krb()     - Is this operation permitted for this principal?
+ */
+krb5_boolean
+kadm5int_acl_check_krb(kcontext, caller_princ, opmask, principal, restrictions)
+    krb5_context         kcontext;
+    krb5_const_principal caller_princ;
+    krb5_int32           opmask;
+    krb5_const_principal principal;
+    restriction_t        **restrictions;
+{
+    krb5_boolean        retval;
+    uint64_t            start;
+
+    start = k5_monotonic_usec();
+    retval = acl_op_permitted(kcontext, caller_princ, opmask, principal,
+                              restrictions);
+    acl_usec += k5_monotonic_usec() - start;
+    return retval;
+}
+
 /*
  * kadm5int_acl_check() - Is this operation permitted for this principal?
  *                      this code used not to be based on gssapi.  In order
@@ -788,9 +1049,12 @@ kadm5int_acl_check(kcontext, caller, opmask, principal, restrictions)
     OM_uint32           emin;
     krb5_error_code     code;
     krb5_principal      caller_princ;
+    uint64_t            start;
 
+    start = k5_monotonic_usec();
+    retval = FALSE;
     if (GSS_ERROR(gss_display_name(&emin, caller, &caller_buf, &caller_oid)))
-        return FALSE;
+        goto done;
 
     code = krb5_parse_name(kcontext, (char *) caller_buf.value,
                            &caller_princ);
@@ -798,16 +1062,25 @@ kadm5int_acl_check(kcontext, caller, opmask, principal, restrictions)
     gss_release_buffer(&emin, &caller_buf);
 
     if (code != 0)
-        return FALSE;
+        goto done;
 
-    retval = kadm5int_acl_check_krb(kcontext, caller_princ,
-                                    opmask, principal, restrictions);
+    retval = acl_op_permitted(kcontext, caller_princ, opmask, principal,
+                              restrictions);
 
     krb5_free_principal(kcontext, caller_princ);
 
+done:
+    acl_usec += k5_monotonic_usec() - start;
     return retval;
 }
 
+/* Return the cumulative time spent in ACL checks, in microseconds. */
+uint64_t
+kadm5int_acl_usec(void)
+{
+    return acl_usec;
+}
+
 kadm5_ret_t
 kadm5_get_privs(void *server_handle, long *privs)
 {
@@ -83,6 +83,7 @@ typedef struct _restriction {
 
 krb5_error_code kadm5int_acl_init(krb5_context, int, char *);
 void kadm5int_acl_finish(krb5_context, int);
+int kadm5int_acl_reload(krb5_context);
 krb5_boolean kadm5int_acl_check(krb5_context,
                                 gss_name_t,
                                 krb5_int32,
@@ -97,4 +98,5 @@ krb5_error_code kadm5int_acl_impose_restrictions(krb5_context,
                                                  kadm5_principal_ent_rec *,
                                                  long *,
                                                  restriction_t *);
+uint64_t kadm5int_acl_usec(void);
 #endif  /* SERVER_ACL_H__ */
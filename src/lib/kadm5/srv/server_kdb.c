@@ -258,11 +258,14 @@ kdb_get_entry(kadm5_server_handle_t handle,
     krb5_tl_data tl_data;
     XDR xdrs;
     krb5_db_entry *kdb;
+    uint64_t start;
 
     *kdb_ptr = NULL;
 
+    start = k5_monotonic_usec();
     ret = krb5_db_get_principal(handle->context, principal,
                                 KRB5_KDB_FLAG_ALIAS_OK, &kdb);
+    handle->phase_usec[KADM5_PHASE_KDB] += k5_monotonic_usec() - start;
     if (ret == KRB5_KDB_NOENTRY)
         return(KADM5_UNK_PRINC);
     if (ret)
@@ -365,6 +368,7 @@ kdb_put_entry(kadm5_server_handle_t handle,
     krb5_int32 now;
     XDR xdrs;
     krb5_tl_data tl_data;
+    uint64_t start;
 
     ret = krb5_timeofday(handle->context, &now);
     if (ret)
@@ -394,7 +398,9 @@ kdb_put_entry(kadm5_server_handle_t handle,
     /* we are always updating TL data */
     kdb->mask |= KADM5_TL_DATA;
 
+    start = k5_monotonic_usec();
     ret = krb5_db_put_principal(handle->context, kdb);
+    handle->phase_usec[KADM5_PHASE_KDB] += k5_monotonic_usec() - start;
     if (ret)
         return(ret);
 
@@ -405,13 +411,29 @@ krb5_error_code
 kdb_delete_entry(kadm5_server_handle_t handle, krb5_principal name)
 {
     krb5_error_code ret;
+    uint64_t start;
 
+    start = k5_monotonic_usec();
     ret = krb5_db_delete_principal(handle->context, name);
+    handle->phase_usec[KADM5_PHASE_KDB] += k5_monotonic_usec() - start;
     if (ret == KRB5_KDB_NOENTRY)
         ret = 0;
     return ret;
 }
 
+/* Commit a transaction begun with krb5_db_begin_txn(). */
+krb5_error_code
+kdb_commit_txn(kadm5_server_handle_t handle)
+{
+    krb5_error_code ret;
+    uint64_t start;
+
+    start = k5_monotonic_usec();
+    ret = krb5_db_commit_txn(handle->context);
+    handle->phase_usec[KADM5_PHASE_KDB] += k5_monotonic_usec() - start;
+    return ret;
+}
+
 typedef struct _iter_data {
     void (*func)(void *, krb5_principal);
     void *data;
@@ -101,11 +101,9 @@ check_against_policy(kadm5_server_handle_t handle, const char *password,
     return KADM5_OK;
 }
 
-/* Check a password against all available password quality plugin modules
- * and against policy. */
-kadm5_ret_t
-passwd_check(kadm5_server_handle_t handle, const char *password,
-             kadm5_policy_ent_t policy, krb5_principal princ)
+static kadm5_ret_t
+check_password(kadm5_server_handle_t handle, const char *password,
+               kadm5_policy_ent_t policy, krb5_principal princ)
 {
     krb5_error_code ret;
     pwqual_handle *h;
@@ -136,6 +134,21 @@ passwd_check(kadm5_server_handle_t handle, const char *password,
     return 0;
 }
 
+/* Check a password against all available password quality plugin modules
+ * and against policy. */
+kadm5_ret_t
+passwd_check(kadm5_server_handle_t handle, const char *password,
+             kadm5_policy_ent_t policy, krb5_principal princ)
+{
+    kadm5_ret_t ret;
+    uint64_t start;
+
+    start = k5_monotonic_usec();
+    ret = check_password(handle, password, policy, princ);
+    handle->phase_usec[KADM5_PHASE_PWQUAL] += k5_monotonic_usec() - start;
+    return ret;
+}
+
 void
 destroy_pwqual(kadm5_server_handle_t handle)
 {
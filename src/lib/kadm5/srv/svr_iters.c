@@ -35,6 +35,9 @@ struct iter_data {
     int n_names, sz_names;
     unsigned int malloc_failed;
     char *exp;
+    int max;                    /* Page size, for paged listing */
+    char *after;                /* Names must sort after this one, if set */
+    krb5_boolean more;          /* More names follow the page */
 #ifdef SOLARIS_REGEXPS
     char *expbuf;
 #endif
@@ -127,34 +130,44 @@ static kadm5_ret_t glob_to_regexp(char *glob, char *realm, char **regexp)
     return KADM5_OK;
 }
 
-static void get_either_iter(struct iter_data *data, char *name)
+/* Return true if name matches the compiled expression in data. */
+static int name_matches(struct iter_data *data, char *name)
 {
-    int match;
 #ifdef SOLARIS_REGEXPS
-    match = (step(name, data->expbuf) != 0);
+    return (step(name, data->expbuf) != 0);
 #endif
 #ifdef POSIX_REGEXPS
-    match = (regexec(&data->preg, name, 0, NULL, 0) == 0);
+    return (regexec(&data->preg, name, 0, NULL, 0) == 0);
 #endif
 #ifdef BSD_REGEXPS
-    match = (re_exec(name) != 0);
+    return (re_exec(name) != 0);
 #endif
-    if (match) {
-        if (data->n_names == data->sz_names) {
-            int new_sz = data->sz_names * 2;
-            char **new_names = realloc(data->names,
-                                       new_sz * sizeof(char *));
-            if (new_names) {
-                data->names = new_names;
-                data->sz_names = new_sz;
-            } else {
-                data->malloc_failed = 1;
-                free(name);
-                return;
-            }
-        }
+}
+
+/* Make room for one more name in data->names. */
+static int grow_names(struct iter_data *data)
+{
+    int new_sz;
+    char **new_names;
+
+    if (data->n_names < data->sz_names)
+        return 1;
+    new_sz = data->sz_names * 2;
+    new_names = realloc(data->names, new_sz * sizeof(char *));
+    if (new_names == NULL) {
+        data->malloc_failed = 1;
+        return 0;
+    }
+    data->names = new_names;
+    data->sz_names = new_sz;
+    return 1;
+}
+
+static void get_either_iter(struct iter_data *data, char *name)
+{
+    if (name_matches(data, name) && grow_names(data))
         data->names[data->n_names++] = name;
-    } else
+    else
         free(name);
 }
 
@@ -261,6 +274,193 @@ kadm5_ret_t kadm5_get_principals(void *server_handle,
     return kadm5_get_either(1, server_handle, exp, princs, count);
 }
 
+/* Returned by page iteration callbacks to stop once a page is full. */
+#define PAGE_FULL (-1)
+
+/* Add the name of entry to a page of names collected in database key order,
+ * stopping at the first match beyond the page. */
+static int get_page_iter(krb5_pointer ptr, krb5_db_entry *entry)
+{
+    struct iter_data *data = ptr;
+    char *name;
+    krb5_error_code ret;
+
+    ret = krb5_unparse_name(data->context, entry->princ, &name);
+    if (ret)
+        return ret;
+    if (!name_matches(data, name)) {
+        free(name);
+        return 0;
+    }
+    if (data->n_names == data->max) {
+        data->more = TRUE;
+        free(name);
+        return PAGE_FULL;
+    }
+    if (!grow_names(data)) {
+        free(name);
+        return ENOMEM;
+    }
+    data->names[data->n_names++] = name;
+    return 0;
+}
+
+/*
+ * For a database module which cannot iterate in key order, keep the first
+ * data->max matching names after data->after in a sorted page.  This visits
+ * the whole database for each page, but the reply stays bounded.
+ */
+static void get_page_sorted_iter(void *ptr, krb5_principal princ)
+{
+    struct iter_data *data = ptr;
+    char *name;
+    int lo, hi, mid;
+
+    if (data->malloc_failed)
+        return;
+    if (krb5_unparse_name(data->context, princ, &name) != 0)
+        return;
+    if ((data->after != NULL && strcmp(name, data->after) <= 0) ||
+        !name_matches(data, name)) {
+        free(name);
+        return;
+    }
+
+    lo = 0;
+    hi = data->n_names;
+    while (lo < hi) {
+        mid = (lo + hi) / 2;
+        if (strcmp(data->names[mid], name) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (data->n_names == data->max) {
+        data->more = TRUE;
+        if (lo == data->max) {
+            free(name);
+            return;
+        }
+        free(data->names[--data->n_names]);
+    }
+    if (!grow_names(data)) {
+        free(name);
+        return;
+    }
+    memmove(data->names + lo + 1, data->names + lo,
+            (data->n_names - lo) * sizeof(char *));
+    data->names[lo] = name;
+    data->n_names++;
+}
+
+kadm5_ret_t kadm5_get_principals_page(void *server_handle,
+                                      char *exp,
+                                      char *cursor,
+                                      int max,
+                                      char ***princs,
+                                      int *count,
+                                      char **cursor_out)
+{
+    struct iter_data data;
+#ifdef BSD_REGEXPS
+    char *msg;
+#endif
+    char *regexp = NULL;
+    int i;
+    krb5_principal start = NULL;
+    kadm5_ret_t ret;
+    kadm5_server_handle_t handle = server_handle;
+
+    if (princs == NULL || count == NULL || cursor_out == NULL)
+        return EINVAL;
+    *princs = NULL;
+    *count = 0;
+    *cursor_out = NULL;
+    if (exp == NULL)
+        exp = "*";
+
+    CHECK_HANDLE(server_handle);
+
+    if (max <= 0)
+        return EINVAL;
+    if (cursor != NULL) {
+        ret = krb5_parse_name(handle->context, cursor, &start);
+        if (ret)
+            return ret;
+    }
+
+    ret = glob_to_regexp(exp, handle->params.realm, &regexp);
+    if (ret) {
+        krb5_free_principal(handle->context, start);
+        return ret;
+    }
+
+    if (
+#ifdef SOLARIS_REGEXPS
+        ((data.expbuf = compile(regexp, NULL, NULL)) == NULL)
+#endif
+#ifdef POSIX_REGEXPS
+        ((regcomp(&data.preg, regexp, REG_NOSUB)) != 0)
+#endif
+#ifdef BSD_REGEXPS
+        ((msg = (char *) re_comp(regexp)) != NULL)
+#endif
+    )
+    {
+        free(regexp);
+        krb5_free_principal(handle->context, start);
+        return EINVAL;
+    }
+
+    data.context = handle->context;
+    data.n_names = 0;
+    data.sz_names = 10;
+    data.malloc_failed = 0;
+    data.max = max;
+    data.after = cursor;
+    data.more = FALSE;
+    data.names = malloc(sizeof(char *) * data.sz_names);
+    if (data.names == NULL) {
+        ret = ENOMEM;
+        goto cleanup;
+    }
+
+    /* Each page is a separate iteration, seeking past the cursor, so the
+     * database is only locked while one page is collected. */
+    ret = krb5_db_iterate_after(handle->context, exp, start, get_page_iter,
+                                &data);
+    if (ret == KRB5_PLUGIN_OP_NOTSUPP) {
+        data.more = FALSE;
+        ret = kdb_iter_entry(handle, exp, get_page_sorted_iter, &data);
+    } else if (ret == PAGE_FULL) {
+        ret = 0;
+    }
+    if (!ret && data.malloc_failed)
+        ret = ENOMEM;
+    if (!ret && data.more) {
+        *cursor_out = strdup(data.names[data.n_names - 1]);
+        if (*cursor_out == NULL)
+            ret = ENOMEM;
+    }
+    if (ret) {
+        for (i = 0; i < data.n_names; i++)
+            free(data.names[i]);
+        free(data.names);
+        goto cleanup;
+    }
+
+    *princs = data.names;
+    *count = data.n_names;
+
+cleanup:
+    free(regexp);
+#ifdef POSIX_REGEXPS
+    regfree(&data.preg);
+#endif
+    krb5_free_principal(handle->context, start);
+    return ret;
+}
+
 kadm5_ret_t kadm5_get_policies(void *server_handle,
                                char *exp,
                                char ***pols,
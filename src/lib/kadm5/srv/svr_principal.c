@@ -552,9 +552,8 @@ kadm5_create_principal_3(void *server_handle,
     if (ret)
         goto cleanup;
 
-    ret = k5_kadm5_hook_create(handle->context, handle->hook_handles,
-                               KADM5_HOOK_STAGE_PRECOMMIT, entry, mask,
-                               new_n_ks_tuple, new_ks_tuple, password);
+    ret = k5_kadm5_hook_create(handle, KADM5_HOOK_STAGE_PRECOMMIT, entry,
+                               mask, new_n_ks_tuple, new_ks_tuple, password);
     if (ret)
         goto cleanup;
 
@@ -580,9 +579,8 @@ kadm5_create_principal_3(void *server_handle,
     /* store the new db entry */
     ret = kdb_put_entry(handle, kdb, &adb);
 
-    (void) k5_kadm5_hook_create(handle->context, handle->hook_handles,
-                                KADM5_HOOK_STAGE_POSTCOMMIT, entry, mask,
-                                new_n_ks_tuple, new_ks_tuple, password);
+    (void) k5_kadm5_hook_create(handle, KADM5_HOOK_STAGE_POSTCOMMIT, entry,
+                                mask, new_n_ks_tuple, new_ks_tuple, password);
 
 cleanup:
     free(new_ks_tuple);
@@ -610,8 +608,7 @@ kadm5_delete_principal(void *server_handle, krb5_principal principal)
 
     if ((ret = kdb_get_entry(handle, principal, &kdb, &adb)))
         return(ret);
-    ret = k5_kadm5_hook_remove(handle->context, handle->hook_handles,
-                               KADM5_HOOK_STAGE_PRECOMMIT, principal);
+    ret = k5_kadm5_hook_remove(handle, KADM5_HOOK_STAGE_PRECOMMIT, principal);
     if (ret) {
         kdb_free_entry(handle, kdb, &adb);
         return ret;
@@ -622,9 +619,8 @@ kadm5_delete_principal(void *server_handle, krb5_principal principal)
     kdb_free_entry(handle, kdb, &adb);
 
     if (ret == 0)
-        (void) k5_kadm5_hook_remove(handle->context,
-                                    handle->hook_handles,
-                                    KADM5_HOOK_STAGE_POSTCOMMIT, principal);
+        (void) k5_kadm5_hook_remove(handle, KADM5_HOOK_STAGE_POSTCOMMIT,
+                                    principal);
 
     return ret;
 }
@@ -756,15 +752,15 @@ kadm5_modify_principal(void *server_handle,
     /* let the mask propagate to the database provider */
     kdb->mask = mask;
 
-    ret = k5_kadm5_hook_modify(handle->context, handle->hook_handles,
-                               KADM5_HOOK_STAGE_PRECOMMIT, entry, mask);
+    ret = k5_kadm5_hook_modify(handle, KADM5_HOOK_STAGE_PRECOMMIT, entry,
+                               mask);
     if (ret)
         goto done;
 
     ret = kdb_put_entry(handle, kdb, &adb);
     if (ret) goto done;
-    (void) k5_kadm5_hook_modify(handle->context, handle->hook_handles,
-                                KADM5_HOOK_STAGE_POSTCOMMIT, entry, mask);
+    (void) k5_kadm5_hook_modify(handle, KADM5_HOOK_STAGE_POSTCOMMIT, entry,
+                                mask);
 
     ret = KADM5_OK;
 done:
@@ -839,16 +835,16 @@ kadm5_rename_principal(void *server_handle,
         goto done;
     }
 
-    ret = k5_kadm5_hook_rename(handle->context, handle->hook_handles,
-                               KADM5_HOOK_STAGE_PRECOMMIT, source, target);
+    ret = k5_kadm5_hook_rename(handle, KADM5_HOOK_STAGE_PRECOMMIT, source,
+                               target);
     if (ret)
         goto done;
 
     if ((ret = kdb_put_entry(handle, kdb, &adb)))
         goto done;
 
-    (void) k5_kadm5_hook_rename(handle->context, handle->hook_handles,
-                                KADM5_HOOK_STAGE_POSTCOMMIT, source, target);
+    (void) k5_kadm5_hook_rename(handle, KADM5_HOOK_STAGE_POSTCOMMIT, source,
+                                target);
 
     ret = kdb_delete_entry(handle, source);
 
@@ -1615,17 +1611,16 @@ kadm5_chpass_principal_3(void *server_handle,
     if (hist_added)
         kdb->mask |= KADM5_KEY_HIST;
 
-    ret = k5_kadm5_hook_chpass(handle->context, handle->hook_handles,
-                               KADM5_HOOK_STAGE_PRECOMMIT, principal, keepold,
-                               new_n_ks_tuple, new_ks_tuple, password);
+    ret = k5_kadm5_hook_chpass(handle, KADM5_HOOK_STAGE_PRECOMMIT, principal,
+                               keepold, new_n_ks_tuple, new_ks_tuple,
+                               password);
     if (ret)
         goto done;
 
     if ((ret = kdb_put_entry(handle, kdb, &adb)))
         goto done;
 
-    (void) k5_kadm5_hook_chpass(handle->context, handle->hook_handles,
-                                KADM5_HOOK_STAGE_POSTCOMMIT, principal,
+    (void) k5_kadm5_hook_chpass(handle, KADM5_HOOK_STAGE_POSTCOMMIT, principal,
                                 keepold, new_n_ks_tuple, new_ks_tuple, password);
     ret = KADM5_OK;
 done:
@@ -1770,16 +1765,14 @@ kadm5_randkey_principal_3(void *server_handle,
     kdb->mask = KADM5_KEY_DATA | KADM5_FAIL_AUTH_COUNT;
     /* | KADM5_RANDKEY_USED */;
 
-    ret = k5_kadm5_hook_chpass(handle->context, handle->hook_handles,
-                               KADM5_HOOK_STAGE_PRECOMMIT, principal, keepold,
-                               new_n_ks_tuple, new_ks_tuple, NULL);
+    ret = k5_kadm5_hook_chpass(handle, KADM5_HOOK_STAGE_PRECOMMIT, principal,
+                               keepold, new_n_ks_tuple, new_ks_tuple, NULL);
     if (ret)
         goto done;
     if ((ret = kdb_put_entry(handle, kdb, &adb)))
         goto done;
 
-    (void) k5_kadm5_hook_chpass(handle->context, handle->hook_handles,
-                                KADM5_HOOK_STAGE_POSTCOMMIT, principal,
+    (void) k5_kadm5_hook_chpass(handle, KADM5_HOOK_STAGE_POSTCOMMIT, principal,
                                 keepold, new_n_ks_tuple, new_ks_tuple, NULL);
     ret = KADM5_OK;
 done:
@@ -2500,3 +2493,150 @@ done:
     kdb_free_entry(handle, kdb, &adb);
     return ret;
 }
+
+/*
+ * Each batch operation runs in a single database transaction, so that the
+ * database lock is taken and the update log is synced once for the whole
+ * batch.
+ */
+
+kadm5_ret_t
+kadm5_create_principals(void *server_handle, kadm5_principal_ent_t ents,
+                        int n_ents, long mask, int n_ks_tuple,
+                        krb5_key_salt_tuple *ks_tuple, char *pass,
+                        kadm5_ret_t *results)
+{
+    kadm5_server_handle_t handle = server_handle;
+    kadm5_ret_t ret;
+    int i;
+
+    CHECK_HANDLE(server_handle);
+    if (n_ents < 0 || (n_ents > 0 && (ents == NULL || results == NULL)))
+        return EINVAL;
+
+    ret = krb5_db_begin_txn(handle->context);
+    if (ret)
+        return ret;
+    for (i = 0; i < n_ents; i++) {
+        results[i] = kadm5_create_principal_3(handle, &ents[i], mask,
+                                              n_ks_tuple, ks_tuple, pass);
+    }
+    return kdb_commit_txn(handle);
+}
+
+/* Apply set_attrs and clear_attrs to the current attributes of ent's
+ * principal, placing the result in ent. */
+static kadm5_ret_t
+change_attrs(kadm5_server_handle_t handle, kadm5_principal_ent_t ent,
+             krb5_flags set_attrs, krb5_flags clear_attrs)
+{
+    krb5_db_entry *kdb;
+    osa_princ_ent_rec adb;
+    kadm5_ret_t ret;
+
+    ret = kdb_get_entry(handle, ent->principal, &kdb, &adb);
+    if (ret)
+        return ret;
+    ent->attributes = (kdb->attributes | set_attrs) & ~clear_attrs;
+    kdb_free_entry(handle, kdb, &adb);
+    return 0;
+}
+
+kadm5_ret_t
+kadm5_modify_principals(void *server_handle, kadm5_principal_ent_t ents,
+                        int n_ents, long mask, krb5_flags set_attrs,
+                        krb5_flags clear_attrs, kadm5_ret_t *results)
+{
+    kadm5_server_handle_t handle = server_handle;
+    kadm5_principal_ent_rec ent;
+    kadm5_ret_t ret;
+    int i;
+
+    CHECK_HANDLE(server_handle);
+    if (n_ents < 0 || (n_ents > 0 && (ents == NULL || results == NULL)))
+        return EINVAL;
+
+    ret = krb5_db_begin_txn(handle->context);
+    if (ret)
+        return ret;
+    for (i = 0; i < n_ents; i++) {
+        ent = ents[i];
+        if (mask & KADM5_ATTRIBUTES) {
+            results[i] = change_attrs(handle, &ent, set_attrs, clear_attrs);
+            if (results[i])
+                continue;
+        }
+        results[i] = kadm5_modify_principal(handle, &ent, mask);
+    }
+    return kdb_commit_txn(handle);
+}
+
+kadm5_ret_t
+kadm5_randkey_principals(void *server_handle, krb5_principal *princs,
+                         int n_princs, krb5_boolean keepold, int n_ks_tuple,
+                         krb5_key_salt_tuple *ks_tuple, kadm5_ret_t *results)
+{
+    kadm5_server_handle_t handle = server_handle;
+    kadm5_ret_t ret;
+    int i;
+
+    CHECK_HANDLE(server_handle);
+    if (n_princs < 0 || (n_princs > 0 && (princs == NULL || results == NULL)))
+        return EINVAL;
+
+    ret = krb5_db_begin_txn(handle->context);
+    if (ret)
+        return ret;
+    for (i = 0; i < n_princs; i++) {
+        results[i] = kadm5_randkey_principal_3(handle, princs[i], keepold,
+                                               n_ks_tuple, ks_tuple, NULL,
+                                               NULL);
+    }
+    return kdb_commit_txn(handle);
+}
+
+kadm5_ret_t
+kadm5_setkey_principals(void *server_handle, krb5_principal *princs,
+                        int n_princs, krb5_boolean keepold,
+                        kadm5_key_data **key_data, int *n_key_data,
+                        kadm5_ret_t *results)
+{
+    kadm5_server_handle_t handle = server_handle;
+    kadm5_ret_t ret;
+    int i;
+
+    CHECK_HANDLE(server_handle);
+    if (n_princs < 0 || (n_princs > 0 &&
+                         (princs == NULL || key_data == NULL ||
+                          n_key_data == NULL || results == NULL)))
+        return EINVAL;
+
+    ret = krb5_db_begin_txn(handle->context);
+    if (ret)
+        return ret;
+    for (i = 0; i < n_princs; i++) {
+        results[i] = kadm5_setkey_principal_4(handle, princs[i], keepold,
+                                              key_data[i], n_key_data[i]);
+    }
+    return kdb_commit_txn(handle);
+}
+
+kadm5_ret_t
+kadm5_delete_principals(void *server_handle, krb5_principal *princs,
+                        int n_princs, kadm5_ret_t *results)
+{
+    kadm5_server_handle_t handle = server_handle;
+    kadm5_ret_t ret;
+    int i;
+
+    CHECK_HANDLE(server_handle);
+    if (n_princs < 0 || (n_princs > 0 && (princs == NULL || results == NULL)))
+        return EINVAL;
+
+    ret = krb5_db_begin_txn(handle->context);
+    if (ret)
+        return ret;
+    for (i = 0; i < n_princs; i++)
+        results[i] = kadm5_delete_principal(handle, princs[i]);
+    return kdb_commit_txn(handle);
+}
@@ -239,5 +239,12 @@ program KRB5_IPROP_PROG {
 		 */
 		kdb_fullresync_result_t
 		IPROP_FULL_RESYNC_EXT(uint32_t) = 3;
+
+		/*
+		 * Resync from the given serial number/timestamp with a delta
+		 * dump, after the master's ulog has wrapped past it
+		 */
+		kdb_fullresync_result_t
+		IPROP_DELTA_RESYNC(kdb_last_t) = 4;
 	} = 1;
 } = 100423;
@@ -740,6 +740,96 @@ krb5_db_unlock(krb5_context kcontext)
     return v->unlock(kcontext);
 }
 
+/*
+ * Begin a write transaction.  Puts and deletes until the matching
+ * krb5_db_commit_txn() or krb5_db_abort_txn() may be batched by the module,
+ * and are recorded in the update log as one group which is synced to disk
+ * after the module has committed the transaction.  If the transaction is
+ * aborted or the commit fails, any updates logged during it are discarded by
+ * resetting the update log.
+ */
+krb5_error_code
+krb5_db_begin_txn(krb5_context kcontext)
+{
+    krb5_error_code status = 0;
+    kdb_vftabl *v;
+
+    status = get_vftabl(kcontext, &v);
+    if (status)
+        return status;
+    if (kcontext->dal_handle->in_txn) {
+        k5_setmsg(kcontext, EINVAL,
+                  _("A database transaction is already in progress"));
+        return EINVAL;
+    }
+
+    if (v->begin_txn != NULL) {
+        status = v->begin_txn(kcontext);
+        if (status)
+            return status;
+    }
+
+    /* The database must be locked before the ulog. */
+    if (logging(kcontext)) {
+        status = ulog_begin_group(kcontext);
+        if (status) {
+            if (v->abort_txn != NULL)
+                (void)v->abort_txn(kcontext);
+            return status;
+        }
+    }
+
+    kcontext->dal_handle->in_txn = TRUE;
+    return 0;
+}
+
+/* End the current transaction, using the module method fn if it is set.  The
+ * module finishes the transaction before the ulog group is synced, so that the
+ * ulog never describes changes the database did not take. */
+static krb5_error_code
+end_txn(krb5_context kcontext, krb5_error_code (*fn)(krb5_context kcontext),
+        krb5_boolean commit)
+{
+    krb5_error_code status;
+
+    if (!kcontext->dal_handle->in_txn)
+        return EINVAL;
+    kcontext->dal_handle->in_txn = FALSE;
+
+    status = (fn == NULL) ? 0 : fn(kcontext);
+    if (logging(kcontext)) {
+        if (commit && status == 0)
+            ulog_end_group(kcontext);
+        else
+            ulog_abort_group(kcontext);
+    }
+    return status;
+}
+
+krb5_error_code
+krb5_db_commit_txn(krb5_context kcontext)
+{
+    krb5_error_code status = 0;
+    kdb_vftabl *v;
+
+    status = get_vftabl(kcontext, &v);
+    if (status)
+        return status;
+    return end_txn(kcontext, v->commit_txn, TRUE);
+}
+
+krb5_error_code
+krb5_db_abort_txn(krb5_context kcontext)
+{
+    krb5_error_code status = 0;
+    kdb_vftabl *v;
+
+    status = get_vftabl(kcontext, &v);
+    if (status)
+        return status;
+    return end_txn(kcontext, v->abort_txn, FALSE);
+}
+
 krb5_error_code
 krb5_db_get_principal(krb5_context kcontext, krb5_const_principal search_for,
                       unsigned int flags, krb5_db_entry **entry)
@@ -994,6 +1084,28 @@ krb5_db_iterate(krb5_context kcontext, char *match_entry,
                       &proxy_args, iterflags);
 }
 
+krb5_error_code
+krb5_db_iterate_after(krb5_context kcontext, char *match_entry,
+                      krb5_const_principal start,
+                      int (*func)(krb5_pointer, krb5_db_entry *),
+                      krb5_pointer func_arg)
+{
+    krb5_error_code status = 0;
+    kdb_vftabl *v;
+    struct callback_proxy_args proxy_args;
+
+    status = get_vftabl(kcontext, &v);
+    if (status)
+        return status;
+    if (v->iterate_after == NULL)
+        return KRB5_PLUGIN_OP_NOTSUPP;
+
+    proxy_args.func = func;
+    proxy_args.func_arg = func_arg;
+    return v->iterate_after(kcontext, match_entry, start,
+                            sort_entry_callback_proxy, &proxy_args);
+}
+
 /* Return a read only pointer alias to mkey list.  Do not free this! */
 krb5_keylist_node *
 krb5_db_mkey_list_alias(krb5_context kcontext)
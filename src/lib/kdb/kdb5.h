@@ -32,6 +32,7 @@ struct _kdb5_dal_handle
     db_library lib_handle;
     krb5_keylist_node *master_keylist;
     krb5_principal master_princ;
+    krb5_boolean in_txn;
 };
 /* typedef kdb5_dal_handle is in k5-int.h now */
 
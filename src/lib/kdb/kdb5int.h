@@ -37,4 +37,13 @@ krb5_error_code
 krb5int_delete_principal_no_log(krb5_context kcontext,
                                 krb5_principal search_for);
 
+krb5_error_code
+ulog_begin_group(krb5_context context);
+
+void
+ulog_end_group(krb5_context context);
+
+void
+ulog_abort_group(krb5_context context);
+
 #endif /* __KDB5INT_H__ */
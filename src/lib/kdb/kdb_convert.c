@@ -573,25 +573,22 @@ ulog_conv_2logentry(krb5_context context, krb5_db_entry *entry,
     return (0);
 }
 
-/* Convert an update log (ulog) entry into a kerberos record. */
-krb5_error_code
-ulog_conv_2dbentry(krb5_context context, krb5_db_entry **entry,
-                   kdb_incr_update_t *update)
+/*
+ * Apply the attributes in update to ent.  If is_add is true, ent is a newly
+ * allocated entry with no prior contents.
+ */
+static krb5_error_code
+apply_update(krb5_context context, krb5_db_entry *ent, krb5_boolean is_add,
+             kdb_incr_update_t *update)
 {
-    krb5_db_entry *ent;
     int slave;
     krb5_principal mod_princ = NULL;
     int i, j, cnt = 0, mod_time = 0, nattrs;
-    krb5_principal dbprinc;
-    char *dbprincstr = NULL;
     krb5_tl_data newtl;
     krb5_error_code ret;
     unsigned int prev_n_keys = 0;
-    krb5_boolean is_add;
     void *newptr;
 
-    *entry = NULL;
-
     slave = (context->kdblog_context != NULL) &&
         (context->kdblog_context->iproprole == IPROP_SLAVE);
 
@@ -600,36 +597,6 @@ ulog_conv_2dbentry(krb5_context context, krb5_db_entry **entry,
      */
     nattrs = update->kdb_update.kdbe_t_len;
 
-    dbprincstr = malloc((update->kdb_princ_name.utf8str_t_len + 1)
-                        * sizeof (char));
-    if (dbprincstr == NULL)
-        return (ENOMEM);
-    strncpy(dbprincstr, (char *)update->kdb_princ_name.utf8str_t_val,
-            update->kdb_princ_name.utf8str_t_len);
-    dbprincstr[update->kdb_princ_name.utf8str_t_len] = 0;
-
-    ret = krb5_parse_name(context, dbprincstr, &dbprinc);
-    free(dbprincstr);
-    if (ret)
-        return (ret);
-
-    ret = krb5_db_get_principal(context, dbprinc, 0, &ent);
-    krb5_free_principal(context, dbprinc);
-    if (ret && ret != KRB5_KDB_NOENTRY)
-        return (ret);
-    is_add = (ret == KRB5_KDB_NOENTRY);
-
-    /*
-     * Set ent->n_tl_data = 0 initially, if this is an ADD update
-     */
-    if (is_add) {
-        ent = krb5_db_alloc(context, NULL, sizeof(*ent));
-        if (ent == NULL)
-            return (ENOMEM);
-        memset(ent, 0, sizeof(*ent));
-        ent->n_tl_data = 0;
-    }
-
     for (i = 0; i < nattrs; i++) {
         krb5_principal tmpprinc = NULL;
 
@@ -778,10 +745,94 @@ ulog_conv_2dbentry(krb5_context context, krb5_db_entry **entry,
             return (ret);
     }
 
+    return (0);
+}
+
+/* Allocate an empty entry for an ADD update. */
+static krb5_error_code
+new_entry(krb5_context context, krb5_db_entry **entry)
+{
+    krb5_db_entry *ent;
+
+    *entry = NULL;
+    ent = krb5_db_alloc(context, NULL, sizeof(*ent));
+    if (ent == NULL)
+        return (ENOMEM);
+    memset(ent, 0, sizeof(*ent));
+    *entry = ent;
+    return (0);
+}
+
+/* Convert an update log (ulog) entry into a kerberos record. */
+krb5_error_code
+ulog_conv_2dbentry(krb5_context context, krb5_db_entry **entry,
+                   kdb_incr_update_t *update)
+{
+    krb5_db_entry *ent;
+    krb5_principal dbprinc;
+    char *dbprincstr = NULL;
+    krb5_error_code ret;
+    krb5_boolean is_add;
+
+    *entry = NULL;
+
+    dbprincstr = k5memdup0(update->kdb_princ_name.utf8str_t_val,
+                           update->kdb_princ_name.utf8str_t_len, &ret);
+    if (dbprincstr == NULL)
+        return (ret);
+
+    ret = krb5_parse_name(context, dbprincstr, &dbprinc);
+    free(dbprincstr);
+    if (ret)
+        return (ret);
+
+    ret = krb5_db_get_principal(context, dbprinc, 0, &ent);
+    krb5_free_principal(context, dbprinc);
+    if (ret && ret != KRB5_KDB_NOENTRY)
+        return (ret);
+    is_add = (ret == KRB5_KDB_NOENTRY);
+
+    if (is_add) {
+        ret = new_entry(context, &ent);
+        if (ret)
+            return (ret);
+    }
+
+    ret = apply_update(context, ent, is_add, update);
+    if (ret) {
+        krb5_db_free_principal(context, ent);
+        return (ret);
+    }
     *entry = ent;
     return (0);
 }
 
+/*
+ * Apply a ulog update to *entry without consulting the database, as when an
+ * earlier update in the same batch produced *entry.  If *entry is NULL (the
+ * principal was deleted earlier in the batch), the update is applied to a new
+ * entry, which is returned in *entry.
+ */
+krb5_error_code
+ulog_merge_2dbentry(krb5_context context, krb5_db_entry **entry,
+                    kdb_incr_update_t *update)
+{
+    krb5_error_code ret;
+    krb5_boolean is_add = (*entry == NULL);
+
+    if (is_add) {
+        ret = new_entry(context, entry);
+        if (ret)
+            return (ret);
+    }
+    ret = apply_update(context, *entry, is_add, update);
+    if (ret && is_add) {
+        krb5_db_free_principal(context, *entry);
+        *entry = NULL;
+    }
+    return (ret);
+}
+
 
 
 /*
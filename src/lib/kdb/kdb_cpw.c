@@ -288,34 +288,170 @@ make_random_salt(krb5_context context, krb5_keysalt *salt_out)
     return 0;
 }
 
+/* Compute the salt for a new key of the given salt type. */
+static krb5_error_code
+make_salt(krb5_context context, krb5_int32 salttype, krb5_db_entry *db_entry,
+          krb5_keysalt *key_salt, const krb5_data **s2k_params_out)
+{
+    krb5_error_code retval;
+    krb5_data *saltdata;
+    static const krb5_data afs_params = { KV5M_DATA, 1, "\1" };
+
+    *s2k_params_out = NULL;
+    key_salt->data = empty_data();
+    switch (key_salt->type = salttype) {
+    case KRB5_KDB_SALTTYPE_ONLYREALM:
+        retval = krb5_copy_data(context, krb5_princ_realm(context,
+                                                          db_entry->princ),
+                                &saltdata);
+        if (retval)
+            return retval;
+        key_salt->data = *saltdata;
+        free(saltdata);
+        return 0;
+    case KRB5_KDB_SALTTYPE_NOREALM:
+        return krb5_principal2salt_norealm(context, db_entry->princ,
+                                           &key_salt->data);
+    case KRB5_KDB_SALTTYPE_NORMAL:
+        return krb5_principal2salt(context, db_entry->princ, &key_salt->data);
+    case KRB5_KDB_SALTTYPE_V4:
+        return 0;
+    case KRB5_KDB_SALTTYPE_AFS3:
+        retval = krb5int_copy_data_contents(context, &db_entry->princ->realm,
+                                            &key_salt->data);
+        if (retval)
+            return retval;
+        *s2k_params_out = &afs_params;
+        return 0;
+    case KRB5_KDB_SALTTYPE_SPECIAL:
+        return make_random_salt(context, key_salt);
+    default:
+        return KRB5_KDB_BAD_SALTTYPE;
+    }
+}
+
+/* One string-to-key computation for add_key_pwd(). */
+struct s2k_job {
+    krb5_enctype enctype;
+    krb5_data pwd;
+    krb5_keysalt key_salt;
+    const krb5_data *s2k_params;
+    krb5_keyblock key;
+    krb5_error_code retval;
+};
+
+static void
+run_s2k_job(struct s2k_job *job)
+{
+    /* krb5_c_string_to_key_with_params() does not use its context. */
+    job->retval = krb5_c_string_to_key_with_params(NULL, job->enctype,
+                                                   &job->pwd,
+                                                   &job->key_salt.data,
+                                                   job->s2k_params, &job->key);
+}
+
+#if defined(ENABLE_THREADS) && defined(HAVE_PTHREAD)
+
+/* The most threads started, besides the caller's, for one set of jobs. */
+#define S2K_MAX_THREADS 3
+
+/* A set of jobs shared between the calling thread and its helpers. */
+struct s2k_batch {
+    k5_mutex_t lock;
+    struct s2k_job *jobs;
+    int njobs;
+    int next;                   /* index of the next job to be taken */
+};
+
+/* Run jobs from the batch until none are left. */
+static void *
+run_s2k_batch(void *arg)
+{
+    struct s2k_batch *batch = arg;
+    int i;
+
+    for (;;) {
+        k5_mutex_lock(&batch->lock);
+        i = batch->next++;
+        k5_mutex_unlock(&batch->lock);
+        if (i >= batch->njobs)
+            break;
+        run_s2k_job(&batch->jobs[i]);
+    }
+    return NULL;
+}
+
+/*
+ * Run the string-to-key computations in jobs.  With iterated string-to-key
+ * functions each job can take a noticeable amount of CPU time, so when there
+ * is more than one, start a few threads to share them with the calling
+ * thread.  The threads are joined before returning.  If no thread can be
+ * started, the calling thread runs every job.
+ */
+static void
+run_s2k_jobs(struct s2k_job *jobs, int njobs)
+{
+    struct s2k_batch batch;
+    pthread_t threads[S2K_MAX_THREADS];
+    int i, nthreads = 0;
+
+    if (njobs <= 1 || k5_mutex_init(&batch.lock) != 0) {
+        for (i = 0; i < njobs; i++)
+            run_s2k_job(&jobs[i]);
+        return;
+    }
+    batch.jobs = jobs;
+    batch.njobs = njobs;
+    batch.next = 0;
+    while (nthreads < njobs - 1 && nthreads < S2K_MAX_THREADS) {
+        if (pthread_create(&threads[nthreads], NULL, run_s2k_batch,
+                           &batch) != 0)
+            break;
+        nthreads++;
+    }
+    run_s2k_batch(&batch);
+    for (i = 0; i < nthreads; i++)
+        pthread_join(threads[i], NULL);
+    k5_mutex_destroy(&batch.lock);
+}
+
+#else /* !(ENABLE_THREADS && HAVE_PTHREAD) */
+
+static void
+run_s2k_jobs(struct s2k_job *jobs, int njobs)
+{
+    int i;
+
+    for (i = 0; i < njobs; i++)
+        run_s2k_job(&jobs[i]);
+}
+
+#endif /* ENABLE_THREADS && HAVE_PTHREAD */
+
 /*
- * Add key_data for a krb5_db_entry
- * If passwd is NULL the assumes that the caller wants a random password.
+ * Add key_data for a krb5_db_entry, deriving the keys from passwd.  The salts
+ * are computed up front so that the string-to-key operations for the distinct
+ * key/salt tuples can run concurrently.
  */
 static krb5_error_code
-add_key_pwd(context, master_key, ks_tuple, ks_tuple_count, passwd,
-            db_entry, kvno)
-    krb5_context          context;
-    krb5_keyblock       * master_key;
-    krb5_key_salt_tuple * ks_tuple;
-    int                   ks_tuple_count;
-    const char          * passwd;
-    krb5_db_entry       * db_entry;
-    int                   kvno;
+add_key_pwd(krb5_context context, krb5_keyblock *master_key,
+            krb5_key_salt_tuple *ks_tuple, int ks_tuple_count,
+            const char *passwd, krb5_db_entry *db_entry, int kvno)
 {
     krb5_error_code       retval;
-    krb5_keysalt          key_salt;
-    krb5_keyblock         key;
-    krb5_data             pwd;
-    krb5_data             afs_params = string2data("\1"), *s2k_params;
-    int                   i, j;
+    struct s2k_job      * jobs, *job;
+    int                   i, j, njobs = 0;
     krb5_key_data         tmp_key_data;
 
+    jobs = k5calloc(ks_tuple_count > 0 ? ks_tuple_count : 1, sizeof(*jobs),
+                    &retval);
+    if (jobs == NULL)
+        return retval;
+
     for (i = 0; i < ks_tuple_count; i++) {
         krb5_boolean similar;
 
         similar = 0;
-        s2k_params = NULL;
 
         /*
          * We could use krb5_keysalt_iterate to replace this loop, or use
@@ -327,7 +463,7 @@ add_key_pwd(context, master_key, ks_tuple, ks_tuple_count, passwd,
                                                  ks_tuple[i].ks_enctype,
                                                  ks_tuple[j].ks_enctype,
                                                  &similar)))
-                return(retval);
+                goto cleanup;
 
             if (similar &&
                 (ks_tuple[j].ks_salttype == ks_tuple[i].ks_salttype))
@@ -337,83 +473,49 @@ add_key_pwd(context, master_key, ks_tuple, ks_tuple_count, passwd,
         if (j < i)
             continue;
 
-        if ((retval = krb5_dbe_create_key_data(context, db_entry)))
-            return(retval);
-
         /* Convert password string to key using appropriate salt */
-        switch (key_salt.type = ks_tuple[i].ks_salttype) {
-        case KRB5_KDB_SALTTYPE_ONLYREALM: {
-            krb5_data * saltdata;
-            if ((retval = krb5_copy_data(context, krb5_princ_realm(context,
-                                                                   db_entry->princ), &saltdata)))
-                return(retval);
+        job = &jobs[njobs++];
+        job->enctype = ks_tuple[i].ks_enctype;
+        job->pwd = string2data((char *)passwd);
+        retval = make_salt(context, ks_tuple[i].ks_salttype, db_entry,
+                           &job->key_salt, &job->s2k_params);
+        if (retval)
+            goto cleanup;
+    }
 
-            key_salt.data = *saltdata;
-            free(saltdata);
-        }
-            break;
-        case KRB5_KDB_SALTTYPE_NOREALM:
-            if ((retval=krb5_principal2salt_norealm(context, db_entry->princ,
-                                                    &key_salt.data)))
-                return(retval);
-            break;
-        case KRB5_KDB_SALTTYPE_NORMAL:
-            if ((retval = krb5_principal2salt(context, db_entry->princ,
-                                              &key_salt.data)))
-                return(retval);
-            break;
-        case KRB5_KDB_SALTTYPE_V4:
-            key_salt.data.length = 0;
-            key_salt.data.data = 0;
-            break;
-        case KRB5_KDB_SALTTYPE_AFS3:
-            retval = krb5int_copy_data_contents(context,
-                                                &db_entry->princ->realm,
-                                                &key_salt.data);
-            if (retval)
-                return retval;
-            s2k_params = &afs_params;
-            break;
-        case KRB5_KDB_SALTTYPE_SPECIAL:
-            retval = make_random_salt(context, &key_salt);
-            if (retval)
-                return retval;
-            break;
-        default:
-            return(KRB5_KDB_BAD_SALTTYPE);
-        }
+    run_s2k_jobs(jobs, njobs);
 
-        pwd = string2data((char *)passwd);
+    for (i = 0; i < njobs; i++) {
+        job = &jobs[i];
+        retval = job->retval;
+        if (retval)
+            goto cleanup;
 
-        retval = krb5_c_string_to_key_with_params(context,
-                                                  ks_tuple[i].ks_enctype,
-                                                  &pwd, &key_salt.data,
-                                                  s2k_params, &key);
-        if (retval) {
-            free(key_salt.data.data);
-            return retval;
-        }
+        if ((retval = krb5_dbe_create_key_data(context, db_entry)))
+            goto cleanup;
 
         memset(&tmp_key_data, 0, sizeof(tmp_key_data));
-        retval = krb5_dbe_encrypt_key_data(context, master_key, &key,
-                                           (const krb5_keysalt *)&key_salt,
+        retval = krb5_dbe_encrypt_key_data(context, master_key, &job->key,
+                                           (const krb5_keysalt *)&job->key_salt,
                                            kvno, &tmp_key_data);
-        if (key_salt.data.data)
-            free(key_salt.data.data);
-        free(key.contents);
-
-        if( retval )
-            return retval;
+        if (retval)
+            goto cleanup;
 
         /* Copy the result to ensure we use db_alloc storage. */
         retval = copy_key_data(context, &tmp_key_data,
                                &db_entry->key_data[db_entry->n_key_data - 1]);
         krb5_dbe_free_key_data_contents(context, &tmp_key_data);
         if (retval)
-            return retval;
+            goto cleanup;
     }
 
-    return 0;
+cleanup:
+    for (i = 0; i < njobs; i++) {
+        free(jobs[i].key_salt.data.data);
+        krb5_free_keyblock_contents(context, &jobs[i].key);
+    }
+    free(jobs);
+    return retval;
 }
 
 static krb5_error_code
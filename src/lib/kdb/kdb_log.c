@@ -72,6 +72,25 @@ sync_update(kdb_hlog_t *ulog, kdb_ent_header_t *upd)
     }
 }
 
+/* Sync count consecutive update entries to disk, starting at index indx. */
+static void
+sync_entries(kdb_hlog_t *ulog, unsigned int indx, unsigned int count)
+{
+    unsigned long start, end;
+
+    if (!pagesize)
+        pagesize = getpagesize();
+
+    start = (unsigned long)INDEX(ulog, indx) & ~(pagesize - 1);
+    end = ((unsigned long)INDEX(ulog, indx + count) + (pagesize - 1)) &
+        ~(pagesize - 1);
+    if (msync((caddr_t)start, end - start, MS_SYNC)) {
+        /* Couldn't sync to disk, let's panic. */
+        syslog(LOG_ERR, _("could not sync ulog update to disk"));
+        abort();
+    }
+}
+
 /* Sync memory to disk for the update log header. */
 static void
 sync_header(kdb_hlog_t *ulog)
@@ -241,7 +260,8 @@ reset_ulog(kdb_log_context *log_ctx)
 /*
  * If any database operations will be invoked while the ulog lock is held, the
  * caller must explicitly lock the database before locking the ulog, or
- * deadlock may result.
+ * deadlock may result.  While a group of updates is in progress or the caller
+ * holds the lock through ulog_lock(), this function does nothing.
  */
 static krb5_error_code
 lock_ulog(krb5_context context, int mode)
@@ -250,6 +270,8 @@ lock_ulog(krb5_context context, int mode)
     kdb_hlog_t *ulog = NULL;
 
     INIT_ULOG(context);
+    if (log_ctx->grouped || log_ctx->held)
+        return 0;
     return krb5_lock_file(context, log_ctx->ulogfd, mode);
 }
 
@@ -284,6 +306,8 @@ store_update(kdb_log_context *log_ctx, kdb_incr_update_t *upd)
         retval = resize(ulog, ulogentries, log_ctx->ulogfd, recsize);
         if (retval)
             return retval;
+        /* Entries stored earlier in the group were discarded. */
+        log_ctx->group_count = 0;
     }
 
     ulog->kdb_state = KDB_UNSTABLE;
@@ -304,7 +328,18 @@ store_update(kdb_log_context *log_ctx, kdb_incr_update_t *upd)
         return KRB5_LOG_CONV;
 
     indx_log->kdb_commit = TRUE;
-    sync_update(ulog, indx_log);
+    if (!log_ctx->grouped) {
+        sync_update(ulog, indx_log);
+    } else {
+        /* Track the run of entries to sync when the group ends.  A gap
+         * means the ulog was reset, discarding the earlier entries. */
+        if (log_ctx->group_count == 0 ||
+            upd->kdb_entry_sno != log_ctx->group_sno + log_ctx->group_count) {
+            log_ctx->group_sno = upd->kdb_entry_sno;
+            log_ctx->group_count = 0;
+        }
+        log_ctx->group_count++;
+    }
 
     /* Modify the ulog header to reflect the new update. */
     ulog->kdb_last_sno = upd->kdb_entry_sno;
@@ -325,10 +360,90 @@ store_update(kdb_log_context *log_ctx, kdb_incr_update_t *upd)
     }
 
     ulog->kdb_state = KDB_STABLE;
-    sync_header(ulog);
+    if (!log_ctx->grouped)
+        sync_header(ulog);
+    return 0;
+}
+
+/*
+ * Begin a group of updates.  The ulog is held exclusively locked until
+ * ulog_end_group(), and updates added in the meantime are synced to disk
+ * together when the group ends rather than one at a time.  The caller must
+ * lock the database first.
+ */
+krb5_error_code
+ulog_begin_group(krb5_context context)
+{
+    krb5_error_code ret;
+    kdb_log_context *log_ctx;
+    kdb_hlog_t *ulog;
+
+    INIT_ULOG(context);
+    ret = krb5_lock_file(context, log_ctx->ulogfd, KRB5_LOCKMODE_EXCLUSIVE);
+    if (ret)
+        return ret;
+    log_ctx->grouped = TRUE;
+    log_ctx->group_count = 0;
     return 0;
 }
 
+/*
+ * Sync the updates added since ulog_begin_group() and unlock the ulog.  The
+ * entries are synced before the header, so that the header never refers to
+ * entries which have not reached the disk.
+ */
+void
+ulog_end_group(krb5_context context)
+{
+    kdb_log_context *log_ctx;
+    kdb_hlog_t *ulog;
+    unsigned int indx, count, n;
+    uint64_t start;
+
+    INIT_ULOG(context);
+    if (!log_ctx->grouped)
+        return;
+
+    start = k5_monotonic_usec();
+    count = log_ctx->group_count;
+    if (count > log_ctx->ulogentries)
+        count = log_ctx->ulogentries;
+    if (count > 0) {
+        /* The run of entries may wrap around the end of the log. */
+        indx = (log_ctx->group_sno - 1) % log_ctx->ulogentries;
+        n = log_ctx->ulogentries - indx;
+        if (n > count)
+            n = count;
+        sync_entries(ulog, indx, n);
+        if (n < count)
+            sync_entries(ulog, 0, count - n);
+    }
+    sync_header(ulog);
+    log_ctx->grouped = FALSE;
+    log_ctx->group_count = 0;
+    (void)krb5_lock_file(context, log_ctx->ulogfd, KRB5_LOCKMODE_UNLOCK);
+    log_ctx->ulog_usec += k5_monotonic_usec() - start;
+}
+
+/*
+ * End a group whose updates the database did not take.  If any updates were
+ * added during the group, reset the ulog while it is still locked, so that
+ * downstream replicas resynchronize fully rather than apply them.
+ */
+void
+ulog_abort_group(krb5_context context)
+{
+    kdb_log_context *log_ctx;
+    kdb_hlog_t *ulog;
+
+    INIT_ULOG(context);
+    if (!log_ctx->grouped)
+        return;
+    if (log_ctx->group_count > 0)
+        reset_ulog(log_ctx);
+    ulog_end_group(context);
+}
+
 /* Add an entry to the update log. */
 krb5_error_code
 ulog_add_update(krb5_context context, kdb_incr_update_t *upd)
@@ -336,8 +451,10 @@ ulog_add_update(krb5_context context, kdb_incr_update_t *upd)
     krb5_error_code ret;
     kdb_log_context *log_ctx;
     kdb_hlog_t *ulog;
+    uint64_t start;
 
     INIT_ULOG(context);
+    start = k5_monotonic_usec();
     ret = lock_ulog(context, KRB5_LOCKMODE_EXCLUSIVE);
     if (ret)
         return ret;
@@ -351,97 +468,199 @@ ulog_add_update(krb5_context context, kdb_incr_update_t *upd)
     time_current(&upd->kdb_time);
     ret = store_update(log_ctx, upd);
     unlock_ulog(context);
+    log_ctx->ulog_usec += k5_monotonic_usec() - start;
+    return ret;
+}
+
+/* qsort comparator for replay_batch(), ordering updates by principal name and
+ * then by position in the batch. */
+static int
+cmp_update_name(const void *a, const void *b)
+{
+    const kdb_incr_update_t *u1 = *(kdb_incr_update_t *const *)a;
+    const kdb_incr_update_t *u2 = *(kdb_incr_update_t *const *)b;
+    const utf8str_t *n1 = &u1->kdb_princ_name, *n2 = &u2->kdb_princ_name;
+    unsigned int len = (n1->utf8str_t_len < n2->utf8str_t_len) ?
+        n1->utf8str_t_len : n2->utf8str_t_len;
+    int cmp;
+
+    cmp = memcmp(n1->utf8str_t_val, n2->utf8str_t_val, len);
+    if (cmp != 0)
+        return cmp;
+    if (n1->utf8str_t_len != n2->utf8str_t_len)
+        return (n1->utf8str_t_len < n2->utf8str_t_len) ? -1 : 1;
+    return (u1 < u2) ? -1 : (u1 > u2);
+}
+
+static krb5_boolean
+same_princ_name(const kdb_incr_update_t *u1, const kdb_incr_update_t *u2)
+{
+    return u1->kdb_princ_name.utf8str_t_len ==
+        u2->kdb_princ_name.utf8str_t_len &&
+        memcmp(u1->kdb_princ_name.utf8str_t_val,
+               u2->kdb_princ_name.utf8str_t_val,
+               u1->kdb_princ_name.utf8str_t_len) == 0;
+}
+
+/*
+ * Apply the updates in list (all for the same principal, in batch order) to
+ * the database with at most one put or delete.  Updates after the first are
+ * merged into the entry produced by the earlier ones instead of being written
+ * and read back.
+ */
+static krb5_error_code
+replay_princ(krb5_context context, kdb_incr_update_t **list, size_t count)
+{
+    krb5_error_code ret = 0;
+    krb5_db_entry *entry = NULL;
+    krb5_principal dbprinc = NULL;
+    char *dbprincstr;
+    size_t i;
+
+    for (i = 0; i < count; i++) {
+        if (list[i]->kdb_deleted) {
+            krb5_db_free_principal(context, entry);
+            entry = NULL;
+        } else if (i == 0) {
+            ret = ulog_conv_2dbentry(context, &entry, list[i]);
+        } else {
+            ret = ulog_merge_2dbentry(context, &entry, list[i]);
+        }
+        if (ret)
+            goto cleanup;
+    }
+
+    if (entry != NULL) {
+        ret = krb5int_put_principal_no_log(context, entry);
+    } else {
+        dbprincstr = k5memdup0(list[0]->kdb_princ_name.utf8str_t_val,
+                               list[0]->kdb_princ_name.utf8str_t_len, &ret);
+        if (dbprincstr == NULL)
+            goto cleanup;
+        ret = krb5_parse_name(context, dbprincstr, &dbprinc);
+        free(dbprincstr);
+        if (ret)
+            goto cleanup;
+        ret = krb5int_delete_principal_no_log(context, dbprinc);
+        if (ret == KRB5_KDB_NOENTRY)
+            ret = 0;
+    }
+
+cleanup:
+    krb5_db_free_principal(context, entry);
+    krb5_free_principal(context, dbprinc);
+    return ret;
+}
+
+/*
+ * Apply the committed updates in a batch to the database.  Updates for
+ * different principals are independent, so the batch is grouped by principal
+ * name and each principal is written once with the combined result of its
+ * updates.
+ */
+static krb5_error_code
+replay_batch(krb5_context context, kdb_incr_update_t *updates, int count)
+{
+    krb5_error_code ret = 0;
+    kdb_incr_update_t **list;
+    size_t n = 0, i, j;
+    int k;
+
+    list = k5calloc(count > 0 ? count : 1, sizeof(*list), &ret);
+    if (list == NULL)
+        return ret;
+    for (k = 0; k < count; k++) {
+        if (updates[k].kdb_commit)
+            list[n++] = &updates[k];
+    }
+    qsort(list, n, sizeof(*list), cmp_update_name);
+
+    for (i = 0; i < n && !ret; i = j) {
+        for (j = i + 1; j < n && same_princ_name(list[i], list[j]); j++);
+        ret = replay_princ(context, &list[i], j - i);
+    }
+
+    free(list);
     return ret;
 }
 
-/* Used by the slave to update its hash db from the incr update log. */
+/*
+ * Used by the slave to update its hash db from the incr update log.  The
+ * batch is applied within one database transaction, and the slave's ulog
+ * records for it are written as one group and synced once.
+ */
 krb5_error_code
 ulog_replay(krb5_context context, kdb_incr_result_t *incr_ret, char **db_args)
 {
-    krb5_db_entry *entry = NULL;
-    kdb_incr_update_t *upd = NULL, *fupd;
+    kdb_incr_update_t *upd;
     int i, no_of_updates;
     krb5_error_code retval;
-    krb5_principal dbprinc;
-    char *dbprincstr;
     kdb_log_context *log_ctx;
     kdb_hlog_t *ulog = NULL;
+    krb5_boolean in_txn = FALSE, grouped = FALSE;
 
     INIT_ULOG(context);
 
+    no_of_updates = incr_ret->updates.kdb_ulog_t_len;
+    upd = incr_ret->updates.kdb_ulog_t_val;
+
     /* Lock the DB before the ulog to avoid deadlock. */
     retval = krb5_db_open(context, db_args,
                           KRB5_KDB_OPEN_RW | KRB5_KDB_SRV_TYPE_ADMIN);
     if (retval)
-        return retval;
+        goto done;
     retval = krb5_db_lock(context, KRB5_DB_LOCKMODE_EXCLUSIVE);
     if (retval)
-        return retval;
-    retval = lock_ulog(context, KRB5_LOCKMODE_EXCLUSIVE);
-    if (retval) {
-        krb5_db_unlock(context);
-        return retval;
-    }
+        goto done;
+    retval = krb5_db_begin_txn(context);
+    if (retval)
+        goto cleanup;
+    in_txn = TRUE;
+    retval = ulog_begin_group(context);
+    if (retval)
+        goto cleanup;
+    grouped = TRUE;
 
-    no_of_updates = incr_ret->updates.kdb_ulog_t_len;
-    upd = incr_ret->updates.kdb_ulog_t_val;
-    fupd = upd;
+    retval = replay_batch(context, upd, no_of_updates);
+    if (retval)
+        goto cleanup;
 
     for (i = 0; i < no_of_updates; i++) {
-        if (!upd->kdb_commit)
+        if (!upd[i].kdb_commit)
             continue;
 
         /* If (unexpectedly) this update does not follow the last one we
          * stored, discard any previous ulog state. */
-        if (ulog->kdb_num != 0 && upd->kdb_entry_sno != ulog->kdb_last_sno + 1)
+        if (ulog->kdb_num != 0 &&
+            upd[i].kdb_entry_sno != ulog->kdb_last_sno + 1)
             reset_ulog(log_ctx);
 
-        if (upd->kdb_deleted) {
-            dbprincstr = k5memdup0(upd->kdb_princ_name.utf8str_t_val,
-                                   upd->kdb_princ_name.utf8str_t_len, &retval);
-            if (dbprincstr == NULL)
-                goto cleanup;
-
-            retval = krb5_parse_name(context, dbprincstr, &dbprinc);
-            free(dbprincstr);
-            if (retval)
-                goto cleanup;
-
-            retval = krb5int_delete_principal_no_log(context, dbprinc);
-            krb5_free_principal(context, dbprinc);
-            if (retval == KRB5_KDB_NOENTRY)
-                retval = 0;
-            if (retval)
-                goto cleanup;
-        } else {
-            entry = k5alloc(sizeof(krb5_db_entry), &retval);
-            if (entry == NULL)
-                goto cleanup;
-
-            retval = ulog_conv_2dbentry(context, &entry, upd);
-            if (retval)
-                goto cleanup;
-
-            retval = krb5int_put_principal_no_log(context, entry);
-            krb5_db_free_principal(context, entry);
-            if (retval)
-                goto cleanup;
-        }
-
-        retval = store_update(log_ctx, upd);
+        retval = store_update(log_ctx, &upd[i]);
         if (retval)
             goto cleanup;
-
-        upd++;
     }
 
 cleanup:
-    if (fupd)
-        ulog_free_entries(fupd, no_of_updates);
-    if (retval)
+    /* Commit the database changes before the ulog entries describing them
+     * are synced, and discard the ulog state if they could not be
+     * committed, so that the ulog never runs ahead of the database. */
+    if (in_txn) {
+        if (retval)
+            (void)krb5_db_abort_txn(context);
+        else
+            retval = krb5_db_commit_txn(context);
+    }
+    /* On any failure, reset the ulog so that a full resync follows.  If the
+     * group was never started, take the ulog lock for the reset. */
+    if (retval && lock_ulog(context, KRB5_LOCKMODE_EXCLUSIVE) == 0) {
         reset_ulog(log_ctx);
-    unlock_ulog(context);
+        unlock_ulog(context);
+    }
+    if (grouped)
+        ulog_end_group(context);
     krb5_db_unlock(context);
+done:
+    ulog_free_entries(upd, no_of_updates);
     return retval;
 }
 
@@ -659,6 +878,89 @@ ulog_get_last(krb5_context context, kdb_last_t *last_out)
     return 0;
 }
 
+/*
+ * Look up the ulog entry for sno and place its serial number and timestamp in
+ * last_out.  Return KRB5_LOG_ERROR if the ulog does not contain sno.
+ */
+krb5_error_code
+ulog_find_sno(krb5_context context, kdb_sno_t sno, kdb_last_t *last_out)
+{
+    krb5_error_code ret;
+    kdb_log_context *log_ctx;
+    kdb_hlog_t *ulog;
+    kdb_ent_header_t *ent;
+
+    INIT_ULOG(context);
+    ret = lock_ulog(context, KRB5_LOCKMODE_SHARED);
+    if (ret)
+        return ret;
+    ret = KRB5_LOG_ERROR;
+    if (ulog->kdb_state != KDB_STABLE || ulog->kdb_num == 0 ||
+        sno < ulog->kdb_first_sno || sno > ulog->kdb_last_sno)
+        goto cleanup;
+    ent = INDEX(ulog, (sno - 1) % log_ctx->ulogentries);
+    if (ent->kdb_entry_sno != sno)
+        goto cleanup;
+    last_out->last_sno = sno;
+    last_out->last_time = ent->kdb_time;
+    ret = 0;
+
+cleanup:
+    unlock_ulog(context);
+    return ret;
+}
+
+/*
+ * Return true if last was once in the ulog but has since been overwritten as
+ * the log wrapped around, i.e. it precedes the first entry of the ulog by both
+ * serial number and timestamp.  Return false if the ulog still contains last,
+ * or if last is newer than the ulog's first entry (which is the case after the
+ * ulog is reinitialized and starts again from serial number 1).
+ */
+krb5_boolean
+ulog_sno_discarded(krb5_context context, const kdb_last_t *last)
+{
+    kdb_log_context *log_ctx;
+    kdb_hlog_t *ulog;
+    krb5_boolean result;
+
+    INIT_ULOG(context);
+    if (lock_ulog(context, KRB5_LOCKMODE_SHARED) != 0)
+        return FALSE;
+    result = ulog->kdb_state == KDB_STABLE && ulog->kdb_num > 0 &&
+        last->last_sno != 0 && last->last_sno < ulog->kdb_first_sno &&
+        (last->last_time.seconds < ulog->kdb_first_time.seconds ||
+         (last->last_time.seconds == ulog->kdb_first_time.seconds &&
+          last->last_time.useconds < ulog->kdb_first_time.useconds));
+    unlock_ulog(context);
+    return result;
+}
+
+/*
+ * Lock (mode is KRB5_LOCKMODE_SHARED or KRB5_LOCKMODE_EXCLUSIVE) or unlock
+ * (KRB5_LOCKMODE_UNLOCK) the ulog on behalf of the caller, so that several
+ * ulog calls and database reads see the same state.  Other ulog functions do
+ * not lock or unlock the ulog while it is held, so the caller must not add
+ * updates while holding a shared lock.  The caller must lock the database
+ * first.
+ */
+krb5_error_code
+ulog_lock(krb5_context context, int mode)
+{
+    krb5_error_code ret;
+    kdb_log_context *log_ctx;
+    kdb_hlog_t *ulog;
+
+    INIT_ULOG(context);
+    if (mode == KRB5_LOCKMODE_UNLOCK && !log_ctx->held)
+        return 0;
+    ret = krb5_lock_file(context, log_ctx->ulogfd, mode);
+    if (ret)
+        return ret;
+    log_ctx->held = (mode != KRB5_LOCKMODE_UNLOCK);
+    return 0;
+}
+
 krb5_error_code
 ulog_set_last(krb5_context context, const kdb_last_t *last)
 {
@@ -541,6 +541,41 @@ authgss_service(AUTH *auth, int svc)
 	return (TRUE);
 }
 
+/*
+ * Get or set the sequence number of the current call, which is used to
+ * verify and unwrap its reply.  A client with several calls outstanding sets
+ * the sequence number of each call before processing its reply, and restores
+ * the sequence number of the last call sent before sending another.  These
+ * return FALSE if auth is not an established RPCSEC_GSS handle.
+ */
+bool_t
+authgss_get_seq(AUTH *auth, uint32_t *seq)
+{
+	struct rpc_gss_data	*gd;
+
+	if (!auth || auth->ah_ops != &authgss_ops)
+		return (FALSE);
+	gd = AUTH_PRIVATE(auth);
+	if (!gd || !gd->established)
+		return (FALSE);
+	*seq = gd->gc.gc_seq;
+	return (TRUE);
+}
+
+bool_t
+authgss_set_seq(AUTH *auth, uint32_t seq)
+{
+	struct rpc_gss_data	*gd;
+
+	if (!auth || auth->ah_ops != &authgss_ops)
+		return (FALSE);
+	gd = AUTH_PRIVATE(auth);
+	if (!gd || !gd->established)
+		return (FALSE);
+	gd->gc.gc_seq = seq;
+	return (TRUE);
+}
+
 static void
 authgss_destroy_context(AUTH *auth)
 {
@@ -65,6 +65,7 @@ static char sccsid[] = "@(#)clnt_tcp.c 1.37 87/10/05 Copyr 1984 Sun Micro";
 #include <port-sockets.h>
 
 #define MCALL_MSG_SIZE 24
+#define MAX_NONBLOCK_RECORD (1024 * 1024)
 
 #ifndef GETSOCKNAME_ARG3_TYPE
 #define GETSOCKNAME_ARG3_TYPE int
@@ -100,10 +101,80 @@ struct ct_data {
 	} ct_u;
 	u_int		ct_mpos;			/* pos after marshal */
 	XDR		ct_xdrs;
+	bool_t		ct_nonblock;	/* replies assembled with getrec? */
 };
 
 static int	readtcp(char *, caddr_t, int);
 static int	writetcp(char *, caddr_t, int);
+static int	waittcp(struct ct_data *, struct timeval *);
+
+/*
+ * Marshal and send a call, returning its transaction id in *xid.
+ */
+static enum clnt_stat
+sendcall(
+	CLIENT *h,
+	rpcproc_t proc,
+	xdrproc_t xdr_args,
+	void *args_ptr,
+	bool_t shipnow,
+	uint32_t *xid)
+{
+	register struct ct_data *ct = (struct ct_data *) h->cl_private;
+	register XDR *xdrs = &(ct->ct_xdrs);
+	uint32_t *msg_x_id = &ct->ct_u.ct_mcalli;	/* yuk */
+	long procl = proc;
+
+	xdrs->x_op = XDR_ENCODE;
+	ct->ct_error.re_status = RPC_SUCCESS;
+	*xid = ntohl(--(*msg_x_id));
+	if ((! XDR_PUTBYTES(xdrs, ct->ct_u.ct_mcall, ct->ct_mpos)) ||
+	    (! XDR_PUTLONG(xdrs, &procl)) ||
+	    (! AUTH_MARSHALL(h->cl_auth, xdrs)) ||
+	    (! AUTH_WRAP(h->cl_auth, xdrs, xdr_args, args_ptr))) {
+		if (ct->ct_error.re_status == RPC_SUCCESS)
+			ct->ct_error.re_status = RPC_CANTENCODEARGS;
+		(void)xdrrec_endofrecord(xdrs, TRUE);
+		return (ct->ct_error.re_status);
+	}
+	if (! xdrrec_endofrecord(xdrs, shipnow))
+		return (ct->ct_error.re_status = RPC_CANTSEND);
+	return (RPC_SUCCESS);
+}
+
+/*
+ * Position the stream at the start of the next reply record.  On a
+ * non-blocking handle, wait up to ct_wait for the record if wait is set;
+ * otherwise return RPC_TIMEDOUT (without recording an error) if the record
+ * has not fully arrived yet.
+ */
+static enum clnt_stat
+nextrecord(struct ct_data *ct, bool_t wait)
+{
+	struct timeval tout;
+	bool_t died;
+
+	if (!ct->ct_nonblock) {
+		if (! xdrrec_skiprecord(&(ct->ct_xdrs)))
+			return (ct->ct_error.re_status);
+		return (RPC_SUCCESS);
+	}
+	while (! xdrrec_getrec(&(ct->ct_xdrs), &died)) {
+		if (died) {
+			if (ct->ct_error.re_status == RPC_SUCCESS)
+				ct->ct_error.re_status = RPC_CANTRECV;
+			return (ct->ct_error.re_status);
+		}
+		if (!wait)
+			return (RPC_TIMEDOUT);
+		tout = ct->ct_wait;
+		if (waittcp(ct, &tout) == 0)
+			ct->ct_error.re_status = RPC_TIMEDOUT;
+		if (ct->ct_error.re_status != RPC_SUCCESS)
+			return (ct->ct_error.re_status);
+	}
+	return (RPC_SUCCESS);
+}
 
 
 /*
@@ -187,6 +258,7 @@ clnttcp_create(
 	ct->ct_sock = *sockp;
 	ct->ct_wait.tv_usec = 0;
 	ct->ct_waitset = FALSE;
+	ct->ct_nonblock = FALSE;
 	if (raddr == NULL) {
 	    /* Get the remote address from the socket, if it's IPv4. */
 	    struct sockaddr_in sin;
@@ -256,10 +328,8 @@ clnttcp_call(
 	register XDR *xdrs = &(ct->ct_xdrs);
 	struct rpc_msg reply_msg;
 	uint32_t x_id;
-	uint32_t *msg_x_id = &ct->ct_u.ct_mcalli;	/* yuk */
 	register bool_t shipnow;
 	int refreshes = 2;
-	long procl = proc;
 
 	if (!ct->ct_waitset) {
 		ct->ct_wait = timeout;
@@ -270,20 +340,9 @@ clnttcp_call(
 	    && timeout.tv_usec == 0) ? FALSE : TRUE;
 
 call_again:
-	xdrs->x_op = XDR_ENCODE;
-	ct->ct_error.re_status = RPC_SUCCESS;
-	x_id = ntohl(--(*msg_x_id));
-	if ((! XDR_PUTBYTES(xdrs, ct->ct_u.ct_mcall, ct->ct_mpos)) ||
-	    (! XDR_PUTLONG(xdrs, &procl)) ||
-	    (! AUTH_MARSHALL(h->cl_auth, xdrs)) ||
-	    (! AUTH_WRAP(h->cl_auth, xdrs, xdr_args, args_ptr))) {
-		if (ct->ct_error.re_status == RPC_SUCCESS)
-			ct->ct_error.re_status = RPC_CANTENCODEARGS;
-		(void)xdrrec_endofrecord(xdrs, TRUE);
+	if (sendcall(h, proc, xdr_args, args_ptr, shipnow, &x_id) !=
+	    RPC_SUCCESS)
 		return (ct->ct_error.re_status);
-	}
-	if (! xdrrec_endofrecord(xdrs, shipnow))
-		return (ct->ct_error.re_status = RPC_CANTSEND);
 	if (! shipnow)
 		return (RPC_SUCCESS);
 	/*
@@ -302,7 +361,7 @@ call_again:
 		reply_msg.acpted_rply.ar_verf = gssrpc__null_auth;
 		reply_msg.acpted_rply.ar_results.where = NULL;
 		reply_msg.acpted_rply.ar_results.proc = xdr_void;
-		if (! xdrrec_skiprecord(xdrs))
+		if (nextrecord(ct, TRUE) != RPC_SUCCESS)
 			return (ct->ct_error.re_status);
 		/* now decode and validate the response header */
 		if (! xdr_replymsg(xdrs, &reply_msg)) {
@@ -351,6 +410,124 @@ call_again:
 	return (ct->ct_error.re_status);
 }
 
+/*
+ * Switch a TCP client handle to non-blocking reply assembly, so that
+ * replies to calls made with clnttcp_send() can be collected with
+ * clnttcp_getreply() as they arrive.  clnt_call() keeps working on the
+ * handle, waiting up to the call timeout for its reply.
+ */
+bool_t
+clnttcp_setnonblock(CLIENT *h)
+{
+	register struct ct_data *ct = (struct ct_data *) h->cl_private;
+
+	if (h->cl_ops != &tcp_ops)
+		return (FALSE);
+	if (ct->ct_nonblock)
+		return (TRUE);
+	if (! xdrrec_setnonblock(&(ct->ct_xdrs), MAX_NONBLOCK_RECORD))
+		return (FALSE);
+	ct->ct_nonblock = TRUE;
+	return (TRUE);
+}
+
+/*
+ * Send a call without waiting for its reply, so that several calls can be
+ * outstanding at once.  The transaction id of the call is stored in *xid
+ * for matching against the reply returned by clnttcp_getreply().
+ */
+enum clnt_stat
+clnttcp_send(
+	CLIENT *h,
+	rpcproc_t proc,
+	xdrproc_t xdr_args,
+	void *args_ptr,
+	uint32_t *xid)
+{
+	return (sendcall(h, proc, xdr_args, args_ptr, TRUE, xid));
+}
+
+/*
+ * Decode the header of the next reply on a non-blocking handle into
+ * *reply_msg.  If wait is false and no complete reply has arrived, return
+ * RPC_TIMEDOUT without blocking; otherwise wait up to the handle timeout.
+ * On success the caller must finish the reply with clnttcp_endreply()
+ * before reading another one.
+ */
+enum clnt_stat
+clnttcp_getreply(
+	CLIENT *h,
+	struct rpc_msg *reply_msg,
+	bool_t wait)
+{
+	register struct ct_data *ct = (struct ct_data *) h->cl_private;
+	register XDR *xdrs = &(ct->ct_xdrs);
+	enum clnt_stat stat;
+	enum xdr_op op;
+
+	if (!ct->ct_nonblock)
+		return (RPC_FAILED);
+	ct->ct_error.re_status = RPC_SUCCESS;
+	xdrs->x_op = XDR_DECODE;
+	for (;;) {
+		reply_msg->acpted_rply.ar_verf = gssrpc__null_auth;
+		reply_msg->acpted_rply.ar_results.where = NULL;
+		reply_msg->acpted_rply.ar_results.proc = xdr_void;
+		stat = nextrecord(ct, wait);
+		if (stat != RPC_SUCCESS)
+			return (stat);
+		if (xdr_replymsg(xdrs, reply_msg))
+			return (RPC_SUCCESS);
+		/* Discard undecodable replies, as clnttcp_call() does. */
+		op = xdrs->x_op;
+		xdrs->x_op = XDR_FREE;
+		xdr_replymsg(xdrs, reply_msg);
+		xdrs->x_op = op;
+		if (ct->ct_error.re_status != RPC_SUCCESS)
+			return (ct->ct_error.re_status);
+	}
+}
+
+/*
+ * Finish a reply read by clnttcp_getreply(): check its status and
+ * verifier and decode the results with xdr_results.  If xdr_results is
+ * null, the reply is discarded.
+ */
+enum clnt_stat
+clnttcp_endreply(
+	CLIENT *h,
+	struct rpc_msg *reply_msg,
+	xdrproc_t xdr_results,
+	void *results_ptr)
+{
+	register struct ct_data *ct = (struct ct_data *) h->cl_private;
+	register XDR *xdrs = &(ct->ct_xdrs);
+
+	ct->ct_error.re_status = RPC_SUCCESS;
+	if (xdr_results != NULL) {
+		gssrpc__seterr_reply(reply_msg, &(ct->ct_error));
+		if (ct->ct_error.re_status == RPC_SUCCESS) {
+			if (! AUTH_VALIDATE(h->cl_auth,
+					    &reply_msg->acpted_rply.ar_verf)) {
+				ct->ct_error.re_status = RPC_AUTHERROR;
+				ct->ct_error.re_why = AUTH_INVALIDRESP;
+			} else if (! AUTH_UNWRAP(h->cl_auth, xdrs,
+						 xdr_results, results_ptr)) {
+				if (ct->ct_error.re_status == RPC_SUCCESS)
+					ct->ct_error.re_status =
+						RPC_CANTDECODERES;
+			}
+		}
+	}
+	/* free verifier ... */
+	if ((reply_msg->rm_reply.rp_stat == MSG_ACCEPTED) &&
+	    (reply_msg->acpted_rply.ar_verf.oa_base != NULL)) {
+		xdrs->x_op = XDR_FREE;
+		(void)xdr_opaque_auth(xdrs, &(reply_msg->acpted_rply.ar_verf));
+	}
+	return (ct->ct_error.re_status);
+}
+
 static void
 clnttcp_geterr(
 	CLIENT *h,
@@ -428,42 +605,28 @@ clnttcp_destroy(CLIENT *h)
 }
 
 /*
- * Interface between xdr serializer and tcp connection.
- * Behaves like the system calls, read & write, but keeps some error state
- * around for the rpc level.
+ * Wait up to *tout for the socket to become readable.  Return 1 if it is,
+ * 0 on timeout, or -1 on error with the error recorded in ct_error.
  */
 static int
-readtcp(
-        char *ctptr,
-	caddr_t buf,
-	register int len)
+waittcp(struct ct_data *ct, struct timeval *tout)
 {
-  register struct ct_data *ct = (struct ct_data *)(void *)ctptr;
-  struct timeval tout;
 #ifdef FD_SETSIZE
 	fd_set mask;
 	fd_set readfds;
 
-	if (len == 0)
-		return (0);
 	FD_ZERO(&mask);
 	FD_SET(ct->ct_sock, &mask);
 #else
 	register int mask = 1 << (ct->ct_sock);
 	int readfds;
-
-	if (len == 0)
-		return (0);
-
 #endif /* def FD_SETSIZE */
 	while (TRUE) {
 		readfds = mask;
-		tout = ct->ct_wait;
 		switch (select(gssrpc__rpc_dtablesize(), &readfds, (fd_set*)NULL, (fd_set*)NULL,
-			       &tout)) {
+			       tout)) {
 		case 0:
-			ct->ct_error.re_status = RPC_TIMEDOUT;
-			return (-1);
+			return (0);
 
 		case -1:
 			if (errno == EINTR)
@@ -472,7 +635,44 @@ readtcp(
 			ct->ct_error.re_errno = errno;
 			return (-1);
 		}
-		break;
+		return (1);
+	}
+}
+
+/*
+ * Interface between xdr serializer and tcp connection.
+ * Behaves like the system calls, read & write, but keeps some error state
+ * around for the rpc level.
+ */
+static int
+readtcp(
+        char *ctptr,
+	caddr_t buf,
+	register int len)
+{
+	register struct ct_data *ct = (struct ct_data *)(void *)ctptr;
+	struct timeval tout;
+
+	if (len == 0)
+		return (0);
+	if (ct->ct_nonblock) {
+		/* Read only what is available; 0 means no data yet. */
+		tout.tv_sec = tout.tv_usec = 0;
+		switch (waittcp(ct, &tout)) {
+		case 0:
+			return (0);
+		case -1:
+			return (-1);
+		}
+	} else {
+		tout = ct->ct_wait;
+		switch (waittcp(ct, &tout)) {
+		case 0:
+			ct->ct_error.re_status = RPC_TIMEDOUT;
+			return (-1);
+		case -1:
+			return (-1);
+		}
 	}
 	switch (len = read(ct->ct_sock, buf, (size_t) len)) {
 
@@ -484,6 +684,8 @@ readtcp(
 		break;
 
 	case -1:
+		if (ct->ct_nonblock && errno == EINTR)
+			return (0);
 		ct->ct_error.re_errno = errno;
 		ct->ct_error.re_status = RPC_CANTRECV;
 		break;
@@ -86,7 +86,7 @@ static struct svc_callout {
 static struct svc_callout *svc_find(rpcprog_t, rpcvers_t,
 				    struct svc_callout **);
 
-static void svc_do_xprt(SVCXPRT *xprt);
+static bool_t svc_do_xprt(SVCXPRT *xprt);
 
 /* ***************  SVCXPRT related stuff **************** */
 
@@ -441,9 +441,21 @@ svc_getreqset(FDSET_TYPE *readfds)
 #endif
 }
 
+/*
+ * Receive and dispatch the requests waiting on a single transport, as
+ * svc_getreqset() does for each ready descriptor.  This works for
+ * transports whose descriptors are not tracked in svc_fdset.  Returns
+ * FALSE if the transport died and has been destroyed.
+ */
+bool_t
+svc_getreq_xprt(SVCXPRT *xprt)
+{
+	return (svc_do_xprt(xprt));
+}
+
 extern struct svc_auth_ops svc_auth_gss_ops;
 
-static void
+static bool_t
 svc_do_xprt(SVCXPRT *xprt)
 {
 	caddr_t rawcred, rawverf, cookedcred;
@@ -454,13 +466,14 @@ svc_do_xprt(SVCXPRT *xprt)
 	rpcvers_t low_vers;
 	rpcvers_t high_vers;
 	enum xprt_stat stat;
+	bool_t alive = TRUE;
 
 	rawcred = mem_alloc(MAX_AUTH_BYTES);
 	rawverf = mem_alloc(MAX_AUTH_BYTES);
 	cookedcred = mem_alloc(RQCRED_SIZE);
 
 	if (rawcred == NULL || rawverf == NULL || cookedcred == NULL)
-		return;
+		return (TRUE);
 
 	msg.rm_call.cb_cred.oa_base = rawcred;
 	msg.rm_call.cb_verf.oa_base = rawverf;
@@ -523,6 +536,7 @@ svc_do_xprt(SVCXPRT *xprt)
 	call_done:
 		if ((stat = SVC_STAT(xprt)) == XPRT_DIED){
 			SVC_DESTROY(xprt);
+			alive = FALSE;
 			break;
 		} else if ((xprt->xp_auth != NULL) &&
 			   (xprt->xp_auth->svc_ah_ops != &svc_auth_gss_ops)) {
@@ -533,4 +547,5 @@ svc_do_xprt(SVCXPRT *xprt)
 	mem_free(rawcred, MAX_AUTH_BYTES);
 	mem_free(rawverf, MAX_AUTH_BYTES);
 	mem_free(cookedcred, RQCRED_SIZE);
+	return (alive);
 }
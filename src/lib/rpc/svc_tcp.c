@@ -45,6 +45,7 @@ static char sccsid[] = "@(#)svc_tcp.c 1.21 87/08/11 Copyr 1984 Sun Micro";
 
 #include "k5-platform.h"
 #include <unistd.h>
+#include <sys/ioctl.h>
 #include <gssrpc/rpc.h>
 #include <sys/socket.h>
 #include <port-sockets.h>
@@ -100,7 +101,14 @@ static struct xp_ops svctcp_rendezvous_op = {
 };
 
 static int readtcp(char *, caddr_t, int), writetcp(char *, caddr_t, int);
-static SVCXPRT *makefd_xprt(int, u_int, u_int);
+static SVCXPRT *makefd_xprt(int, u_int, u_int, bool_t);
+static SVCXPRT *accept_conn(SVCXPRT *, bool_t);
+
+/*
+ * Largest record accepted on a non-blocking connection, which must be
+ * buffered in full before it is decoded.
+ */
+#define MAX_NONBLOCK_RECORD (1024 * 1024)
 
 struct tcp_rendezvous { /* kept in xprt->xp_p1 */
 	u_int sendsize;
@@ -109,6 +117,11 @@ struct tcp_rendezvous { /* kept in xprt->xp_p1 */
 
 struct tcp_conn {  /* kept in xprt->xp_p1 */
 	enum xprt_stat strm_stat;
+	bool_t nonblock;
+	char *out_buf;		/* output queued on a non-blocking connection */
+	u_int out_size;
+	u_int out_start;	/* queued bytes are out_buf[out_start..out_end) */
+	u_int out_end;
 	uint32_t x_id;
 	XDR xdrs;
 	char verf_body[MAX_AUTH_BYTES];
@@ -216,20 +229,27 @@ svcfd_create(
 	u_int recvsize)
 {
 
-	return (makefd_xprt(fd, sendsize, recvsize));
+	return (makefd_xprt(fd, sendsize, recvsize, FALSE));
 }
 
+/*
+ * Create a connection transport for fd.  A blocking transport is driven
+ * through svc_fdset and must have a descriptor which fits in it; a
+ * non-blocking one is not registered there, and is driven by the caller
+ * with svc_getreq_xprt() and svctcp_flush().
+ */
 static SVCXPRT *
 makefd_xprt(
 	int fd,
 	u_int sendsize,
-	u_int recvsize)
+	u_int recvsize,
+	bool_t nonblock)
 {
 	register SVCXPRT *xprt;
 	register struct tcp_conn *cd;
 
 #ifdef FD_SETSIZE
-	if (fd >= FD_SETSIZE) {
+	if (!nonblock && fd >= FD_SETSIZE) {
 		(void) fprintf(stderr, "svc_tcp: makefd_xprt: fd too high\n");
 		xprt = NULL;
 		goto done;
@@ -254,8 +274,20 @@ makefd_xprt(
 		goto done;
 	}
 	cd->strm_stat = XPRT_IDLE;
+	cd->nonblock = nonblock;
+	cd->out_buf = NULL;
+	cd->out_size = cd->out_start = cd->out_end = 0;
 	xdrrec_create(&(cd->xdrs), sendsize, recvsize,
 	    (caddr_t)xprt, readtcp, writetcp);
+	if (nonblock &&
+	    !xdrrec_setnonblock(&(cd->xdrs), MAX_NONBLOCK_RECORD)) {
+		(void) fprintf(stderr, "svc_tcp: makefd_xprt: out of memory\n");
+		XDR_DESTROY(&(cd->xdrs));
+		mem_free((char *) cd, sizeof(struct tcp_conn));
+		mem_free((char *) xprt, sizeof(SVCXPRT));
+		xprt = (SVCXPRT *)NULL;
+		goto done;
+	}
 	xprt->xp_p2 = NULL;
 	xprt->xp_p1 = (caddr_t)cd;
 	xprt->xp_auth = NULL;
@@ -265,20 +297,26 @@ makefd_xprt(
 	xprt->xp_ops = &svctcp_op;  /* truely deals with calls */
 	xprt->xp_port = 0;  /* this is a connection, not a rendezvouser */
 	xprt->xp_sock = fd;
-	xprt_register(xprt);
+	if (!nonblock)
+		xprt_register(xprt);
     done:
 	return (xprt);
 }
 
-static bool_t
-rendezvous_request(
+/*
+ * Accept a connection on the rendezvouser xprt and make a transport for
+ * it.
+ */
+static SVCXPRT *
+accept_conn(
 	register SVCXPRT *xprt,
-	struct rpc_msg *msg)
+	bool_t nonblock)
 {
         SOCKET sock;
 	struct tcp_rendezvous *r;
 	struct sockaddr_in addr, laddr;
 	socklen_t len, llen;
+	int on = 1;
 
 	r = (struct tcp_rendezvous *)xprt->xp_p1;
     again:
@@ -287,27 +325,58 @@ rendezvous_request(
 	    &len)) < 0) {
 		if (errno == EINTR)
 			goto again;
-	       return (FALSE);
+	       return (NULL);
 	}
 	set_cloexec_fd(sock);
-	if (getsockname(sock, (struct sockaddr *) &laddr, &llen) < 0)
-	     return (FALSE);
+	if (getsockname(sock, (struct sockaddr *) &laddr, &llen) < 0 ||
+	    (nonblock && ioctlsocket(sock, FIONBIO, (void *)&on) != 0)) {
+                (void)closesocket(sock);
+		return (NULL);
+	}
 
 	/*
 	 * make a new transporter (re-uses xprt)
 	 */
-	xprt = makefd_xprt(sock, r->sendsize, r->recvsize);
+	xprt = makefd_xprt(sock, r->sendsize, r->recvsize, nonblock);
 	if (xprt == NULL) {
                 (void)closesocket(sock);
-		return (FALSE);
+		return (NULL);
 	}
 	xprt->xp_raddr = addr;
 	xprt->xp_addrlen = len;
 	xprt->xp_laddr = laddr;
 	xprt->xp_laddrlen = llen;
+	return (xprt);
+}
+
+static bool_t
+rendezvous_request(
+	register SVCXPRT *xprt,
+	struct rpc_msg *msg)
+{
+	(void)accept_conn(xprt, FALSE);
 	return (FALSE); /* there is never an rpc msg to be processed */
 }
 
+/*
+ * Usage:
+ *	newxprt = svctcp_accept(xprt);
+ *
+ * Accepts a pending connection on the rendezvouser xprt, for callers
+ * which run their own event loop.  The returned transport reads records
+ * without blocking, as data arrives, and is not limited to descriptors
+ * below FD_SETSIZE.  Replies which cannot be written at once are queued.
+ * While svctcp_output_pending() is false, the caller should call
+ * svc_getreq_xprt() whenever the socket (newxprt->xp_sock) is readable;
+ * otherwise it should call svctcp_flush() whenever the socket is
+ * writable.  Returns NULL if no connection could be accepted.
+ */
+SVCXPRT *
+svctcp_accept(SVCXPRT *xprt)
+{
+	return (accept_conn(xprt, TRUE));
+}
+
 static enum xprt_stat
 rendezvous_stat(register SVCXPRT *xprt)
 {
@@ -328,6 +397,8 @@ svctcp_destroy(register SVCXPRT *xprt)
 	} else {
 		/* an actual connection socket */
 		XDR_DESTROY(&(cd->xdrs));
+		if (cd->out_buf != NULL)
+			mem_free(cd->out_buf, cd->out_size);
 	}
 	if (xprt->xp_auth != NULL) {
 		SVCAUTH_DESTROY(xprt->xp_auth);
@@ -360,13 +431,26 @@ readtcp(
 #ifdef FD_SETSIZE
 	fd_set mask;
 	fd_set readfds;
-
-	FD_ZERO(&mask);
-	FD_SET(sock, &mask);
 #else
 	register int mask = 1 << sock;
 	int readfds;
 #endif /* def FD_SETSIZE */
+
+	/* Read only what is available; 0 means no data yet. */
+	if (((struct tcp_conn *)(xprt->xp_p1))->nonblock) {
+		len = read(sock, buf, (size_t) len);
+		if (len > 0)
+			return (len);
+		if (len < 0 && (errno == EAGAIN || errno == EWOULDBLOCK ||
+				errno == EINTR))
+			return (0);
+		goto fatal_err;
+	}
+
+#ifdef FD_SETSIZE
+	FD_ZERO(&mask);
+	FD_SET(sock, &mask);
+#endif /* def FD_SETSIZE */
 #ifdef FD_SETSIZE
 #define loopcond (!FD_ISSET(sock, &readfds))
 #else
@@ -391,9 +475,69 @@ fatal_err:
 	return (-1);
 }
 
+/*
+ * writes as much of the output queued on a non-blocking connection as the
+ * socket will accept.  Returns -1 on a fatal error.
+ */
+static int
+write_queued(register struct tcp_conn *cd, int sock)
+{
+	register int i;
+
+	while (cd->out_start < cd->out_end) {
+		i = write(sock, cd->out_buf + cd->out_start,
+		    (size_t)(cd->out_end - cd->out_start));
+		if (i < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				break;
+			cd->strm_stat = XPRT_DIED;
+			return (-1);
+		}
+		cd->out_start += i;
+	}
+	if (cd->out_start == cd->out_end)
+		cd->out_start = cd->out_end = 0;
+	return (0);
+}
+
+/*
+ * adds output to the queue of a non-blocking connection.
+ */
+static int
+queue_output(register struct tcp_conn *cd, caddr_t buf, int len)
+{
+	char *newbuf;
+	u_int pending = cd->out_end - cd->out_start;
+
+	if ((u_int)len > cd->out_size - cd->out_end) {
+		if (cd->out_start > 0) {
+			memmove(cd->out_buf, cd->out_buf + cd->out_start,
+			    pending);
+			cd->out_start = 0;
+			cd->out_end = pending;
+		}
+		if ((u_int)len > cd->out_size - cd->out_end) {
+			newbuf = realloc(cd->out_buf, pending + len);
+			if (newbuf == NULL) {
+				cd->strm_stat = XPRT_DIED;
+				return (-1);
+			}
+			cd->out_buf = newbuf;
+			cd->out_size = pending + len;
+		}
+	}
+	memcpy(cd->out_buf + cd->out_end, buf, (size_t)len);
+	cd->out_end += len;
+	return (len);
+}
+
 /*
  * writes data to the tcp connection.
- * Any error is fatal and the connection is closed.
+ * Any error is fatal and the connection is closed.  On a non-blocking
+ * connection, data which the socket will not accept yet is queued, to be
+ * written by svctcp_flush().
  */
 static int
 writetcp(
@@ -402,18 +546,59 @@ writetcp(
 	int len)
 {
 	register SVCXPRT *xprt = (SVCXPRT *)(void *) xprtptr;
+	register struct tcp_conn *cd = (struct tcp_conn *)(xprt->xp_p1);
 	register int i, cnt;
 
 	for (cnt = len; cnt > 0; cnt -= i, buf += i) {
+		/* Keep the output in order behind anything already queued. */
+		if (cd->nonblock && cd->out_end > cd->out_start)
+			return (queue_output(cd, buf, cnt) < 0 ? -1 : len);
 		if ((i = write(xprt->xp_sock, buf, (size_t) cnt)) < 0) {
-			((struct tcp_conn *)(xprt->xp_p1))->strm_stat =
-			    XPRT_DIED;
+			if (cd->nonblock && errno == EINTR) {
+				i = 0;
+				continue;
+			}
+			if (cd->nonblock &&
+			    (errno == EAGAIN || errno == EWOULDBLOCK))
+				return (queue_output(cd, buf, cnt) < 0 ?
+				    -1 : len);
+			cd->strm_stat = XPRT_DIED;
 			return (-1);
 		}
 	}
 	return (len);
 }
 
+/*
+ * Usage:
+ *	pending = svctcp_output_pending(xprt);
+ *
+ * Returns TRUE if output is queued on a transport from svctcp_accept().
+ */
+bool_t
+svctcp_output_pending(SVCXPRT *xprt)
+{
+	register struct tcp_conn *cd = (struct tcp_conn *)(xprt->xp_p1);
+
+	return (cd->out_end > cd->out_start);
+}
+
+/*
+ * Usage:
+ *	alive = svctcp_flush(xprt);
+ *
+ * Writes as much of the output queued on a transport from svctcp_accept()
+ * as its socket will accept, without blocking.  Returns FALSE if the
+ * connection has failed; the caller should then destroy the transport.
+ */
+bool_t
+svctcp_flush(SVCXPRT *xprt)
+{
+	register struct tcp_conn *cd = (struct tcp_conn *)(xprt->xp_p1);
+
+	return (write_queued(cd, xprt->xp_sock) == 0);
+}
+
 static enum xprt_stat
 svctcp_stat(SVCXPRT *xprt)
 {
@@ -422,6 +607,9 @@ svctcp_stat(SVCXPRT *xprt)
 
 	if (cd->strm_stat == XPRT_DIED)
 		return (XPRT_DIED);
+	/* Read no more requests until the queued replies are sent. */
+	if (cd->out_end > cd->out_start)
+		return (XPRT_IDLE);
 	if (! xdrrec_eof(&(cd->xdrs)))
 		return (XPRT_MOREREQS);
 	return (XPRT_IDLE);
@@ -435,9 +623,19 @@ svctcp_recv(
 	register struct tcp_conn *cd =
 	    (struct tcp_conn *)(xprt->xp_p1);
 	register XDR *xdrs = &(cd->xdrs);
+	bool_t died;
 
 	xdrs->x_op = XDR_DECODE;
-	(void)xdrrec_skiprecord(xdrs);
+	if (cd->nonblock) {
+		/* Wait until a whole record has arrived. */
+		if (!xdrrec_getrec(xdrs, &died)) {
+			if (died)
+				cd->strm_stat = XPRT_DIED;
+			return (FALSE);
+		}
+	} else {
+		(void)xdrrec_skiprecord(xdrs);
+	}
 	if (xdr_callmsg(xdrs, msg)) {
 		cd->x_id = msg->rm_xid;
 		return (TRUE);
@@ -117,6 +117,18 @@ typedef struct rec_strm {
 	bool_t last_frag;
 	u_int sendsize;
 	u_int recvsize;
+	/*
+	 * non-blocking record assembly (see xdrrec_setnonblock)
+	 */
+	bool_t nonblock;
+	caddr_t in_recbuf;	/* buffer holding the record being read */
+	u_int in_recbufsize;
+	u_int in_maxrec;	/* largest record we will accept */
+	uint32_t in_header;	/* current fragment header */
+	u_int in_hdrlen;	/* bytes of in_header read so far */
+	bool_t in_haveheader;	/* in_header is complete */
+	u_int in_reclen;	/* record bytes announced so far */
+	u_int in_received;	/* record bytes read so far */
 } RECSTREAM;
 
 static u_int	fix_buf_size(u_int);
@@ -188,6 +200,8 @@ xdrrec_create(
 	rstrm->in_finger = (rstrm->in_boundry += recvsize);
 	rstrm->fbtbc = 0;
 	rstrm->last_frag = TRUE;
+	rstrm->nonblock = FALSE;
+	rstrm->in_recbuf = NULL;
 }
 
 
@@ -390,6 +404,8 @@ xdrrec_destroy(XDR *xdrs)
 
 	mem_free(rstrm->the_buffer,
 		rstrm->sendsize + rstrm->recvsize + BYTES_PER_XDR_UNIT);
+	if (rstrm->in_recbuf != NULL)
+		mem_free(rstrm->in_recbuf, rstrm->in_recbufsize);
 	mem_free((caddr_t)rstrm, sizeof(RECSTREAM));
 }
 
@@ -440,6 +456,106 @@ xdrrec_eof(XDR *xdrs)
 	return (FALSE);
 }
 
+/*
+ * Switch the input side of the stream to non-blocking record assembly.
+ * Input is then read with xdrrec_getrec(), which collects each record in
+ * a buffer (growing it up to maxrec bytes) without waiting for data, so
+ * that decoding never calls readit.  In this mode readit must return 0
+ * instead of blocking when no data is available, and -1 on end of file
+ * or error.
+ */
+bool_t
+xdrrec_setnonblock(XDR *xdrs, u_int maxrec)
+{
+	register RECSTREAM *rstrm = (RECSTREAM *)(xdrs->x_private);
+
+	rstrm->in_recbuf = mem_alloc(rstrm->recvsize);
+	if (rstrm->in_recbuf == NULL)
+		return (FALSE);
+	rstrm->in_recbufsize = rstrm->recvsize;
+	rstrm->in_maxrec = maxrec;
+	rstrm->in_hdrlen = 0;
+	rstrm->in_haveheader = FALSE;
+	rstrm->in_reclen = rstrm->in_received = 0;
+	rstrm->in_base = rstrm->in_finger = rstrm->in_boundry =
+		rstrm->in_recbuf;
+	rstrm->fbtbc = 0;
+	rstrm->last_frag = TRUE;
+	rstrm->nonblock = TRUE;
+	return (TRUE);
+}
+
+/*
+ * Read as much of the next record as is available from a non-blocking
+ * stream.  Return TRUE once the whole record has been received; it can
+ * then be decoded without further reads.  Otherwise return FALSE, with
+ * *died set if the stream failed or the record is too large.
+ */
+bool_t
+xdrrec_getrec(XDR *xdrs, bool_t *died)
+{
+	register RECSTREAM *rstrm = (RECSTREAM *)(xdrs->x_private);
+	uint32_t fraglen;
+	caddr_t newbuf;
+	int n = 0;
+
+	*died = FALSE;
+	for (;;) {
+		if (!rstrm->in_haveheader) {
+			n = (*(rstrm->readit))(rstrm->tcp_handle,
+			    (caddr_t)&rstrm->in_header + rstrm->in_hdrlen,
+			    (int)(sizeof(rstrm->in_header) - rstrm->in_hdrlen));
+			if (n <= 0)
+				break;
+			rstrm->in_hdrlen += n;
+			if (rstrm->in_hdrlen < sizeof(rstrm->in_header))
+				continue;
+			rstrm->in_header = ntohl(rstrm->in_header);
+			fraglen = rstrm->in_header & ~LAST_FRAG;
+			if (fraglen > rstrm->in_maxrec - rstrm->in_reclen) {
+				*died = TRUE;
+				return (FALSE);
+			}
+			if (rstrm->in_reclen + fraglen > rstrm->in_recbufsize) {
+				newbuf = realloc(rstrm->in_recbuf,
+						 rstrm->in_reclen + fraglen);
+				if (newbuf == NULL) {
+					*died = TRUE;
+					return (FALSE);
+				}
+				rstrm->in_recbuf = newbuf;
+				rstrm->in_recbufsize = rstrm->in_reclen + fraglen;
+			}
+			rstrm->in_reclen += fraglen;
+			rstrm->in_haveheader = TRUE;
+		}
+		if (rstrm->in_received < rstrm->in_reclen) {
+			n = (*(rstrm->readit))(rstrm->tcp_handle,
+			    rstrm->in_recbuf + rstrm->in_received,
+			    (int)(rstrm->in_reclen - rstrm->in_received));
+			if (n <= 0)
+				break;
+			rstrm->in_received += n;
+			if (rstrm->in_received < rstrm->in_reclen)
+				continue;
+		}
+		/* The fragment is complete. */
+		rstrm->in_haveheader = FALSE;
+		rstrm->in_hdrlen = 0;
+		if (rstrm->in_header & LAST_FRAG) {
+			rstrm->in_base = rstrm->in_finger = rstrm->in_recbuf;
+			rstrm->in_boundry = rstrm->in_recbuf + rstrm->in_reclen;
+			rstrm->fbtbc = rstrm->in_reclen;
+			rstrm->last_frag = TRUE;
+			rstrm->in_reclen = rstrm->in_received = 0;
+			return (TRUE);
+		}
+	}
+	if (n < 0)
+		*died = TRUE;
+	return (FALSE);
+}
+
 /*
  * The client must tell the package when an end-of-record has occurred.
  * The second paraemters tells whether the record should be flushed to the
@@ -494,6 +610,9 @@ fill_input_buf(RECSTREAM *rstrm)
 	u_int i;
 	register int len;
 
+	/* A non-blocking stream only decodes fully received records. */
+	if (rstrm->nonblock)
+		return (FALSE);
 	where = rstrm->in_base;
 	i = (u_int)((u_long)rstrm->in_boundry % BYTES_PER_XDR_UNIT);
 	where += i;
@@ -28,12 +28,14 @@
  * @file plugins/kadm5_hook/test/main.c
  *
  * This is a test kadm5_hook plugin. If enabled, it will print when kadm5_hook
- * calls are made.
+ * calls are made.  Creating the principal "slowhook" takes an extra second.
  */
 
 #include <krb5/krb5.h>
 #include <krb5/kadm5_hook_plugin.h>
 #include <stdio.h>
+#include <string.h>
+#include <unistd.h>
 #include <assert.h>
 
 static void
@@ -77,7 +79,17 @@ create(krb5_context context,
        krb5_key_salt_tuple *ks_tuple,
        const char *newpass)
 {
+    char *unparsed;
+
     log_call(context, "create", stage, princ->principal);
+
+    /* Simulate a slow module for the "slowhook" principal. */
+    if (stage == KADM5_HOOK_STAGE_PRECOMMIT &&
+        krb5_unparse_name(context, princ->principal, &unparsed) == 0) {
+        if (strncmp(unparsed, "slowhook@", 9) == 0)
+            sleep(1);
+        krb5_free_unparsed_name(context, unparsed);
+    }
     return 0;
 }
 
@@ -110,6 +110,8 @@ WRAP_K (krb5_db2_lock,
           int             in_mode),
         (context, in_mode));
 WRAP_K (krb5_db2_unlock, (krb5_context ctx), (ctx));
+WRAP_K (krb5_db2_begin_txn, (krb5_context ctx), (ctx));
+WRAP_K (krb5_db2_end_txn, (krb5_context ctx), (ctx));
 
 WRAP_K (krb5_db2_get_principal,
         (krb5_context ctx,
@@ -137,6 +139,12 @@ WRAP_K (krb5_db2_iterate,
                                krb5_db_entry *),
          krb5_pointer p, krb5_flags flags),
         (ctx, s, f, p, flags));
+WRAP_K (krb5_db2_iterate_after,
+        (krb5_context ctx, char *s, krb5_const_principal start,
+         krb5_error_code (*f) (krb5_pointer,
+                               krb5_db_entry *),
+         krb5_pointer p),
+        (ctx, s, start, f, p));
 
 WRAP_K (krb5_db2_create_policy,
         (krb5_context context, osa_policy_ent_t entry),
@@ -233,5 +241,9 @@ kdb_vftabl PLUGIN_SYMBOL_NAME(krb5_db2, kdb_function_table) = {
     /* check_policy_as */               wrap_krb5_db2_check_policy_as,
     0,
     /* audit_as_req */                  wrap_krb5_db2_audit_as_req,
-    0, 0
+    0, 0,
+    /* begin_txn */                     wrap_krb5_db2_begin_txn,
+    /* commit_txn */                    wrap_krb5_db2_end_txn,
+    /* abort_txn */                     wrap_krb5_db2_end_txn,
+    /* iterate_after */                 wrap_krb5_db2_iterate_after
 };
@@ -68,11 +68,33 @@
 
 #define KDB_DB2_DATABASE_NAME "database_name"
 
+#define DEFAULT_PAGE_SIZE 4096
+
+/* Seconds between page cache statistics traces for a handle kept open. */
+#define CACHE_STATS_INTERVAL 300
+
+/*
+ * Key of the record naming the realm which is omitted from the keys of that
+ * realm's principals, present only in databases created with short_keys.  It
+ * cannot collide with a principal key, which is an unparsed principal name
+ * with a single terminating null byte.
+ */
+#define KEY_REALM_KEY "\0key_realm"
+#define KEY_REALM_KEYLEN (sizeof(KEY_REALM_KEY) - 1)
+
 #define SUFFIX_DB ""
 #define SUFFIX_LOCK ".ok"
 #define SUFFIX_POLICY ".kadm5"
 #define SUFFIX_POLICY_LOCK ".kadm5.lock"
 
+/*
+ * Page cache size used for temporary databases.  A temporary database is
+ * written only by kdb5_util load, which stores every record of a dump in one
+ * pass; the default cache of a handful of pages would cause most puts to
+ * write back and re-read interior btree pages.
+ */
+#define TEMPDB_CACHESIZE (32 * 1024 * 1024)
+
 /*
  * Locking:
  *
@@ -160,6 +182,7 @@ ctx_clear(krb5_db2_context *dbc)
      */
     free(dbc->db_lf_name);
     free(dbc->db_name);
+    free(dbc->key_realm);
     /*
      * Clear the structure and reset the defaults.
      */
@@ -205,7 +228,7 @@ configure_context(krb5_context context, char *conf_section, char **db_args)
     krb5_db2_context *dbc;
     char **t_ptr, *opt = NULL, *val = NULL, *pval = NULL;
     profile_t profile = KRB5_DB_GET_PROFILE(context);
-    int bval;
+    int bval, ival;
 
     status = ctx_get(context, &dbc);
     if (status != 0)
@@ -218,6 +241,36 @@ configure_context(krb5_context context, char *conf_section, char **db_args)
         goto cleanup;
     dbc->unlockiter = bval;
 
+    status = profile_get_integer(profile, KDB_MODULE_SECTION, conf_section,
+                                 KRB5_CONF_DB_CACHE_SIZE, 0, &ival);
+    if (status != 0)
+        goto cleanup;
+    if (ival < 0) {
+        status = EINVAL;
+        k5_setmsg(context, status, _("Invalid db2 cache size %d"), ival);
+        goto cleanup;
+    }
+    dbc->cache_size = ival;
+
+    status = profile_get_integer(profile, KDB_MODULE_SECTION, conf_section,
+                                 KRB5_CONF_DB_PAGE_SIZE, DEFAULT_PAGE_SIZE,
+                                 &ival);
+    if (status != 0)
+        goto cleanup;
+    /* libdb2 requires a power of two between 512 and 64K. */
+    if (ival < 512 || ival > 65536 || (ival & (ival - 1)) != 0) {
+        status = EINVAL;
+        k5_setmsg(context, status, _("Invalid db2 page size %d"), ival);
+        goto cleanup;
+    }
+    dbc->page_size = ival;
+
+    status = profile_get_boolean(profile, KDB_MODULE_SECTION, conf_section,
+                                 KRB5_CONF_SHORT_KEYS, FALSE, &bval);
+    if (status != 0)
+        goto cleanup;
+    dbc->short_keys = bval;
+
     for (t_ptr = db_args; t_ptr && *t_ptr; t_ptr++) {
         free(opt);
         free(val);
@@ -344,9 +397,18 @@ open_db(krb5_db2_context *dbc, int flags, int mode)
     DB *db;
     BTREEINFO bti;
     HASHINFO hashi;
+    unsigned int cachesize, psize;
+
+    /* A cache size of 0 lets libdb2 pick its small default.  The page size
+     * only takes effect when the database is created. */
+    cachesize = dbc->cache_size;
+    if (dbc->tempdb && cachesize < TEMPDB_CACHESIZE)
+        cachesize = TEMPDB_CACHESIZE;
+    psize = dbc->page_size ? dbc->page_size : DEFAULT_PAGE_SIZE;
+
     bti.flags = 0;
-    bti.cachesize = 0;
-    bti.psize = 4096;
+    bti.cachesize = cachesize;
+    bti.psize = psize;
     bti.lorder = 0;
     bti.minkeypage = 0;
     bti.compare = NULL;
@@ -357,8 +419,8 @@ open_db(krb5_db2_context *dbc, int flags, int mode)
         return NULL;
     }
 
-    hashi.bsize = 4096;
-    hashi.cachesize = 0;
+    hashi.bsize = psize;
+    hashi.cachesize = cachesize;
     hashi.ffactor = 40;
     hashi.hash = NULL;
     hashi.lorder = 0;
@@ -394,21 +456,162 @@ done:
     return db;
 }
 
+/* Record the status of the DB and lock files for a newly opened handle. */
+static void
+ctx_record_open(krb5_db2_context *dbc)
+{
+    char *fname;
+
+    dbc->db_pid = 0;
+    if (ctx_dbsuffix(dbc, SUFFIX_DB, &fname) != 0)
+        return;
+    if (stat(fname, &dbc->db_st) == 0 &&
+        fstat(dbc->db_lf_file, &dbc->db_lf_st) == 0)
+        dbc->db_pid = getpid();
+    free(fname);
+}
+
+/*
+ * Return true if the read-only handle in dbc->db, left open by ctx_unlock(),
+ * can be reused.  Every modification of the DB updates the lock file's
+ * timestamp (see ctx_update_age()), and a load replaces the DB file, so the
+ * handle is stale if either has changed since it was opened.  The caller must
+ * hold a lock on the DB.
+ */
+static krb5_boolean
+ctx_db_unchanged(krb5_db2_context *dbc)
+{
+    struct stat st, lf_st;
+    char *fname;
+    int ret;
+
+    /* Don't share a file offset with a parent or child process. */
+    if (dbc->db_pid != getpid())
+        return FALSE;
+    if (fstat(dbc->db_lf_file, &lf_st) != 0)
+        return FALSE;
+    if (ctx_dbsuffix(dbc, SUFFIX_DB, &fname) != 0)
+        return FALSE;
+    ret = stat(fname, &st);
+    free(fname);
+    if (ret != 0)
+        return FALSE;
+    return lf_st.st_mtime == dbc->db_lf_st.st_mtime &&
+        st.st_dev == dbc->db_st.st_dev && st.st_ino == dbc->db_st.st_ino &&
+        st.st_size == dbc->db_st.st_size &&
+        st.st_mtime == dbc->db_st.st_mtime;
+}
+
+/* Read the key realm record of the newly opened DB into dbc->key_realm. */
+static krb5_error_code
+ctx_read_key_realm(krb5_db2_context *dbc)
+{
+    krb5_error_code retval;
+    DB *db = dbc->db;
+    DBT key, contents;
+    int dbret;
+
+    free(dbc->key_realm);
+    dbc->key_realm = NULL;
+
+    key.data = (char *)KEY_REALM_KEY;
+    key.size = KEY_REALM_KEYLEN;
+    dbret = db->get(db, &key, &contents, 0);
+    if (dbret == 1)
+        return 0;
+    else if (dbret != 0)
+        return errno;
+    dbc->key_realm = k5memdup0(contents.data, contents.size, &retval);
+    return retval;
+}
+
+/* Record in the newly created DB that keys omit the realm of context. */
+static krb5_error_code
+ctx_write_key_realm(krb5_context context, krb5_db2_context *dbc)
+{
+    DB *db = dbc->db;
+    DBT key, contents;
+    char *realm = KRB5_DB_GET_REALM(context);
+
+    dbc->key_realm = strdup(realm);
+    if (dbc->key_realm == NULL)
+        return ENOMEM;
+    key.data = (char *)KEY_REALM_KEY;
+    key.size = KEY_REALM_KEYLEN;
+    contents.data = realm;
+    contents.size = strlen(realm);
+    return db->put(db, &key, &contents, 0) ? errno : 0;
+}
+
+/* Return true if key is the key realm record rather than a principal key. */
+static inline krb5_boolean
+is_key_realm_key(const DBT *key)
+{
+    return key->size == KEY_REALM_KEYLEN &&
+        memcmp(key->data, KEY_REALM_KEY, KEY_REALM_KEYLEN) == 0;
+}
+
+/*
+ * Set *key to the DB key for princ.  The key is the unparsed principal name
+ * including its terminating null byte, with the realm omitted if it is the
+ * key realm of the DB.
+ */
+static krb5_error_code
+ctx_encode_dbkey(krb5_context context, krb5_db2_context *dbc,
+                 krb5_const_principal princ, krb5_data *key)
+{
+    krb5_error_code retval;
+    char *name;
+
+    if (dbc->key_realm == NULL ||
+        !data_eq_string(princ->realm, dbc->key_realm))
+        return krb5_encode_princ_dbkey(context, key, princ);
+
+    retval = krb5_unparse_name_flags(context, princ,
+                                     KRB5_PRINCIPAL_UNPARSE_NO_REALM, &name);
+    if (retval)
+        return retval;
+    *key = make_data(name, strlen(name) + 1);
+    return 0;
+}
+
+/* Trace the page cache statistics of the open DB handle in dbc. */
+static void
+ctx_trace_stats(krb5_context context, krb5_db2_context *dbc)
+{
+    DBSTAT st;
+
+    if (dbstat(dbc->db, &st) == 0)
+        TRACE_DB2_CACHE_STATS(context, dbc->db_name, &st);
+    dbc->stats_time = time(NULL);
+}
+
+/* Close the DB handle in dbc, tracing its page cache statistics. */
+static void
+ctx_close_db(krb5_context context, krb5_db2_context *dbc)
+{
+    if (dbc->db == NULL)
+        return;
+    ctx_trace_stats(context, dbc);
+    dbc->db->close(dbc->db);
+    dbc->db = NULL;
+}
+
 static krb5_error_code
 ctx_unlock(krb5_context context, krb5_db2_context *dbc)
 {
     krb5_error_code retval, retval2;
-    DB *db;
 
     retval = osa_adb_release_lock(dbc->policy_db);
 
     if (!dbc->db_locks_held) /* lock already unlocked */
         return KRB5_KDB_NOTLOCKED;
 
-    db = dbc->db;
     if (--(dbc->db_locks_held) == 0) {
-        db->close(db);
-        dbc->db = NULL;
+        /* Keep a read-only handle open, so that the next shared lock can
+         * reuse it and its page cache if the DB has not changed. */
+        if (dbc->db_lock_mode != KRB5_LOCKMODE_SHARED || dbc->db_pid == 0)
+            ctx_close_db(context, dbc);
         dbc->db_lock_mode = 0;
 
         retval2 = krb5_lock_file(context, dbc->db_lf_file,
@@ -448,23 +651,50 @@ ctx_lock(krb5_context context, krb5_db2_context *dbc, int lockmode)
         else if (retval)
             return retval;
 
-        /* Open the DB (or re-open it for read/write). */
-        if (dbc->db != NULL)
-            dbc->db->close(dbc->db);
-        dbc->db = open_db(dbc,
-                          kmode == KRB5_LOCKMODE_SHARED ? O_RDONLY : O_RDWR,
-                          0600);
-        if (dbc->db == NULL) {
-            retval = errno;
-            dbc->db_locks_held = 0;
-            dbc->db_lock_mode = 0;
-            (void) osa_adb_release_lock(dbc->policy_db);
-            (void) krb5_lock_file(context, dbc->db_lf_file,
-                                  KRB5_LOCKMODE_UNLOCK);
-            return retval;
-        }
+        /* Reuse a read-only handle left open by ctx_unlock() if the DB has
+         * not changed; otherwise open the DB (or re-open it for
+         * read/write). */
+        if (dbc->db != NULL && dbc->db_locks_held == 0 &&
+            kmode == KRB5_LOCKMODE_SHARED && ctx_db_unchanged(dbc)) {
+            dbc->db_lock_mode = kmode;
+            /* A reused handle may stay open for the life of the process
+             * (as in the KDC), so trace its statistics periodically. */
+            if (time(NULL) - dbc->stats_time >= CACHE_STATS_INTERVAL)
+                ctx_trace_stats(context, dbc);
+        } else {
+            ctx_close_db(context, dbc);
+            dbc->db = open_db(dbc,
+                              kmode == KRB5_LOCKMODE_SHARED ? O_RDONLY :
+                              O_RDWR, 0600);
+            if (dbc->db == NULL) {
+                retval = errno;
+                dbc->db_locks_held = 0;
+                dbc->db_lock_mode = 0;
+                (void) osa_adb_release_lock(dbc->policy_db);
+                (void) krb5_lock_file(context, dbc->db_lf_file,
+                                      KRB5_LOCKMODE_UNLOCK);
+                return retval;
+            }
+            dbc->db_lock_mode = kmode;
+            dbc->stats_time = time(NULL);
+
+            retval = ctx_read_key_realm(dbc);
+            if (retval) {
+                ctx_close_db(context, dbc);
+                dbc->db_locks_held = 0;
+                dbc->db_lock_mode = 0;
+                (void) osa_adb_release_lock(dbc->policy_db);
+                (void) krb5_lock_file(context, dbc->db_lf_file,
+                                      KRB5_LOCKMODE_UNLOCK);
+                return retval;
+            }
 
-        dbc->db_lock_mode = kmode;
+            /* Only a read-only handle is kept open while unlocked. */
+            if (kmode == KRB5_LOCKMODE_SHARED && !dbc->tempdb)
+                ctx_record_open(dbc);
+            else
+                dbc->db_pid = 0;
+        }
     }
     dbc->db_locks_held++;
 
@@ -522,8 +752,11 @@ cleanup:
 }
 
 static void
-ctx_fini(krb5_db2_context *dbc)
+ctx_fini(krb5_context context, krb5_db2_context *dbc)
 {
+    /* Close a read-only handle left open by ctx_unlock(). */
+    if (dbc->db_locks_held == 0)
+        ctx_close_db(context, dbc);
     if (dbc->db_lf_file != -1)
         (void) close(dbc->db_lf_file);
     if (dbc->policy_db)
@@ -536,7 +769,7 @@ krb5_error_code
 krb5_db2_fini(krb5_context context)
 {
     if (context->dal_handle->db_context != NULL) {
-        ctx_fini(context->dal_handle->db_context);
+        ctx_fini(context, context->dal_handle->db_context);
         context->dal_handle->db_context = NULL;
     }
     return 0;
@@ -588,6 +821,13 @@ ctx_update_age(krb5_db2_context *dbc)
     time_t now;
     struct utimbuf utbuf;
 
+    /* A temporary DB is exclusively locked for its whole lifetime, so no
+     * reader can be watching its age; the real lockfile is updated when the
+     * temporary DB is promoted.  Likewise, the age is updated once at the end
+     * of a transaction. */
+    if (dbc->tempdb || dbc->in_txn)
+        return;
+
     now = time((time_t *) NULL);
     if (fstat(dbc->db_lf_file, &st) != 0)
         return;
@@ -615,6 +855,46 @@ krb5_db2_unlock(krb5_context context)
     return ctx_unlock(context, context->dal_handle->db_context);
 }
 
+/*
+ * Begin a transaction by taking an exclusive lock, which keeps the DB handle
+ * open and its page cache warm across the puts and deletes of the batch.
+ */
+krb5_error_code
+krb5_db2_begin_txn(krb5_context context)
+{
+    krb5_error_code retval;
+    krb5_db2_context *dbc;
+
+    if (!inited(context))
+        return KRB5_KDB_DBNOTINITED;
+    dbc = context->dal_handle->db_context;
+    retval = ctx_lock(context, dbc, KRB5_DB_LOCKMODE_EXCLUSIVE);
+    if (retval)
+        return retval;
+    dbc->in_txn = TRUE;
+    return 0;
+}
+
+/*
+ * End a transaction, updating the DB age and releasing the lock taken by
+ * krb5_db2_begin_txn().  The DB cannot roll back changes, so this is used for
+ * both commit and abort; changes made before an abort are kept.
+ */
+krb5_error_code
+krb5_db2_end_txn(krb5_context context)
+{
+    krb5_db2_context *dbc;
+
+    if (!inited(context))
+        return KRB5_KDB_DBNOTINITED;
+    dbc = context->dal_handle->db_context;
+    if (!dbc->in_txn)
+        return KRB5_KDB_NOTLOCKED;
+    dbc->in_txn = FALSE;
+    ctx_update_age(dbc);
+    return ctx_unlock(context, dbc);
+}
+
 /* Zero out and unlink filename. */
 static krb5_error_code
 destroy_file(char *filename)
@@ -721,6 +1001,11 @@ ctx_create_db(krb5_context context, krb5_db2_context *dbc)
         retval = errno;
         goto cleanup;
     }
+    if (dbc->short_keys) {
+        retval = ctx_write_key_realm(context, dbc);
+        if (retval)
+            goto cleanup;
+    }
 
     /* Create the policy database, initialize a handle to it, and lock it. */
     retval = osa_adb_create_db(polname, plockname, OSA_ADB_POLICY_DB_MAGIC);
@@ -775,8 +1060,7 @@ krb5_db2_get_principal(krb5_context context, krb5_const_principal searchfor,
     if (retval)
         return retval;
 
-    /* XXX deal with wildcard lookups */
-    retval = krb5_encode_princ_dbkey(context, &keydata, searchfor);
+    retval = ctx_encode_dbkey(context, dbc, searchfor, &keydata);
     if (retval)
         goto cleanup;
     key.data = keydata.data;
@@ -796,7 +1080,10 @@ krb5_db2_get_principal(krb5_context context, krb5_const_principal searchfor,
     case 0:
         contdata.data = contents.data;
         contdata.length = contents.size;
-        retval = krb5_decode_princ_entry(context, &contdata, entry);
+        if (dbc->packed_entries)
+            retval = krb5_decode_packed_princ_entry(context, &contdata, entry);
+        else
+            retval = krb5_decode_princ_entry(context, &contdata, entry);
         break;
     }
 
@@ -809,7 +1096,12 @@ cleanup:
 void
 krb5_db2_free_principal(krb5_context context, krb5_db_entry *entry)
 {
-    krb5_dbe_free(context, entry);
+    krb5_db2_context *dbc = context->dal_handle->db_context;
+
+    if (dbc != NULL && dbc->packed_entries)
+        krb5_dbe_free_packed(context, entry);
+    else
+        krb5_dbe_free(context, entry);
 }
 
 krb5_error_code
@@ -845,7 +1137,7 @@ krb5_db2_put_principal(krb5_context context, krb5_db_entry *entry,
         goto cleanup;
     contents.data = contdata.data;
     contents.size = contdata.length;
-    retval = krb5_encode_princ_dbkey(context, &keydata, entry->princ);
+    retval = ctx_encode_dbkey(context, dbc, entry->princ, &keydata);
     if (retval) {
         krb5_free_data_contents(context, &contdata);
         goto cleanup;
@@ -882,7 +1174,7 @@ krb5_db2_delete_principal(krb5_context context, krb5_const_principal searchfor)
     if ((retval = ctx_lock(context, dbc, KRB5_LOCKMODE_EXCLUSIVE)))
         return (retval);
 
-    if ((retval = krb5_encode_princ_dbkey(context, &keydata, searchfor)))
+    if ((retval = ctx_encode_dbkey(context, dbc, searchfor, &keydata)))
         goto cleanup;
     key.data = keydata.data;
     key.size = keydata.length;
@@ -944,6 +1236,8 @@ typedef struct iter_curs {
     DBT key;
     DBT data;
     DBT keycopy;
+    DBT prefix;
+    DBT start;
     unsigned int startflag;
     unsigned int stepflag;
     krb5_context ctx;
@@ -973,13 +1267,44 @@ curs_unlock(iter_curs *curs)
     curs->islocked = FALSE;
 }
 
-/* Set up curs and lock DB. */
+/*
+ * Set prefix to the literal prefix of the glob pattern match_expr, up to the
+ * first wildcard, escape, or realm separator.  Keys of principals matching
+ * the pattern begin with this prefix, whether or not the realm is omitted from
+ * them.
+ */
+static void
+glob_prefix(const char *match_expr, DBT *prefix)
+{
+    prefix->data = (char *)match_expr;
+    prefix->size = (match_expr == NULL) ? 0 : strcspn(match_expr, "*?[\\@");
+}
+
+/* Compare two DB keys in the order of the default btree comparison. */
+static int
+key_cmp(const DBT *a, const DBT *b)
+{
+    size_t len = (a->size < b->size) ? a->size : b->size;
+    int cmp;
+
+    cmp = (len == 0) ? 0 : memcmp(a->data, b->data, len);
+    if (cmp != 0)
+        return cmp;
+    return (a->size > b->size) - (a->size < b->size);
+}
+
+/* Set up curs and lock DB.  If start is not NULL, iteration is in key order
+ * and begins after the key start (if it is not empty). */
 static krb5_error_code
 curs_init(iter_curs *curs, krb5_context ctx, krb5_db2_context *dbc,
-          krb5_flags iterflags)
+          char *match_expr, const DBT *start, krb5_flags iterflags)
 {
     curs->keycopy.size = 0;
     curs->keycopy.data = NULL;
+    curs->start.size = 0;
+    curs->start.data = NULL;
+    if (start != NULL)
+        curs->start = *start;
     curs->islocked = FALSE;
     curs->ctx = ctx;
     curs->dbc = dbc;
@@ -996,18 +1321,49 @@ curs_init(iter_curs *curs, krb5_context ctx, krb5_db2_context *dbc,
         curs->startflag = R_FIRST;
         curs->stepflag = R_NEXT;
     }
+
+    /* Principals are only found in key order in a btree DB, so a prefix
+     * can only bound forward iteration of one. */
+    glob_prefix(match_expr, &curs->prefix);
+    if ((iterflags & KRB5_DB_ITER_REV) || dbc->hashfirst)
+        curs->prefix.size = 0;
     return curs_lock(curs);
 }
 
-/* Get initial entry. */
+/* Get initial entry.  With a start key, seek to the first key after it; with a
+ * prefix, seek to the first key not less than it instead of starting at the
+ * beginning. */
 static int
 curs_start(iter_curs *curs)
 {
     DB *db = curs->dbc->db;
+    int dbret;
 
+    if (curs->start.size > 0 && key_cmp(&curs->start, &curs->prefix) > 0) {
+        curs->key = curs->start;
+        dbret = db->seq(db, &curs->key, &curs->data, R_CURSOR);
+        if (dbret == 0 && key_cmp(&curs->key, &curs->start) == 0)
+            dbret = db->seq(db, &curs->key, &curs->data, R_NEXT);
+        return dbret;
+    }
+    if (curs->prefix.size > 0) {
+        curs->key = curs->prefix;
+        return db->seq(db, &curs->key, &curs->data, R_CURSOR);
+    }
     return db->seq(db, &curs->key, &curs->data, curs->startflag);
 }
 
+/* Return true if the current key is past the keys beginning with the prefix,
+ * and iteration can stop. */
+static krb5_boolean
+curs_done(iter_curs *curs)
+{
+    if (curs->prefix.size == 0)
+        return FALSE;
+    return curs->key.size < curs->prefix.size ||
+        memcmp(curs->key.data, curs->prefix.data, curs->prefix.size) != 0;
+}
+
 /* Save iteration state so DB can be unlocked/closed. */
 static krb5_error_code
 curs_save(iter_curs *curs)
@@ -1041,7 +1397,7 @@ curs_step(iter_curs *curs)
     int dbret;
     krb5_db2_context *dbc = curs->dbc;
 
-    if (dbc->unlockiter) {
+    if (dbc->unlockiter && curs->keycopy.data != NULL) {
         /* Reacquire libdb cursor using saved copy of key. */
         curs->key = curs->keycopy;
         dbret = dbc->db->seq(dbc->db, &curs->key, &curs->data, R_CURSOR);
@@ -1097,19 +1453,31 @@ curs_fini(iter_curs *curs)
 }
 
 static krb5_error_code
-ctx_iterate(krb5_context context, krb5_db2_context *dbc,
-            ctx_iterate_cb func, krb5_pointer func_arg, krb5_flags iterflags)
+ctx_iterate(krb5_context context, krb5_db2_context *dbc, char *match_expr,
+            const DBT *start, ctx_iterate_cb func, krb5_pointer func_arg,
+            krb5_flags iterflags)
 {
     krb5_error_code retval;
     int dbret;
     iter_curs curs;
 
-    retval = curs_init(&curs, context, dbc, iterflags);
+    retval = curs_init(&curs, context, dbc, match_expr, start, iterflags);
+    if (retval) {
+        curs_fini(&curs);
+        return retval;
+    }
+    /* A hash DB has no key order to resume from. */
+    if (start != NULL && dbc->hashfirst) {
+        curs_fini(&curs);
+        return KRB5_PLUGIN_OP_NOTSUPP;
+    }
     dbret = curs_start(&curs);
-    while (dbret == 0) {
-        retval = curs_run_cb(&curs, func, func_arg);
-        if (retval)
-            goto cleanup;
+    while (dbret == 0 && !curs_done(&curs)) {
+        if (!is_key_realm_key(&curs.key)) {
+            retval = curs_run_cb(&curs, func, func_arg);
+            if (retval)
+                goto cleanup;
+        }
         dbret = curs_step(&curs);
     }
     switch (dbret) {
@@ -1131,8 +1499,36 @@ krb5_db2_iterate(krb5_context context, char *match_expr, ctx_iterate_cb func,
 {
     if (!inited(context))
         return KRB5_KDB_DBNOTINITED;
-    return ctx_iterate(context, context->dal_handle->db_context, func,
-                       func_arg, iterflags);
+    return ctx_iterate(context, context->dal_handle->db_context, match_expr,
+                       NULL, func, func_arg, iterflags);
+}
+
+krb5_error_code
+krb5_db2_iterate_after(krb5_context context, char *match_expr,
+                       krb5_const_principal start, ctx_iterate_cb func,
+                       krb5_pointer func_arg)
+{
+    krb5_error_code retval;
+    krb5_db2_context *dbc;
+    krb5_data keydata;
+    DBT key;
+
+    if (!inited(context))
+        return KRB5_KDB_DBNOTINITED;
+    dbc = context->dal_handle->db_context;
+
+    /* An empty start key requests key order from the beginning. */
+    keydata = empty_data();
+    if (start != NULL) {
+        retval = ctx_encode_dbkey(context, dbc, start, &keydata);
+        if (retval)
+            return retval;
+    }
+    key.data = keydata.data;
+    key.size = keydata.length;
+    retval = ctx_iterate(context, dbc, match_expr, &key, func, func_arg, 0);
+    krb5_free_data_contents(context, &keydata);
+    return retval;
 }
 
 krb5_boolean
@@ -1171,6 +1567,7 @@ krb5_db2_open(krb5_context context, char *conf_section, char **db_args,
               int mode)
 {
     krb5_error_code status = 0;
+    krb5_db2_context *dbc;
 
     krb5_clear_error_message(context);
     if (inited(context))
@@ -1184,7 +1581,15 @@ krb5_db2_open(krb5_context context, char *conf_section, char **db_args,
     if (status != 0)
         return status;
 
-    return ctx_init(context->dal_handle->db_context);
+    /*
+     * The KDC only reads entries and updates their scalar fields, so it can
+     * use entries decoded into a single allocation.  Administrative programs
+     * free and replace parts of entries as they modify them.
+     */
+    dbc = context->dal_handle->db_context;
+    dbc->packed_entries = (mode & KRB5_KDB_SRV_TYPE_KDC) != 0;
+
+    return ctx_init(dbc);
 }
 
 krb5_error_code
@@ -1415,7 +1820,9 @@ ctx_merge_nra(krb5_context context, krb5_db2_context *dbc_temp,
 
     nra.kcontext = context;
     nra.db_context = dbc_real;
-    return ctx_iterate(context, dbc_temp, krb5_db2_merge_nra_iterator, &nra, 0);
+    return ctx_iterate(context, dbc_temp, NULL, NULL,
+                       krb5_db2_merge_nra_iterator,
+                       &nra, 0);
 }
 
 /*
@@ -1525,6 +1932,13 @@ krb5_db2_promote_db(krb5_context context, char *conf_section, char **db_args)
             goto cleanup;
     }
 
+    /* Flush the temporary DB's page cache so that no pages are written after
+     * it becomes visible under the real name. */
+    if (dbc_temp->db->sync(dbc_temp->db, 0) != 0) {
+        retval = errno;
+        goto cleanup;
+    }
+
     /* Perform filesystem manipulations for the promotion. */
     retval = ctx_promote(context, dbc_temp, dbc_real);
     if (retval)
@@ -1538,7 +1952,7 @@ cleanup:
     if (real_locked)
         (void) ctx_unlock(context, dbc_real);
     if (dbc_real)
-        ctx_fini(dbc_real);
+        ctx_fini(context, dbc_real);
     return retval;
 }
 
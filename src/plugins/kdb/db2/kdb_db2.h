@@ -48,6 +48,17 @@ typedef struct _krb5_db2_context {
     krb5_boolean        disable_last_success;
     krb5_boolean        disable_lockout;
     krb5_boolean        unlockiter;
+    unsigned int        cache_size;     /* Page cache size in bytes     */
+    unsigned int        page_size;      /* Page size for new databases  */
+    krb5_boolean        short_keys;     /* Omit realm in new databases  */
+    char *              key_realm;      /* Realm omitted from keys      */
+    krb5_boolean        in_txn;         /* Transaction in progress      */
+    krb5_boolean        packed_entries; /* Decode entries for the KDC   */
+    /* Identity of the read-only DB handle kept open while unlocked. */
+    pid_t               db_pid;
+    struct stat         db_st;          /* Status of DB file at open    */
+    struct stat         db_lf_st;       /* Status of lock file at open  */
+    time_t              stats_time;     /* Last cache statistics trace  */
 } krb5_db2_context;
 
 krb5_error_code krb5_db2_init(krb5_context);
@@ -62,6 +73,11 @@ krb5_error_code krb5_db2_iterate(krb5_context, char *,
                                  krb5_error_code (*)(krb5_pointer,
                                                      krb5_db_entry *),
                                  krb5_pointer, krb5_flags);
+krb5_error_code krb5_db2_iterate_after(krb5_context, char *,
+                                       krb5_const_principal,
+                                       krb5_error_code (*)(krb5_pointer,
+                                                           krb5_db_entry *),
+                                       krb5_pointer);
 krb5_error_code krb5_db2_set_nonblocking(krb5_context, krb5_boolean,
                                          krb5_boolean *);
 krb5_boolean krb5_db2_set_lockmode(krb5_context, krb5_boolean);
@@ -82,6 +98,9 @@ krb5_db2_promote_db(krb5_context kcontext, char *conf_section, char **db_args);
 krb5_error_code
 krb5_db2_lock(krb5_context context, int in_mode);
 
+krb5_error_code krb5_db2_begin_txn(krb5_context context);
+krb5_error_code krb5_db2_end_txn(krb5_context context);
+
 krb5_error_code
 krb5_db2_open(krb5_context kcontext, char *conf_section, char **db_args,
               int mode);
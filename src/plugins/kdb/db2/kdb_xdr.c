@@ -221,23 +221,138 @@ epc_error:;
     return retval;
 }
 
-krb5_error_code
-krb5_decode_princ_entry(krb5_context context, krb5_data *content,
-                        krb5_db_entry **entry_ptr)
+/*
+ * A packed entry is decoded into a single allocation beginning with this
+ * header, followed by the e_data, tl_data and key_data of the entry.  Only the
+ * principal is allocated separately.  Pieces of a packed entry which are
+ * replaced by the caller lie outside the allocation and are freed
+ * individually by krb5_dbe_free_packed().
+ */
+struct packed_entry {
+    krb5_db_entry entry;
+    size_t size;
+};
+
+#define PACK_ALIGN(n) (((n) + sizeof(void *) - 1) & ~(sizeof(void *) - 1))
+
+/* Space for an object of len bytes in a packed entry.  Zero-length objects
+ * get a byte so that their pointers lie within the allocation. */
+#define PACK_SIZE(len) PACK_ALIGN((len) ? (size_t)(len) : 1)
+
+struct arena {
+    unsigned char *next;
+};
+
+/* Allocate len zeroed bytes from a, or from the heap if a is NULL. */
+static void *
+dalloc(struct arena *a, size_t len, krb5_error_code *code)
+{
+    void *ptr;
+
+    if (a == NULL)
+        return k5alloc(len, code);
+    ptr = a->next;
+    a->next += PACK_SIZE(len);
+    *code = 0;
+    return ptr;
+}
+
+static void *
+dmemdup(struct arena *a, const void *in, size_t len, krb5_error_code *code)
+{
+    void *ptr = dalloc(a, len, code);
+
+    if (ptr != NULL && len > 0)
+        memcpy(ptr, in, len);
+    return ptr;
+}
+
+/* Compute the size of the packed representation of the entry encoded in
+ * content, checking the encoding as decode_entry() will. */
+static krb5_error_code
+packed_size(krb5_data *content, size_t *size_out)
+{
+    unsigned char *nextloc = (unsigned char *)content->data;
+    int sizeleft = content->length, i, j;
+    krb5_int16 len, n_tl_data, n_key_data, ver, i16;
+    size_t size;
+
+    *size_out = 0;
+
+    if ((sizeleft -= KRB5_KDB_V1_BASE_LENGTH) < 0)
+        return KRB5_KDB_TRUNCATED_RECORD;
+    krb5_kdb_decode_int16(nextloc, len);
+    krb5_kdb_decode_int16(nextloc + KRB5_KDB_V1_BASE_LENGTH - 4, n_tl_data);
+    krb5_kdb_decode_int16(nextloc + KRB5_KDB_V1_BASE_LENGTH - 2, n_key_data);
+    nextloc += KRB5_KDB_V1_BASE_LENGTH;
+    if (n_tl_data < 0 || n_key_data < 0)
+        return KRB5_KDB_TRUNCATED_RECORD;
+
+    size = PACK_ALIGN(sizeof(struct packed_entry));
+    if (len > KRB5_KDB_V1_BASE_LENGTH) {
+        /* As in decode_entry(), e_data is not counted in sizeleft. */
+        size += PACK_SIZE(len - KRB5_KDB_V1_BASE_LENGTH);
+        nextloc += len - KRB5_KDB_V1_BASE_LENGTH;
+    }
+
+    /* Principal name */
+    if ((sizeleft -= 2) < 0)
+        return KRB5_KDB_TRUNCATED_RECORD;
+    krb5_kdb_decode_int16(nextloc, i16);
+    nextloc += 2;
+    if (i16 < 0 || (sizeleft -= i16) < 0)
+        return KRB5_KDB_TRUNCATED_RECORD;
+    nextloc += i16;
+
+    for (i = 0; i < n_tl_data; i++) {
+        if ((sizeleft -= 4) < 0)
+            return KRB5_KDB_TRUNCATED_RECORD;
+        krb5_kdb_decode_int16(nextloc + 2, i16);
+        nextloc += 4;
+        if ((sizeleft -= (krb5_ui_2)i16) < 0)
+            return KRB5_KDB_TRUNCATED_RECORD;
+        size += PACK_ALIGN(sizeof(krb5_tl_data)) + PACK_SIZE((krb5_ui_2)i16);
+        nextloc += (krb5_ui_2)i16;
+    }
+
+    if (n_key_data > 0)
+        size += PACK_ALIGN(n_key_data * sizeof(krb5_key_data));
+    for (i = 0; i < n_key_data; i++) {
+        if ((sizeleft -= 4) < 0)
+            return KRB5_KDB_TRUNCATED_RECORD;
+        krb5_kdb_decode_int16(nextloc, ver);
+        nextloc += 4;
+        if (ver > KRB5_KDB_V1_KEY_DATA_ARRAY)
+            return KRB5_KDB_BAD_VERSION;
+        for (j = 0; j < ver; j++) {
+            if ((sizeleft -= 4) < 0)
+                return KRB5_KDB_TRUNCATED_RECORD;
+            krb5_kdb_decode_int16(nextloc + 2, i16);
+            nextloc += 4;
+            if ((sizeleft -= (krb5_ui_2)i16) < 0)
+                return KRB5_KDB_TRUNCATED_RECORD;
+            if (i16 != 0)
+                size += PACK_SIZE((krb5_ui_2)i16);
+            nextloc += (krb5_ui_2)i16;
+        }
+    }
+
+    *size_out = size;
+    return 0;
+}
+
+/* Decode the entry encoded in content, allocating its parts from a, or from
+ * the heap if a is NULL. */
+static krb5_error_code
+decode_entry(krb5_context context, krb5_data *content, struct arena *a,
+             krb5_db_entry *entry)
 {
     int                   sizeleft, i;
     unsigned char       * nextloc;
     krb5_tl_data       ** tl_data;
     krb5_int16            i16;
-    krb5_db_entry       * entry;
     krb5_error_code retval;
 
-    *entry_ptr = NULL;
-
-    entry = k5alloc(sizeof(*entry), &retval);
-    if (entry == NULL)
-        return retval;
-
     /*
      * Reverse the encoding of encode_princ_entry.
      *
@@ -250,10 +365,8 @@ krb5_decode_princ_entry(krb5_context context, krb5_data *content,
     /* First do the easy stuff */
     nextloc = (unsigned char *)content->data;
     sizeleft = content->length;
-    if ((sizeleft -= KRB5_KDB_V1_BASE_LENGTH) < 0) {
-        retval = KRB5_KDB_TRUNCATED_RECORD;
-        goto error_out;
-    }
+    if ((sizeleft -= KRB5_KDB_V1_BASE_LENGTH) < 0)
+        return KRB5_KDB_TRUNCATED_RECORD;
 
     /* Base Length */
     krb5_kdb_decode_int16(nextloc, entry->len);
@@ -295,26 +408,22 @@ krb5_decode_princ_entry(krb5_context context, krb5_data *content,
     krb5_kdb_decode_int16(nextloc, entry->n_tl_data);
     nextloc += 2;
 
-    if (entry->n_tl_data < 0) {
-        retval = KRB5_KDB_TRUNCATED_RECORD;
-        goto error_out;
-    }
+    if (entry->n_tl_data < 0)
+        return KRB5_KDB_TRUNCATED_RECORD;
 
     /* # key_data strutures */
     krb5_kdb_decode_int16(nextloc, entry->n_key_data);
     nextloc += 2;
 
-    if (entry->n_key_data < 0) {
-        retval = KRB5_KDB_TRUNCATED_RECORD;
-        goto error_out;
-    }
+    if (entry->n_key_data < 0)
+        return KRB5_KDB_TRUNCATED_RECORD;
 
     /* Check for extra data */
     if (entry->len > KRB5_KDB_V1_BASE_LENGTH) {
         entry->e_length = entry->len - KRB5_KDB_V1_BASE_LENGTH;
-        entry->e_data = k5memdup(nextloc, entry->e_length, &retval);
+        entry->e_data = dmemdup(a, nextloc, entry->e_length, &retval);
         if (entry->e_data == NULL)
-            goto error_out;
+            return retval;
         nextloc += entry->e_length;
     }
 
@@ -322,10 +431,8 @@ krb5_decode_princ_entry(krb5_context context, krb5_data *content,
      * Get the principal name for the entry
      * (stored as a string which gets unparsed.)
      */
-    if ((sizeleft -= 2) < 0) {
-        retval = KRB5_KDB_TRUNCATED_RECORD;
-        goto error_out;
-    }
+    if ((sizeleft -= 2) < 0)
+        return KRB5_KDB_TRUNCATED_RECORD;
 
     i = 0;
     krb5_kdb_decode_int16(nextloc, i16);
@@ -333,61 +440,49 @@ krb5_decode_princ_entry(krb5_context context, krb5_data *content,
     nextloc += 2;
 
     if ((retval = krb5_parse_name(context, (char *)nextloc, &(entry->princ))))
-        goto error_out;
-    if (((size_t) i != (strlen((char *)nextloc) + 1)) || (sizeleft < i)) {
-        retval = KRB5_KDB_TRUNCATED_RECORD;
-        goto error_out;
-    }
+        return retval;
+    if (((size_t) i != (strlen((char *)nextloc) + 1)) || (sizeleft < i))
+        return KRB5_KDB_TRUNCATED_RECORD;
     sizeleft -= i;
     nextloc += i;
 
     /* tl_data is a linked list */
     tl_data = &entry->tl_data;
     for (i = 0; i < entry->n_tl_data; i++) {
-        if ((sizeleft -= 4) < 0) {
-            retval = KRB5_KDB_TRUNCATED_RECORD;
-            goto error_out;
-        }
-        if ((*tl_data = (krb5_tl_data *)
-             malloc(sizeof(krb5_tl_data))) == NULL) {
-            retval = ENOMEM;
-            goto error_out;
-        }
-        (*tl_data)->tl_data_next = NULL;
-        (*tl_data)->tl_data_contents = NULL;
+        if ((sizeleft -= 4) < 0)
+            return KRB5_KDB_TRUNCATED_RECORD;
+        *tl_data = dalloc(a, sizeof(krb5_tl_data), &retval);
+        if (*tl_data == NULL)
+            return retval;
         krb5_kdb_decode_int16(nextloc, (*tl_data)->tl_data_type);
         nextloc += 2;
         krb5_kdb_decode_int16(nextloc, (*tl_data)->tl_data_length);
         nextloc += 2;
 
-        if ((sizeleft -= (*tl_data)->tl_data_length) < 0) {
-            retval = KRB5_KDB_TRUNCATED_RECORD;
-            goto error_out;
-        }
+        if ((sizeleft -= (*tl_data)->tl_data_length) < 0)
+            return KRB5_KDB_TRUNCATED_RECORD;
         (*tl_data)->tl_data_contents =
-            k5memdup(nextloc, (*tl_data)->tl_data_length, &retval);
+            dmemdup(a, nextloc, (*tl_data)->tl_data_length, &retval);
         if ((*tl_data)->tl_data_contents == NULL)
-            goto error_out;
+            return retval;
         nextloc += (*tl_data)->tl_data_length;
         tl_data = &((*tl_data)->tl_data_next);
     }
 
     /* key_data is an array */
-    if (entry->n_key_data && ((entry->key_data = (krb5_key_data *)
-                               malloc(sizeof(krb5_key_data) * entry->n_key_data)) == NULL)) {
-        retval = ENOMEM;
-        goto error_out;
+    if (entry->n_key_data) {
+        entry->key_data = dalloc(a, sizeof(krb5_key_data) * entry->n_key_data,
+                                 &retval);
+        if (entry->key_data == NULL)
+            return retval;
     }
     for (i = 0; i < entry->n_key_data; i++) {
         krb5_key_data * key_data;
         int j;
 
-        if ((sizeleft -= 4) < 0) {
-            retval = KRB5_KDB_TRUNCATED_RECORD;
-            goto error_out;
-        }
+        if ((sizeleft -= 4) < 0)
+            return KRB5_KDB_TRUNCATED_RECORD;
         key_data = entry->key_data + i;
-        memset(key_data, 0, sizeof(krb5_key_data));
         krb5_kdb_decode_int16(nextloc, key_data->key_data_ver);
         nextloc += 2;
         krb5_kdb_decode_int16(nextloc, key_data->key_data_kvno);
@@ -396,25 +491,21 @@ krb5_decode_princ_entry(krb5_context context, krb5_data *content,
         /* key_data_ver determins number of elements and how to unparse them. */
         if (key_data->key_data_ver <= KRB5_KDB_V1_KEY_DATA_ARRAY) {
             for (j = 0; j < key_data->key_data_ver; j++) {
-                if ((sizeleft -= 4) < 0) {
-                    retval = KRB5_KDB_TRUNCATED_RECORD;
-                    goto error_out;
-                }
+                if ((sizeleft -= 4) < 0)
+                    return KRB5_KDB_TRUNCATED_RECORD;
                 krb5_kdb_decode_int16(nextloc, key_data->key_data_type[j]);
                 nextloc += 2;
                 krb5_kdb_decode_int16(nextloc, key_data->key_data_length[j]);
                 nextloc += 2;
 
-                if ((sizeleft -= key_data->key_data_length[j]) < 0) {
-                    retval = KRB5_KDB_TRUNCATED_RECORD;
-                    goto error_out;
-                }
+                if ((sizeleft -= key_data->key_data_length[j]) < 0)
+                    return KRB5_KDB_TRUNCATED_RECORD;
                 if (key_data->key_data_length[j]) {
                     key_data->key_data_contents[j] =
-                        k5memdup(nextloc, key_data->key_data_length[j],
-                                 &retval);
+                        dmemdup(a, nextloc, key_data->key_data_length[j],
+                                &retval);
                     if (key_data->key_data_contents[j] == NULL)
-                        goto error_out;
+                        return retval;
                     nextloc += key_data->key_data_length[j];
                 }
             }
@@ -423,12 +514,63 @@ krb5_decode_princ_entry(krb5_context context, krb5_data *content,
             abort();
         }
     }
+    return 0;
+}
+
+krb5_error_code
+krb5_decode_princ_entry(krb5_context context, krb5_data *content,
+                        krb5_db_entry **entry_ptr)
+{
+    krb5_db_entry *entry;
+    krb5_error_code retval;
+
+    *entry_ptr = NULL;
+
+    entry = k5alloc(sizeof(*entry), &retval);
+    if (entry == NULL)
+        return retval;
+    retval = decode_entry(context, content, NULL, entry);
+    if (retval) {
+        krb5_dbe_free(context, entry);
+        return retval;
+    }
     *entry_ptr = entry;
     return 0;
+}
 
-error_out:
-    krb5_dbe_free(context, entry);
-    return retval;
+/*
+ * Decode the entry encoded in content into a single allocation (plus the
+ * principal name).  The result must be freed with krb5_dbe_free_packed(), and
+ * the caller must not free any of its parts separately; parts may be replaced
+ * by pointers to separately allocated memory.
+ */
+krb5_error_code
+krb5_decode_packed_princ_entry(krb5_context context, krb5_data *content,
+                               krb5_db_entry **entry_ptr)
+{
+    struct packed_entry *pe;
+    struct arena a;
+    krb5_error_code retval;
+    size_t size;
+
+    *entry_ptr = NULL;
+
+    retval = packed_size(content, &size);
+    if (retval)
+        return retval;
+    pe = k5alloc(size, &retval);
+    if (pe == NULL)
+        return retval;
+    pe->size = size;
+    a.next = (unsigned char *)pe + PACK_ALIGN(sizeof(*pe));
+    retval = decode_entry(context, content, &a, &pe->entry);
+    if (retval) {
+        krb5_dbe_free_packed(context, &pe->entry);
+        return retval;
+    }
+    assert(a.next <= (unsigned char *)pe + size);
+    *entry_ptr = &pe->entry;
+    return 0;
 }
 
 void
@@ -463,3 +605,46 @@ krb5_dbe_free(krb5_context context, krb5_db_entry *entry)
     }
     free(entry);
 }
+
+/* Free an entry returned by krb5_decode_packed_princ_entry(), including any
+ * parts which were replaced after decoding. */
+void
+krb5_dbe_free_packed(krb5_context context, krb5_db_entry *entry)
+{
+    struct packed_entry *pe = (struct packed_entry *)entry;
+    krb5_tl_data *tl_data, *tl_data_next;
+    uintptr_t start, end;
+    int i, j;
+
+#define IN_PACK(p) ((uintptr_t)(p) >= start && (uintptr_t)(p) < end)
+
+    if (entry == NULL)
+        return;
+    start = (uintptr_t)pe;
+    end = start + pe->size;
+
+    if (!IN_PACK(entry->e_data))
+        free(entry->e_data);
+    krb5_free_principal(context, entry->princ);
+    for (tl_data = entry->tl_data; tl_data; tl_data = tl_data_next) {
+        tl_data_next = tl_data->tl_data_next;
+        if (!IN_PACK(tl_data->tl_data_contents))
+            free(tl_data->tl_data_contents);
+        if (!IN_PACK(tl_data))
+            free(tl_data);
+    }
+    for (i = 0; entry->key_data != NULL && i < entry->n_key_data; i++) {
+        for (j = 0; j < entry->key_data[i].key_data_ver; j++) {
+            if (entry->key_data[i].key_data_length[j] &&
+                !IN_PACK(entry->key_data[i].key_data_contents[j])) {
+                zapfree(entry->key_data[i].key_data_contents[j],
+                        entry->key_data[i].key_data_length[j]);
+            }
+        }
+    }
+    if (!IN_PACK(entry->key_data))
+        free(entry->key_data);
+    zapfree(pe, pe->size);
+
+#undef IN_PACK
+}
@@ -12,9 +12,16 @@ krb5_error_code
 krb5_decode_princ_entry(krb5_context context, krb5_data *content,
                         krb5_db_entry **entry);
 
+krb5_error_code
+krb5_decode_packed_princ_entry(krb5_context context, krb5_data *content,
+                               krb5_db_entry **entry);
+
 void
 krb5_dbe_free(krb5_context context, krb5_db_entry *entry);
 
+void
+krb5_dbe_free_packed(krb5_context context, krb5_db_entry *entry);
+
 krb5_error_code
 krb5_encode_princ_entry(krb5_context context, krb5_data *content,
                         krb5_db_entry *entry);
@@ -478,3 +478,15 @@ __bt_fd(dbp)
 	}
 	return (t->bt_fd);
 }
+
+int
+__bt_stat(dbp, st)
+	const DB *dbp;
+	DBSTAT *st;
+{
+	BTREE *t;
+
+	t = dbp->internal;
+	mpool_getstat(t->bt_mp, st);
+	return (RET_SUCCESS);
+}
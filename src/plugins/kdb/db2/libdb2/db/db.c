@@ -73,6 +73,27 @@ kdb2_dbopen(fname, flags, mode, type, openinfo)
 	return (NULL);
 }
 
+/*
+ * kdb2_dbstat --
+ *	Get page cache statistics for a database.
+ */
+int
+kdb2_dbstat(dbp, st)
+	const DB *dbp;
+	DBSTAT *st;
+{
+	switch (dbp->type) {
+	case DB_BTREE:
+	case DB_RECNO:
+		/* Recno databases are built on a btree. */
+		return (__bt_stat(dbp, st));
+	case DB_HASH:
+		return (__hash_stat(dbp, st));
+	}
+	errno = EINVAL;
+	return (RET_ERROR);
+}
+
 static int
 __dberr()
 {
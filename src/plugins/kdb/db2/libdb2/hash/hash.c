@@ -303,6 +303,18 @@ hash_fd(dbp)
 	return (hashp->fp);
 }
 
+int
+__hash_stat(dbp, st)
+	const DB *dbp;
+	DBSTAT *st;
+{
+	HTAB *hashp;
+
+	hashp = (HTAB *)dbp->internal;
+	mpool_getstat(hashp->mp, st);
+	return (RET_SUCCESS);
+}
+
 /************************** LOCAL CREATION ROUTINES **********************/
 static HTAB *
 init_hash(hashp, file, info)
@@ -206,6 +206,14 @@ DB	*__hash_open __P((const char *, int, int, const HASHINFO *, int));
 DB	*__rec_open __P((const char *, int, int, const RECNOINFO *, int));
 void	 __dbpanic __P((DB *dbp));
 
+/* page cache statistics for each database type, used in dbstat() */
+
+#define __bt_stat	__kdb2_bt_stat
+#define __hash_stat	__kdb2_hash_stat
+
+int	 __bt_stat __P((const DB *, DBSTAT *));
+int	 __hash_stat __P((const DB *, DBSTAT *));
+
 /*
  * There is no portable way to figure out the maximum value of a file
  * offset, so we put it here.
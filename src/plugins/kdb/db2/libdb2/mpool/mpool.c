@@ -124,9 +124,7 @@ mpool_new(mp, pgnoaddr, flags)
 		(void)fprintf(stderr, "mpool_new: page allocation overflow.\n");
 		abort();
 	}
-#ifdef STATISTICS
 	++mp->pagenew;
-#endif
 	/*
 	 * Get a BKT from the cache.  Assign a new page number, attach
 	 * it to the head of the hash chain, the tail of the lru chain,
@@ -190,9 +188,7 @@ mpool_get(mp, pgno, flags)
 	off_t off;
 	int nr;
 
-#ifdef STATISTICS
 	++mp->pageget;
-#endif
 
 	/* Check for a page that is cached. */
 	if ((bp = mpool_look(mp, pgno)) != NULL) {
@@ -214,7 +210,7 @@ mpool_get(mp, pgno, flags)
 		TAILQ_INSERT_TAIL(&mp->lqh, bp, q);
 
 		/* Return a pinned page. */
-		bp->flags |= MPOOL_PINNED;
+		bp->flags |= MPOOL_PINNED | MPOOL_REFERENCED;
 		return (bp->page);
 	}
 
@@ -223,9 +219,7 @@ mpool_get(mp, pgno, flags)
 		return (NULL);
 
 	/* Read in the contents. */
-#ifdef STATISTICS
 	++mp->pageread;
-#endif
 	off = mp->pagesize * pgno;
 	if (off / mp->pagesize != pgno) {
 	    /* Run past the end of the file, or at least the part we
@@ -283,9 +277,7 @@ mpool_put(mp, page, flags)
 {
 	BKT *bp;
 
-#ifdef STATISTICS
 	++mp->pageput;
-#endif
 	bp = (BKT *)((char *)page - sizeof(BKT));
 #ifdef DEBUG
 	if (!(bp->flags & MPOOL_PINNED)) {
@@ -350,7 +342,7 @@ mpool_bkt(mp)
 	MPOOL *mp;
 {
 	struct _hqh *head;
-	BKT *bp;
+	BKT *bp, *victim;
 
 	/* If under the max cached, always create a new page. */
 	if (mp->curcache < mp->maxcache)
@@ -358,39 +350,52 @@ mpool_bkt(mp)
 
 	/*
 	 * If the cache is max'd out, walk the lru list for a buffer we
-	 * can flush.  If we find one, write it (if necessary) and take it
-	 * off any lists.  If we don't find anything we grow the cache anyway.
-	 * The cache never shrinks.
+	 * can flush.  Pages which have been hit since they were last
+	 * passed over get a second chance: their reference bit is cleared
+	 * and the scan moves on, so a hot page is not evicted just because
+	 * a sequential scan pushed it to the head of the lru list.  If
+	 * every unpinned page was referenced, take the least recently used
+	 * one.  If we find one, write it (if necessary) and take it off any
+	 * lists.  If we don't find anything we grow the cache anyway.  The
+	 * cache never shrinks.
 	 */
-	for (bp = mp->lqh.tqh_first; bp != NULL; bp = bp->q.tqe_next)
-		if (!(bp->flags & MPOOL_PINNED)) {
-			/* Flush if dirty. */
-			if (bp->flags & MPOOL_DIRTY &&
-			    mpool_write(mp, bp) == RET_ERROR)
-				return (NULL);
-#ifdef STATISTICS
-			++mp->pageflush;
-#endif
-			/* Remove from the hash and lru queues. */
-			head = &mp->hqh[HASHKEY(bp->pgno)];
-			TAILQ_REMOVE(head, bp, hq);
-			TAILQ_REMOVE(&mp->lqh, bp, q);
+	victim = NULL;
+	for (bp = mp->lqh.tqh_first; bp != NULL; bp = bp->q.tqe_next) {
+		if (bp->flags & MPOOL_PINNED)
+			continue;
+		if (victim == NULL)
+			victim = bp;
+		if (!(bp->flags & MPOOL_REFERENCED)) {
+			victim = bp;
+			break;
+		}
+		bp->flags &= ~MPOOL_REFERENCED;
+	}
+	if (victim != NULL) {
+		bp = victim;
+		/* Flush if dirty. */
+		if (bp->flags & MPOOL_DIRTY &&
+		    mpool_write(mp, bp) == RET_ERROR)
+			return (NULL);
+		++mp->pageflush;
+		/* Remove from the hash and lru queues. */
+		head = &mp->hqh[HASHKEY(bp->pgno)];
+		TAILQ_REMOVE(head, bp, hq);
+		TAILQ_REMOVE(&mp->lqh, bp, q);
 #if defined(DEBUG) && !defined(DEBUG_IDX0SPLIT)
-			{ void *spage;
-				spage = bp->page;
-				memset(bp, 0xff, sizeof(BKT) + mp->pagesize);
-				bp->page = spage;
-			}
-#endif
-			bp->flags = 0;
-			return (bp);
+		{ void *spage;
+			spage = bp->page;
+			memset(bp, 0xff, sizeof(BKT) + mp->pagesize);
+			bp->page = spage;
 		}
+#endif
+		bp->flags = 0;
+		return (bp);
+	}
 
 new:	if ((bp = (BKT *)malloc(sizeof(BKT) + mp->pagesize)) == NULL)
 		return (NULL);
-#ifdef STATISTICS
 	++mp->pagealloc;
-#endif
 #if defined(DEBUG) || defined(PURIFY) || 1
 	memset(bp, 0xff, sizeof(BKT) + mp->pagesize);
 #endif
@@ -411,9 +416,7 @@ mpool_write(mp, bp)
 {
 	off_t off;
 
-#ifdef STATISTICS
 	++mp->pagewrite;
-#endif
 
 	/* Run through the user's filter. */
 	if (mp->pgout)
@@ -450,17 +453,31 @@ mpool_look(mp, pgno)
 	head = &mp->hqh[HASHKEY(pgno)];
 	for (bp = head->tqh_first; bp != NULL; bp = bp->hq.tqe_next)
 		if ((bp->pgno == pgno) && (bp->flags & MPOOL_INUSE)) {
-#ifdef STATISTICS
 			++mp->cachehit;
-#endif
 			return (bp);
 		}
-#ifdef STATISTICS
 	++mp->cachemiss;
-#endif
 	return (NULL);
 }
 
+/*
+ * mpool_getstat
+ *	Return cache statistics.
+ */
+void
+mpool_getstat(mp, st)
+	MPOOL *mp;
+	DBSTAT *st;
+{
+	st->cachehit = mp->cachehit;
+	st->cachemiss = mp->cachemiss;
+	st->pageread = mp->pageread;
+	st->pagewrite = mp->pagewrite;
+	st->pageflush = mp->pageflush;
+	st->curcache = mp->curcache;
+	st->maxcache = mp->maxcache;
+}
+
 #ifdef STATISTICS
 /*
  * mpool_stat
@@ -55,6 +55,7 @@ typedef struct _bkt {
 #define	MPOOL_DIRTY	0x01		/* page needs to be written */
 #define	MPOOL_PINNED	0x02		/* page is pinned into memory */
 #define	MPOOL_INUSE	0x04		/* page address is valid */
+#define	MPOOL_REFERENCED 0x08		/* page was hit since last scan */
 	u_int8_t flags;			/* flags */
 } BKT;
 
@@ -72,7 +73,6 @@ typedef struct MPOOL {
 					/* page out conversion routine */
 	void    (*pgout) __P((void *, db_pgno_t, void *));
 	void	*pgcookie;		/* cookie for page in/out routines */
-#ifdef STATISTICS
 	u_long	cachehit;
 	u_long	cachemiss;
 	u_long	pagealloc;
@@ -82,7 +82,6 @@ typedef struct MPOOL {
 	u_long	pageput;
 	u_long	pageread;
 	u_long	pagewrite;
-#endif
 } MPOOL;
 
 #define	MPOOL_IGNOREPIN	0x01		/* Ignore if the page is pinned. */
@@ -100,6 +99,7 @@ typedef struct MPOOL {
 #define mpool_sync	kdb2_mpool_sync
 #define mpool_close	kdb2_mpool_close
 #define mpool_stat	kdb2_mpool_stat
+#define mpool_getstat	kdb2_mpool_getstat
 
 __BEGIN_DECLS
 MPOOL	*mpool_open __P((void *, int, db_pgno_t, db_pgno_t));
@@ -111,6 +111,7 @@ int	 mpool_delete __P((MPOOL *, void *));
 int	 mpool_put __P((MPOOL *, void *, u_int));
 int	 mpool_sync __P((MPOOL *));
 int	 mpool_close __P((MPOOL *));
+void	 mpool_getstat __P((MPOOL *, DBSTAT *));
 #ifdef STATISTICS
 void	 mpool_stat __P((MPOOL *));
 #endif
@@ -60,7 +60,10 @@
 extern struct timeval timelimit;
 
 #define  DEFAULT_CONNS_PER_SERVER    5
+#define  SERVER_RETRY_INTERVAL       60
+#define  SERVER_STATS_INTERVAL       (5 * 60)
 #define  REALM_READ_REFRESH_INTERVAL (5 * 60)
+#define  DEFAULT_TKT_POLICY_CACHE_TTL (5 * 60)
 
 #if !defined(LDAP_OPT_RESULT_CODE) && defined(LDAP_OPT_ERROR_NUMBER)
 #define LDAP_OPT_RESULT_CODE LDAP_OPT_ERROR_NUMBER
@@ -172,6 +175,7 @@ typedef struct  _krb5_ldap_server_handle {
     int                              msgid;
     LDAP                             *ldap_handle;
     krb5_boolean                     server_info_update_pending;
+    struct timeval                   busy_since;
     krb5_ldap_server_info            *server_info;
     struct _krb5_ldap_server_handle  *next;
 } krb5_ldap_server_handle;
@@ -180,10 +184,18 @@ struct _krb5_ldap_server_info {
     krb5_ldap_server_type        server_type;
     krb5_ldap_server_status      server_status;
     krb5_ui_4                    num_conns;
+    krb5_ui_4                    num_busy;   /* handles taken from the pool */
     krb5_ldap_server_handle      *ldap_server_handles;
     time_t                       downtime;
     char                        *server_name;
     int                          modify_increment;
+    /* Statistics for handles returned to the pool, traced every
+     * SERVER_STATS_INTERVAL seconds and on close. */
+    unsigned long                num_requests;
+    unsigned long                num_failures;
+    unsigned long                total_usec;
+    unsigned long                max_usec;
+    time_t                       stats_time; /* last statistics trace */
     struct _krb5_ldap_server_info *next;
 };
 
@@ -192,10 +204,16 @@ struct _krb5_ldap_server_info {
 
 typedef enum {SERVICE_DN_TYPE_SERVER, SERVICE_DN_TYPE_CLIENT} krb5_ldap_servicetype;
 
+typedef struct _krb5_ldap_tkt_policy_cache krb5_ldap_tkt_policy_cache;
+typedef struct _krb5_ldap_princ_cache krb5_ldap_princ_cache;
+typedef struct _krb5_ldap_lockout_queue krb5_ldap_lockout_queue;
+
 typedef struct _krb5_ldap_context {
     krb5_ldap_servicetype         service_type;
     krb5_ldap_server_info         **server_info_list;
     krb5_ui_4                     max_server_conns;
+    krb5_ui_4                     server_conns_limit;
+    unsigned int                  next_server;
     char                          *conf_section;
     char                          *bind_dn;
     char                          *bind_pwd;
@@ -212,6 +230,13 @@ typedef struct _krb5_ldap_context {
     krb5_boolean                  disable_last_success;
     krb5_boolean                  disable_lockout;
     int                           ldap_debug;
+    int                           srv_type;   /* KRB5_KDB_SRV_TYPE_* */
+    krb5_deltat                   tkt_policy_cache_ttl;
+    k5_mutex_t                    tkt_policy_cache_lock;
+    krb5_ldap_tkt_policy_cache    *tkt_policy_cache;
+    krb5_ui_4                     princ_cache_size;
+    krb5_ldap_princ_cache         *princ_cache;
+    krb5_ldap_lockout_queue       *lockout_queue;
     krb5_context                  kcontext;   /* to set the error code and message */
 } krb5_ldap_context;
 
@@ -234,6 +259,13 @@ krb5_ldap_db_init(krb5_context, krb5_ldap_context *);
 krb5_error_code
 krb5_ldap_db_single_init(krb5_ldap_context *);
 
+krb5_error_code
+krb5_ldap_open_handle(krb5_ldap_context *, krb5_ldap_server_info *,
+                      krb5_ldap_server_handle **);
+
+krb5_error_code
+krb5_ldap_initialize_server(krb5_ldap_context *, krb5_ldap_server_info *);
+
 krb5_error_code
 krb5_ldap_rebind(krb5_ldap_context *, krb5_ldap_server_handle **);
 
@@ -321,4 +353,7 @@ krb5_ldap_lockout_audit(krb5_context context,
                         krb5_timestamp stamp,
                         krb5_error_code status);
 
+void
+krb5_ldap_free_lockout_queue(krb5_ldap_context *ldap_context);
+
 #endif
@@ -164,13 +164,20 @@ authenticate(krb5_ldap_context *ctx, krb5_ldap_server_handle *server)
     return 0;
 }
 
-static krb5_error_code
-initialize_server(krb5_ldap_context *ldap_context, krb5_ldap_server_info *info)
+/* Open and authenticate a new connection to the server described by info,
+ * without adding it to the server's pool.  Do not lock the mutex; the caller
+ * should lock it. */
+krb5_error_code
+krb5_ldap_open_handle(krb5_ldap_context *ldap_context,
+                      krb5_ldap_server_info *info,
+                      krb5_ldap_server_handle **handle_out)
 {
     krb5_ldap_server_handle *server;
     krb5_error_code ret;
     int st;
 
+    *handle_out = NULL;
+
     server = calloc(1, sizeof(krb5_ldap_server_handle));
     if (server == NULL)
         return ENOMEM;
@@ -187,13 +194,42 @@ initialize_server(krb5_ldap_context *ldap_context, krb5_ldap_server_info *info)
 
     ret = authenticate(ldap_context, server);
     if (ret) {
-        info->server_status = OFF;
-        time(&info->downtime);
+        ldap_unbind_ext_s(server->ldap_handle, NULL, NULL);
         free(server);
         return ret;
     }
 
     server->server_info_update_pending = FALSE;
+    *handle_out = server;
+    return 0;
+}
+
+/* Open a new connection to the server described by info and add it to the
+ * server's pool.  On failure, mark the server as down.  Do not lock the mutex;
+ * the caller should lock it. */
+krb5_error_code
+krb5_ldap_initialize_server(krb5_ldap_context *ldap_context,
+                            krb5_ldap_server_info *info)
+{
+    krb5_ldap_server_handle *server;
+    krb5_error_code ret;
+
+    if (info->server_status == NOTSET) {
+#ifdef LDAP_MOD_INCREMENT
+        info->modify_increment = has_modify_increment(ldap_context->kcontext,
+                                                      info->server_name);
+#else
+        info->modify_increment = 0;
+#endif
+    }
+
+    ret = krb5_ldap_open_handle(ldap_context, info, &server);
+    if (ret) {
+        info->server_status = OFF;
+        time(&info->downtime);
+        return ret;
+    }
+
     server->next = info->ldap_server_handles;
     info->ldap_server_handles = server;
     info->num_conns++;
@@ -234,15 +270,8 @@ krb5_ldap_db_init(krb5_context context, krb5_ldap_context *ctx)
         if (info->server_status == NOTSET) {
             krb5_clear_error_message(context);
 
-#ifdef LDAP_MOD_INCREMENT
-            info->modify_increment = has_modify_increment(context,
-                                                          info->server_name);
-#else
-            info->modify_increment = 0;
-#endif
-
             for (conns = 0; conns < ctx->max_server_conns; conns++) {
-                ret = initialize_server(ctx, info);
+                ret = krb5_ldap_initialize_server(ctx, info);
                 if (ret)
                     break;
             }
@@ -273,7 +302,7 @@ krb5_ldap_db_single_init(krb5_ldap_context *ldap_context)
         server_info = ldap_context->server_info_list[cnt];
         if ((server_info->server_status == NOTSET || server_info->server_status == ON)) {
             if (server_info->num_conns < ldap_context->max_server_conns-1) {
-                st = initialize_server(ldap_context, server_info);
+                st = krb5_ldap_initialize_server(ldap_context, server_info);
                 if (st == LDAP_SUCCESS)
                     goto cleanup;
             }
@@ -286,7 +315,7 @@ krb5_ldap_db_single_init(krb5_ldap_context *ldap_context)
     cnt = 0;
     while (ldap_context->server_info_list[cnt] != NULL) {
         server_info = ldap_context->server_info_list[cnt];
-        st = initialize_server(ldap_context, server_info);
+        st = krb5_ldap_initialize_server(ldap_context, server_info);
         if (st == LDAP_SUCCESS)
             goto cleanup;
         ++cnt;
@@ -302,6 +331,7 @@ krb5_ldap_rebind(krb5_ldap_context *ldap_context,
     krb5_ldap_server_handle *handle = *ldap_server_handle;
 
     ldap_unbind_ext_s(handle->ldap_handle, NULL, NULL);
+    handle->ldap_handle = NULL;
     if (ldap_initialize(&handle->ldap_handle,
                         handle->server_info->server_name) != LDAP_SUCCESS ||
         authenticate(ldap_context, handle) != 0) {
@@ -87,7 +87,97 @@ krb5_update_server_info(krb5_ldap_server_handle *ldap_server_handle,
 #endif
 
 /*
- * Return ldap server handle from the pool. If the pool is exhausted return NULL.
+ * Return true if a handle may be taken from or added to the pool of server
+ * info.  A server marked down is retried once SERVER_RETRY_INTERVAL seconds
+ * have passed since it failed.
+ */
+static krb5_boolean
+server_usable(krb5_ldap_context *ldap_context, krb5_ldap_server_info *info,
+              time_t now)
+{
+    if (info->server_status == OFF &&
+        now - info->downtime < SERVER_RETRY_INTERVAL)
+        return FALSE;
+    if (info->server_status != ON)
+        return info->ldap_server_handles == NULL;
+    return info->ldap_server_handles != NULL ||
+        info->num_conns < ldap_context->server_conns_limit;
+}
+
+/*
+ * Choose the usable server with the fewest handles in use.  The scan starts
+ * after the server chosen last time, so that servers with equal load are used
+ * in turn.
+ */
+static krb5_ldap_server_info *
+choose_server(krb5_ldap_context *ldap_context, time_t now)
+{
+    krb5_ldap_server_info      **list = ldap_context->server_info_list;
+    krb5_ldap_server_info      *info, *best = NULL;
+    unsigned int               i, n, ind, best_ind = 0;
+
+    for (n = 0; list[n] != NULL; n++);
+    for (i = 0; i < n; i++) {
+        ind = (ldap_context->next_server + i) % n;
+        info = list[ind];
+        if (!server_usable(ldap_context, info, now))
+            continue;
+        if (best == NULL || info->num_busy < best->num_busy) {
+            best = info;
+            best_ind = ind;
+        }
+    }
+    if (best != NULL)
+        ldap_context->next_server = best_ind + 1;
+    return best;
+}
+
+/*
+ * Open a new connection to info for krb5_get_ldap_handle(), and return it as
+ * a busy handle.  A slot is reserved in the server's counts while the mutex
+ * is released for the connect and bind, so that other threads see the
+ * pending connection.  On failure, mark the server as down.  The caller
+ * should lock the mutex; it is unlocked and relocked here.
+ */
+static krb5_ldap_server_handle *
+connect_server(krb5_ldap_context *ldap_context, krb5_ldap_server_info *info)
+{
+    krb5_ldap_server_handle    *handle = NULL;
+    krb5_error_code            st;
+    krb5_boolean               probe = (info->server_status == NOTSET);
+    int                        modify_increment = 0;
+
+    info->num_conns++;
+    info->num_busy++;
+    HNDL_UNLOCK(ldap_context);
+
+#ifdef LDAP_MOD_INCREMENT
+    if (probe) {
+        modify_increment = has_modify_increment(ldap_context->kcontext,
+                                                info->server_name);
+    }
+#endif
+    st = krb5_ldap_open_handle(ldap_context, info, &handle);
+
+    HNDL_LOCK(ldap_context);
+    if (st) {
+        info->num_conns--;
+        info->num_busy--;
+        info->server_status = OFF;
+        time(&info->downtime);
+        info->num_failures++;
+        return NULL;
+    }
+    if (probe)
+        info->modify_increment = modify_increment;
+    info->server_status = ON;
+    gettimeofday(&handle->busy_since, NULL);
+    return handle;
+}
+
+/*
+ * Return ldap server handle from the pool, opening a new connection to the
+ * chosen server if its pool is empty.  If no server is usable return NULL.
  * Do not lock the mutex, caller should lock it
  */
 
@@ -96,30 +186,22 @@ krb5_get_ldap_handle(krb5_ldap_context *ldap_context)
 {
     krb5_ldap_server_handle    *ldap_server_handle=NULL;
     krb5_ldap_server_info      *ldap_server_info=NULL;
-    int                        cnt=0;
-
-    while (ldap_context->server_info_list[cnt] != NULL) {
-        ldap_server_info = ldap_context->server_info_list[cnt];
-        if (ldap_server_info->server_status != OFF) {
-            if (ldap_server_info->ldap_server_handles != NULL) {
-                ldap_server_handle = ldap_server_info->ldap_server_handles;
-                ldap_server_info->ldap_server_handles = ldap_server_handle->next;
-                break;
-#ifdef ASYNC_BIND
-                if (ldap_server_handle->server_info_update_pending == TRUE) {
-                    krb5_update_server_info(context, ldap_server_handle,
-                                            ldap_server_info);
-                }
-
-                if (ldap_server_info->server_status == ON) {
-                    ldap_server_info->ldap_server_handles = ldap_server_handle->next;
-                    break;
-                } else
-                    ldap_server_handle = NULL;
-#endif
-            }
+    time_t                     now = time(NULL);
+
+    /* A server whose connection fails is marked down, so this terminates. */
+    while ((ldap_server_info = choose_server(ldap_context, now)) != NULL) {
+        if (ldap_server_info->ldap_server_handles == NULL) {
+            ldap_server_handle = connect_server(ldap_context,
+                                                ldap_server_info);
+            if (ldap_server_handle == NULL)
+                continue;
+            break;
         }
-        ++cnt;
+        ldap_server_handle = ldap_server_info->ldap_server_handles;
+        ldap_server_info->ldap_server_handles = ldap_server_handle->next;
+        ldap_server_info->num_busy++;
+        gettimeofday(&ldap_server_handle->busy_since, NULL);
+        break;
     }
     return ldap_server_handle;
 }
@@ -146,24 +228,48 @@ krb5_retry_get_ldap_handle(krb5_ldap_context *ldap_context,
 
 /*
  * Put back the ldap server handle to the front of the list of handles of the
- * ldap server info structure.
+ * ldap server info structure, recording how long it was in use.  If the
+ * server has been marked down meanwhile, close the handle instead.
  * Do not lock the mutex here. The caller should lock it.
  */
 
 static krb5_error_code
 krb5_put_ldap_handle(krb5_ldap_server_handle *ldap_server_handle)
 {
+    krb5_ldap_server_info      *info;
+    struct timeval             now;
+    long                       usec;
 
     if (ldap_server_handle == NULL)
         return 0;
 
-    ldap_server_handle->next = ldap_server_handle->server_info->ldap_server_handles;
-    ldap_server_handle->server_info->ldap_server_handles = ldap_server_handle;
+    info = ldap_server_handle->server_info;
+    gettimeofday(&now, NULL);
+    usec = (now.tv_sec - ldap_server_handle->busy_since.tv_sec) * 1000000 +
+        (now.tv_usec - ldap_server_handle->busy_since.tv_usec);
+    if (usec < 0)               /* the clock was stepped back */
+        usec = 0;
+    info->num_busy--;
+    info->num_requests++;
+    info->total_usec += usec;
+    if ((unsigned long)usec > info->max_usec)
+        info->max_usec = usec;
+
+    if (info->server_status == OFF) {
+        if (ldap_server_handle->ldap_handle != NULL)
+            ldap_unbind_ext_s(ldap_server_handle->ldap_handle, NULL, NULL);
+        free(ldap_server_handle);
+        info->num_conns--;
+        return 0;
+    }
+
+    ldap_server_handle->next = info->ldap_server_handles;
+    info->ldap_server_handles = ldap_server_handle;
     return 0;
 }
 
 /*
- * Free up all the ldap server handles of the server info.
+ * Close all the idle ldap server handles of the server info.
  * This function is called when the ldap server returns LDAP_SERVER_DOWN.
  */
 
@@ -175,9 +281,11 @@ krb5_ldap_cleanup_handles(krb5_ldap_server_info *ldap_server_info)
     while (ldap_server_info->ldap_server_handles != NULL) {
         ldap_server_handle = ldap_server_info->ldap_server_handles;
         ldap_server_info->ldap_server_handles = ldap_server_handle->next;
-        /* ldap_unbind_s(ldap_server_handle); */
+        if (ldap_server_handle->ldap_handle != NULL)
+            ldap_unbind_ext_s(ldap_server_handle->ldap_handle, NULL, NULL);
         free (ldap_server_handle);
         ldap_server_handle = NULL;
+        ldap_server_info->num_conns--;
     }
     return 0;
 }
@@ -213,12 +321,15 @@ krb5_ldap_request_next_handle_from_pool(krb5_ldap_context *ldap_context,
                                         ldap_server_handle)
 {
     krb5_error_code            st=0;
+    krb5_ldap_server_info      *info;
 
     HNDL_LOCK(ldap_context);
-    (*ldap_server_handle)->server_info->server_status = OFF;
-    time(&(*ldap_server_handle)->server_info->downtime);
+    info = (*ldap_server_handle)->server_info;
+    info->server_status = OFF;
+    time(&info->downtime);
+    info->num_failures++;
     krb5_put_ldap_handle(*ldap_server_handle);
-    krb5_ldap_cleanup_handles((*ldap_server_handle)->server_info);
+    krb5_ldap_cleanup_handles(info);
 
     if (((*ldap_server_handle)=krb5_get_ldap_handle(ldap_context)) == NULL)
         (*ldap_server_handle)=krb5_retry_get_ldap_handle(ldap_context, &st);
@@ -234,9 +345,20 @@ void
 krb5_ldap_put_handle_to_pool(krb5_ldap_context *ldap_context,
                              krb5_ldap_server_handle *ldap_server_handle)
 {
+    krb5_ldap_server_info      *info;
+    time_t                     now;
+
     if (ldap_server_handle != NULL) {
         HNDL_LOCK(ldap_context);
+        info = ldap_server_handle->server_info;
         krb5_put_ldap_handle(ldap_server_handle);
+        /* Long-running daemons may never close the context, so trace the
+         * server statistics periodically as well. */
+        now = time(NULL);
+        if (now - info->stats_time >= SERVER_STATS_INTERVAL) {
+            TRACE_LDAP_SERVER_STATS(ldap_context->kcontext, info);
+            info->stats_time = now;
+        }
         HNDL_UNLOCK(ldap_context);
     }
     return;
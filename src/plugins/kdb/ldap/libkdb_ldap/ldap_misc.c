@@ -38,6 +38,8 @@
 #include "ldap_principal.h"
 #include "princ_xdr.h"
 #include "ldap_pwd_policy.h"
+#include "ldap_tkt_policy.h"
+#include "ldap_princ_cache.h"
 #include <time.h>
 #include <ctype.h>
 #include <kadm5/admin.h>
@@ -187,6 +189,7 @@ add_server_entry(krb5_context context, const char *name)
     if (server == NULL)
         return ENOMEM;
     server->server_status = NOTSET;
+    server->stats_time = time(NULL);
     server->server_name = strdup(name);
     if (server->server_name == NULL) {
         free(server);
@@ -314,6 +317,7 @@ krb5_ldap_read_server_params(krb5_context context, char *conf_section,
     char *servers, *save_ptr, *item;
     const char *delims = "\t\n\f\v\r ,", *name;
     krb5_error_code ret = 0;
+    int ttl;
     kdb5_dal_handle *dal_handle = context->dal_handle;
     krb5_ldap_context *ldap_context = dal_handle->db_context;
 
@@ -327,6 +331,9 @@ krb5_ldap_read_server_params(krb5_context context, char *conf_section,
     /* This mutex is used in the LDAP connection pool. */
     if (k5_mutex_init(&(ldap_context->hndl_lock)) != 0)
         return KRB5_KDB_SERVER_INTERNAL_ERR;
+    if (k5_mutex_init(&ldap_context->tkt_policy_cache_lock) != 0)
+        return KRB5_KDB_SERVER_INTERNAL_ERR;
+    ldap_context->srv_type = srv_type;
 
     /* Read the maximum number of LDAP connections per server. */
     if (ldap_context->max_server_conns == 0) {
@@ -344,6 +351,44 @@ krb5_ldap_read_server_params(krb5_context context, char *conf_section,
         return EINVAL;
     }
 
+    /* Read the number of connections up to which each server's pool may
+     * grow under load. */
+    ret = prof_get_integer_def(context, conf_section,
+                               KRB5_CONF_LDAP_MAX_CONNS_PER_SERVER,
+                               ldap_context->max_server_conns,
+                               &ldap_context->server_conns_limit);
+    if (ret)
+        return ret;
+    if (ldap_context->server_conns_limit < ldap_context->max_server_conns)
+        ldap_context->server_conns_limit = ldap_context->max_server_conns;
+
+    /* Read the ticket policy cache lifetime.  Unlike other integer values, 0
+     * is meaningful here (it disables the cache), so look for -1 as unset. */
+    ret = profile_get_integer(context->profile, KDB_MODULE_SECTION,
+                              conf_section,
+                              KRB5_CONF_LDAP_TKT_POLICY_CACHE_TTL, -1, &ttl);
+    if (!ret && ttl == -1) {
+        ret = profile_get_integer(context->profile, KDB_MODULE_DEF_SECTION,
+                                  KRB5_CONF_LDAP_TKT_POLICY_CACHE_TTL, NULL,
+                                  DEFAULT_TKT_POLICY_CACHE_TTL, &ttl);
+    }
+    if (ret)
+        return attr_read_error(context, ret,
+                               KRB5_CONF_LDAP_TKT_POLICY_CACHE_TTL);
+    if (ttl < 0) {
+        k5_setmsg(context, EINVAL, _("Invalid ticket policy cache TTL %d"),
+                  ttl);
+        return EINVAL;
+    }
+    ldap_context->tkt_policy_cache_ttl = ttl;
+
+    /* Read the number of principal entries the KDC may cache. */
+    ret = prof_get_integer_def(context, conf_section,
+                               KRB5_CONF_LDAP_PRINCIPAL_CACHE_SIZE, 0,
+                               &ldap_context->princ_cache_size);
+    if (ret)
+        return ret;
+
     /* Read the DN used to connect to the LDAP server. */
     if (ldap_context->bind_dn == NULL) {
         name = choose_var(srv_type, KRB5_CONF_LDAP_KDC_DN,
@@ -448,6 +493,9 @@ krb5_ldap_free_server_context_params(krb5_ldap_context *ctx)
 
     list = ctx->server_info_list;
     for (i = 0; list != NULL && list[i] != NULL; i++) {
+        if (ctx->kcontext != NULL &&
+            (list[i]->num_requests > 0 || list[i]->num_failures > 0))
+            TRACE_LDAP_SERVER_STATS(ctx->kcontext, list[i]);
         free(list[i]->server_name);
         for (h = list[i]->ldap_server_handles; h != NULL; h = next) {
             next = h->next;
@@ -476,8 +524,12 @@ krb5_ldap_free_server_params(krb5_ldap_context *ctx)
 {
     if (ctx == NULL)
         return;
+    krb5_ldap_free_lockout_queue(ctx);
+    krb5_ldap_princ_cache_free(ctx);
     krb5_ldap_free_server_context_params(ctx);
+    krb5_ldap_free_tkt_policy_cache(ctx);
     k5_mutex_destroy(&ctx->hndl_lock);
+    k5_mutex_destroy(&ctx->tkt_policy_cache_lock);
     free(ctx);
 }
 
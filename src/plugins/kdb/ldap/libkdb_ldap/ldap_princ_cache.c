@@ -0,0 +1,833 @@
+/* -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* plugins/kdb/ldap/libkdb_ldap/ldap_princ_cache.c - LDAP principal cache */
+/*
+ * Copyright (C) 2016 by the Massachusetts Institute of Technology.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * This file implements an optional cache of principal entries for the KDC.
+ * Cached entries are kept coherent with the directory by a content
+ * synchronization search (RFC 4533) in refreshAndPersist mode, on a connection
+ * separate from the handle pool.  The KDC is single-threaded, so instead of
+ * reading that connection in the background we drain any pending change
+ * notifications before each cache lookup, discarding the entries they name.
+ * If the synchronization search cannot be started or ends, the cache is
+ * flushed and bypassed until SERVER_RETRY_INTERVAL seconds have passed.  The
+ * last synchronization cookie received for each search is kept and sent when
+ * the search is restarted, so that the server only needs to report the
+ * changes made since then.
+ *
+ * The KDC's own updates (such as lockout attributes) are also discarded
+ * directly, so that they are seen by the next lookup without waiting for the
+ * change notification.
+ */
+
+#include <ctype.h>
+#include "ldap_main.h"
+#include "kdb_ldap.h"
+#include "ldap_principal.h"
+#include "ldap_princ_cache.h"
+#include "ldap_err.h"
+#include "k5-queue.h"
+
+#define UUID_LEN 16
+
+#define PRINC_CACHE_FILTER \
+    "(|(objectclass=krbprincipalaux)(objectclass=krbprincipal))"
+
+#define TRACE_LDAP_PRINC_CACHE_STATS(c, cache)                          \
+    TRACE(c, "LDAP principal cache: {long} hits, {long} misses, "       \
+          "{long} entries discarded", (long)(cache)->hits,              \
+          (long)(cache)->misses, (long)(cache)->discards)
+#define TRACE_LDAP_PRINC_CACHE_SYNC_ERR(c, ret)                         \
+    TRACE(c, "LDAP principal cache disabled, cannot follow directory "  \
+          "changes: {kerr}", ret)
+
+struct entry {
+    LIST_ENTRY(entry) name_links;
+    LIST_ENTRY(entry) canon_links;
+    LIST_ENTRY(entry) uuid_links;
+    TAILQ_ENTRY(entry) expire_links;
+    char *name;                 /* name used in the lookup */
+    krb5_boolean alias_ok;      /* lookup flags included ALIAS_OK */
+    char *canon;                /* name of the entry found */
+    unsigned char uuid[UUID_LEN];
+    time_t timein;
+    krb5_db_entry *dbent;
+};
+
+LIST_HEAD(entry_list, entry);
+TAILQ_HEAD(entry_queue, entry);
+
+/* A synchronization search of one principal subtree. */
+struct sync_search {
+    int msgid;
+    struct berval *cookie;      /* last cookie received, or NULL */
+};
+
+struct _krb5_ldap_princ_cache {
+    unsigned int nbuckets;
+    struct entry_list *by_name;
+    struct entry_list *by_canon;
+    struct entry_list *by_uuid;
+    struct entry_queue expiration_queue;
+    unsigned int num_entries;
+    krb5_ldap_server_handle *sync;  /* NULL if not following changes */
+    time_t sync_downtime;
+    struct sync_search *searches;   /* one for each subtree */
+    unsigned int nsearches;
+    unsigned long hits, misses, discards;
+};
+
+/* Return the FNV-1a hash of len bytes at data, modulo nbuckets. */
+static unsigned int
+hash_bytes(const void *data, size_t len, unsigned int nbuckets)
+{
+    const unsigned char *p = data;
+    krb5_ui_4 h = 2166136261U;
+
+    while (len-- > 0)
+        h = (h ^ *p++) * 16777619U;
+    return h % nbuckets;
+}
+
+static inline unsigned int
+hash_string(const char *str, unsigned int nbuckets)
+{
+    return hash_bytes(str, strlen(str), nbuckets);
+}
+
+/* Parse the string form of an entryUUID value into uuid.  Return false if it
+ * is not well-formed. */
+static krb5_boolean
+parse_uuid(const char *str, unsigned char *uuid)
+{
+    unsigned int i, n = 0, val;
+
+    for (i = 0; str[i] != '\0' && n < UUID_LEN * 2; i++) {
+        if (str[i] == '-')
+            continue;
+        if (!isxdigit((unsigned char)str[i]))
+            return FALSE;
+        val = isdigit((unsigned char)str[i]) ? str[i] - '0' :
+            tolower((unsigned char)str[i]) - 'a' + 10;
+        if (n % 2 == 0)
+            uuid[n / 2] = val << 4;
+        else
+            uuid[n / 2] |= val;
+        n++;
+    }
+    return n == UUID_LEN * 2 && str[i] == '\0';
+}
+
+/* Make a deep copy of the principal entry in. */
+static krb5_error_code
+copy_entry(krb5_context context, const krb5_db_entry *in,
+           krb5_db_entry **out)
+{
+    krb5_error_code ret;
+    krb5_db_entry *ent;
+    krb5_tl_data *tl, **tlp;
+    krb5_key_data *kd;
+    int i, j;
+
+    *out = NULL;
+
+    ent = k5alloc(sizeof(*ent), &ret);
+    if (ent == NULL)
+        return ret;
+    *ent = *in;
+    ent->e_data = NULL;
+    ent->princ = NULL;
+    ent->tl_data = NULL;
+    ent->key_data = NULL;
+    ent->n_key_data = 0;
+
+    if (in->e_data != NULL) {
+        ent->e_data = k5memdup(in->e_data, in->e_length, &ret);
+        if (ent->e_data == NULL)
+            goto fail;
+    }
+
+    ret = krb5_copy_principal(context, in->princ, &ent->princ);
+    if (ret)
+        goto fail;
+
+    tlp = &ent->tl_data;
+    for (tl = in->tl_data; tl != NULL; tl = tl->tl_data_next) {
+        *tlp = k5alloc(sizeof(**tlp), &ret);
+        if (*tlp == NULL)
+            goto fail;
+        (*tlp)->tl_data_type = tl->tl_data_type;
+        (*tlp)->tl_data_length = tl->tl_data_length;
+        (*tlp)->tl_data_contents = k5memdup(tl->tl_data_contents,
+                                            tl->tl_data_length, &ret);
+        if ((*tlp)->tl_data_contents == NULL)
+            goto fail;
+        tlp = &(*tlp)->tl_data_next;
+    }
+
+    if (in->n_key_data > 0) {
+        ent->key_data = k5calloc(in->n_key_data, sizeof(*ent->key_data),
+                                 &ret);
+        if (ent->key_data == NULL)
+            goto fail;
+        for (i = 0; i < in->n_key_data; i++) {
+            kd = &ent->key_data[i];
+            *kd = in->key_data[i];
+            for (j = 0; j < KRB5_KDB_V1_KEY_DATA_ARRAY; j++)
+                kd->key_data_contents[j] = NULL;
+        }
+        ent->n_key_data = in->n_key_data;
+        for (i = 0; i < in->n_key_data; i++) {
+            kd = &ent->key_data[i];
+            for (j = 0; j < kd->key_data_ver; j++) {
+                kd->key_data_contents[j] =
+                    k5memdup(in->key_data[i].key_data_contents[j],
+                             kd->key_data_length[j], &ret);
+                if (kd->key_data_contents[j] == NULL)
+                    goto fail;
+            }
+        }
+    }
+
+    *out = ent;
+    return 0;
+
+fail:
+    krb5_ldap_free_principal(context, ent);
+    return ret;
+}
+
+/* Remove ent from the cache and free it. */
+static void
+discard_entry(krb5_context context, krb5_ldap_princ_cache *cache,
+              struct entry *ent)
+{
+    LIST_REMOVE(ent, name_links);
+    LIST_REMOVE(ent, canon_links);
+    LIST_REMOVE(ent, uuid_links);
+    TAILQ_REMOVE(&cache->expiration_queue, ent, expire_links);
+    cache->num_entries--;
+    krb5_ldap_free_principal(context, ent->dbent);
+    free(ent->name);
+    free(ent->canon);
+    free(ent);
+}
+
+/* Discard all cached entries. */
+static void
+flush_cache(krb5_context context, krb5_ldap_princ_cache *cache)
+{
+    struct entry *ent;
+
+    while ((ent = TAILQ_FIRST(&cache->expiration_queue)) != NULL) {
+        discard_entry(context, cache, ent);
+        cache->discards++;
+    }
+}
+
+/* Discard cached entries for the directory object with the given UUID. */
+static void
+discard_uuid(krb5_context context, krb5_ldap_princ_cache *cache,
+             const unsigned char *uuid)
+{
+    struct entry *ent, *next;
+    unsigned int h = hash_bytes(uuid, UUID_LEN, cache->nbuckets);
+
+    LIST_FOREACH_SAFE(ent, &cache->by_uuid[h], uuid_links, next) {
+        if (memcmp(ent->uuid, uuid, UUID_LEN) == 0) {
+            discard_entry(context, cache, ent);
+            cache->discards++;
+        }
+    }
+}
+
+/* Stop following directory changes, and flush the cache since we can no
+ * longer tell when entries change. */
+static void
+sync_stop(krb5_context context, krb5_ldap_princ_cache *cache)
+{
+    if (cache->sync != NULL) {
+        ldap_unbind_ext_s(cache->sync->ldap_handle, NULL, NULL);
+        free(cache->sync);
+        cache->sync = NULL;
+    }
+    time(&cache->sync_downtime);
+    flush_cache(context, cache);
+}
+
+/* Free the synchronization searches of cache, along with their cookies. */
+static void
+free_searches(krb5_ldap_princ_cache *cache)
+{
+    unsigned int i;
+
+    for (i = 0; i < cache->nsearches; i++)
+        ber_bvfree(cache->searches[i].cookie);
+    free(cache->searches);
+    cache->searches = NULL;
+    cache->nsearches = 0;
+}
+
+#ifdef LDAP_CONTROL_SYNC
+
+/* Create a Sync Request control for a refreshAndPersist search, resuming
+ * from cookie if it is not NULL. */
+static krb5_error_code
+make_sync_control(krb5_context context, struct berval *cookie,
+                  LDAPControl **ctrl_out)
+{
+    krb5_error_code ret = 0;
+    BerElement *ber;
+    struct berval *bv = NULL;
+    int st;
+
+    *ctrl_out = NULL;
+
+    ber = ber_alloc_t(LBER_USE_DER);
+    if (ber == NULL)
+        return ENOMEM;
+    if (cookie != NULL)
+        st = ber_printf(ber, "{eO}", LDAP_SYNC_REFRESH_AND_PERSIST, cookie);
+    else
+        st = ber_printf(ber, "{e}", LDAP_SYNC_REFRESH_AND_PERSIST);
+    if (st == -1 || ber_flatten(ber, &bv) == -1) {
+        ret = ENOMEM;
+        goto cleanup;
+    }
+    st = ldap_control_create(LDAP_CONTROL_SYNC, 1, bv, 1, ctrl_out);
+    if (st != LDAP_SUCCESS)
+        ret = set_ldap_error(context, st, OP_SEARCH);
+
+cleanup:
+    ber_bvfree(bv);
+    ber_free(ber, 1);
+    return ret;
+}
+
+/* Open a connection to the first server not known to be down, and start a
+ * refreshAndPersist content synchronization search for principal entries in
+ * each subtree, resuming from the search's last cookie if there is one.  No
+ * attributes are requested, as only the entry UUID in each notification is
+ * used. */
+static krb5_error_code
+sync_start(krb5_context context, krb5_ldap_context *ldap_context,
+           krb5_ldap_princ_cache *cache)
+{
+    krb5_error_code ret;
+    krb5_ldap_server_info *info = NULL;
+    krb5_ldap_server_handle *handle = NULL;
+    LDAPControl *ctrl = NULL, *ctrls[2];
+    char **subtrees = NULL, *attrs[] = { LDAP_NO_ATTRS, NULL };
+    unsigned int ntrees = 0, i;
+    int st;
+
+    for (i = 0; ldap_context->server_info_list[i] != NULL; i++) {
+        info = ldap_context->server_info_list[i];
+        if (info->server_status != OFF)
+            break;
+    }
+    if (ldap_context->server_info_list[i] == NULL)
+        return KRB5_KDB_ACCESS_ERROR;
+
+    ret = krb5_ldap_open_handle(ldap_context, info, &handle);
+    if (ret)
+        return ret;
+
+    ret = krb5_get_subtree_info(ldap_context, &subtrees, &ntrees);
+    if (ret)
+        goto cleanup;
+
+    /* The cookies of a previous search only apply to the same subtrees. */
+    if (cache->searches == NULL || cache->nsearches != ntrees) {
+        free_searches(cache);
+        cache->searches = k5calloc(ntrees ? ntrees : 1,
+                                   sizeof(*cache->searches), &ret);
+        if (cache->searches == NULL)
+            goto cleanup;
+        cache->nsearches = ntrees;
+    }
+
+    for (i = 0; i < ntrees; i++) {
+        ret = make_sync_control(context, cache->searches[i].cookie, &ctrl);
+        if (ret)
+            goto cleanup;
+        ctrls[0] = ctrl;
+        ctrls[1] = NULL;
+        st = ldap_search_ext(handle->ldap_handle, subtrees[i],
+                             ldap_context->lrparams->search_scope,
+                             PRINC_CACHE_FILTER, attrs, 0, ctrls, NULL, NULL,
+                             LDAP_NO_LIMIT, &cache->searches[i].msgid);
+        ldap_control_free(ctrl);
+        if (st != LDAP_SUCCESS) {
+            ret = set_ldap_error(context, st, OP_SEARCH);
+            goto cleanup;
+        }
+    }
+
+    cache->sync = handle;
+    handle = NULL;
+
+cleanup:
+    if (handle != NULL) {
+        ldap_unbind_ext_s(handle->ldap_handle, NULL, NULL);
+        free(handle);
+    }
+    for (i = 0; i < ntrees; i++)
+        free(subtrees[i]);
+    free(subtrees);
+    return ret;
+}
+
+/* Return the synchronization search which msg belongs to, or NULL. */
+static struct sync_search *
+find_search(krb5_ldap_princ_cache *cache, LDAPMessage *msg)
+{
+    unsigned int i;
+    int msgid = ldap_msgid(msg);
+
+    for (i = 0; i < cache->nsearches; i++) {
+        if (cache->searches[i].msgid == msgid)
+            return &cache->searches[i];
+    }
+    return NULL;
+}
+
+/* Remember cookie as the point from which search can be resumed.  If the
+ * cookie cannot be copied, the search will be restarted from scratch. */
+static void
+save_cookie(struct sync_search *search, struct berval *cookie)
+{
+    if (search == NULL)
+        return;
+    ber_bvfree(search->cookie);
+    search->cookie = ber_bvdup(cookie);
+}
+
+/* If the next element of ber is a cookie, save it for search. */
+static void
+read_cookie(BerElement *ber, struct sync_search *search)
+{
+    struct berval cookie;
+    ber_len_t len;
+
+    if (ber_peek_tag(ber, &len) == LDAP_TAG_SYNC_COOKIE &&
+        ber_scanf(ber, "m", &cookie) != LBER_ERROR)
+        save_cookie(search, &cookie);
+}
+
+/* Discard cached entries for the object named by the Sync State control of
+ * the search entry msg, and save the control's cookie if it has one.  Return
+ * false if msg has no valid control. */
+static krb5_boolean
+discard_changed(krb5_context context, krb5_ldap_princ_cache *cache, LDAP *ld,
+                LDAPMessage *msg)
+{
+    LDAPControl **ctrls = NULL, *ctrl;
+    BerElement *ber = NULL;
+    struct berval uuid;
+    ber_int_t state;
+    krb5_boolean ok = FALSE;
+
+    if (ldap_get_entry_controls(ld, msg, &ctrls) != LDAP_SUCCESS)
+        return FALSE;
+    ctrl = ldap_control_find(LDAP_CONTROL_SYNC_STATE, ctrls, NULL);
+    if (ctrl == NULL)
+        goto cleanup;
+    ber = ber_init(&ctrl->ldctl_value);
+    if (ber == NULL)
+        goto cleanup;
+    if (ber_scanf(ber, "{em" /* "}" */, &state, &uuid) == LBER_ERROR ||
+        uuid.bv_len != UUID_LEN)
+        goto cleanup;
+
+    /* Whether the entry was added, modified or deleted, any cached copy is
+     * out of date. */
+    discard_uuid(context, cache, (unsigned char *)uuid.bv_val);
+    read_cookie(ber, find_search(cache, msg));
+    ok = TRUE;
+
+cleanup:
+    if (ber != NULL)
+        ber_free(ber, 1);
+    ldap_controls_free(ctrls);
+    return ok;
+}
+
+/* Process the Sync Info message msg.  A message carrying only a new cookie
+ * reports no changes.  Other messages may report deletions as a set of UUIDs;
+ * rather than decode them, start over with an empty cache.  In either case
+ * save the cookie if there is one. */
+static void
+process_sync_info(krb5_context context, krb5_ldap_princ_cache *cache,
+                  LDAP *ld, LDAPMessage *msg)
+{
+    struct sync_search *search = find_search(cache, msg);
+    char *oid = NULL;
+    struct berval *data = NULL, cookie;
+    BerElement *ber = NULL;
+    ber_tag_t tag;
+    ber_len_t len;
+
+    if (ldap_parse_intermediate(ld, msg, &oid, &data, NULL, 0) !=
+        LDAP_SUCCESS || oid == NULL || strcmp(oid, LDAP_SYNC_INFO) != 0 ||
+        data == NULL || (ber = ber_init(data)) == NULL) {
+        flush_cache(context, cache);
+        goto cleanup;
+    }
+
+    tag = ber_peek_tag(ber, &len);
+    if (tag == LDAP_TAG_SYNC_NEW_COOKIE) {
+        if (ber_scanf(ber, "m", &cookie) != LBER_ERROR)
+            save_cookie(search, &cookie);
+        goto cleanup;
+    }
+
+    flush_cache(context, cache);
+    if ((tag == LDAP_TAG_SYNC_REFRESH_DELETE ||
+         tag == LDAP_TAG_SYNC_REFRESH_PRESENT ||
+         tag == LDAP_TAG_SYNC_ID_SET) &&
+        ber_scanf(ber, "{" /* "}" */) != LBER_ERROR)
+        read_cookie(ber, search);
+
+cleanup:
+    if (ber != NULL)
+        ber_free(ber, 1);
+    ber_bvfree(data);
+    ldap_memfree(oid);
+}
+
+/* Process the result which ended a synchronization search.  Save the cookie
+ * of its Sync Done control, or discard the search's cookie if the search
+ * failed, in case the server did not accept it. */
+static void
+end_search(LDAP *ld, LDAPMessage *msg, struct sync_search *search)
+{
+    LDAPControl **ctrls = NULL, *ctrl;
+    BerElement *ber = NULL;
+    int err;
+
+    if (search == NULL)
+        return;
+    if (ldap_parse_result(ld, msg, &err, NULL, NULL, NULL, &ctrls, 0) !=
+        LDAP_SUCCESS || err != LDAP_SUCCESS) {
+        ber_bvfree(search->cookie);
+        search->cookie = NULL;
+        goto cleanup;
+    }
+    ctrl = ldap_control_find(LDAP_CONTROL_SYNC_DONE, ctrls, NULL);
+    if (ctrl == NULL)
+        goto cleanup;
+    ber = ber_init(&ctrl->ldctl_value);
+    if (ber != NULL && ber_scanf(ber, "{" /* "}" */) != LBER_ERROR)
+        read_cookie(ber, search);
+
+cleanup:
+    if (ber != NULL)
+        ber_free(ber, 1);
+    ldap_controls_free(ctrls);
+}
+
+/* Process the change notifications which have arrived on the synchronization
+ * connection, without blocking. */
+static void
+sync_poll(krb5_context context, krb5_ldap_princ_cache *cache)
+{
+    struct timeval ztime = { 0, 0 };
+    LDAPMessage *msg;
+    LDAP *ld = cache->sync->ldap_handle;
+    int st;
+
+    for (;;) {
+        st = ldap_result(ld, LDAP_RES_ANY, LDAP_MSG_ONE, &ztime, &msg);
+        if (st == 0)
+            return;
+        if (st == -1) {
+            sync_stop(context, cache);
+            return;
+        }
+
+        switch (st) {
+        case LDAP_RES_SEARCH_ENTRY:
+            if (!discard_changed(context, cache, ld, msg))
+                flush_cache(context, cache);
+            break;
+        case LDAP_RES_SEARCH_REFERENCE:
+            break;
+        case LDAP_RES_INTERMEDIATE:
+            process_sync_info(context, cache, ld, msg);
+            break;
+        default:
+            /* The search has ended, perhaps because the server does not
+             * support it. */
+            if (st == LDAP_RES_SEARCH_RESULT)
+                end_search(ld, msg, find_search(cache, msg));
+            ldap_msgfree(msg);
+            sync_stop(context, cache);
+            return;
+        }
+        ldap_msgfree(msg);
+    }
+}
+
+#else /* LDAP_CONTROL_SYNC */
+
+/* Without content synchronization support in the LDAP library, we cannot tell
+ * when entries change, so the cache is never used. */
+static krb5_error_code
+sync_start(krb5_context context, krb5_ldap_context *ldap_context,
+           krb5_ldap_princ_cache *cache)
+{
+    return KRB5_PLUGIN_OP_NOTSUPP;
+}
+
+static void
+sync_poll(krb5_context context, krb5_ldap_princ_cache *cache)
+{
+}
+
+#endif /* LDAP_CONTROL_SYNC */
+
+/* Create the principal cache for ldap_context. */
+static krb5_ldap_princ_cache *
+new_cache(krb5_ldap_context *ldap_context)
+{
+    krb5_ldap_princ_cache *cache;
+    unsigned int i;
+
+    cache = calloc(1, sizeof(*cache));
+    if (cache == NULL)
+        return NULL;
+    cache->nbuckets = ldap_context->princ_cache_size;
+    cache->by_name = calloc(cache->nbuckets, sizeof(*cache->by_name));
+    cache->by_canon = calloc(cache->nbuckets, sizeof(*cache->by_canon));
+    cache->by_uuid = calloc(cache->nbuckets, sizeof(*cache->by_uuid));
+    if (cache->by_name == NULL || cache->by_canon == NULL ||
+        cache->by_uuid == NULL) {
+        free(cache->by_name);
+        free(cache->by_canon);
+        free(cache->by_uuid);
+        free(cache);
+        return NULL;
+    }
+    for (i = 0; i < cache->nbuckets; i++) {
+        LIST_INIT(&cache->by_name[i]);
+        LIST_INIT(&cache->by_canon[i]);
+        LIST_INIT(&cache->by_uuid[i]);
+    }
+    TAILQ_INIT(&cache->expiration_queue);
+    return cache;
+}
+
+/* Return the principal cache for ldap_context, creating it or restarting the
+ * synchronization search as needed, and process pending change notifications.
+ * Return NULL if the cache is not enabled or cannot be used now. */
+static krb5_ldap_princ_cache *
+get_cache(krb5_context context, krb5_ldap_context *ldap_context)
+{
+    krb5_error_code ret;
+    krb5_ldap_princ_cache *cache = ldap_context->princ_cache;
+
+    /* Only the KDC caches entries; administrative programs must see their own
+     * changes and changes made by others immediately. */
+    if (ldap_context->princ_cache_size == 0 ||
+        ldap_context->srv_type != KRB5_KDB_SRV_TYPE_KDC)
+        return NULL;
+
+    if (cache == NULL) {
+        cache = new_cache(ldap_context);
+        if (cache == NULL)
+            return NULL;
+        ldap_context->princ_cache = cache;
+    }
+
+    if (cache->sync == NULL) {
+        if (time(NULL) - cache->sync_downtime < SERVER_RETRY_INTERVAL)
+            return NULL;
+        ret = sync_start(context, ldap_context, cache);
+        if (ret) {
+            TRACE_LDAP_PRINC_CACHE_SYNC_ERR(context, ret);
+            krb5_clear_error_message(context);
+            time(&cache->sync_downtime);
+            return NULL;
+        }
+    }
+
+    sync_poll(context, cache);
+    return (cache->sync != NULL) ? cache : NULL;
+}
+
+/*
+ * Look for a cached entry for the principal name (unparsed as for LDAP
+ * searches) with lookup flags flags.  If one is found, set *entry_out to a
+ * copy of it and return true.
+ */
+krb5_boolean
+krb5_ldap_princ_cache_get(krb5_context context,
+                          krb5_ldap_context *ldap_context, const char *name,
+                          unsigned int flags, krb5_db_entry **entry_out)
+{
+    krb5_ldap_princ_cache *cache;
+    struct entry *ent;
+    krb5_boolean alias_ok = (flags & KRB5_KDB_FLAG_ALIAS_OK) != 0;
+    unsigned int h;
+
+    *entry_out = NULL;
+
+    cache = get_cache(context, ldap_context);
+    if (cache == NULL)
+        return FALSE;
+
+    h = hash_string(name, cache->nbuckets);
+    LIST_FOREACH(ent, &cache->by_name[h], name_links) {
+        if (ent->alias_ok == alias_ok && strcmp(ent->name, name) == 0)
+            break;
+    }
+    if (ent != NULL && time(NULL) - ent->timein >= PRINC_CACHE_LIFETIME) {
+        discard_entry(context, cache, ent);
+        ent = NULL;
+    }
+    if (ent == NULL || copy_entry(context, ent->dbent, entry_out) != 0) {
+        cache->misses++;
+        return FALSE;
+    }
+    cache->hits++;
+    return TRUE;
+}
+
+/*
+ * Cache a copy of dbent, found by looking up name with flags flags.  uuid is
+ * the entryUUID value of the directory object, or NULL if it was not
+ * available, in which case the entry is not cached as we could not tell when
+ * it changes.
+ */
+void
+krb5_ldap_princ_cache_put(krb5_context context,
+                          krb5_ldap_context *ldap_context, const char *name,
+                          unsigned int flags, const char *uuid,
+                          krb5_db_entry *dbent)
+{
+    krb5_ldap_princ_cache *cache = ldap_context->princ_cache;
+    struct entry *ent, *oldest;
+    krb5_error_code ret;
+    time_t now = time(NULL);
+
+    if (cache == NULL || cache->sync == NULL || uuid == NULL)
+        return;
+
+    ent = k5alloc(sizeof(*ent), &ret);
+    if (ent == NULL)
+        return;
+    if (!parse_uuid(uuid, ent->uuid))
+        goto fail;
+    ent->name = strdup(name);
+    if (ent->name == NULL)
+        goto fail;
+    ent->alias_ok = (flags & KRB5_KDB_FLAG_ALIAS_OK) != 0;
+    if (krb5_unparse_name(context, dbent->princ, &ent->canon) != 0)
+        goto fail;
+    if (copy_entry(context, dbent, &ent->dbent) != 0)
+        goto fail;
+    ent->timein = now;
+
+    /* Make room by discarding expired entries, or the oldest entry. */
+    while ((oldest = TAILQ_FIRST(&cache->expiration_queue)) != NULL &&
+           (now - oldest->timein >= PRINC_CACHE_LIFETIME ||
+            cache->num_entries >= ldap_context->princ_cache_size))
+        discard_entry(context, cache, oldest);
+
+    LIST_INSERT_HEAD(&cache->by_name[hash_string(ent->name, cache->nbuckets)],
+                     ent, name_links);
+    LIST_INSERT_HEAD(&cache->by_canon[hash_string(ent->canon,
+                                                  cache->nbuckets)],
+                     ent, canon_links);
+    LIST_INSERT_HEAD(&cache->by_uuid[hash_bytes(ent->uuid, UUID_LEN,
+                                                cache->nbuckets)],
+                     ent, uuid_links);
+    TAILQ_INSERT_TAIL(&cache->expiration_queue, ent, expire_links);
+    cache->num_entries++;
+    return;
+
+fail:
+    free(ent->name);
+    free(ent->canon);
+    free(ent);
+}
+
+/* Discard cached entries for princ, which is being modified or deleted.  As
+ * modifications are made using the canonical name, this includes entries
+ * found through an alias. */
+void
+krb5_ldap_princ_cache_remove(krb5_context context,
+                             krb5_ldap_context *ldap_context,
+                             krb5_const_principal princ)
+{
+    krb5_ldap_princ_cache *cache = ldap_context->princ_cache;
+    struct entry *ent, *next;
+    char *name;
+    unsigned int h;
+
+    if (cache == NULL || cache->num_entries == 0)
+        return;
+
+    /* If we cannot tell which entries to discard, discard them all. */
+    if (krb5_unparse_name(context, princ, &name) != 0) {
+        flush_cache(context, cache);
+        return;
+    }
+
+    h = hash_string(name, cache->nbuckets);
+    LIST_FOREACH_SAFE(ent, &cache->by_canon[h], canon_links, next) {
+        if (strcmp(ent->canon, name) == 0) {
+            discard_entry(context, cache, ent);
+            cache->discards++;
+        }
+    }
+    krb5_free_unparsed_name(context, name);
+}
+
+/* Free the principal cache of ldap_context. */
+void
+krb5_ldap_princ_cache_free(krb5_ldap_context *ldap_context)
+{
+    krb5_ldap_princ_cache *cache = ldap_context->princ_cache;
+    krb5_context context = ldap_context->kcontext;
+
+    if (cache == NULL)
+        return;
+    sync_stop(context, cache);
+    free_searches(cache);
+    TRACE_LDAP_PRINC_CACHE_STATS(context, cache);
+    free(cache->by_name);
+    free(cache->by_canon);
+    free(cache->by_uuid);
+    free(cache);
+    ldap_context->princ_cache = NULL;
+}
@@ -37,6 +37,7 @@
 #include "ldap_principal.h"
 #include "princ_xdr.h"
 #include "ldap_err.h"
+#include "ldap_princ_cache.h"
 
 struct timeval timelimit = {300, 0};  /* 5 minutes */
 char     *principal_attributes[] = { "krbprincipalname",
@@ -63,6 +64,35 @@ char     *principal_attributes[] = { "krbprincipalname",
                                      "krbPwdHistory",
                                      NULL };
 
+/*
+ * The attributes fetched for KDC principal lookups.  This omits the password
+ * history and object references, which are only used when the entry is
+ * modified through kadmin and can be large, and adds the operational
+ * entryUUID attribute used to key the principal cache.
+ */
+char     *kdc_principal_attributes[] = { "krbprincipalname",
+                                         "krbcanonicalname",
+                                         "objectclass",
+                                         "krbprincipalkey",
+                                         "krbmaxrenewableage",
+                                         "krbmaxticketlife",
+                                         "krbticketflags",
+                                         "krbprincipalexpiration",
+                                         "krbticketpolicyreference",
+                                         "krbUpEnabled",
+                                         "krbpwdpolicyreference",
+                                         "krbpasswordexpiration",
+                                         "krbLastFailedAuth",
+                                         "krbLoginFailedCount",
+                                         "krbLastSuccessfulAuth",
+                                         "krbLastPwdChange",
+                                         "krbLastAdminUnlock",
+                                         "krbPrincipalAuthInd",
+                                         "krbExtraData",
+                                         "krbAllowedToDelegateTo",
+                                         "entryUUID",
+                                         NULL };
+
 /* Must match KDB_*_ATTR macros in ldap_principal.h.  */
 static char *attributes_set[] = { "krbmaxticketlife",
                                   "krbmaxrenewableage",
@@ -137,15 +167,125 @@ krb5_ldap_free_principal(krb5_context kcontext, krb5_db_entry *entry)
     free(entry);
 }
 
+/* Issue an asynchronous search for the next page of principal entries under
+ * base, continuing from cookie if it is not NULL. */
+static int
+search_page(LDAP *ld, char *base, int scope, char *filter,
+            struct berval *cookie, int *msgid_out)
+{
+    LDAPControl *ctrl = NULL, *ctrls[2];
+    int st;
+
+    st = ldap_create_page_control(ld, ITERATE_PAGE_SIZE, cookie, 0, &ctrl);
+    if (st != LDAP_SUCCESS)
+        return st;
+    ctrls[0] = ctrl;
+    ctrls[1] = NULL;
+    st = ldap_search_ext(ld, base, scope, filter, principal_attributes, 0,
+                         ctrls, NULL, &timelimit, LDAP_NO_LIMIT, msgid_out);
+    ldap_control_free(ctrl);
+    return st;
+}
+
+/*
+ * Wait for the page of results requested by msgid, placing it in *result_out.
+ * Set *cookie to the cookie for the next page, or to an empty value if this
+ * was the last page (or if the server does not support paged results and
+ * returned every entry at once).
+ */
+static int
+get_page(LDAP *ld, int msgid, LDAPMessage **result_out, struct berval *cookie)
+{
+    LDAPMessage *result = NULL;
+    LDAPControl **ctrls = NULL, *ctrl;
+    ber_int_t count;
+    int st, err;
+
+    *result_out = NULL;
+    cookie->bv_val = NULL;
+    cookie->bv_len = 0;
+
+    st = ldap_result(ld, msgid, LDAP_MSG_ALL, &timelimit, &result);
+    if (st == 0)
+        return LDAP_TIMEOUT;
+    if (st == -1) {
+        (void)ldap_get_option(ld, LDAP_OPT_RESULT_CODE, &err);
+        return err;
+    }
+
+    st = ldap_parse_result(ld, result, &err, NULL, NULL, NULL, &ctrls, 0);
+    if (st == LDAP_SUCCESS)
+        st = err;
+    if (st == LDAP_SUCCESS && ctrls != NULL) {
+        ctrl = ldap_control_find(LDAP_CONTROL_PAGEDRESULTS, ctrls, NULL);
+        if (ctrl != NULL)
+            st = ldap_parse_pageresponse_control(ld, ctrl, &count, cookie);
+    }
+    ldap_controls_free(ctrls);
+    if (st != LDAP_SUCCESS) {
+        ldap_msgfree(result);
+        return st;
+    }
+    *result_out = result;
+    return LDAP_SUCCESS;
+}
+
+/* Invoke func on the principal in ent, if it belongs to the realm. */
+static krb5_error_code
+iterate_entry(krb5_context context, krb5_ldap_context *ldap_context, LDAP *ld,
+              LDAPMessage *ent,
+              krb5_error_code (*func)(krb5_pointer, krb5_db_entry *),
+              krb5_pointer func_arg)
+{
+    krb5_error_code st = 0;
+    krb5_db_entry entry;
+    krb5_principal principal;
+    char **values, *princ_name = NULL;
+    unsigned int i;
+
+    memset(&entry, 0, sizeof(entry));
+    values = ldap_get_values(ld, ent, "krbcanonicalname");
+    if (values == NULL)
+        values = ldap_get_values(ld, ent, "krbprincipalname");
+    if (values == NULL)
+        return 0;
+    for (i = 0; values[i] != NULL; ++i) {
+        if (krb5_ldap_parse_principal_name(values[i], &princ_name) != 0)
+            continue;
+        if (krb5_parse_name(context, princ_name, &principal) != 0) {
+            free(princ_name);
+            continue;
+        }
+        free(princ_name);
+        if (is_principal_in_realm(ldap_context, principal)) {
+            st = populate_krb5_db_entry(context, ldap_context, ld, ent,
+                                        principal, &entry);
+            if (st == 0) {
+                (*func)(func_arg, &entry);
+                krb5_dbe_free_contents(context, &entry);
+            }
+            krb5_free_principal(context, principal);
+            break;
+        }
+        krb5_free_principal(context, principal);
+    }
+    ldap_value_free(values);
+    return st;
+}
+
+/*
+ * Iterate over the principals using the simple paged results control, so that
+ * only a page of entries is held in memory at a time.  The request for the
+ * next page is sent before the entries of the current page are passed to
+ * func, so that the server can prepare it in the meantime.
+ */
 krb5_error_code
 krb5_ldap_iterate(krb5_context context, char *match_expr,
                   krb5_error_code (*func)(krb5_pointer, krb5_db_entry *),
                   krb5_pointer func_arg, krb5_flags iterflags)
 {
-    krb5_db_entry            entry;
-    krb5_principal           principal;
-    char                     **subtree=NULL, *princ_name=NULL, *realm=NULL, **values=NULL, *filter=NULL;
-    unsigned int             tree=0, ntree=1, i=0;
+    char                     **subtree=NULL, *realm=NULL, *filter=NULL;
+    unsigned int             tree=0, ntree=1;
     krb5_error_code          st=0, tempst=0;
     LDAP                     *ld=NULL;
     LDAPMessage              *result=NULL, *ent=NULL;
@@ -153,11 +293,13 @@ krb5_ldap_iterate(krb5_context context, char *match_expr,
     krb5_ldap_context        *ldap_context=NULL;
     krb5_ldap_server_handle  *ldap_server_handle=NULL;
     char                     *default_match_expr = "*";
+    struct berval            cookie = { 0, NULL };
+    int                      msgid = 0, scope;
+    krb5_boolean             pending = FALSE;
 
     /* Clear the global error string */
     krb5_clear_error_message(context);
 
-    memset(&entry, 0, sizeof(krb5_db_entry));
     SETUP_CONTEXT();
 
     realm = ldap_context->lrparams->realm_name;
@@ -185,40 +327,67 @@ krb5_ldap_iterate(krb5_context context, char *match_expr,
 
     GET_HANDLE();
 
+    scope = ldap_context->lrparams->search_scope;
     for (tree=0; tree < ntree; ++tree) {
+        /* Request the first page, rebinding if the connection was lost. */
+        st = search_page(ld, subtree[tree], scope, filter, NULL, &msgid);
+        if (translate_ldap_error(st, OP_SEARCH) == KRB5_KDB_ACCESS_ERROR) {
+            tempst = krb5_ldap_rebind(ldap_context, &ldap_server_handle);
+            if (ldap_server_handle)
+                ld = ldap_server_handle->ldap_handle;
+            if (tempst != 0) {
+                k5_wrapmsg(context, st, KRB5_KDB_ACCESS_ERROR,
+                           "LDAP handle unavailable");
+                st = KRB5_KDB_ACCESS_ERROR;
+                goto cleanup;
+            }
+            st = search_page(ld, subtree[tree], scope, filter, NULL, &msgid);
+        }
+        if (st != LDAP_SUCCESS) {
+            st = set_ldap_error(context, st, OP_SEARCH);
+            goto cleanup;
+        }
+        pending = TRUE;
+
+        for (;;) {
+            st = get_page(ld, msgid, &result, &cookie);
+            pending = FALSE;
+            if (st != LDAP_SUCCESS) {
+                st = set_ldap_error(context, st, OP_SEARCH);
+                goto cleanup;
+            }
 
-        LDAP_SEARCH(subtree[tree], ldap_context->lrparams->search_scope, filter, principal_attributes);
-        for (ent=ldap_first_entry(ld, result); ent != NULL; ent=ldap_next_entry(ld, ent)) {
-            values=ldap_get_values(ld, ent, "krbcanonicalname");
-            if (values == NULL)
-                values=ldap_get_values(ld, ent, "krbprincipalname");
-            if (values != NULL) {
-                for (i=0; values[i] != NULL; ++i) {
-                    if (krb5_ldap_parse_principal_name(values[i], &princ_name) != 0)
-                        continue;
-                    if (krb5_parse_name(context, princ_name, &principal) != 0)
-                        continue;
-                    if (is_principal_in_realm(ldap_context, principal)) {
-                        if ((st = populate_krb5_db_entry(context, ldap_context, ld, ent, principal,
-                                                         &entry)) != 0)
-                            goto cleanup;
-                        (*func)(func_arg, &entry);
-                        krb5_dbe_free_contents(context, &entry);
-                        (void) krb5_free_principal(context, principal);
-                        free(princ_name);
-                        break;
-                    }
-                    (void) krb5_free_principal(context, principal);
-                    free(princ_name);
+            /* Prefetch the next page before processing this one. */
+            if (cookie.bv_len > 0) {
+                st = search_page(ld, subtree[tree], scope, filter, &cookie,
+                                 &msgid);
+                if (st != LDAP_SUCCESS) {
+                    st = set_ldap_error(context, st, OP_SEARCH);
+                    goto cleanup;
                 }
-                ldap_value_free(values);
+                pending = TRUE;
             }
-        } /* end of for (ent= ... */
-        ldap_msgfree(result);
-        result = NULL;
+            ber_memfree(cookie.bv_val);
+            cookie.bv_val = NULL;
+
+            for (ent = ldap_first_entry(ld, result); ent != NULL;
+                 ent = ldap_next_entry(ld, ent)) {
+                st = iterate_entry(context, ldap_context, ld, ent, func,
+                                   func_arg);
+                if (st)
+                    goto cleanup;
+            }
+            ldap_msgfree(result);
+            result = NULL;
+            if (!pending)
+                break;
+        }
     } /* end of for (tree= ... */
 
 cleanup:
+    if (pending)
+        (void)ldap_abandon_ext(ld, msgid, NULL, NULL);
+    ber_memfree(cookie.bv_val);
     if (filter)
         free (filter);
 
@@ -232,7 +401,6 @@ cleanup:
     return st;
 }
 
-
 /*
  * delete a principal from the directory.
  */
@@ -339,6 +507,8 @@ krb5_ldap_delete_principal(krb5_context context,
     }
 
 cleanup:
+    krb5_ldap_princ_cache_remove(context, ldap_context, searchfor);
+
     if (user)
         free (user);
 
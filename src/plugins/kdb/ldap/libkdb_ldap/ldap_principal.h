@@ -60,6 +60,10 @@
 /* #define FILTER   "(&(objectclass=krbprincipalaux)(krbprincipalname=" */
 #define FILTER   "(&(|(objectclass=krbprincipalaux)(objectclass=krbprincipal))(krbprincipalname="
 
+/* Number of entries requested per page when iterating over principals.  This
+ * is kept within common server size limits. */
+#define ITERATE_PAGE_SIZE 500
+
 #define  KDB_USER_PRINCIPAL    0x01
 #define  KDB_SERVICE_PRINCIPAL 0x02
 #define KDB_STANDALONE_PRINCIPAL_OBJECT 0x01
@@ -138,6 +142,9 @@ krb5_decode_krbsecretkey(krb5_context, krb5_db_entry *, struct berval **,
 krb5_error_code
 berval2tl_data(struct berval *in, krb5_tl_data **out);
 
+char *
+getstringtime(krb5_timestamp);
+
 krb5_error_code
 krb5_read_tkt_policy(krb5_context, krb5_ldap_context *, krb5_db_entry *,
                      char *);
@@ -66,17 +66,16 @@
 #include "ldap_principal.h"
 #include "princ_xdr.h"
 #include "ldap_tkt_policy.h"
+#include "ldap_princ_cache.h"
 #include "ldap_pwd_policy.h"
 #include "ldap_err.h"
 #include <kadm5/admin.h>
 #include <time.h>
 
 extern char* principal_attributes[];
+extern char* kdc_principal_attributes[];
 extern char* max_pwd_life_attr[];
 
-static char *
-getstringtime(krb5_timestamp);
-
 krb5_error_code
 berval2tl_data(struct berval *in, krb5_tl_data **out)
 {
@@ -110,6 +109,7 @@ krb5_ldap_get_principal(krb5_context context, krb5_const_principal searchfor,
     unsigned int                tree=0, ntrees=1, princlen=0;
     krb5_error_code             tempst=0, st=0;
     char                        **values=NULL, **subtree=NULL, *cname=NULL;
+    char                        **attrs;
     LDAP                        *ld=NULL;
     LDAPMessage                 *result=NULL, *ent=NULL;
     krb5_ldap_context           *ldap_context=NULL;
@@ -144,6 +144,10 @@ krb5_ldap_get_principal(krb5_context context, krb5_const_principal searchfor,
     if ((st=krb5_ldap_unparse_principal_name(user)) != 0)
         goto cleanup;
 
+    if (krb5_ldap_princ_cache_get(context, ldap_context, user, flags,
+                                  entry_ptr))
+        goto cleanup;
+
     filtuser = ldap_filter_correct(user);
     if (filtuser == NULL) {
         st = ENOMEM;
@@ -160,10 +164,16 @@ krb5_ldap_get_principal(krb5_context context, krb5_const_principal searchfor,
     if ((st = krb5_get_subtree_info(ldap_context, &subtree, &ntrees)) != 0)
         goto cleanup;
 
+    /* The KDC never modifies the attributes it does not fetch. */
+    if (ldap_context->srv_type == KRB5_KDB_SRV_TYPE_KDC)
+        attrs = kdc_principal_attributes;
+    else
+        attrs = principal_attributes;
+
     GET_HANDLE();
     for (tree=0; tree < ntrees && !found; ++tree) {
 
-        LDAP_SEARCH(subtree[tree], ldap_context->lrparams->search_scope, filter, principal_attributes);
+        LDAP_SEARCH(subtree[tree], ldap_context->lrparams->search_scope, filter, attrs);
         for (ent=ldap_first_entry(ld, result); ent != NULL && !found; ent=ldap_next_entry(ld, ent)) {
 
             /* get the associated directory user information */
@@ -211,6 +221,13 @@ krb5_ldap_get_principal(krb5_context context, krb5_const_principal searchfor,
                                              cprinc ? cprinc : searchfor,
                                              entry)) != 0)
                 goto cleanup;
+
+            if (ldap_context->princ_cache != NULL) {
+                values = ldap_get_values(ld, ent, "entryUUID");
+                krb5_ldap_princ_cache_put(context, ldap_context, user, flags,
+                                          values ? values[0] : NULL, entry);
+                ldap_value_free(values);
+            }
         }
         ldap_msgfree(result);
         result = NULL;
@@ -1444,6 +1461,9 @@ krb5_ldap_put_principal(krb5_context context, krb5_db_entry *entry,
     }
 
 cleanup:
+    /* Whether or not the update succeeded, cached copies may be stale. */
+    krb5_ldap_princ_cache_remove(context, ldap_context, entry->princ);
+
     if (user)
         free(user);
 
@@ -1494,7 +1514,7 @@ krb5_read_tkt_policy(krb5_context context, krb5_ldap_context *ldap_context,
     krb5_error_code             st=0;
     int                         mask=0, omask=0;
     int                         tkt_mask=(KDB_MAX_LIFE_ATTR | KDB_MAX_RLIFE_ATTR | KDB_TKT_FLAGS_ATTR);
-    krb5_ldap_policy_params     *tktpoldnparam=NULL;
+    krb5_ldap_tkt_policy_cache  tktpol;
 
     if ((st=krb5_get_attributes_mask(context, entries, &mask)) != 0)
         goto cleanup;
@@ -1503,36 +1523,34 @@ krb5_read_tkt_policy(krb5_context context, krb5_ldap_context *ldap_context,
         goto cleanup;
 
     if (policy != NULL) {
-        st = krb5_ldap_read_policy(context, policy, &tktpoldnparam, &omask);
-        if (st && st != KRB5_KDB_NOENTRY) {
+        st = krb5_ldap_read_cached_policy(context, policy, &tktpol);
+        if (st) {
             k5_prependmsg(context, st, _("Error reading ticket policy"));
             goto cleanup;
         }
-
-        st = 0; /* reset the return status */
+        omask = tktpol.mask;
     }
 
     if ((mask & KDB_MAX_LIFE_ATTR) == 0) {
         if ((omask & KDB_MAX_LIFE_ATTR) ==  KDB_MAX_LIFE_ATTR)
-            entries->max_life = tktpoldnparam->maxtktlife;
+            entries->max_life = tktpol.maxtktlife;
         else if (ldap_context->lrparams->max_life)
             entries->max_life = ldap_context->lrparams->max_life;
     }
 
     if ((mask & KDB_MAX_RLIFE_ATTR) == 0) {
         if ((omask & KDB_MAX_RLIFE_ATTR) == KDB_MAX_RLIFE_ATTR)
-            entries->max_renewable_life = tktpoldnparam->maxrenewlife;
+            entries->max_renewable_life = tktpol.maxrenewlife;
         else if (ldap_context->lrparams->max_renewable_life)
             entries->max_renewable_life = ldap_context->lrparams->max_renewable_life;
     }
 
     if ((mask & KDB_TKT_FLAGS_ATTR) == 0) {
         if ((omask & KDB_TKT_FLAGS_ATTR) == KDB_TKT_FLAGS_ATTR)
-            entries->attributes = tktpoldnparam->tktflags;
+            entries->attributes = tktpol.tktflags;
         else if (ldap_context->lrparams->tktflags)
             entries->attributes |= ldap_context->lrparams->tktflags;
     }
-    krb5_ldap_free_policy(context, tktpoldnparam);
 
 cleanup:
     return st;
@@ -1728,7 +1746,7 @@ cleanup:
     return err;
 }
 
-static char *
+char *
 getstringtime(krb5_timestamp epochtime)
 {
     struct tm           tme;
@@ -97,6 +97,7 @@ krb5_ldap_create_policy(krb5_context context, krb5_ldap_policy_params *policy,
         st = set_ldap_error (context, st, OP_ADD);
         goto cleanup;
     }
+    krb5_ldap_uncache_policy(ldap_context, policy->policy);
 
 cleanup:
     if (policy_dn != NULL)
@@ -172,6 +173,7 @@ krb5_ldap_modify_policy(krb5_context context, krb5_ldap_policy_params *policy,
         st = set_ldap_error (context, st, OP_MOD);
         goto cleanup;
     }
+    krb5_ldap_uncache_policy(ldap_context, policy->policy);
 
 cleanup:
     if (policy_dn != NULL)
@@ -321,6 +323,7 @@ krb5_ldap_delete_policy(krb5_context context, char *policyname)
 
             goto cleanup;
         }
+        krb5_ldap_uncache_policy(ldap_context, policyname);
     } else {
         st = EINVAL;
         k5_prependmsg(context, st,
@@ -408,6 +411,118 @@ krb5_ldap_free_policy(krb5_context context, krb5_ldap_policy_params *policy)
     return st;
 }
 
+/* Remove entries for policyname (or all entries if policyname is NULL) and
+ * expired entries from the ticket policy cache list.  The cache lock must be
+ * held. */
+static void
+prune_tkt_policy_cache(krb5_ldap_tkt_policy_cache **list,
+                       const char *policyname, time_t now)
+{
+    krb5_ldap_tkt_policy_cache *ent;
+
+    while (*list != NULL) {
+        ent = *list;
+        if (policyname == NULL || strcmp(ent->policy, policyname) == 0 ||
+            ent->expires <= now) {
+            *list = ent->next;
+            free(ent->policy);
+            free(ent);
+        } else {
+            list = &ent->next;
+        }
+    }
+}
+
+/*
+ * Read the ticket policy values for policyname into *out, using a cached copy
+ * if one was read within the last ldap_ticket_policy_cache_ttl seconds.  A
+ * policy which does not exist is returned (and cached) with no values set,
+ * since principals may still refer to deleted policies.  out->policy and
+ * out->next are not set.
+ */
+krb5_error_code
+krb5_ldap_read_cached_policy(krb5_context context, char *policyname,
+                             krb5_ldap_tkt_policy_cache *out)
+{
+    krb5_error_code             st=0;
+    int                         omask=0;
+    time_t                      now=time(NULL);
+    krb5_ldap_policy_params     *lpolicy=NULL;
+    krb5_ldap_tkt_policy_cache  *ent=NULL;
+    kdb5_dal_handle             *dal_handle=NULL;
+    krb5_ldap_context           *ldap_context=NULL;
+
+    memset(out, 0, sizeof(*out));
+
+    SETUP_CONTEXT();
+
+    k5_mutex_lock(&ldap_context->tkt_policy_cache_lock);
+    for (ent = ldap_context->tkt_policy_cache; ent != NULL; ent = ent->next) {
+        if (ent->expires > now && strcmp(ent->policy, policyname) == 0) {
+            *out = *ent;
+            out->policy = NULL;
+            out->next = NULL;
+            break;
+        }
+    }
+    k5_mutex_unlock(&ldap_context->tkt_policy_cache_lock);
+    if (ent != NULL)
+        return 0;
+
+    st = krb5_ldap_read_policy(context, policyname, &lpolicy, &omask);
+    if (st && st != KRB5_KDB_NOENTRY)
+        return st;
+    st = 0;
+    if (lpolicy != NULL) {
+        out->mask = omask;
+        out->maxtktlife = lpolicy->maxtktlife;
+        out->maxrenewlife = lpolicy->maxrenewlife;
+        out->tktflags = lpolicy->tktflags;
+        krb5_ldap_free_policy(context, lpolicy);
+    }
+    out->expires = now + ldap_context->tkt_policy_cache_ttl;
+
+    if (ldap_context->tkt_policy_cache_ttl == 0)
+        return 0;
+
+    /* Failing to cache the values is not an error. */
+    ent = malloc(sizeof(*ent));
+    if (ent == NULL)
+        return 0;
+    *ent = *out;
+    ent->policy = strdup(policyname);
+    if (ent->policy == NULL) {
+        free(ent);
+        return 0;
+    }
+
+    k5_mutex_lock(&ldap_context->tkt_policy_cache_lock);
+    prune_tkt_policy_cache(&ldap_context->tkt_policy_cache, policyname, now);
+    ent->next = ldap_context->tkt_policy_cache;
+    ldap_context->tkt_policy_cache = ent;
+    k5_mutex_unlock(&ldap_context->tkt_policy_cache_lock);
+    return 0;
+}
+
+/* Discard any cached values for policyname after it is modified or
+ * deleted. */
+void
+krb5_ldap_uncache_policy(krb5_ldap_context *ldap_context,
+                         const char *policyname)
+{
+    k5_mutex_lock(&ldap_context->tkt_policy_cache_lock);
+    prune_tkt_policy_cache(&ldap_context->tkt_policy_cache, policyname,
+                           time(NULL));
+    k5_mutex_unlock(&ldap_context->tkt_policy_cache_lock);
+}
+
+/* Free the ticket policy cache when the context is closed. */
+void
+krb5_ldap_free_tkt_policy_cache(krb5_ldap_context *ldap_context)
+{
+    prune_tkt_policy_cache(&ldap_context->tkt_policy_cache, NULL, 0);
+}
+
 /*
  * This function is general object listing routine.  It is currently
  * used for ticket policy object listing.
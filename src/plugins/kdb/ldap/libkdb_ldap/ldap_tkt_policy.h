@@ -48,6 +48,18 @@ typedef struct _krb5_ldap_policy_params {
     krb5_tl_data          *tl_data;
 }krb5_ldap_policy_params;
 
+/* ticket policy cache entry, used when reading principals */
+
+struct _krb5_ldap_tkt_policy_cache {
+    char                  *policy;
+    int                   mask;
+    long                  maxtktlife;
+    long                  maxrenewlife;
+    long                  tktflags;
+    time_t                expires;
+    struct _krb5_ldap_tkt_policy_cache *next;
+};
+
 krb5_error_code
 krb5_ldap_create_policy(krb5_context, krb5_ldap_policy_params *, int);
 
@@ -72,4 +84,13 @@ krb5_ldap_free_policy(krb5_context, krb5_ldap_policy_params *);
 krb5_error_code
 krb5_ldap_change_count(krb5_context, char *, int);
 
+krb5_error_code
+krb5_ldap_read_cached_policy(krb5_context, char *, krb5_ldap_tkt_policy_cache *);
+
+void
+krb5_ldap_uncache_policy(krb5_ldap_context *, const char *);
+
+void
+krb5_ldap_free_tkt_policy_cache(krb5_ldap_context *);
+
 #endif
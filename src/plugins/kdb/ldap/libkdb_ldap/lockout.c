@@ -33,6 +33,76 @@
 #include "ldap_principal.h"
 #include "ldap_pwd_policy.h"
 #include "ldap_tkt_policy.h"
+#include "ldap_misc.h"
+#include "ldap_princ_cache.h"
+#include "k5-queue.h"
+#include <syslog.h>
+
+/*
+ * In the KDC, lockout and last-success updates are not written to the
+ * directory as they are made.  Updates to each entry are merged into a
+ * pending record keyed by DN, and pending records are sent as asynchronous
+ * modify operations on a dedicated connection once the oldest has waited
+ * LOCKOUT_FLUSH_INTERVAL seconds or LOCKOUT_BATCH_SIZE are pending.  Entries
+ * read from the directory are overlaid with the values in their pending
+ * record (if any) before lockout decisions are made, so that this KDC's
+ * decisions do not depend on when the updates reach the directory.  Other
+ * KDCs see the updates once they are written.  A modify which fails is
+ * retried up to LOCKOUT_MAX_RETRIES times before its changes are dropped and
+ * logged.
+ */
+
+#define LOCKOUT_FLUSH_INTERVAL 1
+#define LOCKOUT_BATCH_SIZE 64
+#define LOCKOUT_NBUCKETS 256
+
+/* How long to wait for outstanding updates when closing the database. */
+#define LOCKOUT_CLOSE_TIMEOUT 5
+
+#define LOCKOUT_MAX_RETRIES 3
+
+#define COUNT_MASK (KADM5_FAIL_AUTH_COUNT | KADM5_FAIL_AUTH_COUNT_INCREMENT)
+
+#define TRACE_LDAP_LOCKOUT_UPDATE_ERR(c, dn, msg)                       \
+    TRACE(c, "LDAP lockout update for {str} failed: {str}", dn, msg)
+#define TRACE_LDAP_LOCKOUT_CONN_ERR(c, ret)                             \
+    TRACE(c, "Cannot connect to LDAP server for lockout updates: {kerr}", \
+          ret)
+#define TRACE_LDAP_LOCKOUT_STATS(c, q)                                  \
+    TRACE(c, "LDAP lockout updates: {long} merged, {long} written",     \
+          (long)(q)->merged, (long)(q)->written)
+
+struct lockout_update {
+    LIST_ENTRY(lockout_update) hash_links;
+    TAILQ_ENTRY(lockout_update) pending_links;
+    TAILQ_ENTRY(lockout_update) inflight_links;
+    char *dn;
+    krb5_principal princ;       /* for discarding cached copies */
+    int known;                  /* fields whose current values we hold */
+    int unsent;                 /* changes not yet sent */
+    int sent;                   /* changes in the outstanding operation */
+    krb5_kvno fail_auth_count;
+    krb5_kvno stored_count;     /* value increments are applied to */
+    krb5_boolean has_fail_count;
+    unsigned int increments;
+    krb5_timestamp last_failed;
+    krb5_timestamp last_success;
+    time_t queued;
+    int msgid;                  /* outstanding modify operation, or -1 */
+    unsigned int failures;      /* consecutive failed modify operations */
+};
+
+LIST_HEAD(update_list, lockout_update);
+TAILQ_HEAD(update_queue, lockout_update);
+
+struct _krb5_ldap_lockout_queue {
+    struct update_list buckets[LOCKOUT_NBUCKETS];
+    struct update_queue pending;    /* records with unsent changes */
+    struct update_queue inflight;   /* records with an outstanding modify */
+    unsigned int npending;
+    krb5_ldap_server_handle *conn;
+    unsigned long merged, written;
+};
 
 static krb5_error_code
 lookup_lockout_policy(krb5_context context,
@@ -105,6 +175,456 @@ locked_check_p(krb5_context context,
     return (stamp < entry->last_failed + lockout_duration);
 }
 
+static unsigned int
+hash_dn(const char *dn)
+{
+    krb5_ui_4 h = 2166136261U;
+
+    for (; *dn != '\0'; dn++)
+        h = (h ^ (unsigned char)*dn) * 16777619U;
+    return h % LOCKOUT_NBUCKETS;
+}
+
+/* Return the lockout update queue for ldap_context, creating it if necessary.
+ * Return NULL if updates should be written synchronously. */
+static krb5_ldap_lockout_queue *
+get_queue(krb5_ldap_context *ldap_context)
+{
+    krb5_ldap_lockout_queue *q = ldap_context->lockout_queue;
+    unsigned int i;
+
+    /* Only the KDC, which is single-threaded, defers updates. */
+    if (ldap_context->srv_type != KRB5_KDB_SRV_TYPE_KDC)
+        return NULL;
+    if (q != NULL)
+        return q;
+
+    q = calloc(1, sizeof(*q));
+    if (q == NULL)
+        return NULL;
+    for (i = 0; i < LOCKOUT_NBUCKETS; i++)
+        LIST_INIT(&q->buckets[i]);
+    TAILQ_INIT(&q->pending);
+    TAILQ_INIT(&q->inflight);
+    ldap_context->lockout_queue = q;
+    return q;
+}
+
+static struct lockout_update *
+find_update(krb5_ldap_lockout_queue *q, const char *dn)
+{
+    struct lockout_update *u;
+
+    LIST_FOREACH(u, &q->buckets[hash_dn(dn)], hash_links) {
+        if (strcmp(u->dn, dn) == 0)
+            return u;
+    }
+    return NULL;
+}
+
+static void
+free_update(krb5_context context, struct lockout_update *u)
+{
+    krb5_free_principal(context, u->princ);
+    free(u->dn);
+    free(u);
+}
+
+/* Free u if it has no unsent changes and no outstanding operation. */
+static void
+release_update(krb5_context context, krb5_ldap_lockout_queue *q,
+               struct lockout_update *u)
+{
+    if (u->unsent != 0 || u->msgid != -1)
+        return;
+    LIST_REMOVE(u, hash_links);
+    free_update(context, u);
+}
+
+/* Replace the lockout fields of entry with any newer values held in q. */
+static void
+overlay_entry(krb5_context context, krb5_ldap_lockout_queue *q,
+              krb5_db_entry *entry)
+{
+    struct lockout_update *u;
+    char *dn;
+
+    if (krb5_get_userdn(context, entry, &dn) != 0 || dn == NULL)
+        return;
+    u = find_update(q, dn);
+    free(dn);
+    if (u == NULL)
+        return;
+
+    if (u->known & COUNT_MASK)
+        entry->fail_auth_count = u->fail_auth_count;
+    if (u->known & KADM5_LAST_FAILED)
+        entry->last_failed = u->last_failed;
+    if (u->known & KADM5_LAST_SUCCESS)
+        entry->last_success = u->last_success;
+}
+
+/* Merge the changes described by entry->mask into q. */
+static krb5_error_code
+merge_update(krb5_context context, krb5_ldap_lockout_queue *q,
+             krb5_db_entry *entry)
+{
+    krb5_error_code ret;
+    struct lockout_update *u;
+    char *dn;
+    int attr_mask = 0;
+
+    ret = krb5_get_userdn(context, entry, &dn);
+    if (ret)
+        return ret;
+    if (dn == NULL)
+        return EINVAL;
+
+    u = find_update(q, dn);
+    if (u == NULL) {
+        ret = krb5_get_attributes_mask(context, entry, &attr_mask);
+        if (ret)
+            goto cleanup;
+        u = k5alloc(sizeof(*u), &ret);
+        if (u == NULL)
+            goto cleanup;
+        ret = krb5_copy_principal(context, entry->princ, &u->princ);
+        if (ret) {
+            free(u);
+            goto cleanup;
+        }
+        u->dn = dn;
+        dn = NULL;
+        u->msgid = -1;
+        u->has_fail_count = (attr_mask & KDB_FAIL_AUTH_COUNT_ATTR) != 0;
+        u->stored_count = entry->fail_auth_count;
+        LIST_INSERT_HEAD(&q->buckets[hash_dn(u->dn)], u, hash_links);
+    }
+
+    if (u->unsent == 0) {
+        TAILQ_INSERT_TAIL(&q->pending, u, pending_links);
+        q->npending++;
+        u->queued = time(NULL);
+    }
+
+    /* entry reflects any values we already hold, so an increment applies to
+     * entry->fail_auth_count as (possibly) reset by the caller. */
+    if (entry->mask & KADM5_FAIL_AUTH_COUNT) {
+        u->unsent = (u->unsent & ~KADM5_FAIL_AUTH_COUNT_INCREMENT) |
+            KADM5_FAIL_AUTH_COUNT;
+        u->increments = 0;
+    }
+    if (entry->mask & KADM5_FAIL_AUTH_COUNT_INCREMENT) {
+        if (!(u->unsent & KADM5_FAIL_AUTH_COUNT)) {
+            u->unsent |= KADM5_FAIL_AUTH_COUNT_INCREMENT;
+            u->increments++;
+        }
+        u->fail_auth_count = entry->fail_auth_count + 1;
+    } else if (entry->mask & KADM5_FAIL_AUTH_COUNT) {
+        u->fail_auth_count = entry->fail_auth_count;
+    }
+    if (entry->mask & KADM5_LAST_FAILED) {
+        u->last_failed = entry->last_failed;
+        u->unsent |= KADM5_LAST_FAILED;
+    }
+    if (entry->mask & KADM5_LAST_SUCCESS) {
+        u->last_success = entry->last_success;
+        u->unsent |= KADM5_LAST_SUCCESS;
+    }
+    u->known |= entry->mask;
+    q->merged++;
+
+cleanup:
+    free(dn);
+    return ret;
+}
+
+/* Add a modification of attr to *mods setting it to the generalized time
+ * representation of stamp. */
+static krb5_error_code
+add_time_mod(LDAPMod ***mods, char *attr, krb5_timestamp stamp)
+{
+    krb5_error_code ret;
+    char *strval[2] = { NULL, NULL };
+
+    strval[0] = getstringtime(stamp);
+    if (strval[0] == NULL)
+        return ENOMEM;
+    ret = krb5_add_str_mem_ldap_mod(mods, attr, LDAP_MOD_REPLACE, strval);
+    free(strval[0]);
+    return ret;
+}
+
+/* Construct the modifications for the unsent changes in u. */
+static krb5_error_code
+make_mods(struct lockout_update *u, krb5_ldap_server_handle *conn,
+          LDAPMod ***mods_out)
+{
+    krb5_error_code ret = 0;
+    LDAPMod **mods = NULL;
+    char *attr = "krbLoginFailedCount";
+
+    *mods_out = NULL;
+
+    if (u->unsent & KADM5_LAST_SUCCESS) {
+        ret = add_time_mod(&mods, "krbLastSuccessfulAuth", u->last_success);
+        if (ret)
+            goto cleanup;
+    }
+    if (u->unsent & KADM5_LAST_FAILED) {
+        ret = add_time_mod(&mods, "krbLastFailedAuth", u->last_failed);
+        if (ret)
+            goto cleanup;
+    }
+
+    if (u->unsent & KADM5_FAIL_AUTH_COUNT) {
+        ret = krb5_add_int_mem_ldap_mod(&mods, attr, LDAP_MOD_REPLACE,
+                                        u->fail_auth_count);
+    } else if (u->unsent & KADM5_FAIL_AUTH_COUNT_INCREMENT) {
+        /* As in krb5_ldap_put_principal(), use an RFC 4525 increment if we
+         * can, or else assert the old value by deleting it before adding the
+         * new one. */
+#ifdef LDAP_MOD_INCREMENT
+        if (conn->server_info->modify_increment && u->has_fail_count) {
+            ret = krb5_add_int_mem_ldap_mod(&mods, attr, LDAP_MOD_INCREMENT,
+                                            u->increments);
+            goto cleanup;
+        }
+#endif
+        if (u->has_fail_count) {
+            ret = krb5_add_int_mem_ldap_mod(&mods, attr, LDAP_MOD_DELETE,
+                                            u->stored_count);
+            if (ret)
+                goto cleanup;
+        }
+        ret = krb5_add_int_mem_ldap_mod(&mods, attr, LDAP_MOD_ADD,
+                                        u->stored_count + u->increments);
+    }
+
+cleanup:
+    if (ret)
+        ldap_mods_free(mods, 1);
+    else
+        *mods_out = mods;
+    return ret;
+}
+
+/* Return the changes in u's outstanding operation to its unsent changes,
+ * after the connection carrying it is lost.  The operation may or may not
+ * have been applied, so write the failure count as an absolute value. */
+static void
+requeue_update(krb5_ldap_lockout_queue *q, struct lockout_update *u)
+{
+    TAILQ_REMOVE(&q->inflight, u, inflight_links);
+    if (u->unsent == 0) {
+        TAILQ_INSERT_TAIL(&q->pending, u, pending_links);
+        q->npending++;
+        u->queued = time(NULL);
+    }
+    if ((u->sent | u->unsent) & COUNT_MASK) {
+        u->unsent = (u->unsent & ~COUNT_MASK) | KADM5_FAIL_AUTH_COUNT;
+        u->increments = 0;
+    }
+    u->unsent |= u->sent & ~COUNT_MASK;
+    u->sent = 0;
+    u->msgid = -1;
+}
+
+/* Close the update connection, requeueing any outstanding operations. */
+static void
+close_conn(krb5_ldap_lockout_queue *q)
+{
+    struct lockout_update *u;
+
+    while ((u = TAILQ_FIRST(&q->inflight)) != NULL)
+        requeue_update(q, u);
+    if (q->conn != NULL) {
+        ldap_unbind_ext_s(q->conn->ldap_handle, NULL, NULL);
+        free(q->conn);
+        q->conn = NULL;
+    }
+}
+
+/* Process the failure of u's outstanding operation with LDAP error st.  Retry
+ * the changes unless the entry is gone or they have failed too many times,
+ * in which case drop them and log an error. */
+static void
+update_failed(krb5_context context, krb5_ldap_lockout_queue *q,
+              struct lockout_update *u, int st)
+{
+    TRACE_LDAP_LOCKOUT_UPDATE_ERR(context, u->dn, ldap_err2string(st));
+    if (st != LDAP_NO_SUCH_OBJECT && ++u->failures < LOCKOUT_MAX_RETRIES) {
+        requeue_update(q, u);
+        return;
+    }
+    syslog(LOG_ERR, _("Dropping lockout update for %s: %s"), u->dn,
+           ldap_err2string(st));
+    TAILQ_REMOVE(&q->inflight, u, inflight_links);
+    u->msgid = -1;
+    u->sent = 0;
+    u->failures = 0;
+}
+
+/* Process the results of outstanding operations, waiting up to tv for each
+ * one.  Cached copies of each entry written are discarded, since they do not
+ * reflect the update. */
+static void
+collect_results(krb5_context context, krb5_ldap_context *ldap_context,
+                krb5_ldap_lockout_queue *q, struct timeval *tv)
+{
+    struct lockout_update *u;
+    LDAPMessage *msg;
+    int st, msgid;
+
+    while (q->conn != NULL && !TAILQ_EMPTY(&q->inflight)) {
+        st = ldap_result(q->conn->ldap_handle, LDAP_RES_ANY, LDAP_MSG_ALL,
+                         tv, &msg);
+        if (st == 0)
+            return;
+        if (st == -1) {
+            close_conn(q);
+            return;
+        }
+
+        msgid = ldap_msgid(msg);
+        TAILQ_FOREACH(u, &q->inflight, inflight_links) {
+            if (u->msgid == msgid)
+                break;
+        }
+        st = ldap_result2error(q->conn->ldap_handle, msg, 1);
+        if (u == NULL)
+            continue;
+        if (st != LDAP_SUCCESS) {
+            update_failed(context, q, u, st);
+        } else {
+            TAILQ_REMOVE(&q->inflight, u, inflight_links);
+            u->msgid = -1;
+            u->sent = 0;
+            u->failures = 0;
+            q->written++;
+            krb5_ldap_princ_cache_remove(context, ldap_context, u->princ);
+        }
+        release_update(context, q, u);
+    }
+}
+
+/* Open the connection used for lockout updates. */
+static krb5_error_code
+open_conn(krb5_ldap_context *ldap_context, krb5_ldap_lockout_queue *q)
+{
+    krb5_ldap_server_info *info;
+    unsigned int i;
+
+    for (i = 0; ldap_context->server_info_list[i] != NULL; i++) {
+        info = ldap_context->server_info_list[i];
+        if (info->server_status != OFF)
+            return krb5_ldap_open_handle(ldap_context, info, &q->conn);
+    }
+    return KRB5_KDB_ACCESS_ERROR;
+}
+
+/* Send the unsent changes of each pending record which has no outstanding
+ * operation. */
+static void
+send_updates(krb5_context context, krb5_ldap_context *ldap_context,
+             krb5_ldap_lockout_queue *q)
+{
+    struct lockout_update *u, *next;
+    LDAPMod **mods;
+    krb5_error_code ret;
+    int st, msgid;
+
+    if (q->conn == NULL) {
+        ret = open_conn(ldap_context, q);
+        if (ret) {
+            /* Keep the records; we will try again on the next flush. */
+            TRACE_LDAP_LOCKOUT_CONN_ERR(context, ret);
+            krb5_clear_error_message(context);
+            return;
+        }
+    }
+
+    TAILQ_FOREACH_SAFE(u, &q->pending, pending_links, next) {
+        if (u->msgid != -1)
+            continue;
+        if (make_mods(u, q->conn, &mods) != 0)
+            continue;
+        st = ldap_modify_ext(q->conn->ldap_handle, u->dn, mods, NULL, NULL,
+                             &msgid);
+        ldap_mods_free(mods, 1);
+        if (st != LDAP_SUCCESS) {
+            TRACE_LDAP_LOCKOUT_UPDATE_ERR(context, u->dn, ldap_err2string(st));
+            close_conn(q);
+            return;
+        }
+
+        TAILQ_REMOVE(&q->pending, u, pending_links);
+        q->npending--;
+        TAILQ_INSERT_TAIL(&q->inflight, u, inflight_links);
+        u->msgid = msgid;
+        u->sent = u->unsent;
+        u->unsent = 0;
+        if (u->sent & COUNT_MASK) {
+            u->stored_count = u->fail_auth_count;
+            u->has_fail_count = TRUE;
+        }
+        u->increments = 0;
+    }
+}
+
+/* Process completed updates, and send pending updates if the batch is full or
+ * the oldest has waited long enough. */
+static void
+flush_queue(krb5_context context, krb5_ldap_context *ldap_context,
+            krb5_ldap_lockout_queue *q)
+{
+    struct timeval ztime = { 0, 0 };
+    struct lockout_update *u;
+
+    collect_results(context, ldap_context, q, &ztime);
+    u = TAILQ_FIRST(&q->pending);
+    if (u == NULL)
+        return;
+    if (q->npending >= LOCKOUT_BATCH_SIZE ||
+        time(NULL) - u->queued >= LOCKOUT_FLUSH_INTERVAL)
+        send_updates(context, ldap_context, q);
+}
+
+/* Write any pending lockout updates and free the queue. */
+void
+krb5_ldap_free_lockout_queue(krb5_ldap_context *ldap_context)
+{
+    krb5_ldap_lockout_queue *q = ldap_context->lockout_queue;
+    krb5_context context = ldap_context->kcontext;
+    struct timeval tv = { LOCKOUT_CLOSE_TIMEOUT, 0 };
+    struct lockout_update *u, *next;
+    unsigned int i;
+
+    if (q == NULL)
+        return;
+
+    /* Records with an outstanding operation must wait for its result before
+     * their remaining changes can be sent. */
+    collect_results(context, ldap_context, q, &tv);
+    if (!TAILQ_EMPTY(&q->pending))
+        send_updates(context, ldap_context, q);
+    collect_results(context, ldap_context, q, &tv);
+    TRACE_LDAP_LOCKOUT_STATS(context, q);
+
+    close_conn(q);
+    for (i = 0; i < LOCKOUT_NBUCKETS; i++) {
+        LIST_FOREACH_SAFE(u, &q->buckets[i], hash_links, next) {
+            if (u->unsent != 0) {
+                syslog(LOG_ERR, _("Lockout update for %s not written before "
+                                  "close"), u->dn);
+            }
+            free_update(context, u);
+        }
+    }
+    free(q);
+    ldap_context->lockout_queue = NULL;
+}
+
 krb5_error_code
 krb5_ldap_lockout_check_policy(krb5_context context,
                                krb5_db_entry *entry,
@@ -113,6 +633,7 @@ krb5_ldap_lockout_check_policy(krb5_context context,
     krb5_error_code code;
     kdb5_dal_handle *dal_handle;
     krb5_ldap_context *ldap_context;
+    krb5_ldap_lockout_queue *q;
     krb5_kvno max_fail = 0;
     krb5_deltat failcnt_interval = 0;
     krb5_deltat lockout_duration = 0;
@@ -121,6 +642,12 @@ krb5_ldap_lockout_check_policy(krb5_context context,
     if (ldap_context->disable_lockout)
         return 0;
 
+    q = get_queue(ldap_context);
+    if (q != NULL) {
+        flush_queue(context, ldap_context, q);
+        overlay_entry(context, q, entry);
+    }
+
     code = lookup_lockout_policy(context, entry, &max_fail,
                                  &failcnt_interval,
                                  &lockout_duration);
@@ -142,6 +669,7 @@ krb5_ldap_lockout_audit(krb5_context context,
     krb5_error_code code;
     kdb5_dal_handle *dal_handle;
     krb5_ldap_context *ldap_context;
+    krb5_ldap_lockout_queue *q;
     krb5_kvno max_fail = 0;
     krb5_deltat failcnt_interval = 0;
     krb5_deltat lockout_duration = 0;
@@ -161,6 +689,10 @@ krb5_ldap_lockout_audit(krb5_context context,
     if (entry == NULL)
         return 0;
 
+    q = get_queue(ldap_context);
+    if (q != NULL)
+        overlay_entry(context, q, entry);
+
     if (!ldap_context->disable_lockout) {
         code = lookup_lockout_policy(context, entry, &max_fail,
                                      &failcnt_interval,
@@ -213,7 +745,14 @@ krb5_ldap_lockout_audit(krb5_context context,
         entry->mask |= KADM5_LAST_FAILED | KADM5_FAIL_AUTH_COUNT_INCREMENT;
     }
 
-    if (entry->mask) {
+    if (entry->mask && q != NULL) {
+        code = merge_update(context, q, entry);
+        if (code != 0)
+            return code;
+        /* Cached copies of the entry predate the update. */
+        krb5_ldap_princ_cache_remove(context, ldap_context, entry->princ);
+        flush_queue(context, ldap_context, q);
+    } else if (entry->mask) {
         code = krb5_ldap_put_principal(context, entry, NULL);
         if (code != 0)
             return code;
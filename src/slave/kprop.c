@@ -34,6 +34,7 @@
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <sys/param.h>
+#include <sys/wait.h>
 #include <netdb.h>
 #include <fcntl.h>
 
@@ -51,6 +52,8 @@ static char *progname = NULL;
 static int debug = 0;
 static char *srvtab = NULL;
 static char *slave_host;
+static char **slave_hosts;
+static int nslaves;
 static char *realm = NULL;
 static char *file = KPROP_DEFAULT_FILE;
 
@@ -82,18 +85,35 @@ static void update_last_prop_file(char *hostname, char *file_name);
 static void usage()
 {
     fprintf(stderr, _("\nUsage: %s [-r realm] [-f file] [-d] [-P port] "
-                      "[-s srvtab] slave_host\n\n"), progname);
+                      "[-s srvtab] slave_host ...\n\n"), progname);
     exit(1);
 }
 
+/* Propagate the open dump file to slave_host.  Exit on failure. */
+static void
+propagate(krb5_context context, int database_fd, int database_size)
+{
+    int fd;
+    krb5_creds *my_creds;
+    krb5_auth_context auth_context;
+
+    get_tickets(context);
+    open_connection(context, slave_host, &fd);
+    kerberos_authenticate(context, &auth_context, fd, my_principal, &my_creds);
+    xmit_database(context, auth_context, my_creds, fd, database_fd,
+                  database_size);
+    update_last_prop_file(slave_host, file);
+    printf(_("Database propagation to %s: SUCCEEDED\n"), slave_host);
+    krb5_free_cred_contents(context, my_creds);
+}
+
 int
 main(int argc, char **argv)
 {
-    int fd, database_fd, database_size;
+    int i, status, database_fd, database_size, nfailed = 0;
     krb5_error_code retval;
     krb5_context context;
-    krb5_creds *my_creds;
-    krb5_auth_context auth_context;
+    pid_t pid, wpid, *pids;
 
     setlocale(LC_ALL, "");
     retval = krb5_init_context(&context);
@@ -102,18 +122,55 @@ main(int argc, char **argv)
         exit(1);
     }
     parse_args(argc, argv);
-    get_tickets(context);
 
     database_fd = open_database(context, file, &database_size);
-    open_connection(context, slave_host, &fd);
-    kerberos_authenticate(context, &auth_context, fd, my_principal, &my_creds);
-    xmit_database(context, auth_context, my_creds, fd, database_fd,
-                  database_size);
-    update_last_prop_file(slave_host, file);
-    printf(_("Database propagation to %s: SUCCEEDED\n"), slave_host);
-    krb5_free_cred_contents(context, my_creds);
+
+    if (nslaves == 1) {
+        slave_host = slave_hosts[0];
+        propagate(context, database_fd, database_size);
+        close_database(context, database_fd);
+        exit(0);
+    }
+
+    /* Propagate to each slave concurrently in a child process.  The children
+     * share the locked dump file, reading it by offset. */
+    pids = calloc(nslaves, sizeof(*pids));
+    if (pids == NULL) {
+        com_err(progname, ENOMEM, _("while allocating process table"));
+        exit(1);
+    }
+    fflush(stdout);
+    for (i = 0; i < nslaves; i++) {
+        pid = fork();
+        if (pid == -1) {
+            com_err(progname, errno, _("while forking"));
+            nfailed++;
+            continue;
+        }
+        if (pid == 0) {
+            slave_host = slave_hosts[i];
+            propagate(context, database_fd, database_size);
+            exit(0);
+        }
+        pids[i] = pid;
+    }
+    for (i = 0; i < nslaves; i++) {
+        if (pids[i] == 0)
+            continue;
+        while ((wpid = waitpid(pids[i], &status, 0)) == -1 && errno == EINTR);
+        if (wpid == -1) {
+            com_err(progname, errno, _("while waiting for propagation to %s"),
+                    slave_hosts[i]);
+            nfailed++;
+        } else if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            fprintf(stderr, _("Database propagation to %s: FAILED\n"),
+                    slave_hosts[i]);
+            nfailed++;
+        }
+    }
+    free(pids);
     close_database(context, database_fd);
-    exit(0);
+    exit(nfailed ? 1 : 0);
 }
 
 static void
@@ -124,10 +181,13 @@ parse_args(int argc, char **argv)
     progname = *argv++;
     while (--argc && (word = *argv++) != NULL) {
         if (*word != '-') {
-            if (slave_host != NULL)
-                usage();
-            else
-                slave_host = word;
+            slave_hosts = realloc(slave_hosts,
+                                  (nslaves + 1) * sizeof(*slave_hosts));
+            if (slave_hosts == NULL) {
+                com_err(progname, ENOMEM, _("while parsing arguments"));
+                exit(1);
+            }
+            slave_hosts[nslaves++] = word;
             continue;
         }
         word++;
@@ -166,7 +226,7 @@ parse_args(int argc, char **argv)
 
         }
     }
-    if (slave_host == NULL)
+    if (nslaves == 0)
         usage();
 }
 
@@ -492,10 +552,11 @@ xmit_database(krb5_context context, krb5_auth_context auth_context,
         exit(1);
     }
 
-    /* Send over the file, block by block. */
+    /* Send over the file, block by block.  Read by offset, since the
+     * descriptor may be shared with other kprop processes. */
     inbuf.data = buf;
     sent_size = 0;
-    while ((n = read(database_fd, buf, sizeof(buf)))) {
+    while ((n = pread(database_fd, buf, sizeof(buf), sent_size)) > 0) {
         inbuf.length = n;
         retval = krb5_mk_priv(context, auth_context, &inbuf, &outbuf, NULL);
         if (retval) {
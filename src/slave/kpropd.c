@@ -122,6 +122,7 @@ static char *srvtab = NULL;
 static int standalone = 0;
 
 static pid_t fullprop_child = (pid_t)-1;
+static pid_t load_child = (pid_t)-1;
 
 static krb5_principal server;   /* This is our server principal name */
 static krb5_principal client;   /* This is who we're talking to */
@@ -152,9 +153,11 @@ static krb5_boolean authorized_principal(krb5_context context,
                                          krb5_principal p,
                                          krb5_enctype auth_etype);
 static void recv_database(krb5_context context, int fd, int database_fd,
-                          krb5_data *confmsg);
-static void load_database(krb5_context context, char *kdb_util,
-                          char *database_file_name);
+                          int load_fd, krb5_data *confmsg);
+static int start_load_database(krb5_context context, char *kdb_util,
+                               int *commit_fd_out);
+static void finish_load_database(krb5_context context, char *kdb_util,
+                                 int load_fd, int commit_fd);
 static void send_error(krb5_context context, int fd, krb5_error_code err_code,
                        char *err_text);
 static void recv_error(krb5_context context, krb5_data *inbuf);
@@ -229,6 +232,17 @@ atexit_kill_do_standalone(void)
         kill(fullprop_child, SIGHUP);
 }
 
+/*
+ * If we exit before the whole dump has been passed to kdb5_util, make sure it
+ * does not see end-of-file and promote a partially loaded database.
+ */
+static void
+atexit_kill_load(void)
+{
+    if (load_child > 0)
+        kill(load_child, SIGKILL);
+}
+
 int
 main(int argc, char **argv)
 {
@@ -462,7 +476,7 @@ doit(int fd)
     int lock_fd;
     mode_t omask;
     krb5_enctype etype;
-    int database_fd;
+    int database_fd, load_fd, commit_fd;
     char host[INET6_ADDRSTRLEN + 1];
 
     signal_wrapper(SIGALRM, alarm_handler);
@@ -536,7 +550,9 @@ doit(int fd)
                 temp_file_name);
         exit(1);
     }
-    recv_database(kpropd_context, fd, database_fd, &confmsg);
+    /* Start kdb5_util now so that it loads records as they arrive. */
+    load_fd = start_load_database(kpropd_context, kdb5_util, &commit_fd);
+    recv_database(kpropd_context, fd, database_fd, load_fd, &confmsg);
     if (rename(temp_file_name, file)) {
         com_err(progname, errno, _("while renaming %s to %s"),
                 temp_file_name, file);
@@ -548,7 +564,7 @@ doit(int fd)
                 temp_file_name);
         exit(1);
     }
-    load_database(kpropd_context, kdb5_util, file);
+    finish_load_database(kpropd_context, kdb5_util, load_fd, commit_fd);
     retval = krb5_lock_file(kpropd_context, lock_fd, KRB5_LOCKMODE_UNLOCK);
     if (retval) {
         com_err(progname, retval, _("while unlocking '%s'"), temp_file_name);
@@ -579,13 +595,37 @@ doit(int fd)
 /* Default timeout can be changed using clnt_control() */
 static struct timeval full_resync_timeout = { 25, 0 };
 
+/*
+ * Ask the master to send us its database.  If last is not NULL, first ask for
+ * a delta dump of the changes since last, which the master can make if its
+ * ulog has wrapped past last; set *delta_out to true if it agrees.  Otherwise
+ * ask for a full dump.
+ */
 static kdb_fullresync_result_t *
-full_resync(CLIENT *clnt)
+full_resync(CLIENT *clnt, kdb_last_t *last, krb5_boolean *delta_out)
 {
     static kdb_fullresync_result_t clnt_res;
     uint32_t vers = IPROPX_VERSION_1; /* max version we support */
     enum clnt_stat status;
 
+    *delta_out = FALSE;
+    if (last != NULL) {
+        memset(&clnt_res, 0, sizeof(clnt_res));
+        status = clnt_call(clnt, IPROP_DELTA_RESYNC, (xdrproc_t)xdr_kdb_last_t,
+                           (caddr_t)last,
+                           (xdrproc_t)xdr_kdb_fullresync_result_t,
+                           (caddr_t)&clnt_res, full_resync_timeout);
+        if (status == RPC_SUCCESS &&
+            clnt_res.ret != UPDATE_FULL_RESYNC_NEEDED) {
+            *delta_out = TRUE;
+            return &clnt_res;
+        }
+        /* Fall back to a full dump if the master doesn't support deltas or
+         * can't make one for us. */
+        if (status != RPC_SUCCESS && status != RPC_PROCUNAVAIL)
+            return NULL;
+    }
+
     memset(&clnt_res, 0, sizeof(clnt_res));
 
     status = clnt_call(clnt, IPROP_FULL_RESYNC_EXT, (xdrproc_t)xdr_u_int32,
@@ -619,6 +659,7 @@ do_iprop()
     struct timeval iprop_start, iprop_end;
     unsigned long usec;
     time_t frrequested = 0, now;
+    krb5_boolean delta_requested = FALSE, delta;
     kdb_incr_result_t *incr_ret;
     kdb_last_t mylast;
     kdb_fullresync_result_t *full_ret;
@@ -828,7 +869,11 @@ reinit:
                     fprintf(stderr, _("Full resync needed\n"));
                 syslog(LOG_INFO, _("kpropd: Full resync needed."));
 
-                full_ret = full_resync(handle->clnt);
+                /* If a delta we asked for last time never arrived, ask for a
+                 * full dump this time. */
+                full_ret = full_resync(handle->clnt,
+                                       delta_requested ? NULL : &mylast,
+                                       &delta);
                 if (full_ret == NULL) {
                     clnt_perror(handle->clnt,
                                 _("iprop_full_resync call failed"));
@@ -841,9 +886,16 @@ reinit:
 
             switch (full_ret->ret) {
             case UPDATE_OK:
-                if (debug)
-                    fprintf(stderr, _("Full resync request granted\n"));
-                syslog(LOG_INFO, _("Full resync request granted."));
+                delta_requested = delta;
+                if (delta) {
+                    if (debug)
+                        fprintf(stderr, _("Delta resync request granted\n"));
+                    syslog(LOG_INFO, _("Delta resync request granted."));
+                } else {
+                    if (debug)
+                        fprintf(stderr, _("Full resync request granted\n"));
+                    syslog(LOG_INFO, _("Full resync request granted."));
+                }
                 backoff_cnt = 0;
                 break;
 
@@ -884,6 +936,7 @@ reinit:
         case UPDATE_OK:
             backoff_cnt = 0;
             frrequested = 0;
+            delta_requested = FALSE;
 
             /*
              * ulog_replay() will convert the ulog updates to db
@@ -953,6 +1006,7 @@ reinit:
                 fprintf(stderr, _("KDC is synchronized with master.\n"));
             backoff_cnt = 0;
             frrequested = 0;
+            delta_requested = FALSE;
             break;
 
         default:
@@ -1360,8 +1414,12 @@ authorized_principal(krb5_context context, krb5_principal p,
     return FALSE;
 }
 
+/*
+ * Receive the database from the master, writing it to database_fd and passing
+ * it to the kdb5_util load process via load_fd.
+ */
 static void
-recv_database(krb5_context context, int fd, int database_fd,
+recv_database(krb5_context context, int fd, int database_fd, int load_fd,
               krb5_data *confmsg)
 {
     krb5_ui_4 database_size, received_size;
@@ -1431,7 +1489,6 @@ recv_database(krb5_context context, int fd, int database_fd,
         }
         n = write(database_fd, outbuf.data, outbuf.length);
         krb5_free_data_contents(context, &inbuf);
-        krb5_free_data_contents(context, &outbuf);
         if (n < 0) {
             snprintf(buf, sizeof(buf),
                      "while writing database block starting at offset %d",
@@ -1444,7 +1501,19 @@ recv_database(krb5_context context, int fd, int database_fd,
                      received_size, n, outbuf.length);
             send_error(context, fd, KRB5KRB_ERR_GENERIC, buf);
         }
+        if (krb5_net_write(context, load_fd, outbuf.data,
+                           outbuf.length) < 0) {
+            retval = errno;
+            snprintf(buf, sizeof(buf),
+                     "while loading database block starting at offset %d",
+                     received_size);
+            com_err(progname, retval, "%s", buf);
+            send_error(context, fd, retval, buf);
+            krb5_free_data_contents(context, &outbuf);
+            exit(1);
+        }
         received_size += outbuf.length;
+        krb5_free_data_contents(context, &outbuf);
     }
 
     /* OK, we've seen the entire file.  Did we get too many bytes? */
@@ -1452,7 +1521,9 @@ recv_database(krb5_context context, int fd, int database_fd,
         snprintf(buf, sizeof(buf),
                  "Received %d bytes, expected %d bytes for database file",
                  received_size, database_size);
+        com_err(progname, 0, "%s", buf);
         send_error(context, fd, KRB5KRB_ERR_GENERIC, buf);
+        exit(1);
     }
 
     if (debug)
@@ -1536,22 +1607,19 @@ recv_error(krb5_context context, krb5_data *inbuf)
     exit(1);
 }
 
-static void
-load_database(krb5_context context, char *kdb_util, char *database_file_name)
+/*
+ * Start kdb5_util to load a database dump from its standard input.  Return
+ * the write end of a pipe connected to that input.  kdb5_util does not make
+ * the loaded database live until a 'C' byte is written to *commit_fd_out, so
+ * that a transfer cut short by kpropd exiting, for any reason, is never
+ * promoted.
+ */
+static int
+start_load_database(krb5_context context, char *kdb_util, int *commit_fd_out)
 {
-    static char *edit_av[10];
-    int error_ret, child_pid, count;
-
-    /* <sys/param.h> has been included, so BSD will be defined on
-     * BSD systems. */
-#if BSD > 0 && BSD <= 43
-#ifndef WEXITSTATUS
-#define WEXITSTATUS(w) (w).w_retcode
-#endif
-    union wait waitb;
-#else
-    int waitb;
-#endif
+    static char *edit_av[12];
+    static char commit_fd_str[16];
+    int count, pipefds[2], commitfds[2];
     kdb_log_context *log_ctx;
 
     if (debug)
@@ -1572,26 +1640,71 @@ load_database(krb5_context context, char *kdb_util, char *database_file_name)
     }
     if (log_ctx && log_ctx->iproprole == IPROP_SLAVE)
         edit_av[count++] = "-i";
-    edit_av[count++] = database_file_name;
+
+    if (pipe(pipefds) < 0 || pipe(commitfds) < 0) {
+        com_err(progname, errno, _("while creating pipe for %s"), kdb_util);
+        exit(1);
+    }
+    snprintf(commit_fd_str, sizeof(commit_fd_str), "%d", commitfds[0]);
+    edit_av[count++] = "-commit_fd";
+    edit_av[count++] = commit_fd_str;
+    edit_av[count++] = "-";
     edit_av[count++] = NULL;
 
-    switch (child_pid = fork()) {
+    switch (load_child = fork()) {
     case -1:
         com_err(progname, errno, _("while trying to fork %s"), kdb_util);
         exit(1);
     case 0:
+        close(pipefds[1]);
+        close(commitfds[1]);
+        if (dup2(pipefds[0], STDIN_FILENO) < 0) {
+            com_err(progname, errno, _("while trying to exec %s"), kdb_util);
+            _exit(1);
+        }
+        if (pipefds[0] != STDIN_FILENO)
+            close(pipefds[0]);
         execv(kdb_util, edit_av);
         com_err(progname, errno, _("while trying to exec %s"), kdb_util);
         _exit(1);
         /*NOTREACHED*/
     default:
         if (debug)
-            fprintf(stderr, "Load PID is %d\n", child_pid);
-        if (wait(&waitb) < 0) {
-            com_err(progname, errno, _("while waiting for %s"), kdb_util);
-            exit(1);
-        }
+            fprintf(stderr, "Load PID is %d\n", (int)load_child);
+        atexit(atexit_kill_load);
+    }
+
+    close(pipefds[0]);
+    close(commitfds[0]);
+    *commit_fd_out = commitfds[1];
+    return pipefds[1];
+}
+
+/*
+ * Signal end-of-file to the kdb5_util load process started by
+ * start_load_database(), confirm that the dump it read was complete, and wait
+ * for it to finish loading the database.
+ */
+static void
+finish_load_database(krb5_context context, char *kdb_util, int load_fd,
+                     int commit_fd)
+{
+    int error_ret, waitb;
+    pid_t pid;
+
+    close(load_fd);
+    /* If the load process has already failed, this write fails with EPIPE
+     * and the exit status below reports the problem. */
+    (void)write(commit_fd, "C", 1);
+    close(commit_fd);
+    do {
+        pid = waitpid(load_child, &waitb, 0);
+    } while (pid < 0 && errno == EINTR);
+    if (pid < 0) {
+        com_err(progname, errno, _("while waiting for %s"), kdb_util);
+        exit(1);
     }
+    load_child = -1;
 
     if (!WIFEXITED(waitb)) {
         com_err(progname, 0, _("%s load terminated"), kdb_util);
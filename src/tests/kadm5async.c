@@ -0,0 +1,240 @@
+/* -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* tests/kadm5async.c - Exercise the asynchronous kadm5 client calls */
+/*
+ * Copyright (C) 2016 by the Massachusetts Institute of Technology.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * This program is invoked from t_kadm5async.py.  Usage:
+ *
+ *   kadm5async [-o] client password prefix count
+ *
+ * It connects to kadmind as client (using AUTH_GSSAPI with -o) and uses the
+ * asynchronous calls to create count principals named prefix0, prefix1, ...,
+ * then to get, modify, change the password of, get again and delete each of
+ * them, checking each result in its callback.  Replies to the first gets are
+ * collected by polling the handle's descriptor; the other stages are waited
+ * for with kadm5_flush_async(), or by a synchronous call.  The program prints
+ * the number of completions of each stage and exits with status 1 if any
+ * result was unexpected.
+ */
+
+#include <k5-int.h>
+#include <kadm5/admin.h>
+#include <poll.h>
+
+static krb5_context ctx;
+static void *handle;
+static int failures;
+
+struct op {
+    int index;
+    krb5_principal princ;
+    kadm5_ret_t expected;
+    int *count;
+};
+
+static void
+check(krb5_error_code code, const char *what)
+{
+    if (code) {
+        com_err("kadm5async", code, "while %s", what);
+        exit(1);
+    }
+}
+
+/* Callback for every operation: check the result code, and for gets, check
+ * that the entry belongs to the requested principal. */
+static void
+done(void *data, kadm5_ret_t code, kadm5_principal_ent_t ent)
+{
+    struct op *op = data;
+
+    (*op->count)++;
+    if (code != op->expected) {
+        com_err("kadm5async", code, "on principal %d (expected %ld)",
+                op->index, (long)op->expected);
+        failures++;
+    } else if (ent != NULL &&
+               !krb5_principal_compare(ctx, ent->principal, op->princ)) {
+        fprintf(stderr, "kadm5async: wrong entry for principal %d\n",
+                op->index);
+        failures++;
+    }
+}
+
+/* Collect replies by polling the handle's descriptor until none are left. */
+static void
+poll_replies(void)
+{
+    struct pollfd pfd;
+    int pending;
+
+    check(kadm5_async_fd(handle, &pfd.fd), "getting descriptor");
+    pfd.events = POLLIN;
+    check(kadm5_process_async(handle, &pending), "processing replies");
+    while (pending > 0) {
+        if (poll(&pfd, 1, 30000) != 1) {
+            fprintf(stderr, "kadm5async: timed out waiting for replies\n");
+            exit(1);
+        }
+        check(kadm5_process_async(handle, &pending), "processing replies");
+    }
+}
+
+int
+main(int argc, char **argv)
+{
+    kadm5_config_params params;
+    kadm5_principal_ent_rec ent;
+    struct op *ops, extra;
+    krb5_principal unknown;
+    char name[256];
+    int i, n, oldauth = 0;
+    int ncreate = 0, nget = 0, nmod = 0, ncpw = 0, nget2 = 0, ndel = 0;
+    int nextra = 0;
+
+    if (argc > 1 && strcmp(argv[1], "-o") == 0) {
+        oldauth = 1;
+        argc--;
+        argv++;
+    }
+    if (argc != 5) {
+        fprintf(stderr, "Usage: kadm5async [-o] client password prefix "
+                "count\n");
+        return 1;
+    }
+    n = atoi(argv[4]);
+
+    check(kadm5_init_krb5_context(&ctx), "initializing context");
+    memset(&params, 0, sizeof(params));
+    if (oldauth)
+        params.mask |= KADM5_CONFIG_OLD_AUTH_GSSAPI;
+    check(kadm5_init_with_password(ctx, argv[1], argv[2], KADM5_ADMIN_SERVICE,
+                                   &params, KADM5_STRUCT_VERSION,
+                                   KADM5_API_VERSION_4, NULL, &handle),
+          "initializing kadm5 handle");
+
+    ops = calloc(n, sizeof(*ops));
+    if (ops == NULL)
+        abort();
+    for (i = 0; i < n; i++) {
+        snprintf(name, sizeof(name), "%s%d", argv[3], i);
+        check(krb5_parse_name(ctx, name, &ops[i].princ), "parsing name");
+        ops[i].index = i;
+    }
+
+    /* Create the principals and wait for all of the replies. */
+    memset(&ent, 0, sizeof(ent));
+    for (i = 0; i < n; i++) {
+        ops[i].count = &ncreate;
+        ops[i].expected = 0;
+        ent.principal = ops[i].princ;
+        snprintf(name, sizeof(name), "pw%d", i);
+        check(kadm5_create_principal_async(handle, &ent, KADM5_PRINCIPAL, 0,
+                                           NULL, name, done, &ops[i]),
+              "sending create");
+    }
+    check(kadm5_flush_async(handle), "flushing creates");
+
+    /* Get each principal, along with one which does not exist. */
+    check(krb5_parse_name(ctx, "unknown", &unknown), "parsing name");
+    extra.index = -1;
+    extra.princ = unknown;
+    extra.expected = KADM5_UNK_PRINC;
+    extra.count = &nextra;
+    check(kadm5_get_principal_async(handle, unknown, KADM5_PRINCIPAL, done,
+                                    &extra), "sending get");
+    for (i = 0; i < n; i++) {
+        ops[i].count = &nget;
+        check(kadm5_get_principal_async(handle, ops[i].princ,
+                                        KADM5_PRINCIPAL_NORMAL_MASK, done,
+                                        &ops[i]), "sending get");
+    }
+    poll_replies();
+
+    /* Modify the principals and create a duplicate; a synchronous call
+     * completes the outstanding requests first. */
+    ent.max_life = 3600;
+    for (i = 0; i < n; i++) {
+        ops[i].count = &nmod;
+        ent.principal = ops[i].princ;
+        check(kadm5_modify_principal_async(handle, &ent, KADM5_MAX_LIFE,
+                                           done, &ops[i]), "sending modify");
+    }
+    extra.princ = ops[0].princ;
+    extra.expected = KADM5_DUP;
+    ent.principal = ops[0].princ;
+    check(kadm5_create_principal_async(handle, &ent, KADM5_PRINCIPAL, 0,
+                                       NULL, "dup", done, &extra),
+          "sending create");
+    memset(&ent, 0, sizeof(ent));
+    check(kadm5_get_principal(handle, ops[0].princ, &ent,
+                              KADM5_PRINCIPAL_NORMAL_MASK),
+          "getting principal");
+    if (ent.max_life != 3600) {
+        fprintf(stderr, "kadm5async: modify did not take effect\n");
+        failures++;
+    }
+    kadm5_free_principal_ent(handle, &ent);
+
+    /* Change the passwords, then get the principals again. */
+    for (i = 0; i < n; i++) {
+        ops[i].count = &ncpw;
+        check(kadm5_chpass_principal_async(handle, ops[i].princ, FALSE, 0,
+                                           NULL, "newpw", done, &ops[i]),
+              "sending chpass");
+    }
+    check(kadm5_flush_async(handle), "flushing chpass");
+    for (i = 0; i < n; i++) {
+        ops[i].count = &nget2;
+        check(kadm5_get_principal_async(handle, ops[i].princ,
+                                        KADM5_PRINCIPAL_NORMAL_MASK, done,
+                                        &ops[i]), "sending get");
+    }
+    poll_replies();
+
+    /* Delete the principals; destroying the handle waits for the replies. */
+    for (i = 0; i < n; i++) {
+        ops[i].count = &ndel;
+        check(kadm5_delete_principal_async(handle, ops[i].princ, done,
+                                           &ops[i]), "sending delete");
+    }
+    check(kadm5_destroy(handle), "destroying handle");
+
+    printf("create %d get %d modify %d chpass %d get %d delete %d "
+           "extra %d\n", ncreate, nget, nmod, ncpw, nget2, ndel, nextra);
+
+    for (i = 0; i < n; i++)
+        krb5_free_principal(ctx, ops[i].princ);
+    krb5_free_principal(ctx, unknown);
+    free(ops);
+    krb5_free_context(ctx);
+    return (failures > 0) ? 1 : 0;
+}
@@ -0,0 +1,89 @@
+#!/usr/bin/python
+from k5test import *
+
+realm = K5Realm(start_kadmind=True, create_host=False, get_creds=False)
+realm.prep_kadmin()
+
+def count_svc():
+    out = realm.run_kadmin(['listprincs', 'svc*'])
+    return len(out.splitlines())
+
+# Create enough principals to span several batch requests.  The list
+# contains a comment, a blank line, and a principal which already
+# exists; the error for that principal should not affect the others.
+names = ['svc%d/host' % i for i in range(600)]
+listfile = os.path.join(realm.testdir, 'princlist')
+f = open(listfile, 'w')
+f.write('# principals\n\n')
+f.write('\n'.join(names[:300] + ['user'] + names[300:]) + '\n')
+f.close()
+out = realm.run_kadmin(['addprincs', '-randkey', '+requires_preauth',
+                        listfile], expected_code=1)
+if 'while creating "user@KRBTEST.COM"' not in out:
+    fail('addprincs did not report existing principal')
+if count_svc() != 600:
+    fail('addprincs did not create all principals')
+out = realm.run_kadmin(['getprinc', 'svc599/host'])
+if 'Attributes: REQUIRES_PRE_AUTH' not in out or 'vno 1' not in out:
+    fail('addprincs did not apply options')
+
+# Randomize the keys of a list read from standard input.
+realm.run_kadmin(['randkeyprincs', '-'], input='\n'.join(names[:10]) + '\n')
+out = realm.run_kadmin(['getprinc', 'svc9/host'])
+if 'vno 2' not in out:
+    fail('randkeyprincs did not change kvno')
+out = realm.run_kadmin(['getprinc', 'svc10/host'])
+if 'vno 1' not in out:
+    fail('randkeyprincs changed an unlisted principal')
+
+# Attribute changes apply to each principal's existing attributes.
+realm.run_kadmin(['modprincs', '+allow_svr', '-maxlife', '1 hour', listfile])
+out = realm.run_kadmin(['getprinc', 'svc0/host'])
+if ('Attributes: REQUIRES_PRE_AUTH' not in out or
+    'Maximum ticket life: 0 days 01:00:00' not in out):
+    fail('modprincs')
+
+# The same commands work in kadmin.local.
+realm.run([kadminl, 'modprincs', '-requires_preauth', listfile])
+out = realm.run_kadmin(['getprinc', 'svc0/host'])
+if 'REQUIRES_PRE_AUTH' in out:
+    fail('kadmin.local modprincs')
+
+# Interactively, a list read from standard input leaves nothing to
+# read the confirmation from, so -force is required.
+out = realm.run([kadminl], input='delprincs -\n')
+if '-force is required' not in out:
+    fail('delprincs read from standard input without -force')
+if count_svc() != 600:
+    fail('delprincs without -force deleted principals')
+
+# A restricted administrator gets per-principal authorization errors.
+realm.run([kadminl, 'addprinc', '-pw', 'pw', 'restricted/admin'])
+f = open(os.path.join(realm.testdir, 'acl'), 'a')
+f.write('restricted/admin@%s d svc1/host@%s\n' % (realm.realm, realm.realm))
+f.close()
+realm.stop_kadmind()
+realm.start_kadmind()
+realm.prep_kadmin('restricted/admin', 'pw')
+out = realm.run_kadmin(['delprincs', '-force', '-'],
+                       input='svc1/host\nsvc2/host\nsvc10/host\n',
+                       expected_code=1)
+if ('while deleting principal "svc2/host@KRBTEST.COM"' not in out or
+    'Operation requires ``delete\'\' privilege' not in out or
+    'while deleting principal "svc10/host@KRBTEST.COM"' not in out or
+    '"svc1/host@KRBTEST.COM"' in out):
+    fail('restricted delprincs')
+realm.prep_kadmin()
+if count_svc() != 599:
+    fail('restricted delprincs deleted the wrong principals')
+
+# Delete the remaining principals.  Principals which no longer exist
+# get an error, but do not prevent the rest from being deleted.
+out = realm.run_kadmin(['delprincs', '-force', listfile], expected_code=1)
+if 'while deleting principal "svc1/host@KRBTEST.COM"' not in out:
+    fail('delprincs did not report missing principal')
+out = realm.run_kadmin(['listprincs', 'svc*'])
+if out.strip():
+    fail('principals remain after delprincs')
+
+success('Bulk principal administration')
@@ -34,4 +34,21 @@ for line in trace.splitlines():
 if not fast_used_for_changepw:
     fail('FAST was not used to get kadmin/changepw ticket')
 
+# Change a password through kpasswd and perform kadmin operations
+# while kadmind runs with worker processes.
+realm.stop_kadmind()
+realm.start_kadmind(['-w', '2'])
+realm.run([kadminl, 'modprinc', '-pwexpire', '1 day ago', 'user'])
+pwinput = 'efgh\nijkl\nijkl\n'
+realm.run([kinit, realm.user_princ], input=pwinput)
+realm.prep_kadmin()
+for i in range(4):
+    realm.run_kadmin(['addprinc', '-randkey', 'worker%d' % i])
+    out = realm.run_kadmin(['getprinc', 'worker%d' % i])
+    if 'Principal: worker%d@' % i not in out:
+        fail('getprinc through kadmind worker')
+out = realm.run_kadmin(['listprincs', 'worker*'])
+if len(out.splitlines()) != 4:
+    fail('listprincs through kadmind workers')
+
 success('Password change tests')
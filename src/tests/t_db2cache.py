@@ -0,0 +1,31 @@
+#!/usr/bin/python
+from k5test import *
+import re
+
+# Create the database with a non-default page size and a cache of 64
+# pages, and check that the cache statistics are traced when the
+# database handle is closed.
+conf = {'dbmodules': {'db': {'db_cache_size': '524288',
+                             'db_page_size': '8192'}}}
+realm = K5Realm(kdc_conf=conf, create_host=False, start_kdc=False)
+tracefile = os.path.join(realm.testdir, 'trace')
+tenv = dict(realm.env)
+tenv['KRB5_TRACE'] = tracefile
+realm.run([kadminl, 'getprinc', realm.user_princ], env=tenv)
+f = open(tracefile, 'r')
+trace = f.read()
+f.close()
+if not re.search(r'DB2 page cache for .*: \d+ hits, \d+ misses, '
+                 r'\d+ reads, \d+ writes, \d+ evictions, \d+/64 pages',
+                 trace):
+    fail('DB2 page cache statistics not traced')
+
+# A page size which is not a power of two is rejected.
+bad = realm.special_env('badpsize', True, kdc_conf={
+        'dbmodules': {'db': {'db_page_size': '1000'}}})
+out = realm.run([kadminl, 'getprinc', realm.user_princ], env=bad,
+                expected_code=1)
+if 'Invalid db2 page size 1000' not in out:
+    fail('Expected error for invalid db2 page size')
+
+success('DB2 page cache configuration')
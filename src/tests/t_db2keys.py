@@ -0,0 +1,79 @@
+#!/usr/bin/python
+from k5test import *
+
+def kadmin(realm, *args, **kwargs):
+    return realm.run([kadminl] + list(args), **kwargs)
+
+def check_list(realm, expr, expected):
+    out = kadmin(realm, 'listprincs', expr)
+    names = sorted(l for l in out.splitlines()
+                   if not l.startswith('Authenticating'))
+    if names != sorted(expected):
+        fail('Unexpected listprincs %s output: %s' % (expr, names))
+
+def check_db(realm):
+    realm.addprinc('host/a.example.com')
+    realm.addprinc('host/b.example.com')
+    realm.addprinc('hostx')
+    realm.addprinc('http/a.example.com')
+    realm.addprinc('host/c@OTHER.REALM')
+    kadmin(realm, 'renprinc', 'hostx', 'host/d.example.com')
+    kadmin(realm, 'delprinc', '-force', 'host/b.example.com')
+
+    kadmin(realm, 'getprinc', 'host/a.example.com')
+    kadmin(realm, 'getprinc', 'host/c@OTHER.REALM')
+    out = kadmin(realm, 'getprinc', 'hostx', expected_code=1)
+    if 'Principal does not exist' not in out:
+        fail('Renamed principal still present')
+
+    check_list(realm, 'host/*', ['host/a.example.com@KRBTEST.COM',
+                                 'host/c@OTHER.REALM',
+                                 'host/d.example.com@KRBTEST.COM',
+                                 realm.host_princ])
+    check_list(realm, 'host/*@KRBTEST.COM', ['host/a.example.com@KRBTEST.COM',
+                                             'host/d.example.com@KRBTEST.COM',
+                                             realm.host_princ])
+    check_list(realm, 'h*/a*', ['host/a.example.com@KRBTEST.COM',
+                                'http/a.example.com@KRBTEST.COM'])
+    check_list(realm, 'host/*@OTHER.REALM', ['host/c@OTHER.REALM'])
+    check_list(realm, 'hostx', [])
+    check_list(realm, 'zzz*', [])
+    out = kadmin(realm, 'listprincs')
+    if len(out.splitlines()) != len(kadmin(realm, 'listprincs', '*@*').
+                                    splitlines()):
+        fail('Unfiltered listprincs mismatch')
+    if 'host/a.example.com@KRBTEST.COM' not in out:
+        fail('Principal missing from full listing')
+
+    # The DB must still serve tickets.
+    realm.start_kdc()
+    realm.kinit(realm.user_princ, password('user'))
+    realm.run([kvno, realm.host_princ])
+    realm.stop_kdc()
+
+# Prefix iteration with the default key layout.
+realm = K5Realm(start_kdc=False)
+check_db(realm)
+dumpfile = os.path.join(realm.testdir, 'dump')
+realm.run([kdb5_util, 'dump', dumpfile])
+realm.stop()
+
+# The same operations with the realm omitted from keys.
+conf = {'dbmodules': {'db': {'short_keys': 'true'}}}
+realm = K5Realm(kdc_conf=conf, start_kdc=False)
+check_db(realm)
+
+# A dump of a DB with short keys loads into the default layout and back.
+realm.run([kdb5_util, 'dump', dumpfile])
+plain = realm.special_env('plain', True, kdc_conf={
+        'dbmodules': {'db': {'short_keys': 'false'}}})
+realm.run([kdb5_util, 'load', dumpfile], env=plain)
+realm.run([kadminl, 'getprinc', 'host/a.example.com'], env=plain)
+out = realm.run([kadminl, 'getprinc', 'host/a.example.com'])
+if 'Principal: host/a.example.com@KRBTEST.COM' not in out:
+    fail('Principal not found after load into default layout')
+realm.run([kdb5_util, 'load', dumpfile])
+check_list(realm, 'host/*.example.com', ['host/a.example.com@KRBTEST.COM',
+                                         'host/d.example.com@KRBTEST.COM'])
+
+success('DB2 key layout and prefix iteration')
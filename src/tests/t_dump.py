@@ -1,6 +1,7 @@
 #!/usr/bin/python
 from k5test import *
 from filecmp import cmp
+import time
 
 # Make sure we can dump and load an ordinary database, and that
 # principals and policies survive a dump/load cycle.
@@ -53,6 +54,68 @@ out = realm.run([kadminl, 'getpols'])
 if 'compat\n' not in out or 'fred\n' not in out or 'barney\n' not in out:
     fail('Missing policy after second load')
 
+# Dump/load in binary format, and check that a dump converts between
+# the text and binary formats without loss.
+realm.run([kdb5_util, 'dump', '-binary', dumpfile])
+realm.run([kdb5_util, 'load', dumpfile])
+out = realm.run([kadminl, 'getprincs'])
+if realm.user_princ not in out or realm.host_princ not in out:
+    fail('Missing principal after binary load')
+out = realm.run([kadminl, 'getpol', 'barney'])
+if 'Number of old keys kept: 1' not in out:
+    fail('Policy has wrong value after binary load')
+textdump = os.path.join(realm.testdir, 'dump.text')
+realm.run([kdb5_util, 'dump', textdump])
+realm.run([kdb5_util, 'load', '-binary', dumpfile])
+realm.run([kdb5_util, 'dump', dumpfile])
+if not cmp(textdump, dumpfile, False):
+    fail('Text dump changed after binary dump/load cycle')
+
+# A truncated binary dump must not be loaded.
+realm.run([kdb5_util, 'dump', '-binary', dumpfile])
+f = open(dumpfile, 'rb')
+contents = f.read()
+f.close()
+f = open(dumpfile, 'wb')
+f.write(contents[:-9])
+f.close()
+realm.run([kdb5_util, 'load', dumpfile], expected_code=1)
+
+# Neither may a corrupted one; the block checksum catches the change.
+f = open(dumpfile, 'wb')
+f.write(contents[:-20] + chr(ord(contents[-20]) ^ 1) + contents[-19:])
+f.close()
+out = realm.run([kdb5_util, 'load', dumpfile], expected_code=1)
+if 'checksum mismatch' not in out:
+    fail('Corrupted binary dump not detected by checksum')
+
+# A record length beyond the limit is rejected before it is read.
+f = open(dumpfile, 'wb')
+f.write(contents[:-13] + 'P\xff\xff\xff\xf0')
+f.close()
+out = realm.run([kdb5_util, 'load', dumpfile], expected_code=1)
+if 'record is too long' not in out:
+    fail('Oversized binary dump record not rejected')
+
+# A load from standard input with -commit_fd is only made live if the
+# sender confirms it by writing 'C' to the commit descriptor.
+realm.run([kdb5_util, 'dump', dumpfile])
+realm.run([kadminl, 'addprinc', '-nokey', 'uncommitted'])
+cmd = '%s load -commit_fd 3 - < %s 3< %s'
+realm.run(['sh', '-c', cmd % (kdb5_util, dumpfile, os.devnull)],
+          expected_code=1)
+out = realm.run([kadminl, 'getprincs'])
+if 'uncommitted@' not in out:
+    fail('Unconfirmed load replaced the database')
+commitfile = os.path.join(realm.testdir, 'commit')
+f = open(commitfile, 'w')
+f.write('C')
+f.close()
+realm.run(['sh', '-c', cmd % (kdb5_util, dumpfile, commitfile)])
+out = realm.run([kadminl, 'getprincs'])
+if 'uncommitted@' in out or realm.user_princ not in out:
+    fail('Confirmed load did not replace the database')
+
 srcdumpdir = os.path.join(srctop, 'tests', 'dumpfiles')
 srcdump = os.path.join(srcdumpdir, 'dump')
 srcdump_r18 = os.path.join(srcdumpdir, 'dump.r18')
@@ -107,4 +170,105 @@ out = realm.run([kadminl, 'getprinc', 'user'])
 if 'Policy: testpol' not in out:
     fail('Loading ov dump did not add user policy reference')
 
+# Propagate changes to a slave database with a delta dump.
+conf = {'realms': {'$realm': {'iprop_enable': 'true',
+                              'iprop_logfile': '$testdir/db.ulog'}}}
+conf_slave = {'realms': {'$realm': {'iprop_logfile': '$testdir/ulog.slave'}},
+              'dbmodules': {'db': {'database_name': '$testdir/db.slave'}}}
+conf_copy = {'realms': {'$realm': {'iprop_enable': 'true',
+                                   'iprop_logfile': '$testdir/ulog.copy'}},
+             'dbmodules': {'db': {'database_name': '$testdir/db.copy'}}}
+realm = K5Realm(kdc_conf=conf, start_kdc=False)
+slave = realm.special_env('slave', True, kdc_conf=conf_slave)
+copy = realm.special_env('copy', True, kdc_conf=conf_copy)
+realm.run([kadminl, 'addprinc', '-nokey', 'gone'])
+realm.run([kadminl, 'addprinc', '-nokey', 'changed'])
+dumpfile = os.path.join(realm.testdir, 'dump')
+realm.run([kdb5_util, 'dump', dumpfile])
+realm.run([kdb5_util, 'load', dumpfile], copy)
+realm.run([kdb5_util, 'dump', '-i1', '-binary', dumpfile])
+realm.run([kdb5_util, 'load', '-i', dumpfile], slave)
+sno = open(dumpfile).readline().split()[6]
+
+realm.run([kadminl, 'addprinc', '-nokey', 'new'])
+realm.run([kadminl, 'delprinc', 'gone'])
+realm.run([kadminl, 'modprinc', '-maxlife', '1 hour', 'changed'])
+realm.run([kadminl, 'modprinc', '-maxrenewlife', '1 day', 'changed'])
+realm.run([kdb5_util, 'dump', '-since', sno, dumpfile])
+realm.run([kdb5_util, 'load', '-i', dumpfile], slave)
+def check_delta_load(env):
+    out = realm.run([kadminl, 'getprincs'], env)
+    if 'new@' not in out or 'gone@' in out or 'changed@' not in out:
+        fail('Principals wrong after delta load')
+    out = realm.run([kadminl, 'getprinc', 'changed'], env)
+    if ('Maximum ticket life: 0 days 01:00:00' not in out or
+        'Maximum renewable life: 1 day 00:00:00' not in out):
+        fail('Principal not updated by delta load')
+check_delta_load(slave)
+def ulog_last(env):
+    out = realm.run([kproplog, '-h'], env)
+    return [l for l in out.splitlines() if 'Last' in l]
+if ulog_last(slave) != ulog_last(None):
+    fail('Slave update log position differs from master after delta load')
+
+# Without -i, a delta is applied like any other updates, which are
+# logged.
+realm.run([kdb5_util, 'load', dumpfile], copy)
+check_delta_load(copy)
+out = realm.run([kproplog, '-h'], copy)
+if 'Number of entries : 4' not in out:
+    fail('Delta load without -i not logged')
+
+# The slave is no longer at sno, so the delta must not be applied again.
+realm.run([kdb5_util, 'load', '-i', dumpfile], slave, expected_code=1)
+
+# A delta cannot be made from a serial number the ulog doesn't contain.
+realm.run([kdb5_util, 'dump', '-since', '1000', dumpfile], expected_code=1)
+
+# Once the master's ulog has wrapped past the slave's serial number, a
+# delta can be made from the principals' modification times, given the
+# slave's timestamp.  Policy changes reinitialize the ulog, so the
+# delta must also carry the deletion of oldpol.
+conf['realms']['$realm']['iprop_master_ulogsize'] = '5'
+realm = K5Realm(kdc_conf=conf, start_kdc=False)
+slave = realm.special_env('slave', True, kdc_conf=conf_slave)
+realm.run([kadminl, 'addpol', 'oldpol'])
+realm.run([kadminl, 'addprinc', '-nokey', 'same'])
+# Principals modified in the same second as the slave's timestamp are
+# included in the delta, so make sure same is older.
+time.sleep(1)
+realm.run([kadminl, 'addprinc', '-nokey', 'gone'])
+realm.run([kadminl, 'addprinc', '-nokey', 'changed'])
+realm.run([kdb5_util, 'dump', '-i1', '-binary', dumpfile])
+realm.run([kdb5_util, 'load', '-i', dumpfile], slave)
+sno, sec, usec = open(dumpfile).readline().split()[6:9]
+since_time = '%s.%s' % (sec, usec)
+
+realm.run([kadminl, 'delpol', 'oldpol'])
+realm.run([kadminl, 'addprinc', '-nokey', 'new'])
+realm.run([kadminl, 'delprinc', 'gone'])
+realm.run([kadminl, 'modprinc', '-maxlife', '1 hour', 'changed'])
+realm.run([kadminl, 'modprinc', '-maxrenewlife', '1 day', 'changed'])
+for i in range(4):
+    realm.run([kadminl, 'addprinc', '-nokey', 'extra%d' % i])
+realm.run([kdb5_util, 'dump', '-since', sno, dumpfile], expected_code=1)
+out = realm.run([kdb5_util, 'dump', '-verbose', '-since', sno,
+                 '-since_time', since_time, dumpfile])
+if 'changed@' not in out or 'same@' in out:
+    fail('Wrong principals in delta from modification times')
+if not open(dumpfile).readline().rstrip().endswith(' complete'):
+    fail('Delta from modification times not marked complete')
+realm.run([kdb5_util, 'dump', '-since', sno, '-since_time', since_time,
+           dumpfile, 'changed'], expected_code=1)
+realm.run([kdb5_util, 'dump', '-since', sno, '-since_time', since_time,
+           dumpfile])
+realm.run([kdb5_util, 'load', '-i', dumpfile], slave)
+check_delta_load(slave)
+if 'same@' not in realm.run([kadminl, 'getprincs'], slave):
+    fail('Unchanged principal deleted by delta load')
+if 'oldpol' in realm.run([kadminl, 'getpols'], slave):
+    fail('Policy deletion not carried by delta load')
+if ulog_last(slave) != ulog_last(None):
+    fail('Slave update log position differs from master after delta load')
+
 success('Dump/load tests')
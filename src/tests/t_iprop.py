@@ -113,9 +113,11 @@ def check_ulog(num, first, last, entries, env=None):
 # updates from slave1.  Because of the awkward way iprop and kprop
 # port configuration currently works, we need separate config files
 # for the slave and master sides of slave1, but they use the same DB
-# and ulog file.
+# and ulog file.  The ulog size is small enough for the last test to
+# wrap around it.
 conf = {'realms': {'$realm': {'iprop_enable': 'true',
-                              'iprop_logfile': '$testdir/db.ulog'}}}
+                              'iprop_logfile': '$testdir/db.ulog',
+                              'iprop_master_ulogsize': '10'}}}
 conf_slave1 = {'realms': {'$realm': {'iprop_slave_poll': '600',
                                      'iprop_logfile': '$testdir/ulog.slave1'}},
                'dbmodules': {'db': {'database_name': '$testdir/db.slave1'}}}
@@ -373,6 +375,28 @@ out = realm.run([kadminl, 'getprinc', pr1], env=slave1)
 if 'Maximum ticket life: 0 days 00:05:00' not in out:
     fail('slave1 does not have modification from master after kpropd -t')
 
+# Fetch a batch containing several updates to the same principals,
+# including a deletion followed by a re-creation.  The slave combines
+# them per principal but must reach the same state as the master.
+realm.addprinc(pr3)
+realm.run([kadminl, 'modprinc', '-maxlife', '7 minutes', pr3])
+realm.run([kadminl, 'modprinc', '+requires_preauth', pr3])
+realm.run([kadminl, 'delprinc', pr1])
+realm.addprinc(pr1)
+realm.run([kadminl, 'modprinc', '-maxlife', '8 minutes', pr1])
+check_ulog(8, 1, 8, [None, pr1, pr3, pr3, pr3, pr1, pr1, pr1])
+out = realm.run_kpropd_once(slave1, ['-d'])
+if 'Got incremental updates (sno=8 ' not in out:
+    fail('Expected incremental updates from kpropd -t')
+check_ulog(8, 1, 8, [None, pr1, pr3, pr3, pr3, pr1, pr1, pr1], slave1)
+out = realm.run([kadminl, 'getprinc', pr3], env=slave1)
+if ('Maximum ticket life: 0 days 00:07:00' not in out or
+    'REQUIRES_PRE_AUTH' not in out):
+    fail('slave1 does not have batched modifications from master')
+out = realm.run([kadminl, 'getprinc', pr1], env=slave1)
+if 'Maximum ticket life: 0 days 00:08:00' not in out:
+    fail('slave1 does not have re-created principal from master')
+
 # Propagate a policy change via full resync.
 realm.run([kadminl, 'addpol', '-minclasses', '3', 'testpol'])
 check_ulog(1, 1, 1, [None])
@@ -385,4 +409,24 @@ out = realm.run([kadminl, 'getpol', 'testpol'], env=slave1)
 if 'Minimum number of password character classes: 3' not in out:
     fail('slave1 does not have policy from master after kpropd -t')
 
+# Make more changes than the master's ulog holds, so that slave1's
+# serial number is overwritten.  slave1 should catch up with a delta
+# of the principals modified since its timestamp, which also removes
+# the deleted principal.
+for i in range(1, 11):
+    realm.run([kadminl, 'modprinc', '-maxlife', '%d minutes' % i, pr1])
+realm.run([kadminl, 'delprinc', pr3])
+check_ulog(10, 3, 12, [pr1] * 9 + [pr3])
+out = realm.run_kpropd_once(slave1, ['-d'])
+if ('Delta resync request granted' not in out or
+    'KDC is synchronized' not in out):
+    fail('Expected delta dump and synchronized from kpropd -t')
+check_ulog(1, 12, 12, [None], slave1)
+out = realm.run([kadminl, 'getprinc', pr1], env=slave1)
+if 'Maximum ticket life: 0 days 00:10:00' not in out:
+    fail('slave1 does not have modification from master after delta')
+out = realm.run([kadminl, 'getprinc', pr3], env=slave1, expected_code=1)
+if 'Principal does not exist' not in out:
+    fail('slave1 does not have principal deletion from master after delta')
+
 success('iprop tests')
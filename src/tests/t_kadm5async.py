@@ -0,0 +1,25 @@
+#!/usr/bin/python
+from k5test import *
+
+realm = K5Realm(start_kadmind=True, create_host=False, get_creds=False)
+kadm5async = './kadm5async'
+expected = 'create 200 get 200 modify 200 chpass 200 get 200 delete 200 ' \
+    'extra 2\n'
+
+# Pipeline requests over RPCSEC_GSS.
+out = realm.run([kadm5async, realm.admin_princ, password('admin'), 'a', '200'])
+if out != expected:
+    fail('Unexpected output from pipelined requests')
+
+# The older AUTH_GSSAPI flavor completes each request as it is made.
+out = realm.run([kadm5async, '-o', realm.admin_princ, password('admin'), 'b',
+                 '200'])
+if out != expected:
+    fail('Unexpected output from AUTH_GSSAPI requests')
+
+# The principals were created, changed and deleted.
+out = realm.run([kadminl, 'listprincs', 'a*'])
+if out != '':
+    fail('Principals left behind by asynchronous deletes')
+
+success('Asynchronous kadm5 requests')
@@ -1,6 +1,8 @@
 #!/usr/bin/python
 from k5test import *
 import os
+import signal
+import time
 
 realm = K5Realm(create_host=False, create_user=False)
 
@@ -358,4 +360,45 @@ kadmin_as(all_extract, ['ktadd', '-norandkey', 'extractkeys'])
 realm.kinit('extractkeys', flags=['-k'])
 os.remove(realm.keytab)
 
+# Replace the ACL with a large one and signal kadmind to reload it.
+# Only the first matching line applies, whether it names the caller
+# literally or with wildcards.
+f = open(os.path.join(realm.testdir, 'acl'), 'w')
+for i in range(3000):
+    f.write('tenant%d/admin  a  tenant%d/*\n' % (i, i))
+f.write('''
+*/two/*/*            l
+one/two/three/four   i
+none                 l
+none                 a
+''')
+f.close()
+logfile = os.path.join(realm.testdir, 'kadmind5.log')
+nreloads = open(logfile).read().count('reloaded ACL file')
+os.kill(realm._kadmind_proc.pid, signal.SIGHUP)
+while open(logfile).read().count('reloaded ACL file') == nreloads:
+    time.sleep(0.1)
+kadmin_as(none, ['listprincs'])
+out = kadmin_as(none, ['addprinc', '-nokey', 'newprinc'], expected_code=1)
+if 'Operation requires ``add\'\' privilege' not in out:
+    fail('second matching ACL line applied after reload')
+kadmin_as(onetwothreefour, ['listprincs'])
+out = kadmin_as(onetwothreefour, ['getprinc', 'none'], expected_code=1)
+if 'Operation requires ``get\'\' privilege' not in out:
+    fail('literal ACL line applied before earlier wildcard line')
+out = kadmin_as(all_add, ['addprinc', '-nokey', 'newprinc'], expected_code=1)
+if 'Operation requires ``add\'\' privilege' not in out:
+    fail('old ACL still applied after reload')
+
+# A reload which fails keeps the current ACL.
+f = open(os.path.join(realm.testdir, 'acl'), 'a')
+f.write('none  Q\n')
+f.close()
+nfails = open(logfile).read().count('failed to reload ACL file')
+os.kill(realm._kadmind_proc.pid, signal.SIGHUP)
+while open(logfile).read().count('failed to reload ACL file') == nfails:
+    time.sleep(0.1)
+kadmin_as(none, ['listprincs'])
+kadmin_as(onetwothreefour, ['listprincs'])
+
 success('kadmin ACL enforcement')
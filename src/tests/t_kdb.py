@@ -51,44 +51,71 @@ core_schema = next((i for i in imap(lambda x:x+local_schema_path, ldap_homes)
 # Make a slapd config file.  This is deprecated in OpenLDAP 2.3 and
 # later, but it's easier than using LDIF and slapadd.  Include some
 # authz-regexp entries for SASL authentication tests.  Load the core
-# schema if we found it, for use in the DIGEST-MD5 test.
-file = open(slapd_conf, 'w')
-file.write('pidfile %s\n' % slapd_pidfile)
-file.write('include %s\n' % schema)
-if core_schema:
-    file.write('include %s\n' % core_schema)
-file.write('moduleload back_bdb\n')
-file.write('database bdb\n')
-file.write('suffix %s\n' % top_dn)
-file.write('rootdn %s\n' % admin_dn)
-file.write('rootpw %s\n' % admin_pw)
-file.write('directory %s\n' % dbdir)
-file.write('authz-regexp .*uidNumber=%d,cn=peercred,cn=external,cn=auth %s\n' %
-           (os.geteuid(), admin_dn))
-file.write('authz-regexp uid=digestuser,cn=digest-md5,cn=auth %s\n' % admin_dn)
-file.close()
+# schema if we found it, for use in the DIGEST-MD5 test.  The syncprov
+# overlay is only loaded for the principal cache tests, as it may not
+# be installed.
+def write_slapd_conf(syncprov=False):
+    file = open(slapd_conf, 'w')
+    file.write('pidfile %s\n' % slapd_pidfile)
+    file.write('include %s\n' % schema)
+    if core_schema:
+        file.write('include %s\n' % core_schema)
+    file.write('moduleload back_bdb\n')
+    if syncprov:
+        file.write('moduleload syncprov\n')
+    file.write('database bdb\n')
+    file.write('suffix %s\n' % top_dn)
+    file.write('rootdn %s\n' % admin_dn)
+    file.write('rootpw %s\n' % admin_pw)
+    file.write('directory %s\n' % dbdir)
+    if syncprov:
+        file.write('overlay syncprov\n')
+    file.write('authz-regexp .*uidNumber=%d,cn=peercred,cn=external,'
+               'cn=auth %s\n' % (os.geteuid(), admin_dn))
+    file.write('authz-regexp uid=digestuser,cn=digest-md5,cn=auth %s\n' %
+               admin_dn)
+    file.close()
 
 slapd_pid = -1
 def kill_slapd():
     global slapd_pid
     if slapd_pid != -1:
         os.kill(slapd_pid, signal.SIGTERM)
+        # Wait for slapd to exit, so that it can be restarted.
+        while True:
+            try:
+                os.kill(slapd_pid, 0)
+            except OSError:
+                break
+            time.sleep(0.1)
         slapd_pid = -1
 atexit.register(kill_slapd)
 
-out = open(slapd_out, 'w')
-subprocess.call([slapd, '-h', ldap_uri, '-f', slapd_conf], stdout=out,
-                stderr=out)
-out.close()
-pidf = open(slapd_pidfile, 'r')
-slapd_pid = int(pidf.read())
-pidf.close()
-output('*** Started slapd (pid %d, output in %s)\n' % (slapd_pid, slapd_out))
-
-# slapd detaches before it finishes setting up its listener sockets
-# (they are bound but listen() has not been called).  Give it a second
-# to finish.
-time.sleep(1)
+# Start slapd with the current config file.  Return False if it fails
+# to start.
+def start_slapd():
+    global slapd_pid
+    out = open(slapd_out, 'w')
+    code = subprocess.call([slapd, '-h', ldap_uri, '-f', slapd_conf],
+                           stdout=out, stderr=out)
+    out.close()
+    if code != 0:
+        return False
+    pidf = open(slapd_pidfile, 'r')
+    slapd_pid = int(pidf.read())
+    pidf.close()
+    output('*** Started slapd (pid %d, output in %s)\n' %
+           (slapd_pid, slapd_out))
+
+    # slapd detaches before it finishes setting up its listener sockets
+    # (they are bound but listen() has not been called).  Give it a
+    # second to finish.
+    time.sleep(1)
+    return True
+
+write_slapd_conf()
+if not start_slapd():
+    fail('slapd failed to start')
 
 # Run kdbtest against the LDAP module.
 conf = {'realms': {'$realm': {'database_module': 'ldap'}},
@@ -299,6 +326,60 @@ out = realm.run([kadminl, 'getstrs', 'authind'])
 if 'require_auth: otp radius' not in out:
     fail('Expected auth indicators value not in output')
 
+# Test the KDC principal cache, restarting slapd with the syncprov
+# overlay.  Changes made by kadmin.local must be seen by the KDC through
+# the overlay.
+realm.stop_kdc()
+kill_slapd()
+write_slapd_conf(syncprov=True)
+if start_slapd():
+    pcache_conf = {'dbmodules':
+                   {'ldap': {'ldap_principal_cache_size': '100'}}}
+    pcache_env = realm.special_env('pcache', True, kdc_conf=pcache_conf)
+    realm.start_kdc(env=pcache_env)
+    realm.kinit(realm.user_princ, password('user'))
+    realm.run([kvno, realm.host_princ])
+    realm.run([kadminl, 'modprinc', '-allow_tix', realm.user_princ])
+    time.sleep(1)
+    realm.kinit(realm.user_princ, password('user'), expected_code=1)
+    realm.run([kadminl, 'modprinc', '+allow_tix', realm.user_princ])
+    realm.run([kadminl, 'cpw', '-pw', 'pcache', realm.user_princ])
+    time.sleep(1)
+    realm.kinit(realm.user_princ, 'pcache')
+    realm.run([kadminl, 'cpw', '-pw', password('user'), realm.user_princ])
+    realm.stop_kdc()
+    kill_slapd()
+else:
+    skipped('LDAP principal cache tests', 'slapd syncprov module not found')
+write_slapd_conf()
+if not start_slapd():
+    fail('slapd failed to restart')
+realm.start_kdc(['-x', 'nconns=3', '-x', 'host=' + ldap_uri,
+                 '-x', 'binddn=' + admin_dn, '-x', 'bindpwd=' + admin_pw])
+
+# Test lockout.  The KDC enforces lockout from its own pending state,
+# and writes the updates to the directory after a short delay.
+realm.run([kadminl, 'addpol', '-maxfailure', '2', '-failurecountinterval',
+           '5m', 'lockout'])
+realm.addprinc('lockuser', password('lockuser'))
+realm.run([kadminl, 'modprinc', '+requires_preauth', '-policy', 'lockout',
+           'lockuser'])
+realm.run([kinit, 'lockuser'], input='wrong\n', expected_code=1)
+realm.run([kinit, 'lockuser'], input='wrong\n', expected_code=1)
+out = realm.run([kinit, 'lockuser'], input=password('lockuser') + '\n',
+                expected_code=1)
+if 'Clients credentials have been revoked' not in out:
+    fail('Expected lockout error message not seen in kinit output')
+time.sleep(2)
+realm.kinit(realm.user_princ, password('user'))
+time.sleep(1)
+out = realm.run([kadminl, 'getprinc', 'lockuser'])
+if 'Failed password attempts: 2' not in out:
+    fail('Lockout state not written to directory')
+realm.run([kadminl, 'modprinc', '-unlock', 'lockuser'])
+realm.kinit('lockuser', password('lockuser'))
+realm.kinit(realm.user_princ, password('user'))
+
 # Test service principal aliases.
 realm.addprinc('canon', password('canon'))
 ldap_modify('dn: krbPrincipalName=canon@KRBTEST.COM,cn=t1,cn=krb5\n'
@@ -3,9 +3,7 @@ from k5test import *
 
 conf_slave = {'dbmodules': {'db': {'database_name': '$testdir/db.slave'}}}
 
-# kprop/kpropd are the only users of krb5_auth_con_initivector, so run
-# this test over all enctypes to exercise mkpriv cipher state.
-for realm in multipass_realms(create_user=False):
+def setup_slave(realm):
     slave = realm.special_env('slave', True, kdc_conf=conf_slave)
 
     # Set up the kpropd acl file.
@@ -23,11 +21,9 @@ for realm in multipass_realms(create_user=False):
     # Make some changes to the master db.
     realm.addprinc('wakawaka')
 
-    # Start kpropd.
-    kpropd = realm.start_kpropd(slave, ['-d'])
+    return slave, dumpfile
 
-    realm.run([kdb5_util, 'dump', dumpfile])
-    realm.run([kprop, '-f', dumpfile, '-P', str(realm.kprop_port()), hostname])
+def wait_for_kpropd(kpropd):
     output('*** kpropd output follows\n')
     while True:
         line = kpropd.stdout.readline()
@@ -37,8 +33,37 @@ for realm in multipass_realms(create_user=False):
         if 'Rejected connection' in line:
             fail('kpropd rejected connection from kprop')
 
+def check_slave(realm, slave):
     out = realm.run([kadminl, 'listprincs'], slave)
     if 'wakawaka' not in out:
         fail('Slave does not have all principals from master')
 
+# kprop/kpropd are the only users of krb5_auth_con_initivector, so run
+# this test over all enctypes to exercise mkpriv cipher state.
+for realm in multipass_realms(create_user=False):
+    slave, dumpfile = setup_slave(realm)
+
+    # Start kpropd.
+    kpropd = realm.start_kpropd(slave, ['-d'])
+
+    realm.run([kdb5_util, 'dump', dumpfile])
+    realm.run([kprop, '-f', dumpfile, '-P', str(realm.kprop_port()), hostname])
+    wait_for_kpropd(kpropd)
+    check_slave(realm, slave)
+
+# Propagate to more than one slave host in a single kprop invocation.
+# kpropd handles one connection at a time, so naming the same slave
+# twice exercises the concurrent transfers without a second kpropd.
+realm = K5Realm(create_user=False)
+slave, dumpfile = setup_slave(realm)
+kpropd = realm.start_kpropd(slave, ['-d'])
+realm.run([kdb5_util, 'dump', '-binary', dumpfile])
+out = realm.run([kprop, '-f', dumpfile, '-P', str(realm.kprop_port()),
+                 hostname, hostname])
+if out.count('SUCCEEDED') != 2:
+    fail('kprop did not report two successful propagations')
+wait_for_kpropd(kpropd)
+wait_for_kpropd(kpropd)
+check_slave(realm, slave)
+
 success('kprop tests')
@@ -0,0 +1,42 @@
+#!/usr/bin/python
+from k5test import *
+
+realm = K5Realm(start_kadmind=True, create_host=False, get_creds=False)
+realm.prep_kadmin()
+
+# Create enough principals that listing them takes several pages.
+names = ['p%d' % i for i in range(2500)]
+realm.run([kadminl, 'addprincs', '-nokey', '-'],
+          input='\n'.join(names) + '\n')
+allnames = set(n + '@' + realm.realm for n in names)
+
+def check_list(args, expected, msg, local=False):
+    if local:
+        out = realm.run([kadminl, 'listprincs'] + args)
+    else:
+        out = realm.run_kadmin(['listprincs'] + args)
+    got = out.splitlines()
+    if len(got) != len(set(got)) or set(got) != expected:
+        fail(msg)
+
+expected = set(n for n in allnames if n.startswith('p1'))
+check_list(['p1*'], expected, 'listprincs with prefix')
+check_list(['p1*'], expected, 'kadmin.local listprincs with prefix', True)
+check_list(['p*'], allnames, 'listprincs across pages')
+check_list(['p*'], allnames, 'kadmin.local listprincs across pages', True)
+check_list(['?1*'], expected, 'listprincs without a prefix')
+
+# A hash database has no key order, so pages are chosen by sorting.
+realm.stop_kadmind()
+realm.run([kdb5_util, 'destroy', '-f'])
+realm.run([kdb5_util, 'create', '-W', '-s', '-P', 'master', '-x',
+           'hash=true'])
+realm.run([kadminl, 'addprincs', '-nokey', '-'],
+          input='\n'.join(names) + '\n')
+realm.addprinc(realm.admin_princ, password('admin'))
+realm.start_kadmind()
+realm.prep_kadmin()
+check_list(['p*'], allnames, 'listprincs on hash DB')
+check_list(['p1*'], expected, 'listprincs on hash DB with prefix')
+
+success('Paged principal listing')
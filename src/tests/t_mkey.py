@@ -327,5 +327,24 @@ realm.run([kadminl, 'addprinc', '-randkey', realm.user_princ])
 check_mkvno(realm.user_princ, 1)
 realm.run([kdb5_util, 'use_mkey', '2', 'now-1day'])
 check_mkey_list((2, defetype, True, True), (1, des3, True, False))
+realm.stop()
+
+# Verify that update_princ_encryption, which applies its changes in one
+# transaction, records one update log entry per updated principal
+# (after the dummy entry created by resetting the ulog).
+conf = {'realms': {'$realm': {'iprop_enable': 'true',
+                              'iprop_logfile': '$testdir/db.ulog'}}}
+realm = K5Realm(kdc_conf=conf, start_kdc=False)
+nprincs = len(realm.run([kadminl, 'listprincs']).splitlines())
+add_mkey([])
+realm.run([kdb5_util, 'use_mkey', '2', 'now-1day'])
+realm.run([kproplog, '-R'])
+update_princ_encryption(False, 2, nprincs - 1, 0)
+out = realm.run([kproplog, '-h'])
+if 'Number of entries : %d\n' % nprincs not in out:
+    fail('Unexpected ulog entry count after update_princ_encryption')
+out = realm.run([kproplog])
+if ('Update principal : %s\n' % realm.host_princ) not in out:
+    fail('update_princ_encryption update missing from ulog')
 
 success('Master key rollover tests')
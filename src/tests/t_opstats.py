@@ -0,0 +1,88 @@
+#!/usr/bin/python
+from k5test import *
+
+plugin = os.path.join(buildtop, 'plugins', 'kadm5_hook', 'test',
+                      'kadm5_hook_test.so')
+krb5_conf = {'plugins': {'kadm5_hook': {'module': 'test:' + plugin}}}
+kdc_conf = {'kdcdefaults': {'kdc_stats_file': '$testdir/kdc.stats'},
+            'realms': {'$realm': {
+                'kadmind_stats_file': '$testdir/kadmind.stats',
+                'kadmind_slow_threshold': '500'}}}
+
+# Return a dictionary mapping each operation or phase in a statistics file to
+# a dictionary of its fields.
+def read_stats(filename):
+    stats = {}
+    f = open(os.path.join(realm.testdir, filename), 'r')
+    lines = f.read().splitlines()
+    f.close()
+    if not lines[0].startswith('# ') or not lines[1].startswith('# hist'):
+        fail('Missing statistics file header')
+    for line in lines[2:]:
+        fields = line.split()
+        stats[fields[0]] = dict(f.split('=') for f in fields[1:])
+    return stats
+
+def check_op(stats, op, count, errors):
+    fields = stats[op]
+    if fields['count'] != str(count) or fields['errors'] != str(errors):
+        fail('Unexpected counts for %s: %s' % (op, fields))
+    if sum(int(n) for n in fields['hist'].split(',')) != count:
+        fail('Histogram for %s does not match count' % op)
+
+realm = K5Realm(krb5_conf=krb5_conf, kdc_conf=kdc_conf, create_host=False,
+                start_kadmind=True)
+
+# Perform some kadmin operations, one of which fails and one of which is
+# slowed down by the test kadm5_hook module.
+realm.prep_kadmin()
+realm.run_kadmin(['addprinc', '-pw', 'pw', 'fast'])
+realm.run_kadmin(['getprinc', 'fast'])
+realm.run_kadmin(['getprinc', 'nonexistent'], expected_code=1)
+realm.run_kadmin(['addprinc', '-randkey', 'slowhook'])
+
+# Change a password through kpasswd, and get a service ticket.
+realm.run([kadminl, 'modprinc', '-pwexpire', '1 day ago', 'user'])
+realm.run([kinit, realm.user_princ], input=password('user') + '\nnp\nnp\n')
+realm.run([kvno, 'fast'])
+
+# The statistics are written when the daemons exit.
+realm.stop()
+
+stats = read_stats('kadmind.stats')
+check_op(stats, 'create_principal', 2, 0)
+check_op(stats, 'get_principal', 2, 1)
+check_op(stats, 'kpasswd', 1, 0)
+if int(stats['create_principal.hook']['max_us']) < 1000000:
+    fail('Hook time not attributed to create_principal')
+if int(stats['create_principal.kdb']['sum_us']) == 0:
+    fail('No KDB time recorded for create_principal')
+if int(stats['kpasswd.kdb']['sum_us']) == 0:
+    fail('No KDB time recorded for kpasswd')
+if int(stats['get_principal.hook']['sum_us']) != 0:
+    fail('Hook time recorded for get_principal')
+if int(stats['create_principal']['max_us']) < 1000000:
+    fail('Slow operation not reflected in create_principal maximum')
+
+# Only the slowed-down operation exceeds the threshold.
+f = open(os.path.join(realm.testdir, 'kadmind5.log'), 'r')
+log = f.read()
+f.close()
+slow = [l for l in log.splitlines() if 'slow operation' in l]
+if len(slow) != 1 or 'slow operation create_principal from ' not in slow[0]:
+    fail('Expected one slow operation log entry')
+if '; acl ' not in slow[0] or ', hook ' not in slow[0]:
+    fail('Slow operation log entry lacks phase times')
+
+stats = read_stats('kdc.stats')
+check_op(stats, 'tgs_req', 1, 0)
+if int(stats['as_req']['count']) < 3:
+    fail('Too few AS requests recorded')
+
+# Each kadmind worker process writes its own file.
+realm.start_kadmind(['-w', '2'])
+realm.stop_kadmind()
+for i in range(2):
+    read_stats('kadmind.stats.%d' % i)
+
+success('Operation statistics')
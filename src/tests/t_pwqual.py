@@ -42,6 +42,26 @@ out = realm.run([kadminl, 'addprinc', '-pw', 'birdsoranges', 'p6'],
 if 'Password may not be a pair of dictionary words' not in out:
     fail('Expected error not seen from combo module')
 
+# The dict module maps a compiled dictionary built from several word
+# lists, and folds case as it does for a text dictionary.
+cdictfile = os.path.join(os.getcwd(), 'testdir', 'dict.compiled')
+breached = ''.join('breached%d\r\n' % i for i in range(20000))
+realm.run([kdb5_util, 'compile_dict', cdictfile, dictfile, '-'],
+          input=breached)
+if os.path.getsize(cdictfile) != 24 + 8 * 20004:
+    fail('Unexpected compiled dictionary size')
+cconf = {'realms': {'$realm': {'dict_file': cdictfile}}}
+cenv = realm.special_env('compiled', True, krb5_conf={'plugins': {'pwqual': None}},
+                         kdc_conf=cconf)
+for pw in ('breached0', 'breached19999', 'BIRDS', 'oranges'):
+    out = realm.run([kadminl, 'addprinc', '-pw', pw, '-policy', 'pol', 'p7'],
+                    env=cenv, expected_code=1)
+    if 'Password is in the password dictionary' not in out:
+        fail('Expected error not seen from compiled dictionary password')
+realm.run([kadminl, 'addprinc', '-pw', 'breached20000', '-policy', 'pol',
+           'p7'], env=cenv)
+realm.run([kadminl, 'cpw', '-pw', 'birdsoranges', 'p7'], env=cenv)
+
 # These plugin ordering tests aren't specifically related to the
 # password quality interface, but are convenient to put here.
 
@@ -77,4 +77,24 @@ test_reject_afs3(realm, 'arcfour-hmac')
 test_reject_afs3(realm, 'aes256-cts-hmac-sha1-96')
 #test_reject_afs3(realm, 'des3-cbc-sha1')
 
+# Password keys for several enctypes are derived concurrently; check
+# that they match the keys derived for each enctype on its own.
+all_kstypes = ['aes256-cts-hmac-sha1-96', 'aes128-cts-hmac-sha1-96',
+               'camellia256-cts-cmac', 'camellia128-cts-cmac',
+               'des3-cbc-sha1', 'arcfour-hmac', 'des-cbc-crc']
+def multi_keys(kstypes):
+    kt = os.path.join(realm.testdir, 'multi.keytab')
+    if os.path.exists(kt):
+        os.remove(kt)
+    realm.run([kadminl, 'ank', '-e', ','.join(kstypes), '-pw', 'password',
+               'multi'])
+    realm.run([kadminl, 'ktadd', '-norandkey', '-k', kt, 'multi'])
+    realm.run([kadminl, 'delprinc', 'multi'])
+    out = realm.run([klist, '-eKk', kt])
+    return [l.split(None, 1)[1] for l in out.splitlines() if 'multi@' in l]
+together = multi_keys(all_kstypes)
+separate = [k for e in all_kstypes for k in multi_keys([e])]
+if len(together) != len(all_kstypes) or together != separate:
+    fail('Concurrently derived keys do not match individually derived keys')
+
 success("Salt types")